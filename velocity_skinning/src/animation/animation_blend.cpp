@@ -0,0 +1,205 @@
+#include "animation_blend.hpp"
+
+#include "../simd/simd_float4.hpp"
+
+#include <chrono>
+#include <cmath>
+
+namespace cgp
+{
+	static size_t padded_size(size_t N)
+	{
+		return (N + 3) & ~size_t(3);
+	}
+
+	void soa_pose::resize(size_t N_joint)
+	{
+		size_t const N = padded_size(N_joint);
+		numarray<float>* components[7] = { &qx, &qy, &qz, &qw, &tx, &ty, &tz };
+		for (numarray<float>* c : components) {
+			c->resize(N);
+			c->fill(0.0f);
+		}
+		for (size_t k = 0; k < N; ++k)
+			qw[k] = 1.0f; // padding lanes hold the identity
+	}
+
+	void soa_pose::set(numarray<affine_rt> const& pose)
+	{
+		for (size_t k = 0; k < pose.size(); ++k) {
+			quaternion const& q = pose[k].rotation.quat();
+			qx[k] = q.x; qy[k] = q.y; qz[k] = q.z; qw[k] = q.w;
+			tx[k] = pose[k].translation.x; ty[k] = pose[k].translation.y; tz[k] = pose[k].translation.z;
+		}
+	}
+
+	void soa_pose::get(numarray<affine_rt>& pose) const
+	{
+		for (size_t k = 0; k < pose.size(); ++k)
+			pose[k] = affine_rt(rotation_transform(quaternion(qx[k], qy[k], qz[k], qw[k])), vec3(tx[k], ty[k], tz[k]));
+	}
+
+	double animation_blend_statistics::ns_per_joint_layer() const
+	{
+		return joint_layer > 0 ? time_ns / double(joint_layer) : 0.0;
+	}
+
+
+	// Normalized lerp of quaternions (shortest path) and lerp of translations, for 4 joints at a time
+	//   result = blend(result, layer, w)
+	static void blend_override(soa_pose& result, soa_pose const& layer, numarray<float> const& weight, size_t N)
+	{
+		for (size_t k = 0; k < N; k += 4) {
+			float4 const w = float4::load(&weight[k]);
+			float4 const one_minus_w = float4(1.0f) - w;
+
+			float4 const ax = float4::load(&result.qx[k]), ay = float4::load(&result.qy[k]), az = float4::load(&result.qz[k]), aw = float4::load(&result.qw[k]);
+			float4 const bx = float4::load(&layer.qx[k]), by = float4::load(&layer.qy[k]), bz = float4::load(&layer.qz[k]), bw = float4::load(&layer.qw[k]);
+
+			float4 const d = ax * bx + ay * by + az * bz + aw * bw;
+			float4 const wb = w * sign(d);
+			float4 x = one_minus_w * ax + wb * bx;
+			float4 y = one_minus_w * ay + wb * by;
+			float4 z = one_minus_w * az + wb * bz;
+			float4 s = one_minus_w * aw + wb * bw;
+			float4 const inv_n = float4(1.0f) / sqrt(x * x + y * y + z * z + s * s);
+			(x * inv_n).store(&result.qx[k]);
+			(y * inv_n).store(&result.qy[k]);
+			(z * inv_n).store(&result.qz[k]);
+			(s * inv_n).store(&result.qw[k]);
+
+			(one_minus_w * float4::load(&result.tx[k]) + w * float4::load(&layer.tx[k])).store(&result.tx[k]);
+			(one_minus_w * float4::load(&result.ty[k]) + w * float4::load(&layer.ty[k])).store(&result.ty[k]);
+			(one_minus_w * float4::load(&result.tz[k]) + w * float4::load(&layer.tz[k])).store(&result.tz[k]);
+		}
+	}
+
+	// result = result * delta^w, where delta is the layer pose relative to its rest pose (already stored in layer)
+	static void blend_additive(soa_pose& result, soa_pose const& layer, numarray<float> const& weight, size_t N)
+	{
+		for (size_t k = 0; k < N; k += 4) {
+			float4 const w = float4::load(&weight[k]);
+			float4 const one_minus_w = float4(1.0f) - w;
+
+			// delta^w approximated by nlerp(identity, delta, w)
+			float4 const dw_sign = sign(float4::load(&layer.qw[k]));
+			float4 bx = w * dw_sign * float4::load(&layer.qx[k]);
+			float4 by = w * dw_sign * float4::load(&layer.qy[k]);
+			float4 bz = w * dw_sign * float4::load(&layer.qz[k]);
+			float4 bw = one_minus_w + w * dw_sign * float4::load(&layer.qw[k]);
+			float4 const inv_n = float4(1.0f) / sqrt(bx * bx + by * by + bz * bz + bw * bw);
+			bx = bx * inv_n; by = by * inv_n; bz = bz * inv_n; bw = bw * inv_n;
+
+			float4 const ax = float4::load(&result.qx[k]), ay = float4::load(&result.qy[k]), az = float4::load(&result.qz[k]), aw = float4::load(&result.qw[k]);
+
+			// translation: t_a + R_a (w t_delta), with v' = v + 2 q.xyz x (q.xyz x v + q.w v)
+			float4 const vx = w * float4::load(&layer.tx[k]), vy = w * float4::load(&layer.ty[k]), vz = w * float4::load(&layer.tz[k]);
+			float4 const cx = ay * vz - az * vy + aw * vx;
+			float4 const cy = az * vx - ax * vz + aw * vy;
+			float4 const cz = ax * vy - ay * vx + aw * vz;
+			float4 const two(2.0f);
+			(float4::load(&result.tx[k]) + vx + two * (ay * cz - az * cy)).store(&result.tx[k]);
+			(float4::load(&result.ty[k]) + vy + two * (az * cx - ax * cz)).store(&result.ty[k]);
+			(float4::load(&result.tz[k]) + vz + two * (ax * cy - ay * cx)).store(&result.tz[k]);
+
+			// rotation: q_a * q_delta
+			(aw * bx + ax * bw + ay * bz - az * by).store(&result.qx[k]);
+			(aw * by - ax * bz + ay * bw + az * bx).store(&result.qy[k]);
+			(aw * bz + ax * by - ay * bx + az * bw).store(&result.qz[k]);
+			(aw * bw - ax * bx - ay * by - az * bz).store(&result.qw[k]);
+		}
+	}
+
+	void animation_blend_evaluator::initialize(size_t N_joint_arg)
+	{
+		N_joint = N_joint_arg;
+		sample.resize(N_joint);
+		weight.resize(padded_size(N_joint));
+		result.resize(N_joint);
+		layer.resize(N_joint);
+	}
+
+	void animation_blend_evaluator::evaluate(blend_layer const* layers, size_t N_layer, numarray<affine_rt>& skeleton_local)
+	{
+		assert_cgp(N_layer>=1, "The blend stack needs at least a base layer");
+		auto const time_start = std::chrono::steady_clock::now();
+
+		size_t const N = padded_size(N_joint);
+		for (size_t l = 0; l < N_layer; ++l) {
+			blend_layer const& current = layers[l];
+			assert_cgp(current.animation!=nullptr && current.animation->number_joint()==N_joint, "Blend layer incompatible with the skeleton");
+
+			current.animation->evaluate_local(current.time, sample);
+			if (l == 0) {
+				result.set(sample);
+				continue;
+			}
+
+			for (size_t k = 0; k < N_joint; ++k)
+				weight[k] = current.weight * (current.joint_mask.size() > 0 ? current.joint_mask[k] : 1.0f);
+
+			if (current.mode == blend_mode::additive) {
+				numarray<affine_rt> const& rest_pose = current.animation->rest_pose_local;
+				for (size_t k = 0; k < N_joint; ++k)
+					sample[k] = inverse(rest_pose[k]) * sample[k];
+				layer.set(sample);
+				blend_additive(result, layer, weight, N);
+			}
+			else {
+				layer.set(sample);
+				blend_override(result, layer, weight, N);
+			}
+		}
+
+		skeleton_local.resize(N_joint);
+		result.get(skeleton_local);
+
+		auto const time_end = std::chrono::steady_clock::now();
+		statistics.time_ns += double(std::chrono::duration_cast<std::chrono::nanoseconds>(time_end - time_start).count());
+		statistics.joint_layer += N_joint * N_layer;
+	}
+
+	animation_blend_measure measure_animation_blend(skeleton_animation_structure const& skeleton, size_t N_layer, int N_time)
+	{
+		animation_blend_measure measure;
+		size_t const N_joint = skeleton.number_joint();
+		if (N_layer == 0 || N_joint == 0 || N_time <= 0)
+			return measure;
+		measure.number_layer = N_layer;
+		measure.number_joint = N_joint;
+
+		float const t_min = skeleton.animation_time[0];
+		float const duration = skeleton.animation_time[skeleton.animation_time.size() - 1] - t_min;
+		numarray<float> mask(N_joint);
+		for (size_t k = 0; k < N_joint; ++k)
+			mask[k] = k >= N_joint / 2 ? 1.0f : 0.0f;
+
+		numarray<blend_layer> layers(N_layer);
+		for (size_t l = 0; l < N_layer; ++l) {
+			layers[l].animation = &skeleton;
+			layers[l].weight = 0.5f;
+			if (l > 0 && l % 2 == 0) {
+				layers[l].mode = blend_mode::additive;
+				layers[l].joint_mask = mask;
+			}
+		}
+
+		animation_blend_evaluator evaluator;
+		evaluator.initialize(N_joint);
+		numarray<affine_rt> skeleton_local(N_joint);
+		for (int k = 0; k < N_time; ++k) {
+			float const t = (k + 0.618034f) * duration / N_time;
+			for (size_t l = 0; l < N_layer; ++l)
+				layers[l].time = t_min + std::fmod(t + l * duration / N_layer, duration);
+			evaluator.evaluate(&layers[0], N_layer, skeleton_local);
+		}
+		measure.ns_per_joint_layer = evaluator.statistics.ns_per_joint_layer();
+		measure.ns_per_pose = evaluator.statistics.time_ns / N_time;
+
+		auto const time_start = std::chrono::steady_clock::now();
+		for (int k = 0; k < N_time; ++k)
+			skeleton.evaluate_local(t_min + (k + 0.618034f) * duration / N_time, skeleton_local);
+		measure.sample_ns_per_joint = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - time_start).count() / (double(N_time) * N_joint);
+		return measure;
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "../skeleton/skeleton.hpp"
+
+
+namespace cgp
+{
+	enum class blend_mode {
+		override_pose, // the layer pose replaces the current pose, proportionally to its weight
+		additive       // the difference between the layer pose and its rest pose is added to the current pose
+	};
+
+	// One clip of the blend stack
+	struct blend_layer
+	{
+		skeleton_animation_structure const* animation = nullptr;
+		float time = 0.0f;
+		float weight = 1.0f;
+		blend_mode mode = blend_mode::override_pose;
+		numarray<float> joint_mask; // per-joint weight factor in [0,1], empty for all joints
+	};
+
+	// Joint transforms stored as one array per component, padded to a multiple of 4 joints
+	struct soa_pose
+	{
+		numarray<float> qx, qy, qz, qw;
+		numarray<float> tx, ty, tz;
+
+		void resize(size_t N_joint);
+		void set(numarray<affine_rt> const& pose);
+		void get(numarray<affine_rt>& pose) const;
+	};
+
+	struct animation_blend_statistics
+	{
+		double time_ns = 0.0;       // accumulated evaluation time
+		size_t joint_layer = 0;     // accumulated number of (joint x layer) evaluated
+		double ns_per_joint_layer() const;
+	};
+
+	// Sample N clips and blend them layer after layer, with per-joint masks.
+	//  The first layer is the base pose. Once initialized, evaluate doesn't allocate memory.
+	struct animation_blend_evaluator
+	{
+		animation_blend_statistics statistics;
+
+		void initialize(size_t N_joint);
+		void evaluate(blend_layer const* layers, size_t N_layer, numarray<affine_rt>& skeleton_local);
+
+	private:
+		size_t N_joint = 0;
+		numarray<affine_rt> sample; // raw sample of a layer
+		numarray<float> weight;     // per-joint weight of the current layer (padded)
+		soa_pose result;
+		soa_pose layer;
+	};
+
+	struct animation_blend_measure
+	{
+		size_t number_layer = 0;
+		size_t number_joint = 0;
+		double ns_per_joint_layer = 0.0; // sampling and blending, per joint and per layer
+		double ns_per_pose = 0.0;        // evaluation of the whole stack
+		double sample_ns_per_joint = 0.0; // skeleton_animation_structure::evaluate_local of the clip alone, for comparison
+	};
+	// Stack of N_layer layers of the clip of skeleton at different times evaluated at N_time times:
+	//  the base layer, then alternately an override layer and an additive layer masked to the second half of the joints
+	animation_blend_measure measure_animation_blend(skeleton_animation_structure const& skeleton, size_t N_layer, int N_time);
+}
@@ -0,0 +1,290 @@
+#include "clip_library.hpp"
+
+#include "../skeleton/skeleton.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace cgp
+{
+	// Archive layout (little endian)
+	//   clip_archive_header
+	//   for each clip: float time[frame_count], then frame_count x joint_count x (qx,qy,qz,qw, tx,ty,tz) floats
+	//   clip_archive_entry[clip_count] at table_offset
+	static char const clip_archive_magic[8] = { 'V','S','C','L','I','P','0','1' };
+
+	struct clip_archive_header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t clip_count;
+		uint64_t table_offset;
+	};
+
+	struct clip_archive_entry
+	{
+		char name[48];
+		uint64_t offset;
+		uint32_t frame_count;
+		uint32_t joint_count;
+	};
+
+	static_assert(sizeof(clip_archive_header) == 24, "Unexpected padding in clip archive header");
+	static_assert(sizeof(clip_archive_entry) == 64, "Unexpected padding in clip archive entry");
+
+	static size_t const floats_per_transform = 7;
+
+	// Sampling interpolates between two frames: a clip needs at least two, at strictly increasing times
+	static bool valid_clip_times(unsigned char const* data, size_t frame_count)
+	{
+		if (frame_count < 2)
+			return false;
+		float previous = 0.0f;
+		for (size_t kt = 0; kt < frame_count; ++kt) {
+			float t;
+			std::memcpy(&t, data + kt * sizeof(float), sizeof(t));
+			if (!std::isfinite(t) || (kt > 0 && !(t > previous)))
+				return false;
+			previous = t;
+		}
+		return true;
+	}
+
+
+	size_t animation_clip::number_joint() const
+	{
+		return animation_geometry_local.size() > 0 ? animation_geometry_local[0].size() : 0;
+	}
+
+	size_t animation_clip::memory_size() const
+	{
+		size_t bytes = sizeof(animation_clip) + name.capacity();
+		bytes += animation_time.size() * sizeof(float);
+		for (size_t k = 0; k < animation_geometry_local.size(); ++k)
+			bytes += sizeof(numarray<affine_rt>) + animation_geometry_local[k].size() * sizeof(affine_rt);
+		return bytes;
+	}
+
+	numarray<affine_rt> animation_clip::evaluate_local(float t) const
+	{
+		return evaluate_animation_local(animation_time, animation_geometry_local, t);
+	}
+
+
+	bool write_clip_archive(std::string const& filename, numarray<animation_clip> const& clips)
+	{
+		// Clips that clip_library::open would reject, or whose name would be truncated, are refused before anything is written
+		for (animation_clip const& clip : clips) {
+			if (clip.name.size() >= sizeof(clip_archive_entry::name)) {
+				std::cerr << "Clip name " << clip.name << " longer than " << sizeof(clip_archive_entry::name) - 1 << " characters for " << filename << std::endl;
+				return false;
+			}
+			if (!valid_clip_times(reinterpret_cast<unsigned char const*>(clip.animation_time.data.data()), clip.animation_time.size())) {
+				std::cerr << "Clip " << clip.name << " needs at least two frames at increasing times for " << filename << std::endl;
+				return false;
+			}
+		}
+
+		std::ofstream stream(filename, std::ios::binary);
+		if (!stream.is_open())
+			return false;
+
+		clip_archive_header header;
+		std::memcpy(header.magic, clip_archive_magic, sizeof(header.magic));
+		header.version = 1;
+		header.clip_count = uint32_t(clips.size());
+		header.table_offset = 0;
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+		numarray<clip_archive_entry> table;
+		table.resize(clips.size());
+		for (size_t k = 0; k < clips.size(); ++k) {
+			animation_clip const& clip = clips[k];
+			assert_cgp(clip.animation_time.size()==clip.animation_geometry_local.size(), "Incoherent number of frames in clip "+clip.name);
+
+			clip_archive_entry& e = table[k];
+			std::memset(e.name, 0, sizeof(e.name));
+			std::memcpy(e.name, clip.name.c_str(), clip.name.size());
+			e.offset = uint64_t(stream.tellp());
+			e.frame_count = uint32_t(clip.animation_time.size());
+			e.joint_count = uint32_t(clip.number_joint());
+
+			stream.write(reinterpret_cast<char const*>(&clip.animation_time[0]), clip.animation_time.size() * sizeof(float));
+			for (size_t kt = 0; kt < clip.animation_geometry_local.size(); ++kt) {
+				for (affine_rt const& T : clip.animation_geometry_local[kt]) {
+					quaternion const& q = T.rotation.quat();
+					float const v[floats_per_transform] = { q.x, q.y, q.z, q.w, T.translation.x, T.translation.y, T.translation.z };
+					stream.write(reinterpret_cast<char const*>(v), sizeof(v));
+				}
+			}
+		}
+
+		header.table_offset = uint64_t(stream.tellp());
+		if (table.size() > 0)
+			stream.write(reinterpret_cast<char const*>(&table[0]), table.size() * sizeof(clip_archive_entry));
+		stream.seekp(0);
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+		return stream.good();
+	}
+
+
+	bool clip_library::open(std::string const& filename)
+	{
+		close();
+		if (!archive.open(filename))
+			return false;
+
+		clip_archive_header header;
+		if (archive.size() < sizeof(header)) {
+			close();
+			return false;
+		}
+		std::memcpy(&header, archive.data(), sizeof(header));
+		if (std::memcmp(header.magic, clip_archive_magic, sizeof(header.magic)) != 0 || header.version != 1
+			|| !archive.contains(header.table_offset, header.clip_count, sizeof(clip_archive_entry))) {
+			std::cerr << "Invalid clip archive " << filename << std::endl;
+			close();
+			return false;
+		}
+
+		// Only the table and the times are read at opening, the transforms are accessed on demand
+		table.resize(header.clip_count);
+		for (size_t k = 0; k < header.clip_count; ++k) {
+			clip_archive_entry e;
+			std::memcpy(&e, archive.data() + header.table_offset + k * sizeof(clip_archive_entry), sizeof(e));
+
+			// A name filling its whole field has no terminating zero: it has been truncated or the entry is corrupted
+			bool const valid_name = std::memchr(e.name, '\0', sizeof(e.name)) != nullptr;
+
+			// Times, then the transforms of each frame
+			uint64_t const frame_bytes = uint64_t(e.joint_count) * floats_per_transform * sizeof(float);
+			if (!valid_name || !archive.contains(e.offset, e.frame_count, sizeof(float))
+				|| !archive.contains(e.offset + uint64_t(e.frame_count) * sizeof(float), e.frame_count, frame_bytes)
+				|| !valid_clip_times(archive.data() + e.offset, e.frame_count)) {
+				std::cerr << "Invalid clip archive " << filename << std::endl;
+				close();
+				return false;
+			}
+
+			table[k] = { std::string(e.name), size_t(e.offset), size_t(e.frame_count), size_t(e.joint_count) };
+			index_of_name[table[k].name] = k;
+		}
+		return true;
+	}
+
+	void clip_library::close()
+	{
+		clear_cache();
+		table.clear();
+		index_of_name.clear();
+		archive.close();
+	}
+
+	bool clip_library::is_open() const
+	{
+		return archive.is_open();
+	}
+
+	size_t clip_library::number_clip() const
+	{
+		return table.size();
+	}
+
+	std::string const& clip_library::clip_name(size_t index) const
+	{
+		return table[index].name;
+	}
+
+	int clip_library::find(std::string const& name) const
+	{
+		auto const it = index_of_name.find(name);
+		return it == index_of_name.end() ? -1 : int(it->second);
+	}
+
+	size_t clip_library::clip_number_joint(size_t index) const
+	{
+		return table[index].joint_count;
+	}
+
+	std::shared_ptr<animation_clip const> clip_library::acquire(size_t index)
+	{
+		assert_cgp(index<table.size(), "Clip index out of the archive");
+
+		auto const it = resident.find(index);
+		if (it != resident.end()) {
+			statistics.hit++;
+			lru.splice(lru.begin(), lru, it->second.lru_position);
+			return it->second.clip;
+		}
+
+		statistics.miss++;
+		std::shared_ptr<animation_clip const> const clip = decode(index);
+
+		lru.push_front(index);
+		resident_clip r;
+		r.clip = clip;
+		r.lru_position = lru.begin();
+		r.bytes = clip->memory_size();
+		resident[index] = r;
+		statistics.resident_bytes += r.bytes;
+		statistics.resident_clip = resident.size();
+
+		evict_to_budget();
+		return clip;
+	}
+
+	numarray<affine_rt> clip_library::sample_local(size_t index, float t)
+	{
+		return acquire(index)->evaluate_local(t);
+	}
+
+	void clip_library::clear_cache()
+	{
+		lru.clear();
+		resident.clear();
+		statistics.resident_bytes = 0;
+		statistics.resident_clip = 0;
+	}
+
+	std::shared_ptr<animation_clip const> clip_library::decode(size_t index) const
+	{
+		entry const& e = table[index];
+		unsigned char const* data = archive.data() + e.offset;
+
+		std::shared_ptr<animation_clip> clip = std::make_shared<animation_clip>();
+		clip->name = e.name;
+		clip->animation_time.resize(e.frame_count);
+		std::memcpy(&clip->animation_time[0], data, e.frame_count * sizeof(float));
+		data += e.frame_count * sizeof(float);
+
+		clip->animation_geometry_local.resize(e.frame_count);
+		for (size_t kt = 0; kt < e.frame_count; ++kt) {
+			numarray<affine_rt>& frame = clip->animation_geometry_local[kt];
+			frame.resize(e.joint_count);
+			for (size_t kj = 0; kj < e.joint_count; ++kj) {
+				float v[floats_per_transform];
+				std::memcpy(v, data, sizeof(v));
+				data += sizeof(v);
+				frame[kj] = affine_rt(rotation_transform(quaternion(v[0], v[1], v[2], v[3])), vec3(v[4], v[5], v[6]));
+			}
+		}
+		return clip;
+	}
+
+	void clip_library::evict_to_budget()
+	{
+		// The most recently used clip is always kept, even if it exceeds the budget alone
+		while (statistics.resident_bytes > budget_bytes && lru.size() > 1) {
+			size_t const index = lru.back();
+			lru.pop_back();
+			auto const it = resident.find(index);
+			statistics.resident_bytes -= it->second.bytes;
+			resident.erase(it);
+			statistics.eviction++;
+		}
+		statistics.resident_clip = resident.size();
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "../memory/mapped_file.hpp"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+
+namespace cgp
+{
+	// A decoded animation clip: local joint transforms for every frame
+	struct animation_clip
+	{
+		std::string name;
+		numarray<float> animation_time;
+		numarray<numarray<affine_rt> > animation_geometry_local;
+
+		size_t number_joint() const;
+		size_t memory_size() const; // Bytes used by the decoded clip
+		numarray<affine_rt> evaluate_local(float t) const;
+	};
+
+	// Write clips in a packed archive readable by clip_library (false if a clip has less than two frames, times not increasing or a name too long)
+	bool write_clip_archive(std::string const& filename, numarray<animation_clip> const& clips);
+
+	struct clip_library_statistics
+	{
+		size_t hit = 0;      // Clip already decoded when sampled
+		size_t miss = 0;     // Clip decoded from the archive
+		size_t eviction = 0; // Clip removed from the cache to stay in budget
+		size_t resident_clip = 0;
+		size_t resident_bytes = 0;
+	};
+
+	// Library of clips stored in a memory-mapped archive
+	//  Clips are decoded when first sampled, and kept in a LRU cache limited to budget_bytes.
+	//  A clip still referenced by a shared_ptr stays valid after its eviction from the cache.
+	struct clip_library
+	{
+		size_t budget_bytes = 64 * 1024 * 1024;
+		clip_library_statistics statistics;
+
+		bool open(std::string const& filename); // false if a clip has less than two frames, times not increasing or a truncated name
+		void close();
+		bool is_open() const;
+
+		size_t number_clip() const;
+		std::string const& clip_name(size_t index) const;
+		int find(std::string const& name) const; // -1 if not found
+		size_t clip_number_joint(size_t index) const;
+
+		// Decoded clip (decoded now if not resident)
+		std::shared_ptr<animation_clip const> acquire(size_t index);
+		// Interpolated local joint transforms of the clip at time t
+		numarray<affine_rt> sample_local(size_t index, float t);
+
+		void clear_cache();
+
+	private:
+		struct entry
+		{
+			std::string name;
+			size_t offset;
+			size_t frame_count;
+			size_t joint_count;
+		};
+		struct resident_clip
+		{
+			std::shared_ptr<animation_clip const> clip;
+			std::list<size_t>::iterator lru_position;
+			size_t bytes;
+		};
+
+		std::shared_ptr<animation_clip const> decode(size_t index) const;
+		void evict_to_budget();
+
+		mapped_file archive;
+		numarray<entry> table;
+		std::unordered_map<std::string, size_t> index_of_name;
+		std::list<size_t> lru; // front = most recently used
+		std::unordered_map<size_t, resident_clip> resident;
+	};
+}
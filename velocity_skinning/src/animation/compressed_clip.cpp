@@ -0,0 +1,298 @@
+#include "compressed_clip.hpp"
+
+#include <algorithm>
+
+namespace cgp
+{
+	static float const sqrt2 = 1.41421356f;
+	static uint32_t const quaternion_component_mask = (1u << 15) - 1;
+	static float const quaternion_component_max = 32766.0f; // even, so that 0 is exactly representable
+	static float const translation_quantum_max = 65535.0f;
+
+	quantized_quaternion quantize_quaternion(quaternion const& q_input)
+	{
+		float q[4] = { q_input.x, q_input.y, q_input.z, q_input.w };
+		float const n = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+		for (int k = 0; k < 4; ++k)
+			q[k] /= n;
+
+		// On ties, prefer a positive component: q is then decoded with its original sign,
+		//  which keeps the interpolation between keys with orthogonal quaternions identical to the uncompressed clip
+		int largest = 0;
+		for (int k = 1; k < 4; ++k) {
+			float const a = std::abs(q[k]);
+			float const a_largest = std::abs(q[largest]);
+			if (a > a_largest + 1e-6f || (a > a_largest - 1e-6f && q[k] > 0 && q[largest] < 0))
+				largest = k;
+		}
+		// q and -q are the same rotation: make the dropped component positive
+		float const sign = q[largest] < 0 ? -1.0f : 1.0f;
+
+		// The three smallest components are in [-1/sqrt(2), 1/sqrt(2)]
+		uint64_t bits = uint64_t(largest);
+		for (int k = 0; k < 4; ++k) {
+			if (k == largest)
+				continue;
+			float const u = (sign * q[k] * sqrt2 + 1.0f) * 0.5f;
+			uint32_t const v = uint32_t(std::round(std::min(std::max(u, 0.0f), 1.0f) * quaternion_component_max)) & quaternion_component_mask;
+			bits = (bits << 15) | v;
+		}
+
+		quantized_quaternion result;
+		result.data[0] = uint16_t(bits >> 32);
+		result.data[1] = uint16_t(bits >> 16);
+		result.data[2] = uint16_t(bits);
+		return result;
+	}
+
+	quaternion dequantize_quaternion(quantized_quaternion const& quantized)
+	{
+		uint64_t const bits = (uint64_t(quantized.data[0]) << 32) | (uint64_t(quantized.data[1]) << 16) | uint64_t(quantized.data[2]);
+		int const largest = int((bits >> 45) & 3u);
+
+		float q[4];
+		float sum = 0.0f;
+		int shift = 30;
+		for (int k = 0; k < 4; ++k) {
+			if (k == largest)
+				continue;
+			uint32_t const v = uint32_t(bits >> shift) & quaternion_component_mask;
+			q[k] = (float(v) / quaternion_component_max * 2.0f - 1.0f) / sqrt2;
+			sum += q[k] * q[k];
+			shift -= 15;
+		}
+		q[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+		return quaternion(q[0], q[1], q[2], q[3]);
+	}
+
+	static quantized_translation quantize_translation(vec3 const& p, vec3 const& p_min, vec3 const& extent)
+	{
+		quantized_translation result;
+		for (int k = 0; k < 3; ++k) {
+			float const u = extent[k] > 0 ? (p[k] - p_min[k]) / extent[k] : 0.0f;
+			result.data[k] = uint16_t(std::round(std::min(std::max(u, 0.0f), 1.0f) * translation_quantum_max));
+		}
+		return result;
+	}
+
+	static vec3 dequantize_translation(quantized_translation const& q, vec3 const& p_min, vec3 const& extent)
+	{
+		vec3 p;
+		for (int k = 0; k < 3; ++k)
+			p[k] = p_min[k] + extent[k] * (q.data[k] / translation_quantum_max);
+		return p;
+	}
+
+	static float rotation_angle(rotation_transform const& a, rotation_transform const& b)
+	{
+		float const c = std::abs(dot(a.quat(), b.quat()));
+		return 2.0f * std::acos(std::min(c, 1.0f));
+	}
+
+
+	// Greedy piecewise linear fit: from each key, extend the segment as long as every skipped frame
+	//  is reproduced within the error by the interpolation of the (quantized) end keys
+	template <typename T, typename INTERPOLATE, typename DISTANCE>
+	static numarray<uint16_t> reduce_keys(numarray<T> const& decoded, numarray<T> const& original, numarray<float> const& time,
+		float max_error, int max_key_span, INTERPOLATE interpolate, DISTANCE distance)
+	{
+		size_t const N_frame = original.size();
+
+		bool constant = true;
+		for (size_t f = 1; f < N_frame && constant; ++f)
+			constant = distance(decoded[0], original[f]) <= max_error;
+		if (constant)
+			return numarray<uint16_t>{ 0 };
+
+		numarray<uint16_t> keys;
+		keys.push_back(0);
+		size_t k = 0;
+		while (k + 1 < N_frame) {
+			size_t m = k + 1;
+			while (m + 1 < N_frame && int(m + 1 - k) <= max_key_span) {
+				size_t const candidate = m + 1;
+				bool valid = true;
+				for (size_t f = k + 1; f < candidate && valid; ++f) {
+					float const alpha = (time[f] - time[k]) / (time[candidate] - time[k]);
+					valid = distance(interpolate(decoded[k], decoded[candidate], alpha), original[f]) <= max_error;
+				}
+				if (!valid)
+					break;
+				m = candidate;
+			}
+			keys.push_back(uint16_t(m));
+			k = m;
+		}
+		return keys;
+	}
+
+	compressed_clip compress_clip(
+		numarray<float> const& animation_time,
+		numarray<numarray<affine_rt> > const& animation_geometry_local,
+		compression_parameters const& parameters)
+	{
+		size_t const N_frame = animation_time.size();
+		assert_cgp(N_frame>=2 && N_frame==animation_geometry_local.size(), "Incoherent number of frames in the animation");
+		assert_cgp(N_frame<=65536, "Compressed clips are limited to 65536 frames");
+		size_t const N_joint = animation_geometry_local[0].size();
+
+		compressed_clip clip;
+		clip.animation_time = animation_time;
+		clip.track.resize(N_joint);
+
+		numarray<rotation_transform> rotation, rotation_decoded;
+		numarray<vec3> translation, translation_decoded;
+		numarray<quantized_quaternion> rotation_quantized;
+		numarray<quantized_translation> translation_quantized;
+		rotation.resize(N_frame); rotation_decoded.resize(N_frame); rotation_quantized.resize(N_frame);
+		translation.resize(N_frame); translation_decoded.resize(N_frame); translation_quantized.resize(N_frame);
+
+		for (size_t kj = 0; kj < N_joint; ++kj) {
+			compressed_track& track = clip.track[kj];
+
+			// Quantize every frame, the key reduction is then performed on the decoded values
+			vec3 p_min = animation_geometry_local[0][kj].translation;
+			vec3 p_max = p_min;
+			for (size_t kt = 0; kt < N_frame; ++kt) {
+				affine_rt const& T = animation_geometry_local[kt][kj];
+				rotation[kt] = T.rotation;
+				translation[kt] = T.translation;
+				for (int c = 0; c < 3; ++c) {
+					p_min[c] = std::min(p_min[c], T.translation[c]);
+					p_max[c] = std::max(p_max[c], T.translation[c]);
+				}
+			}
+			track.translation_min = p_min;
+			track.translation_extent = p_max - p_min;
+
+			for (size_t kt = 0; kt < N_frame; ++kt) {
+				rotation_quantized[kt] = quantize_quaternion(rotation[kt].quat());
+				rotation_decoded[kt] = rotation_transform(dequantize_quaternion(rotation_quantized[kt]));
+				translation_quantized[kt] = quantize_translation(translation[kt], p_min, track.translation_extent);
+				translation_decoded[kt] = dequantize_translation(translation_quantized[kt], p_min, track.translation_extent);
+			}
+
+			track.rotation_frame = reduce_keys(rotation_decoded, rotation, animation_time,
+				parameters.rotation_error, parameters.max_key_span,
+				[](rotation_transform const& a, rotation_transform const& b, float alpha) { return rotation_transform::lerp(a, b, alpha); },
+				rotation_angle);
+			track.translation_frame = reduce_keys(translation_decoded, translation, animation_time,
+				parameters.translation_error, parameters.max_key_span,
+				[](vec3 const& a, vec3 const& b, float alpha) { return (1.0f - alpha) * a + alpha * b; },
+				[](vec3 const& a, vec3 const& b) { return norm(a - b); });
+
+			for (uint16_t const f : track.rotation_frame)
+				track.rotation.push_back(rotation_quantized[f]);
+			for (uint16_t const f : track.translation_frame)
+				track.translation.push_back(translation_quantized[f]);
+		}
+
+		return clip;
+	}
+
+
+	size_t compressed_clip::number_joint() const
+	{
+		return track.size();
+	}
+
+	size_t compressed_clip::memory_size() const
+	{
+		size_t bytes = sizeof(compressed_clip) + animation_time.size() * sizeof(float);
+		for (compressed_track const& t : track) {
+			bytes += sizeof(compressed_track);
+			bytes += t.rotation_frame.size() * sizeof(uint16_t) + t.rotation.size() * sizeof(quantized_quaternion);
+			bytes += t.translation_frame.size() * sizeof(uint16_t) + t.translation.size() * sizeof(quantized_translation);
+		}
+		return bytes;
+	}
+
+	// Find the key segment [k, k+1] containing the time t, and the interpolation factor
+	static void find_key(numarray<uint16_t> const& frames, numarray<float> const& time, float t, size_t& k, float& alpha)
+	{
+		size_t const N_key = frames.size();
+		if (N_key == 1 || t <= time[frames[0]]) {
+			k = 0;
+			alpha = 0.0f;
+			return;
+		}
+		if (t >= time[frames[N_key - 1]]) {
+			k = N_key - 2;
+			alpha = 1.0f;
+			return;
+		}
+
+		// first key with a time > t
+		auto const it = std::upper_bound(frames.begin(), frames.end(), t,
+			[&time](float value, uint16_t frame) { return value < time[frame]; });
+		k = size_t(it - frames.begin()) - 1;
+
+		float const t0 = time[frames[k]];
+		float const t1 = time[frames[k + 1]];
+		alpha = (t - t0) / (t1 - t0);
+	}
+
+	void compressed_clip::evaluate_local(float t, numarray<affine_rt>& skeleton_local) const
+	{
+		size_t const N_joint = track.size();
+		skeleton_local.resize(N_joint);
+
+		for (size_t kj = 0; kj < N_joint; ++kj) {
+			compressed_track const& tr = track[kj];
+			size_t k;
+			float alpha;
+
+			find_key(tr.rotation_frame, animation_time, t, k, alpha);
+			rotation_transform R(dequantize_quaternion(tr.rotation[k]));
+			if (alpha > 0.0f)
+				R = rotation_transform::lerp(R, rotation_transform(dequantize_quaternion(tr.rotation[k + 1])), alpha);
+
+			find_key(tr.translation_frame, animation_time, t, k, alpha);
+			vec3 p = dequantize_translation(tr.translation[k], tr.translation_min, tr.translation_extent);
+			if (alpha > 0.0f)
+				p = (1.0f - alpha) * p + alpha * dequantize_translation(tr.translation[k + 1], tr.translation_min, tr.translation_extent);
+
+			skeleton_local[kj] = affine_rt(R, p);
+		}
+	}
+
+	numarray<affine_rt> compressed_clip::evaluate_local(float t) const
+	{
+		numarray<affine_rt> skeleton_local;
+		evaluate_local(t, skeleton_local);
+		return skeleton_local;
+	}
+
+	numarray<numarray<affine_rt> > compressed_clip::decompress() const
+	{
+		numarray<numarray<affine_rt> > frames;
+		frames.resize(animation_time.size());
+		for (size_t kt = 0; kt < animation_time.size(); ++kt)
+			evaluate_local(animation_time[kt], frames[kt]);
+		return frames;
+	}
+
+	void compressed_clip::scale(float s)
+	{
+		for (compressed_track& t : track) {
+			t.translation_min *= s;
+			t.translation_extent *= s;
+		}
+	}
+
+	compression_error compressed_clip_error(compressed_clip const& clip, numarray<numarray<affine_rt> > const& animation_geometry_local)
+	{
+		compression_error error;
+		numarray<affine_rt> frame;
+		for (size_t kt = 0; kt < clip.animation_time.size(); ++kt) {
+			clip.evaluate_local(clip.animation_time[kt], frame);
+			for (size_t kj = 0; kj < frame.size(); ++kj) {
+				affine_rt const& T = animation_geometry_local[kt][kj];
+				error.rotation = std::max(error.rotation, rotation_angle(frame[kj].rotation, T.rotation));
+				error.translation = std::max(error.translation, norm(frame[kj].translation - T.translation));
+			}
+		}
+		return error;
+	}
+}
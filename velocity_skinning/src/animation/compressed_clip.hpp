@@ -0,0 +1,73 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include <cstdint>
+
+
+namespace cgp
+{
+	struct compression_parameters
+	{
+		float rotation_error = 1e-3f;    // Maximal angle (radians) between a removed key and its interpolation
+		float translation_error = 1e-4f; // Maximal distance between a removed key and its interpolation
+		int max_key_span = 256;          // Maximal number of frames between two kept keys (bounds the compression time)
+	};
+
+	// Unit quaternion stored with the smallest-three encoding:
+	//  index of the largest component (2 bits) and the three others quantized on 15 bits each, in 48 bits
+	struct quantized_quaternion
+	{
+		uint16_t data[3];
+	};
+	quantized_quaternion quantize_quaternion(quaternion const& q);
+	quaternion dequantize_quaternion(quantized_quaternion const& q);
+
+	// Translation quantized on 16 bits per component, relative to the range of its track
+	struct quantized_translation
+	{
+		uint16_t data[3];
+	};
+
+	// Animation of one joint: keys on a subset of the frames, linearly interpolated in between
+	//  A constant channel is stored as a single key.
+	struct compressed_track
+	{
+		numarray<uint16_t> rotation_frame;      // Frame index of each rotation key
+		numarray<quantized_quaternion> rotation;
+
+		numarray<uint16_t> translation_frame;   // Frame index of each translation key
+		numarray<quantized_translation> translation;
+		vec3 translation_min;
+		vec3 translation_extent;
+	};
+
+	struct compressed_clip
+	{
+		numarray<float> animation_time;  // Time of the original frames
+		numarray<compressed_track> track; // One track per joint
+
+		size_t number_joint() const;
+		size_t memory_size() const;
+
+		// Sample the clip directly from the keys, without expanding it to full frames
+		numarray<affine_rt> evaluate_local(float t) const;
+		void evaluate_local(float t, numarray<affine_rt>& skeleton_local) const;
+
+		// Expand the clip to one rigid transform per joint and per frame
+		numarray<numarray<affine_rt> > decompress() const;
+		void scale(float s);
+	};
+
+	compressed_clip compress_clip(
+		numarray<float> const& animation_time,
+		numarray<numarray<affine_rt> > const& animation_geometry_local,
+		compression_parameters const& parameters);
+
+	// Maximal deviation of the compressed clip with respect to the original frames
+	struct compression_error
+	{
+		float rotation = 0.0f;    // radians
+		float translation = 0.0f;
+	};
+	compression_error compressed_clip_error(compressed_clip const& clip, numarray<numarray<affine_rt> > const& animation_geometry_local);
+}
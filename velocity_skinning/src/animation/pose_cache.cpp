@@ -0,0 +1,153 @@
+#include "pose_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace cgp
+{
+	void pose_cache::reset(skeleton_animation_structure const& skeleton, pose_cache_parameters const& value)
+	{
+		clear();
+		parameters = value;
+		size_t const N_frame = skeleton.number_animation_frame();
+		if (N_frame < 2 || skeleton.number_joint() == 0)
+			return;
+
+		number_joint = skeleton.number_joint();
+		t_min = skeleton.animation_time[0];
+		duration = skeleton.animation_time[N_frame - 1] - t_min;
+		if (duration <= 0.0f) {
+			number_joint = 0;
+			return;
+		}
+
+		size_t const pose_bytes = number_joint * sizeof(affine_rt);
+		size_t const max_sample = std::max(parameters.max_bytes / pose_bytes, size_t(2)) - 1;
+		number_sample = size_t(std::ceil(duration * std::max(parameters.sample_rate, 1.0f)));
+		number_sample = std::min(std::max(number_sample, size_t(1)), max_sample);
+		step = duration / number_sample;
+
+		pose.resize((number_sample + 1) * number_joint);
+		baked.resize(number_sample + 1);
+		baked.fill(0);
+	}
+
+	void pose_cache::clear()
+	{
+		number_joint = 0;
+		number_sample = 0;
+		t_min = 0.0f;
+		duration = 0.0f;
+		step = 0.0f;
+		pose.clear();
+		baked.clear();
+		baked_count = 0;
+		lookup_count = 0;
+	}
+
+	bool pose_cache::empty() const
+	{
+		return number_joint == 0;
+	}
+
+	void pose_cache::bake_sample(skeleton_animation_structure const& skeleton, size_t k)
+	{
+		// The clip is evaluated on [t_min, t_min+duration[ and loops: the last sample is the first one
+		float const t = k == number_sample ? t_min : t_min + k * step;
+		skeleton.evaluate_local(t, skeleton_local);
+
+		// skeleton_local_to_global written in place in the table (the parents come before their children)
+		affine_rt* global = &pose[k * number_joint];
+		numarray<int> const& parent_index = skeleton.parent_index;
+		global[0] = skeleton_local[0];
+		for (size_t j = 1; j < number_joint; ++j)
+			global[j] = global[parent_index[j]] * skeleton_local[j];
+		baked[k] = 1;
+		baked_count++;
+	}
+
+	void pose_cache::bake(skeleton_animation_structure const& skeleton)
+	{
+		for (size_t k = 0; k <= number_sample && !empty(); ++k)
+			if (baked[k] == 0)
+				bake_sample(skeleton, k);
+	}
+
+	void pose_cache::sample(skeleton_animation_structure const& skeleton, float t, numarray<affine_rt>& skeleton_global)
+	{
+		assert_cgp(!empty(), "The pose cache has not been reset with a looping clip");
+		lookup_count.fetch_add(1, std::memory_order_relaxed);
+
+		float u = std::fmod(t - t_min, duration) / step;
+		if (u < 0.0f)
+			u += float(number_sample);
+		size_t const k = std::min(size_t(u), number_sample - 1);
+		float const alpha = std::min(std::max(u - float(k), 0.0f), 1.0f);
+
+		if (baked[k] == 0)
+			bake_sample(skeleton, k);
+		if (baked[k + 1] == 0)
+			bake_sample(skeleton, k + 1);
+
+		affine_rt const* P0 = &pose[k * number_joint];
+		affine_rt const* P1 = &pose[(k + 1) * number_joint];
+		skeleton_global.resize(number_joint);
+		for (size_t j = 0; j < number_joint; ++j) {
+			rotation_transform const R = rotation_transform::lerp(P0[j].rotation, P1[j].rotation, alpha);
+			vec3 const T = P0[j].translation * (1.0f - alpha) + P1[j].translation * alpha;
+			skeleton_global[j] = affine_rt(R, T);
+		}
+	}
+
+	memory_usage memory_usage_of(pose_cache const& cache)
+	{
+		return memory_usage_of(cache.pose) + memory_usage_of(cache.baked);
+	}
+
+	pose_cache_measure measure_pose_cache(skeleton_animation_structure const& skeleton, pose_cache_parameters const& parameters, int N_time)
+	{
+		pose_cache_measure measure;
+		pose_cache cache;
+		cache.reset(skeleton, parameters);
+		if (cache.empty() || N_time <= 0)
+			return measure;
+		cache.bake(skeleton);
+		measure.number_sample = cache.number_sample;
+		measure.bytes = cache.pose.size() * sizeof(affine_rt);
+
+		// Times offset from the samples by an irrational fraction of the step, the worst case of the interpolation is approached
+		numarray<float> time(N_time);
+		for (int k = 0; k < N_time; ++k)
+			time[k] = cache.t_min + std::fmod((k + 0.618034f) * cache.duration / N_time, cache.duration);
+
+		numarray<numarray<affine_rt>> exact(N_time);
+		numarray<affine_rt> skeleton_local;
+		auto time_start = std::chrono::steady_clock::now();
+		for (int k = 0; k < N_time; ++k) {
+			skeleton.evaluate_local(time[k], skeleton_local);
+			skeleton_local_to_global(skeleton_local, skeleton.parent_index, exact[k]);
+		}
+		measure.evaluate_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - time_start).count() / N_time;
+
+		numarray<numarray<affine_rt>> cached(N_time);
+		time_start = std::chrono::steady_clock::now();
+		for (int k = 0; k < N_time; ++k)
+			cache.sample(skeleton, time[k], cached[k]);
+		measure.sample_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - time_start).count() / N_time;
+
+		for (int k = 0; k < N_time; ++k) {
+			for (size_t j = 0; j < cache.number_joint; ++j) {
+				measure.max_translation_error = std::max(measure.max_translation_error, norm(exact[k][j].translation - cached[k][j].translation));
+				// Angle from the chord between the unit quaternions (acos of their dot product is imprecise for small angles)
+				quaternion const& q0 = exact[k][j].rotation.data;
+				quaternion const& q1 = cached[k][j].rotation.data;
+				float const sign = dot(q0, q1) < 0.0f ? -1.0f : 1.0f;
+				float const dx = q0.x - sign * q1.x, dy = q0.y - sign * q1.y, dz = q0.z - sign * q1.z, dw = q0.w - sign * q1.w;
+				float const chord = std::min(std::sqrt(dx * dx + dy * dy + dz * dz + dw * dw), 2.0f);
+				measure.max_rotation_error = std::max(measure.max_rotation_error, 4.0f * std::asin(0.5f * chord));
+			}
+		}
+		return measure;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "../skeleton/skeleton.hpp"
+#include "../memory/memory_footprint.hpp"
+
+#include <atomic>
+
+
+namespace cgp
+{
+	struct pose_cache_parameters
+	{
+		float sample_rate = 120.0f;      // baked poses per second of the clip
+		size_t max_bytes = size_t(16) << 20; // the sample rate is lowered so that the table fits
+	};
+
+	// Global joint transforms of a looping clip baked at a fixed rate, stored contiguously by sample:
+	//  sample k covers pose[k*N_joint, (k+1)*N_joint[ at time t_min + k*step, for k in [0, number_sample] (the last one loops back to t_min).
+	//  Sampling looks up the two neighbouring baked poses and interpolates them (lerp of the rotations and of the translations),
+	//  instead of interpolating the keyframes and multiplying along the hierarchy. Samples are baked on first use.
+	//  The lazy fill modifies the cache: instances sharing it must sample it from a single thread, unless it has been baked entirely.
+	struct pose_cache
+	{
+		pose_cache_parameters parameters;
+		size_t number_joint = 0;
+		size_t number_sample = 0; // intervals: number_sample+1 poses
+		float t_min = 0.0f;
+		float duration = 0.0f;
+		float step = 0.0f;
+		numarray<affine_rt> pose;
+		numarray<unsigned char> baked;
+		size_t baked_count = 0;
+		std::atomic<size_t> lookup_count{ 0 }; // calls to sample since reset
+
+		// Table of the clip of skeleton (nothing baked). skeleton must be the one given to sample and bake.
+		void reset(skeleton_animation_structure const& skeleton, pose_cache_parameters const& value);
+		void clear();
+		bool empty() const;
+
+		void bake(skeleton_animation_structure const& skeleton); // all the samples at once
+		// Global transforms at t, brought back in the clip
+		void sample(skeleton_animation_structure const& skeleton, float t, numarray<affine_rt>& skeleton_global);
+
+	private:
+		void bake_sample(skeleton_animation_structure const& skeleton, size_t k);
+		numarray<affine_rt> skeleton_local; // scratch of bake_sample
+	};
+
+	memory_usage memory_usage_of(pose_cache const& cache);
+
+	// Cached sampling compared to the evaluation of the clip, at N_time times between the samples
+	struct pose_cache_measure
+	{
+		size_t number_sample = 0;
+		size_t bytes = 0;
+		float max_translation_error = 0.0f; // global joint positions
+		float max_rotation_error = 0.0f;    // angle in radians
+		double evaluate_ns = 0.0;            // per pose, interpolation of the keyframes and hierarchy
+		double sample_ns = 0.0;              // per pose, from the baked table
+	};
+	pose_cache_measure measure_pose_cache(skeleton_animation_structure const& skeleton, pose_cache_parameters const& parameters, int N_time);
+}
@@ -0,0 +1,417 @@
+#include "headless_driver.hpp"
+
+#include "../scene.hpp"
+#include "../loader/skinning_loader.hpp"
+#include "../loader/procedural_rig.hpp"
+#include "../skinning/skinning_fuzz.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace cgp;
+
+struct headless_options
+{
+	std::string shape = "cylinder";
+	std::string animation = "bend_zx";
+	int frames = 600;
+	float dt = 1.0f / 60.0f;
+	int instances = 0;
+	bool lod = false;
+	bool crowd = false;
+	int task_graph_threads = -1; // frames run as a task graph on this number of threads (0: hardware threads), none if negative
+	bool batched = false; // instances skinned by batched_skinning, and its throughput measured after the run
+	float pose_cache_rate = 0.0f; // poses baked per second of the clip, no pose cache if 0
+	int blend_layers = 0; // layers of the clip blended by animation_blend_evaluator after the run to measure its cost, none if 0
+	float budget_ms = -1.0f; // skinning of the instances under this time budget per frame, none if negative
+	int vertex_cache_frames = 0; // frames recorded in a vertex cache after the run, none if 0
+	bool quiet = false;
+	float fast_rotation_angle = 0.0f;
+	bool rotation_deviation = false;
+	std::string json; // report file, none if empty
+	int fuzz_case = 0; // differential fuzzing of the skinning implementations instead of the scene frames
+	unsigned int fuzz_seed = 1;
+	int fuzz_frames = 300;
+	procedural_rig_parameters procedural; // --shape chain|tree|hand
+	bool arena = false;
+	std::string huge_pages = "none"; // huge_page_mode of the arenas: none, transparent or explicit
+	std::string shm_output;  // name of the shared memory ring the skinned vertices are published to, none if empty
+	int shm_slots = 4;
+	std::string shm_consume; // local consumer of a ring published by another process instead of the scene frames
+	float shm_timeout = 5.0f; // seconds without new frame before the consumer stops
+};
+
+static bool parse_options(headless_options& options, int argc, char* argv[])
+{
+	for (int k = 1; k < argc; ++k) {
+		std::string const arg = argv[k];
+		bool const has_value = k + 1 < argc;
+		if (arg == "--shape" && has_value) options.shape = argv[++k];
+		else if (arg == "--animation" && has_value) options.animation = argv[++k];
+		else if (arg == "--frames" && has_value) options.frames = std::atoi(argv[++k]);
+		else if (arg == "--dt" && has_value) options.dt = float(std::atof(argv[++k]));
+		else if (arg == "--instances" && has_value) options.instances = std::atoi(argv[++k]);
+		else if (arg == "--json" && has_value) options.json = argv[++k];
+		else if (arg == "--fast-rotation" && has_value) options.fast_rotation_angle = float(std::atof(argv[++k]));
+		else if (arg == "--fuzz" && has_value) options.fuzz_case = std::atoi(argv[++k]);
+		else if (arg == "--fuzz-seed" && has_value) options.fuzz_seed = unsigned(std::strtoul(argv[++k], nullptr, 10));
+		else if (arg == "--fuzz-frames" && has_value) options.fuzz_frames = std::atoi(argv[++k]);
+		else if (arg == "--joints" && has_value) options.procedural.number_joint = std::atoi(argv[++k]);
+		else if (arg == "--branching" && has_value) options.procedural.branching = std::atoi(argv[++k]);
+		else if (arg == "--influences" && has_value) options.procedural.influence = std::atoi(argv[++k]);
+		else if (arg == "--rings" && has_value) options.procedural.ring = std::atoi(argv[++k]);
+		else if (arg == "--radial" && has_value) options.procedural.radial = std::atoi(argv[++k]);
+		else if (arg == "--seed" && has_value) options.procedural.seed = unsigned(std::strtoul(argv[++k], nullptr, 10));
+		else if (arg == "--rotation-deviation") options.rotation_deviation = true;
+		else if (arg == "--vertex-cache" && has_value) options.vertex_cache_frames = std::atoi(argv[++k]);
+		else if (arg == "--shm-output" && has_value) options.shm_output = argv[++k];
+		else if (arg == "--shm-slots" && has_value) options.shm_slots = std::atoi(argv[++k]);
+		else if (arg == "--shm-consume" && has_value) options.shm_consume = argv[++k];
+		else if (arg == "--shm-timeout" && has_value) options.shm_timeout = float(std::atof(argv[++k]));
+		else if (arg == "--arena") options.arena = true;
+		else if (arg == "--huge-pages" && has_value) options.huge_pages = argv[++k];
+		else if (arg == "--lod") options.lod = true;
+		else if (arg == "--crowd") options.crowd = true;
+		else if (arg == "--batched") options.batched = true;
+		else if (arg == "--task-graph" && has_value) options.task_graph_threads = std::atoi(argv[++k]);
+		else if (arg == "--pose-cache" && has_value) options.pose_cache_rate = float(std::atof(argv[++k]));
+		else if (arg == "--blend-layers" && has_value) options.blend_layers = std::atoi(argv[++k]);
+		else if (arg == "--budget" && has_value) options.budget_ms = float(std::atof(argv[++k]));
+		else if (arg == "--quiet") options.quiet = true;
+		else {
+			std::cerr << "Unknown argument " << arg << std::endl;
+			return false;
+		}
+	}
+	bool const huge_pages = options.huge_pages == "none" || options.huge_pages == "transparent" || options.huge_pages == "explicit";
+	return options.frames > 0 && options.dt > 0.0f && options.fuzz_case >= 0 && options.fuzz_frames > 0 && options.shm_slots > 0 && huge_pages;
+}
+
+static shape_loader find_shape_loader(headless_options& options)
+{
+	std::string const& name = options.shape;
+	if (name == "cylinder") return load_cylinder;
+	if (name == "rectangle") return load_rectangle;
+	if (procedural_topology_from_name(name, options.procedural.topology)) {
+		procedural_rig_parameters const parameters = options.procedural;
+		return [parameters](skeleton_animation_structure& skeleton, rig_structure& rig, mesh& shape) { load_procedural_rig(parameters, skeleton, rig, shape); };
+	}
+	return nullptr;
+}
+
+// The built-in clips animate the cylinder and the rectangle, the procedural motions the procedural rigs
+static animation_loader find_animation_loader(headless_options const& options)
+{
+	std::string const& name = options.animation;
+	procedural_topology topology;
+	if (!procedural_topology_from_name(options.shape, topology)) {
+		if (name == "bend_z") return load_animation_bend_z;
+		if (name == "bend_zx") return load_animation_bend_zx;
+		if (name == "twist_x") return load_animation_twist_x;
+		if (name == "translation") return load_animation_translation;
+		return nullptr;
+	}
+
+	procedural_motion motion;
+	if (name == "wave") motion = procedural_motion::wave;
+	else if (name == "twist") motion = procedural_motion::twist;
+	else return nullptr;
+	procedural_rig_parameters const parameters = options.procedural;
+	return [parameters, motion](numarray<numarray<affine_rt>>& animation, numarray<float>& time, numarray<int> const& parent_index) {
+		load_procedural_animation(parameters, motion, animation, time, parent_index); };
+}
+
+// Value below which a ratio q of the sorted values lies
+static double quantile(numarray<double> sorted, double q)
+{
+	if (sorted.size() == 0)
+		return 0.0;
+	size_t const k = std::min(size_t(q * sorted.size()), sorted.size() - 1);
+	return sorted[k];
+}
+
+// Returns 2 if an implementation diverges from velocity_skinning_compute
+static int run_fuzz(headless_options const& options)
+{
+	skinning_fuzz_parameters parameters;
+	parameters.number_frame = options.fuzz_frames;
+	parameters.dt = options.dt;
+
+	numarray<skinning_fuzz_report> const report = run_skinning_fuzz(default_skinning_reference(), default_skinning_candidates(), options.fuzz_seed, options.fuzz_case, parameters);
+
+	bool diverged = false;
+	std::cout << "Fuzzing " << options.fuzz_case << " cases from seed " << options.fuzz_seed << ", " << options.fuzz_frames << " frames each" << std::endl;
+	for (skinning_fuzz_report const& r : report) {
+		std::cout << "  " << r.candidate << ": " << r.case_run << " cases, max error " << r.max_error;
+		if (r.diverged) {
+			diverged = true;
+			std::cout << " - DIVERGED, seed " << r.seed;
+			if (r.frame != -1)
+				std::cout << " frame " << r.frame << " vertex " << r.vertex << (r.normal ? " (normal)" : " (position)");
+			std::cout << " error " << r.error;
+		}
+		std::cout << std::endl;
+	}
+	return diverged ? 2 : 0;
+}
+
+// Qualities of the instances in the last frame, when they are skinned under a time budget
+static std::string budget_summary(scene_structure const& scene)
+{
+	if (!scene.skinning_budget.enabled)
+		return "";
+	skinning_budget_statistics const& s = scene.skinning_budget.budget.statistics;
+	std::ostringstream out;
+	out << " (main " << scene.skinning_budget.main_ms << " ms, instances " << s.spent_ms << " of " << s.available_ms << " ms: " << s.quality_count[0] << " full, "
+		<< s.quality_count[1] << " no rotation, " << s.quality_count[2] << " linear, " << s.quality_count[3] << " reused, " << s.deadline_degraded << " late)";
+	return out.str();
+}
+
+// Reads --frames frames of a ring published by another process (e.g. a second headless run with --shm-output).
+//  The vertices are used in place in the read-only mapping (bounding box of the positions), as an external consumer would.
+static int run_shared_output_consumer(headless_options const& options)
+{
+	shared_output_reader reader;
+	auto const time_start = std::chrono::steady_clock::now();
+	auto elapsed_s = [](std::chrono::steady_clock::time_point since) { return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count(); };
+	while (!reader.open(options.shm_consume)) {
+		if (elapsed_s(time_start) > options.shm_timeout) {
+			std::cerr << "Could not open the shared memory output " << options.shm_consume << std::endl;
+			return 1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	std::cout << "Reading " << options.shm_consume << ": " << reader.vertex_count() << " vertices, " << reader.slot_count() << " slots" << std::endl;
+
+	auto last_frame = std::chrono::steady_clock::now();
+	while (reader.statistics.received < uint64_t(options.frames) && elapsed_s(last_frame) < options.shm_timeout) {
+		shared_output_received frame;
+		if (!reader.acquire(frame)) {
+			std::this_thread::yield();
+			continue;
+		}
+		last_frame = std::chrono::steady_clock::now();
+
+		vec3 p_min = frame.position.size() > 0 ? frame.position[0] : vec3();
+		vec3 p_max = p_min;
+		for (vec3 const& p : frame.position) {
+			for (int k = 0; k < 3; ++k) {
+				p_min[k] = std::min(p_min[k], p[k]);
+				p_max[k] = std::max(p_max[k], p[k]);
+			}
+		}
+		bool const valid = reader.release(frame);
+		if (!options.quiet)
+			std::cout << "frame " << frame.frame_id << (valid ? "" : " (torn)") << " latency " << frame.latency_ms << " ms, bounding box diagonal " << norm(p_max - p_min) << std::endl;
+	}
+
+	shared_output_statistics const& s = reader.statistics;
+	std::cout << s.received << " frames received, " << s.dropped << " dropped, " << s.torn << " torn, latency min " << s.latency_min_ms << " ms, mean "
+		<< s.mean_latency_ms() << " ms, max " << s.latency_max_ms << " ms" << std::endl;
+	if (!options.json.empty()) {
+		std::ofstream out(options.json);
+		out << "{\n\"shared_output\": { \"name\": \"" << options.shm_consume << "\", \"received\": " << s.received << ", \"dropped\": " << s.dropped
+			<< ", \"torn\": " << s.torn << ", \"latency_min_ms\": " << s.latency_min_ms << ", \"latency_mean_ms\": " << s.mean_latency_ms()
+			<< ", \"latency_max_ms\": " << s.latency_max_ms << " }\n}\n";
+	}
+	return s.received > 0 ? 0 : 1;
+}
+
+int run_headless_driver(scene_structure& scene, int argc, char* argv[])
+{
+	headless_options options;
+	if (!parse_options(options, argc, argv)) {
+		std::cerr << "Usage: " << argv[0] << " [--shape cylinder|rectangle|chain|tree|hand] [--animation bend_z|bend_zx|twist_x|translation|wave|twist] [--joints N] [--branching N] [--influences N] [--rings N] [--radial N] [--seed s] [--frames N] [--dt seconds] [--instances N] [--crowd] [--budget ms] [--batched] [--task-graph threads] [--pose-cache rate] [--blend-layers N] [--lod] [--vertex-cache frames] [--fast-rotation angle] [--rotation-deviation] [--quiet] [--json file] [--arena [--huge-pages none|transparent|explicit]] [--shm-output name [--shm-slots N]] [--shm-consume name [--shm-timeout seconds]] [--fuzz N [--fuzz-seed s] [--fuzz-frames F]]" << std::endl;
+		return 1;
+	}
+	if (options.fuzz_case > 0)
+		return run_fuzz(options);
+	if (!options.shm_consume.empty())
+		return run_shared_output_consumer(options);
+
+	shape_loader const load_shape = find_shape_loader(options);
+	animation_loader const load_animation = find_animation_loader(options);
+	if (load_shape == nullptr || load_animation == nullptr) {
+		std::cerr << "Unknown shape or animation: " << options.shape << " " << options.animation << std::endl;
+		return 1;
+	}
+
+	render_counter.reset();
+	scene.initialize();
+	scene.lod.enabled = options.lod;
+	scene.crowd.enabled = options.crowd;
+	scene.skinning_budget.enabled = options.budget_ms >= 0.0f;
+	scene.skinning_budget.budget.parameters.budget_ms = std::max(options.budget_ms, 0.0f);
+	scene.skinning_arena.enabled = options.arena;
+	scene.skinning_arena.huge_pages = options.huge_pages == "explicit" ? 2 : (options.huge_pages == "transparent" ? 1 : 0);
+	scene.shared_output.enabled = !options.shm_output.empty();
+	if (scene.shared_output.enabled)
+		scene.shared_output.name = options.shm_output;
+	scene.shared_output.slot_count = options.shm_slots;
+	scene.instances.count = options.instances;
+	scene.velocity_skinning_params.fast_rotation_angle = options.fast_rotation_angle;
+	scene.batched.enabled = options.batched;
+	scene.frame_graph.enabled = options.task_graph_threads >= 0;
+	if (scene.frame_graph.enabled)
+		scene.frame_graph.scheduler.initialize(size_t(options.task_graph_threads));
+	scene.pose_cache.enabled = options.pose_cache_rate > 0.0f;
+	scene.pose_cache.parameters.sample_rate = options.pose_cache_rate;
+	scene.load_content(options.shape + " " + options.animation, load_shape, load_animation);
+
+	scene.environment.camera_projection = scene.camera_projection.matrix();
+	scene.idle_frame();
+
+	numarray<double> frame_ms;
+	for (int k = 0; k < options.frames; ++k) {
+		scene.timer.t += options.dt;
+		if (scene.timer.t > scene.timer.t_max)
+			scene.timer.t = scene.timer.t_min;
+
+		render_statistics const before = render_counter;
+		auto const time_start = std::chrono::steady_clock::now();
+		scene.render_frame(options.dt);
+		double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+		frame_ms.push_back(ms);
+
+		if (!options.quiet)
+			std::cout << "frame " << k << " t=" << scene.timer.t << " " << ms << " ms, " << render_counter.update_bytes - before.update_bytes << " bytes updated, "
+				<< render_counter.draw_call - before.draw_call << " draws, " << scene.crowd.update.size() << " instances updated" << budget_summary(scene) << std::endl;
+	}
+
+	numarray<double> sorted = frame_ms;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (double ms : frame_ms)
+		total += ms;
+	double const mean = total / frame_ms.size();
+	std::cout << options.frames << " frames of " << options.shape << " " << options.animation << " (" << scene.asset->position_rest_pose.size() << " vertices): mean "
+		<< mean << " ms, median " << quantile(sorted, 0.5) << " ms, p95 " << quantile(sorted, 0.95) << " ms, max " << sorted[sorted.size() - 1] << " ms" << std::endl;
+
+	crowd_frame_statistics const& crowd = scene.crowd.scheduler.statistics;
+	if (options.crowd)
+		std::cout << "crowd of " << options.instances << " instances: updated per frame min " << crowd.min_updated << ", mean " << crowd.mean_updated()
+			<< ", max " << crowd.max_updated << std::endl;
+
+	if (scene.frame_graph.enabled) {
+		task_graph_profile const& profile = scene.frame_graph.profile;
+		std::cout << "task graph on " << scene.frame_graph.scheduler.number_thread() << " threads, last frame: " << scene.frame_graph.graph.size() << " tasks, wall "
+			<< profile.wall_ms << " ms, work " << profile.work_ms << " ms, critical path " << profile.critical_path_ms << " ms" << std::endl;
+	}
+
+	skinning_arena_data const& arena = scene.skinning_arena;
+	if (arena.enabled)
+		std::cout << "skinning arena (" << options.huge_pages << " huge pages): " << arena.buffers.arena.capacity() << " bytes" << (arena.buffers.arena.huge_page_backed() ? " on huge pages" : "")
+			<< ", instances " << memory_usage_of(arena.instances).bytes << " bytes" << (arena.instances.huge_page_backed() ? " on huge pages" : "") << std::endl;
+
+	if (scene.shared_output.writer.is_open())
+		std::cout << scene.shared_output.writer.published() << " frames published to " << scene.shared_output.name << std::endl;
+
+	skinning_budget_statistics const& budget = scene.skinning_budget.budget.statistics;
+	if (scene.skinning_budget.enabled)
+		std::cout << "budget of " << options.budget_ms << " ms: " << budget.frame_over_budget << " of " << budget.frame << " frames over budget (max "
+			<< budget.max_spent_ms << " ms), " << budget.total_degraded << " of " << budget.total_item << " instance updates degraded, "
+			<< budget.total_reused << " reused" << std::endl;
+
+	if (options.batched) {
+		size_t const N_instance = options.instances > 0 ? size_t(options.instances) : size_t(scene.batched.measure_instance);
+		velocity_skinning_parameters const& params = scene.velocity_skinning_params;
+		scene.batched.measure = measure_batched_skinning(scene.asset, N_instance, 60, scene.batched.engine.parameters,
+			params.speed_blending, params.linear_deformation_intensity, params.rotational_deformation_intensity);
+		batched_skinning_measure const& m = scene.batched.measure;
+		std::cout << "batched skinning of " << m.number_instance << " x " << m.number_vertex << " vertices: " << m.loop_vertices_per_s * 1e-6 << " -> "
+			<< m.batched_vertices_per_s * 1e-6 << " M instance-vertices/s, linear blend skinning " << m.loop_lbs_vertices_per_s * 1e-6 << " -> "
+			<< m.batched_lbs_vertices_per_s * 1e-6 << " M/s, max difference " << m.max_difference << std::endl;
+	}
+
+	if (scene.pose_cache.enabled) {
+		scene.pose_cache.measure = measure_pose_cache(scene.asset->skeleton, scene.pose_cache.parameters, 1000);
+		pose_cache_measure const& m = scene.pose_cache.measure;
+		std::cout << "pose cache at " << options.pose_cache_rate << " poses/s: " << m.number_sample + 1 << " poses, " << m.bytes << " bytes, pose "
+			<< m.evaluate_ns << " ns -> " << m.sample_ns << " ns, max error translation " << m.max_translation_error << " rotation " << m.max_rotation_error << " rad";
+		if (scene.pose_cache.cache != nullptr)
+			std::cout << ", " << scene.pose_cache.cache->baked_count << " baked for " << scene.pose_cache.cache->lookup_count << " lookups";
+		std::cout << std::endl;
+	}
+
+	animation_blend_measure blend;
+	if (options.blend_layers > 0) {
+		blend = measure_animation_blend(scene.asset->skeleton, size_t(options.blend_layers), 1000);
+		std::cout << "animation blend of " << blend.number_layer << " layers x " << blend.number_joint << " joints: " << blend.ns_per_joint_layer
+			<< " ns per joint per layer, " << blend.ns_per_pose << " ns per pose (clip alone " << blend.sample_ns_per_joint << " ns per joint)" << std::endl;
+	}
+
+	if (options.vertex_cache_frames > 0) {
+		scene.vertex_cache.number_frame = options.vertex_cache_frames;
+		scene.record_vertex_cache();
+		vertex_cache_measure const& m = scene.vertex_cache.measure;
+		std::cout << "vertex cache of " << m.number_frame << " frames: " << m.raw_bytes << " -> " << m.compressed_bytes << " bytes (x" << m.ratio << "), encode "
+			<< m.encode_ms << " ms, decode " << m.decode_gb_per_s << " GB/s, random access " << m.random_access_ms << " ms, max error position "
+			<< m.max_position_error << " normal " << m.max_normal_error << " rad" << std::endl;
+	}
+
+	if (options.rotation_deviation) {
+		scene.measure_fast_rotation();
+		for (size_t k = 0; k < scene.fast_rotation.report.size(); ++k) {
+			fast_rotation_report const& r = scene.fast_rotation.report[k];
+			std::cout << "fast rotation below " << options.fast_rotation_angle << " rad, " << scene.fast_rotation.clip[k] << ": max deviation " << r.max_deviation
+				<< " (vertex " << r.max_deviation_vertex << ", t=" << r.max_deviation_time << "), " << r.exact_ms << " ms -> " << r.fast_ms << " ms" << std::endl;
+		}
+	}
+
+	if (!options.json.empty()) {
+		memory_footprint const footprint = scene.compute_memory_footprint();
+		numarray<skinning_lod_measure> lod_measure;
+		if (options.lod)
+			lod_measure = measure_skinning_lod(scene.asset, 60, scene.velocity_skinning_params.speed_blending,
+				scene.velocity_skinning_params.linear_deformation_intensity, scene.velocity_skinning_params.rotational_deformation_intensity);
+
+		std::ofstream out(options.json);
+		out << "{\n\"shape\": \"" << options.shape << "\",\n\"animation\": \"" << options.animation << "\",\n\"frames\": " << options.frames
+			<< ",\n\"dt\": " << options.dt << ",\n\"instances\": " << options.instances
+			<< ",\n\"arena\": { \"enabled\": " << (arena.enabled ? "true" : "false") << ", \"huge_pages\": \"" << options.huge_pages << "\""
+			<< ", \"bytes\": " << arena.buffers.arena.capacity() << ", \"huge_page_backed\": " << (arena.buffers.arena.huge_page_backed() ? "true" : "false")
+			<< ", \"instance_bytes\": " << memory_usage_of(arena.instances).bytes << ", \"instance_huge_page_backed\": " << (arena.instances.huge_page_backed() ? "true" : "false") << " }"
+			<< ",\n\"frame_ms\": { \"mean\": " << mean << ", \"median\": " << quantile(sorted, 0.5) << ", \"p95\": " << quantile(sorted, 0.95) << ", \"max\": " << sorted[sorted.size() - 1] << " }"
+			<< ",\n\"render\": { \"upload_call\": " << render_counter.upload_call << ", \"upload_bytes\": " << render_counter.upload_bytes
+			<< ", \"update_call\": " << render_counter.update_call << ", \"update_bytes\": " << render_counter.update_bytes << ", \"draw_call\": " << render_counter.draw_call << " }"
+			<< ",\n\"crowd\": { \"enabled\": " << (options.crowd ? "true" : "false") << ", \"min_updated\": " << crowd.min_updated
+			<< ", \"mean_updated\": " << crowd.mean_updated() << ", \"max_updated\": " << crowd.max_updated << " }"
+			<< ",\n\"budget\": { \"enabled\": " << (scene.skinning_budget.enabled ? "true" : "false") << ", \"budget_ms\": " << std::max(options.budget_ms, 0.0f)
+			<< ", \"frames\": " << budget.frame << ", \"frames_over_budget\": " << budget.frame_over_budget << ", \"max_spent_ms\": " << budget.max_spent_ms
+			<< ", \"items\": " << budget.total_item << ", \"degraded\": " << budget.total_degraded << ", \"reused\": " << budget.total_reused << " }"
+			<< ",\n\"batched\": { \"instances\": " << scene.batched.measure.number_instance << ", \"vertices\": " << scene.batched.measure.number_vertex
+			<< ", \"loop_vertices_per_s\": " << scene.batched.measure.loop_vertices_per_s << ", \"batched_vertices_per_s\": " << scene.batched.measure.batched_vertices_per_s
+			<< ", \"loop_lbs_vertices_per_s\": " << scene.batched.measure.loop_lbs_vertices_per_s << ", \"batched_lbs_vertices_per_s\": " << scene.batched.measure.batched_lbs_vertices_per_s
+			<< ", \"max_difference\": " << scene.batched.measure.max_difference << " }"
+			<< ",\n\"pose_cache\": { \"sample_rate\": " << options.pose_cache_rate << ", \"poses\": " << (scene.pose_cache.measure.number_sample > 0 ? scene.pose_cache.measure.number_sample + 1 : 0)
+			<< ", \"bytes\": " << scene.pose_cache.measure.bytes << ", \"evaluate_ns\": " << scene.pose_cache.measure.evaluate_ns << ", \"sample_ns\": " << scene.pose_cache.measure.sample_ns
+			<< ", \"max_translation_error\": " << scene.pose_cache.measure.max_translation_error << ", \"max_rotation_error\": " << scene.pose_cache.measure.max_rotation_error << " }"
+			<< ",\n\"blend\": { \"layers\": " << blend.number_layer << ", \"joints\": " << blend.number_joint << ", \"ns_per_joint_layer\": " << blend.ns_per_joint_layer
+			<< ", \"ns_per_pose\": " << blend.ns_per_pose << ", \"sample_ns_per_joint\": " << blend.sample_ns_per_joint << " }"
+			<< ",\n\"vertex_cache\": { \"frames\": " << scene.vertex_cache.measure.number_frame << ", \"raw_bytes\": " << scene.vertex_cache.measure.raw_bytes
+			<< ", \"compressed_bytes\": " << scene.vertex_cache.measure.compressed_bytes << ", \"ratio\": " << scene.vertex_cache.measure.ratio
+			<< ", \"decode_gb_per_s\": " << scene.vertex_cache.measure.decode_gb_per_s << ", \"random_access_ms\": " << scene.vertex_cache.measure.random_access_ms
+			<< ", \"max_position_error\": " << scene.vertex_cache.measure.max_position_error << ", \"max_normal_error\": " << scene.vertex_cache.measure.max_normal_error << " }"
+			<< ",\n\"fast_rotation_angle\": " << options.fast_rotation_angle << ",\n\"fast_rotation\": [";
+		for (size_t k = 0; k < scene.fast_rotation.report.size(); ++k) {
+			fast_rotation_report const& r = scene.fast_rotation.report[k];
+			out << (k > 0 ? ", " : "") << "{ \"animation\": \"" << scene.fast_rotation.clip[k] << "\", \"max_deviation\": " << r.max_deviation
+				<< ", \"exact_ms\": " << r.exact_ms << ", \"fast_ms\": " << r.fast_ms << " }";
+		}
+		out << "],\n\"lod\": [";
+		for (size_t k = 0; k < lod_measure.size(); ++k) {
+			skinning_lod_measure const& m = lod_measure[k];
+			out << (k > 0 ? ", " : "") << "{ \"level\": " << k << ", \"sample\": " << m.sample << ", \"ms_per_frame\": " << m.ms_per_frame
+				<< ", \"max_error\": " << m.max_error << ", \"mean_error\": " << m.mean_error << " }";
+		}
+		out << "],\n\"footprint\": " << footprint.json() << "}\n";
+	}
+
+	return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Command line driver of the headless build (VELOCITY_SKINNING_HEADLESS): runs the frames of a scene at a fixed dt, without window
+//  velocity_skinning --shape cylinder --animation bend_zx --frames 600 --dt 0.0166 [--instances 4] [--crowd] [--budget 4] [--batched] [--task-graph 4] [--pose-cache 120] [--lod] [--vertex-cache 240] [--fast-rotation 0.5 --rotation-deviation] [--quiet] [--json report.json]
+//  velocity_skinning --shape chain|tree|hand --animation wave|twist [--joints 64 --branching 2 --influences 4 --rings 256 --radial 64 --seed 1]: procedural rig
+//  velocity_skinning ... --shm-output /velocity_skinning [--shm-slots 4] [--arena]: publishes the skinned vertices in a shared memory ring
+//  velocity_skinning --shm-consume /velocity_skinning [--frames 600]: local consumer of the ring, reports latency and dropped frames
+//  velocity_skinning --fuzz 200 [--fuzz-seed 1] [--fuzz-frames 300]: compares the skinning implementations to velocity_skinning_compute on random characters
+struct scene_structure;
+int run_headless_driver(scene_structure& scene, int argc, char* argv[]);
@@ -0,0 +1,277 @@
+#include "procedural_rig.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace cgp;
+
+// Uniform value in [0,1[ depending only on (seed, index), so that the parallel build doesn't depend on the order of the computations
+static float hash_uniform(unsigned int seed, unsigned int index)
+{
+	uint64_t x = (uint64_t(seed) << 32) ^ index;
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	x = x ^ (x >> 31);
+	return float(x >> 40) / float(1 << 24);
+}
+
+static float hash_symmetric(unsigned int seed, unsigned int index)
+{
+	return 2.0f * hash_uniform(seed, index) - 1.0f;
+}
+
+// Call work(begin, end) on contiguous ranges of [0, N[, one per thread
+template <typename F>
+static void parallel_ranges(size_t N, int number_thread, F const& work)
+{
+	size_t N_thread = number_thread > 0 ? size_t(number_thread) : std::max(1u, std::thread::hardware_concurrency());
+	N_thread = std::max(size_t(1), std::min(N_thread, N));
+	if (N_thread == 1) {
+		work(size_t(0), N);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	for (size_t k = 0; k < N_thread; ++k)
+		threads.push_back(std::thread(work, k * N / N_thread, (k + 1) * N / N_thread));
+	for (std::thread& t : threads)
+		t.join();
+}
+
+static int hand_phalanges(procedural_rig_parameters const& parameters)
+{
+	return std::max(1, (parameters.number_joint - 1) / std::max(parameters.branching, 1));
+}
+
+static int procedural_number_joint(procedural_rig_parameters const& parameters)
+{
+	if (parameters.topology == procedural_topology::hand)
+		return 1 + std::max(parameters.branching, 1) * hand_phalanges(parameters);
+	return std::max(parameters.number_joint, 2);
+}
+
+size_t procedural_rig_parameters::number_vertex() const
+{
+	return size_t(procedural_number_joint(*this) - 1) * std::max(ring, 2) * std::max(radial, 3);
+}
+
+char const* procedural_topology_name(procedural_topology topology)
+{
+	switch (topology) {
+	case procedural_topology::chain: return "chain";
+	case procedural_topology::tree: return "tree";
+	case procedural_topology::hand: return "hand";
+	}
+	return "";
+}
+
+bool procedural_topology_from_name(std::string const& name, procedural_topology& topology)
+{
+	for (procedural_topology t : { procedural_topology::chain, procedural_topology::tree, procedural_topology::hand }) {
+		if (name == procedural_topology_name(t)) {
+			topology = t;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string procedural_rig_parameters::name() const
+{
+	std::ostringstream s;
+	s << procedural_topology_name(topology) << " " << procedural_number_joint(*this) << " joints " << (number_vertex() + 500) / 1000 << "k vertices";
+	return s.str();
+}
+
+// Parents always come before their children
+static void procedural_skeleton(procedural_rig_parameters const& parameters, numarray<int>& parent_index, numarray<affine_rt>& rest_pose_local)
+{
+	int const N_joint = procedural_number_joint(parameters);
+	int const branching = std::max(parameters.branching, 1);
+	float const L = parameters.bone_length;
+	unsigned int const seed = parameters.seed;
+	parent_index.resize(N_joint);
+	rest_pose_local.resize(N_joint);
+
+	// The x axis of a joint frame points along the bone to its children
+	auto bone = [](rotation_transform const& r, float length) { return affine_rt(r, r * vec3{ length,0,0 }); };
+
+	parent_index[0] = -1;
+	rest_pose_local[0] = affine_rt();
+	for (int k = 1; k < N_joint; ++k) {
+		float const jitter_z = hash_symmetric(seed, 2 * k);
+		float const jitter_x = hash_symmetric(seed, 2 * k + 1);
+
+		if (parameters.topology == procedural_topology::chain) {
+			parent_index[k] = k - 1;
+			rest_pose_local[k] = bone(rotation_transform::from_axis_angle({ 0,0,1 }, 0.15f * jitter_z), L);
+		}
+		else if (parameters.topology == procedural_topology::tree) {
+			int const parent = (k - 1) / branching;
+			int const sibling = (k - 1) % branching;
+			int depth = 0;
+			for (int j = parent; j != -1; j = parent_index[j])
+				++depth;
+			float const fan = (sibling - 0.5f * (branching - 1)) * 0.6f + 0.1f * jitter_z;
+			parent_index[k] = parent;
+			rest_pose_local[k] = bone(rotation_transform::from_axis_angle({ 0,0,1 }, fan) * rotation_transform::from_axis_angle({ 1,0,0 }, 3.14f * jitter_x),
+				L * std::pow(0.85f, float(depth - 1)));
+		}
+		else { // hand: fingers fanning out from the wrist (joint 0)
+			int const P = hand_phalanges(parameters);
+			int const finger = (k - 1) / P;
+			int const phalanx = (k - 1) % P;
+			if (phalanx == 0) {
+				float const fan = (finger - 0.5f * (branching - 1)) * 0.35f;
+				parent_index[k] = 0;
+				rest_pose_local[k] = bone(rotation_transform::from_axis_angle({ 0,0,1 }, fan + 0.05f * jitter_z), 2.0f * L);
+			}
+			else {
+				parent_index[k] = k - 1;
+				rest_pose_local[k] = bone(rotation_transform::from_axis_angle({ 0,0,1 }, 0.1f + 0.05f * jitter_z), L * std::pow(0.8f, float(phalanx)));
+			}
+		}
+	}
+}
+
+void load_procedural_rig(procedural_rig_parameters const& parameters, skeleton_animation_structure& skeleton_data, rig_structure& rig, mesh& shape)
+{
+	// Skeleton
+	procedural_skeleton(parameters, skeleton_data.parent_index, skeleton_data.rest_pose_local);
+	skeleton_data.compressed_animation.reset(); // the animation is loaded afterwards in animation_geometry_local
+	numarray<int> const& parent_index = skeleton_data.parent_index;
+	numarray<affine_rt> const rest_pose = skeleton_local_to_global(skeleton_data.rest_pose_local, parent_index);
+
+	// One tube per bone: bone b goes from the joint parent_index[b+1] to the joint b+1, and is driven by the parent joint
+	size_t const N_bone = parent_index.size() - 1;
+	size_t const N_ring = std::max(parameters.ring, 2);
+	size_t const N_radial = std::max(parameters.radial, 3);
+	size_t const N_vertex_bone = N_ring * N_radial;
+	size_t const N_triangle_bone = 2 * (N_ring - 1) * N_radial;
+	size_t const N_influence = size_t(std::max(parameters.influence, 1));
+
+	// All the arrays are allocated once, then each thread fills the bones of its range
+	shape = mesh();
+	shape.position.resize(N_bone * N_vertex_bone);
+	shape.normal.resize(N_bone * N_vertex_bone);
+	shape.uv.resize(N_bone * N_vertex_bone);
+	shape.connectivity.resize(N_bone * N_triangle_bone);
+	rig.joint.resize(N_bone * N_vertex_bone);
+	rig.weight.resize(N_bone * N_vertex_bone);
+
+	parallel_ranges(N_bone, parameters.number_thread, [&](size_t bone_begin, size_t bone_end) {
+		numarray<int> candidate;
+		for (size_t b = bone_begin; b < bone_end; ++b) {
+			int const child = int(b + 1);
+			int const joint = parent_index[child];
+			vec3 const p0 = rest_pose[joint].translation;
+			vec3 const p1 = rest_pose[child].translation;
+			vec3 const axis = normalize(p1 - p0);
+			vec3 const e1 = normalize(std::abs(axis.z) < 0.9f ? cross(axis, vec3{ 0,0,1 }) : cross(axis, vec3{ 1,0,0 }));
+			vec3 const e2 = cross(axis, e1);
+
+			// Influences: the joint of the bone, the child joint, then the ancestors
+			candidate.clear();
+			candidate.push_back(joint);
+			candidate.push_back(child);
+			for (int j = parent_index[joint]; j != -1; j = parent_index[j])
+				candidate.push_back(j);
+			size_t const N_vertex_influence = std::min(N_influence, candidate.size());
+
+			for (size_t kr = 0; kr < N_ring; ++kr) {
+				float const u = kr / float(N_ring - 1);
+				float const alpha = 3.0f; // same weight evolution as load_cylinder
+				float w_parent = 0.0f, w_child = 0.0f;
+				if (u < 0.5f && parent_index[joint] != -1)
+					w_parent = 0.5f * std::pow(1 - u / 0.5f, alpha);
+				else if (u >= 0.5f)
+					w_child = 0.5f * std::pow((u - 0.5f) / 0.5f, alpha);
+
+				for (size_t ka = 0; ka < N_radial; ++ka) {
+					size_t const idx = b * N_vertex_bone + kr * N_radial + ka;
+					float const theta = 2 * Pi * ka / float(N_radial);
+					vec3 const n = std::cos(theta) * e1 + std::sin(theta) * e2;
+					shape.position[idx] = p0 + u * (p1 - p0) + parameters.radius * n;
+					shape.normal[idx] = n;
+					shape.uv[idx] = { u, ka / float(N_radial) };
+
+					numarray<int>& vertex_joint = rig.joint[idx];
+					numarray<float>& vertex_weight = rig.weight[idx];
+					vertex_joint.resize(N_vertex_influence);
+					vertex_weight.resize(N_vertex_influence);
+					float sum = 0.0f;
+					for (size_t k = 0; k < N_vertex_influence; ++k) {
+						vertex_joint[k] = candidate[k];
+						float w = 0.02f * (0.5f + hash_uniform(parameters.seed, unsigned(idx * N_influence + k)));
+						if (k == 0) w += 1.0f - w_parent - w_child;
+						else if (k == 1) w += w_child;
+						else if (k == 2) w += w_parent;
+						vertex_weight[k] = w;
+						sum += w;
+					}
+					for (size_t k = 0; k < N_vertex_influence; ++k)
+						vertex_weight[k] /= sum;
+				}
+			}
+
+			for (size_t kr = 0; kr + 1 < N_ring; ++kr) {
+				for (size_t ka = 0; ka < N_radial; ++ka) {
+					unsigned int const i00 = unsigned(b * N_vertex_bone + kr * N_radial + ka);
+					unsigned int const i01 = unsigned(b * N_vertex_bone + kr * N_radial + (ka + 1) % N_radial);
+					unsigned int const i10 = i00 + unsigned(N_radial);
+					unsigned int const i11 = i01 + unsigned(N_radial);
+					size_t const t = b * N_triangle_bone + 2 * (kr * N_radial + ka);
+					shape.connectivity[t] = { i00, i01, i11 };
+					shape.connectivity[t + 1] = { i00, i11, i10 };
+				}
+			}
+		}
+	});
+	shape.fill_empty_field();
+}
+
+void load_procedural_animation(procedural_rig_parameters const& parameters, procedural_motion motion,
+	numarray<numarray<affine_rt>>& animation_skeleton, numarray<float>& animation_time, numarray<int> const& parent_index)
+{
+	numarray<int> procedural_parent;
+	numarray<affine_rt> rest_pose_local;
+	procedural_skeleton(parameters, procedural_parent, rest_pose_local);
+	assert_cgp(procedural_parent.size() == parent_index.size(), "The animation doesn't match the procedural skeleton");
+
+	size_t const N_joint = parent_index.size();
+	numarray<int> depth(N_joint);
+	for (size_t k = 0; k < N_joint; ++k)
+		depth[k] = parent_index[k] == -1 ? 0 : depth[parent_index[k]] + 1;
+
+	// One period over 4 seconds, the last key is the first one so that the clip loops
+	size_t const N_key = 9;
+	animation_time.resize(N_key);
+	animation_skeleton.resize(N_key);
+	for (size_t kt = 0; kt < N_key; ++kt) {
+		float const phase = 2 * Pi * kt / float(N_key - 1);
+		animation_time[kt] = 4.0f * kt / float(N_key - 1);
+
+		numarray<affine_rt>& pose = animation_skeleton[kt];
+		pose = rest_pose_local;
+		for (size_t k = 1; k < N_joint; ++k) {
+			if (motion == procedural_motion::wave) {
+				// Bend propagating from the root to the extremities
+				float const angle = 0.5f * std::sin(phase - 0.6f * depth[k]);
+				pose[k].rotation = rest_pose_local[k].rotation * rotation_transform::from_axis_angle({ 0,0,1 }, angle);
+			}
+			else {
+				// Rotation of each bone around itself, with an amplitude depending on the joint
+				float const angle = (0.5f + 0.5f * hash_uniform(parameters.seed + 1, unsigned(k))) * std::sin(phase);
+				pose[k].rotation = rest_pose_local[k].rotation * rotation_transform::from_axis_angle({ 1,0,0 }, angle);
+			}
+		}
+		if (motion == procedural_motion::wave)
+			pose[0].translation = { 0, 0.1f * std::sin(phase), 0 };
+	}
+	animation_skeleton[N_key - 1] = animation_skeleton[0];
+}
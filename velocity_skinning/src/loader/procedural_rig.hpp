@@ -0,0 +1,40 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "../skinning/skinning.hpp"
+#include "../skeleton/skeleton.hpp"
+
+#include <string>
+
+
+// Skeletons, tube meshes and animations of configurable size, to measure how the skinning scales.
+//  Everything is a function of the parameters (seed included): the same parameters always give the same character,
+//  whatever the number of threads used to build it.
+enum class procedural_topology { chain, tree, hand };
+enum class procedural_motion { wave, twist };
+
+struct procedural_rig_parameters
+{
+	procedural_topology topology = procedural_topology::chain;
+	int number_joint = 16;   // hand: 1 + fingers * phalanges, rounded down
+	int branching = 2;       // tree: children per joint, hand: number of fingers
+	int influence = 4;       // influences per vertex (at most the number of joints reachable from the bone)
+	int ring = 64;           // rings of vertices along each bone
+	int radial = 32;         // vertices around each ring
+	float bone_length = 0.25f;
+	float radius = 0.04f;
+	unsigned int seed = 1;
+	int number_thread = 0;   // threads used to fill the mesh and the rig, 0: hardware concurrency
+
+	size_t number_vertex() const; // of the generated mesh
+	std::string name() const;     // e.g. "Chain 16 joints 32k vertices"
+};
+
+char const* procedural_topology_name(procedural_topology topology);
+bool procedural_topology_from_name(std::string const& name, procedural_topology& topology);
+
+// Same role as load_cylinder: skeleton_data gets the rest pose, the animation is loaded afterwards
+void load_procedural_rig(procedural_rig_parameters const& parameters, cgp::skeleton_animation_structure& skeleton_data, cgp::rig_structure& rig, cgp::mesh& shape);
+// Same role as load_animation_bend_z, for the skeleton of load_procedural_rig with the same parameters
+void load_procedural_animation(procedural_rig_parameters const& parameters, procedural_motion motion,
+	cgp::numarray<cgp::numarray<cgp::affine_rt>>& animation_skeleton, cgp::numarray<float>& animation_time, cgp::numarray<int> const& parent_index);
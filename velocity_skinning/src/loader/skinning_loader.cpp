@@ -78,6 +78,7 @@ void load_cylinder(skeleton_animation_structure& skeleton_data, rig_structure& r
 {
 	// Skeleton
 	skeleton_data.parent_index = {-1, 0, 1};
+	skeleton_data.compressed_animation.reset(); // the animation is loaded afterwards in animation_geometry_local
 	
 	rotation_transform r0 = rotation_transform();
 	skeleton_data.rest_pose_local.resize(3);
@@ -119,6 +120,7 @@ void load_rectangle(skeleton_animation_structure& skeleton_data, rig_structure&
 {
 	// Skeleton
 	skeleton_data.parent_index = {-1, 0, 1};
+	skeleton_data.compressed_animation.reset(); // the animation is loaded afterwards in animation_geometry_local
 	
 	rotation_transform r0 = rotation_transform();
 	skeleton_data.rest_pose_local.resize(3);
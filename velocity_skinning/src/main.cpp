@@ -4,6 +4,7 @@
 
 // Custom scene of this code
 #include "scene.hpp"
+#include "headless/headless_driver.hpp"
 
 
 scene_structure scene;
@@ -18,10 +19,18 @@ void animation_loop();
 
 timer_fps fps_record;
 
-int main(int, char* argv[])
+int main(int argc, char* argv[])
 {
 	std::cout << "Run " << argv[0] << std::endl;
 
+#ifdef VELOCITY_SKINNING_HEADLESS
+	// Null renderer: the frames are run by the command line driver, without window nor OpenGL context
+	project::path = cgp::project_path_find(argv[0], "shaders/");
+	return run_headless_driver(scene, argc, argv);
+#else
+	(void)argc;
+#endif
+
 	// Standard Initialization of an OpenGL ready window
 	scene.window = standard_window_initialization();
 
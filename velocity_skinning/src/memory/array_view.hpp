@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+
+namespace cgp
+{
+	// Non-owning view on a contiguous array (the memory belongs to an arena, a numarray, a mapped file, ...)
+	template <typename T>
+	struct array_view
+	{
+		T* data = nullptr;
+		size_t count = 0;
+
+		array_view() = default;
+		array_view(T* data_arg, size_t count_arg) : data(data_arg), count(count_arg) {}
+
+		size_t size() const { return count; }
+		T& operator[](size_t k) const { return data[k]; }
+		T* begin() const { return data; }
+		T* end() const { return data + count; }
+	};
+}
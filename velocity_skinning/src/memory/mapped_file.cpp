@@ -0,0 +1,171 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CGP_MAPPED_FILE_POSIX
+#endif
+
+namespace cgp
+{
+	mapped_file::mapped_file()
+		: mapped_data(nullptr), mapped_size(0), fallback_data()
+#ifdef _WIN32
+		, file_handle(nullptr), mapping_handle(nullptr)
+#endif
+	{}
+
+	mapped_file::~mapped_file()
+	{
+		close();
+	}
+
+	bool mapped_file::open(std::string const& filename)
+	{
+		close();
+
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			CloseHandle(file);
+			return false;
+		}
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		file_handle = file;
+		mapping_handle = mapping;
+		mapped_data = static_cast<unsigned char const*>(view);
+		mapped_size = size_t(file_size.QuadPart);
+		return true;
+
+#elif defined(CGP_MAPPED_FILE_POSIX)
+		int const fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat file_stat;
+		if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+		void* view = mmap(nullptr, size_t(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); // the mapping stays valid after closing the descriptor
+		if (view == MAP_FAILED)
+			return false;
+		mapped_data = static_cast<unsigned char const*>(view);
+		mapped_size = size_t(file_stat.st_size);
+		return true;
+
+#else
+		std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+		if (!stream.is_open())
+			return false;
+		std::streamsize const N = stream.tellg();
+		if (N <= 0)
+			return false;
+		fallback_data.resize(size_t(N));
+		stream.seekg(0, std::ios::beg);
+		stream.read(reinterpret_cast<char*>(fallback_data.data()), N);
+		mapped_data = fallback_data.data();
+		mapped_size = fallback_data.size();
+		return true;
+#endif
+	}
+
+	void mapped_file::close()
+	{
+		if (mapped_data == nullptr)
+			return;
+
+#if defined(_WIN32)
+		UnmapViewOfFile(mapped_data);
+		CloseHandle(static_cast<HANDLE>(mapping_handle));
+		CloseHandle(static_cast<HANDLE>(file_handle));
+		mapping_handle = nullptr;
+		file_handle = nullptr;
+#elif defined(CGP_MAPPED_FILE_POSIX)
+		munmap(const_cast<unsigned char*>(mapped_data), mapped_size);
+#else
+		fallback_data.clear();
+		fallback_data.shrink_to_fit();
+#endif
+		mapped_data = nullptr;
+		mapped_size = 0;
+	}
+
+	bool mapped_file::is_open() const
+	{
+		return mapped_data != nullptr;
+	}
+
+	unsigned char const* mapped_file::data() const
+	{
+		return mapped_data;
+	}
+
+	size_t mapped_file::size() const
+	{
+		return mapped_size;
+	}
+
+	bool mapped_file::contains(uint64_t offset, uint64_t count, uint64_t element_size) const
+	{
+		uint64_t const file_size = mapped_size;
+		if (offset > file_size)
+			return false;
+		return element_size == 0 || count <= (file_size - offset) / element_size;
+	}
+
+#ifdef CGP_MAPPED_FILE_POSIX
+	static void advise_range(unsigned char const* data, size_t size, size_t offset, size_t length, int advice)
+	{
+		if (data == nullptr || offset >= size)
+			return;
+		length = std::min(length, size - offset);
+
+		// madvise expects an address aligned on a page
+		size_t const page = size_t(sysconf(_SC_PAGESIZE));
+		size_t const begin = (offset / page) * page;
+		madvise(const_cast<unsigned char*>(data) + begin, offset + length - begin, advice);
+	}
+#endif
+
+	void mapped_file::advise_will_need(size_t offset, size_t length) const
+	{
+#ifdef CGP_MAPPED_FILE_POSIX
+		advise_range(mapped_data, mapped_size, offset, length, MADV_WILLNEED);
+#else
+		(void)offset; (void)length;
+#endif
+	}
+
+	void mapped_file::advise_dont_need(size_t offset, size_t length) const
+	{
+#ifdef CGP_MAPPED_FILE_POSIX
+		advise_range(mapped_data, mapped_size, offset, length, MADV_DONTNEED);
+#else
+		(void)offset; (void)length;
+#endif
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace cgp
+{
+	// Read-only memory mapping of a file
+	//  Uses mmap (POSIX) or MapViewOfFile (Windows). On platforms without mapping, the file is read in memory.
+	struct mapped_file
+	{
+		mapped_file();
+		~mapped_file();
+		mapped_file(mapped_file const&) = delete;
+		mapped_file& operator=(mapped_file const&) = delete;
+
+		bool open(std::string const& filename);
+		void close();
+
+		bool is_open() const;
+		unsigned char const* data() const;
+		size_t size() const;
+		// Whether count elements of element_size bytes at offset are inside the file (offsets read from the file can't overflow the check)
+		bool contains(uint64_t offset, uint64_t count, uint64_t element_size) const;
+
+		// Hints on the pages that will be accessed soon / that are not needed anymore (no-op when not supported)
+		void advise_will_need(size_t offset, size_t length) const;
+		void advise_dont_need(size_t offset, size_t length) const;
+
+	private:
+		unsigned char const* mapped_data;
+		size_t mapped_size;
+		std::vector<unsigned char> fallback_data;
+#ifdef _WIN32
+		void* file_handle;
+		void* mapping_handle;
+#endif
+	};
+}
@@ -0,0 +1,158 @@
+#include "memory_arena.hpp"
+
+#include "cgp/cgp.hpp"
+
+#include <cstdlib>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <sys/mman.h>
+#define CGP_MEMORY_ARENA_POSIX
+#endif
+
+namespace cgp
+{
+	static size_t const huge_page_size = 2 * 1024 * 1024;
+
+	static size_t round_up(size_t value, size_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	memory_arena::memory_arena()
+		: block(nullptr), block_capacity(0), offset(0), mapping(nullptr), mapping_size(0), huge_pages(false)
+	{}
+
+	memory_arena::~memory_arena()
+	{
+		release();
+	}
+
+	bool memory_arena::reserve(size_t capacity, huge_page_mode mode)
+	{
+		release();
+		if (capacity == 0)
+			return true;
+
+#if defined(CGP_MEMORY_ARENA_POSIX)
+		if (mode == huge_page_mode::explicit_pages) {
+#ifdef MAP_HUGETLB
+			size_t const size = round_up(capacity, huge_page_size);
+			void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (p != MAP_FAILED) {
+				mapping = p;
+				mapping_size = size;
+				block = static_cast<unsigned char*>(p);
+				huge_pages = true;
+			}
+#endif
+			if (mapping == nullptr)
+				mode = huge_page_mode::transparent; // empty huge page pool
+		}
+		if (mapping == nullptr) {
+			// Over-allocate to place the block on a huge page boundary, so that the kernel can use huge pages for all of it
+			size_t const size = mode == huge_page_mode::transparent ? round_up(capacity, huge_page_size) + huge_page_size : capacity;
+			void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED)
+				return false;
+			mapping = p;
+			mapping_size = size;
+			block = static_cast<unsigned char*>(p);
+			if (mode == huge_page_mode::transparent) {
+				block = reinterpret_cast<unsigned char*>(round_up(reinterpret_cast<size_t>(p), huge_page_size));
+#ifdef MADV_HUGEPAGE
+				huge_pages = madvise(block, round_up(capacity, huge_page_size), MADV_HUGEPAGE) == 0;
+#endif
+			}
+		}
+#elif defined(_WIN32)
+		if (mode == huge_page_mode::explicit_pages && GetLargePageMinimum() > 0) {
+			size_t const size = round_up(capacity, GetLargePageMinimum());
+			mapping = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			huge_pages = mapping != nullptr;
+		}
+		if (mapping == nullptr)
+			mapping = VirtualAlloc(nullptr, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (mapping == nullptr)
+			return false;
+		block = static_cast<unsigned char*>(mapping);
+#else
+		(void)mode;
+		mapping = std::malloc(capacity + huge_page_size);
+		if (mapping == nullptr)
+			return false;
+		block = reinterpret_cast<unsigned char*>(round_up(reinterpret_cast<size_t>(mapping), 64));
+#endif
+
+		block_capacity = capacity;
+		offset = 0;
+		return true;
+	}
+
+	void memory_arena::release()
+	{
+		if (mapping != nullptr) {
+#if defined(CGP_MEMORY_ARENA_POSIX)
+			munmap(mapping, mapping_size);
+#elif defined(_WIN32)
+			VirtualFree(mapping, 0, MEM_RELEASE);
+#else
+			std::free(mapping);
+#endif
+		}
+		block = nullptr;
+		block_capacity = 0;
+		offset = 0;
+		mapping = nullptr;
+		mapping_size = 0;
+		huge_pages = false;
+	}
+
+	void memory_arena::reset()
+	{
+		offset = 0;
+	}
+
+	void memory_arena::swap(memory_arena& other)
+	{
+		std::swap(block, other.block);
+		std::swap(block_capacity, other.block_capacity);
+		std::swap(offset, other.offset);
+		std::swap(mapping, other.mapping);
+		std::swap(mapping_size, other.mapping_size);
+		std::swap(huge_pages, other.huge_pages);
+	}
+
+	size_t memory_arena::capacity() const
+	{
+		return block_capacity;
+	}
+
+	size_t memory_arena::used() const
+	{
+		return offset;
+	}
+
+	bool memory_arena::huge_page_backed() const
+	{
+		return huge_pages;
+	}
+
+	size_t memory_arena::aligned_offset(size_t offset, size_t alignment)
+	{
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	unsigned char* memory_arena::allocate_bytes(size_t size, size_t alignment)
+	{
+		size_t const start = aligned_offset(offset, alignment);
+		assert_cgp(start + size <= block_capacity, "Memory arena capacity exceeded");
+		offset = start + size;
+		return block + start;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "array_view.hpp"
+
+#include <cstddef>
+#include <new>
+
+
+namespace cgp
+{
+	enum class huge_page_mode {
+		none,
+		transparent,   // regular pages, with the kernel asked to back them with huge pages (Linux THP)
+		explicit_pages // pages taken from the huge page pool (MAP_HUGETLB / MEM_LARGE_PAGES), regular pages if it fails
+	};
+
+	// Single block of memory in which arrays are placed one after the other (bump allocation)
+	//  The arrays are only released all together, by reset() or release().
+	struct memory_arena
+	{
+		memory_arena();
+		~memory_arena();
+		memory_arena(memory_arena const&) = delete;
+		memory_arena& operator=(memory_arena const&) = delete;
+
+		// Allocate the block (any previous block is released)
+		bool reserve(size_t capacity, huge_page_mode mode = huge_page_mode::none);
+		void release();
+		void reset();
+		void swap(memory_arena& other); // exchange the blocks, the arrays placed in them stay valid
+
+		// count default-constructed elements at an address multiple of alignment (power of 2)
+		template <typename T> array_view<T> allocate(size_t count, size_t alignment = 64);
+
+		size_t capacity() const;
+		size_t used() const;
+		bool huge_page_backed() const; // true if the block is (or was requested to be) backed by huge pages
+
+		// Number of bytes needed by an allocation placed at offset, including the alignment padding
+		static size_t aligned_offset(size_t offset, size_t alignment);
+
+	private:
+		unsigned char* allocate_bytes(size_t size, size_t alignment);
+
+		unsigned char* block;
+		size_t block_capacity;
+		size_t offset;
+		void* mapping;       // start of the system allocation (may differ from block for alignment)
+		size_t mapping_size;
+		bool huge_pages;
+	};
+
+
+	template <typename T> array_view<T> memory_arena::allocate(size_t count, size_t alignment)
+	{
+		T* data = reinterpret_cast<T*>(allocate_bytes(count * sizeof(T), alignment));
+		for (size_t k = 0; k < count; ++k)
+			new (data + k) T();
+		return array_view<T>(data, count);
+	}
+}
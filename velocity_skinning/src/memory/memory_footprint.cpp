@@ -0,0 +1,74 @@
+#include "memory_footprint.hpp"
+
+#include <sstream>
+
+namespace cgp
+{
+	memory_usage& memory_usage::operator+=(memory_usage const& other)
+	{
+		bytes += other.bytes;
+		allocation += other.allocation;
+		return *this;
+	}
+
+	memory_usage operator+(memory_usage a, memory_usage const& b)
+	{
+		a += b;
+		return a;
+	}
+
+	memory_usage memory_usage_of(mesh const& shape)
+	{
+		return memory_usage_of(shape.position) + memory_usage_of(shape.normal) + memory_usage_of(shape.color)
+			+ memory_usage_of(shape.uv) + memory_usage_of(shape.connectivity);
+	}
+
+	size_t gpu_bytes_of_mesh_drawable(mesh const& shape)
+	{
+		size_t const N = shape.position.size();
+		return N * (3 * sizeof(vec3) + sizeof(vec2)) + shape.connectivity.size() * sizeof(uint3);
+	}
+
+	void memory_footprint::add(std::string const& name, memory_usage const& cpu, size_t gpu_bytes)
+	{
+		entry e;
+		e.name = name;
+		e.cpu = cpu;
+		e.gpu_bytes = gpu_bytes;
+		entries.push_back(e);
+	}
+
+	memory_usage memory_footprint::total_cpu() const
+	{
+		memory_usage total;
+		for (entry const& e : entries)
+			total += e.cpu;
+		return total;
+	}
+
+	size_t memory_footprint::total_gpu_bytes() const
+	{
+		size_t total = 0;
+		for (entry const& e : entries)
+			total += e.gpu_bytes;
+		return total;
+	}
+
+	std::string memory_footprint::json() const
+	{
+		std::ostringstream s;
+		memory_usage const cpu = total_cpu();
+		s << "{\n  \"vertex_count\": " << vertex_count
+			<< ",\n  \"cpu_bytes\": " << cpu.bytes
+			<< ",\n  \"cpu_allocations\": " << cpu.allocation
+			<< ",\n  \"gpu_bytes\": " << total_gpu_bytes()
+			<< ",\n  \"components\": [";
+		for (size_t k = 0; k < entries.size(); ++k) {
+			entry const& e = entries[k];
+			s << (k > 0 ? "," : "") << "\n    { \"name\": \"" << e.name << "\", \"cpu_bytes\": " << e.cpu.bytes
+				<< ", \"cpu_allocations\": " << e.cpu.allocation << ", \"gpu_bytes\": " << e.gpu_bytes << " }";
+		}
+		s << "\n  ]\n}\n";
+		return s.str();
+	}
+}
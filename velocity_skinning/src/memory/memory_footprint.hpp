@@ -0,0 +1,71 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+
+#include <string>
+
+
+namespace cgp
+{
+	// Estimated cost of a heap allocation on top of the requested bytes (allocator header and rounding)
+	size_t const heap_allocation_overhead = 16;
+
+	struct memory_usage
+	{
+		size_t bytes = 0;      // heap bytes, allocation overhead included
+		size_t allocation = 0; // number of heap blocks
+
+		memory_usage& operator+=(memory_usage const& other);
+	};
+	memory_usage operator+(memory_usage a, memory_usage const& b);
+
+	// Heap block of a numarray (its capacity, not its size). The numarray object itself is counted by its owner.
+	template <typename T> memory_usage memory_usage_of(numarray<T> const& a);
+	// Outer block holding the inner numarray objects, plus one block per non-empty inner numarray
+	template <typename T> memory_usage memory_usage_of(numarray<numarray<T> > const& a);
+	memory_usage memory_usage_of(mesh const& shape);
+	// Buffers created by mesh_drawable::initialize_data_on_gpu (missing colors and uv are filled with default values)
+	size_t gpu_bytes_of_mesh_drawable(mesh const& shape);
+
+	// Bytes per component, for CPU and GPU memory
+	struct memory_footprint
+	{
+		struct entry
+		{
+			std::string name;
+			memory_usage cpu;
+			size_t gpu_bytes = 0;
+		};
+		numarray<entry> entries;
+		size_t vertex_count = 0; // to report the cost per vertex
+
+		void add(std::string const& name, memory_usage const& cpu, size_t gpu_bytes = 0);
+		memory_usage total_cpu() const;
+		size_t total_gpu_bytes() const;
+
+		std::string json() const;
+	};
+
+
+	template <typename T> memory_usage memory_usage_of(numarray<T> const& a)
+	{
+		memory_usage usage;
+		if (a.data.capacity() > 0) {
+			usage.bytes = a.data.capacity() * sizeof(T) + heap_allocation_overhead;
+			usage.allocation = 1;
+		}
+		return usage;
+	}
+
+	template <typename T> memory_usage memory_usage_of(numarray<numarray<T> > const& a)
+	{
+		memory_usage usage;
+		if (a.data.capacity() > 0) {
+			usage.bytes = a.data.capacity() * sizeof(numarray<T>) + heap_allocation_overhead;
+			usage.allocation = 1;
+		}
+		for (numarray<T> const& inner : a)
+			usage += memory_usage_of(inner);
+		return usage;
+	}
+}
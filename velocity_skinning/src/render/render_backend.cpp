@@ -0,0 +1,62 @@
+#include "render_backend.hpp"
+
+#include "../memory/memory_footprint.hpp"
+
+namespace cgp
+{
+	render_statistics render_counter;
+
+	void render_statistics::reset()
+	{
+		*this = render_statistics();
+	}
+
+	void render_initialize(mesh_drawable& drawable, mesh const& shape)
+	{
+		render_counter.upload_call++;
+		render_counter.upload_bytes += gpu_bytes_of_mesh_drawable(shape);
+#ifndef VELOCITY_SKINNING_HEADLESS
+		drawable.initialize_data_on_gpu(shape);
+#else
+		(void)drawable;
+#endif
+	}
+
+	void render_initialize(curve_drawable& drawable, numarray<vec3> const& position)
+	{
+		render_counter.upload_call++;
+		render_counter.upload_bytes += position.size() * sizeof(vec3);
+#ifndef VELOCITY_SKINNING_HEADLESS
+		drawable.initialize_data_on_gpu(position);
+#else
+		(void)drawable;
+#endif
+	}
+
+	void render_clear(mesh_drawable& drawable)
+	{
+#ifndef VELOCITY_SKINNING_HEADLESS
+		drawable.clear();
+#else
+		(void)drawable;
+#endif
+	}
+
+	void render_clear(curve_drawable& drawable)
+	{
+#ifndef VELOCITY_SKINNING_HEADLESS
+		drawable.clear();
+#else
+		(void)drawable;
+#endif
+	}
+
+	void render_load(opengl_shader_structure& shader, std::string const& vertex_shader, std::string const& fragment_shader)
+	{
+#ifndef VELOCITY_SKINNING_HEADLESS
+		shader.load(vertex_shader, fragment_shader);
+#else
+		(void)shader; (void)vertex_shader; (void)fragment_shader;
+#endif
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+
+#include <string>
+
+
+namespace cgp
+{
+	// GPU work requested by the scene since the last reset
+	struct render_statistics
+	{
+		size_t upload_call = 0;  // buffers created (or re-created)
+		size_t upload_bytes = 0;
+		size_t update_call = 0;  // buffers updated
+		size_t update_bytes = 0;
+		size_t draw_call = 0;
+
+		void reset();
+	};
+	extern render_statistics render_counter;
+
+	// Every upload and draw of the scene goes through these functions. They are recorded in render_counter,
+	//  and only reach OpenGL when the program is not built with VELOCITY_SKINNING_HEADLESS.
+	//  The headless build is a null renderer: the whole frame runs without window nor OpenGL context.
+	void render_initialize(mesh_drawable& drawable, mesh const& shape);
+	void render_initialize(curve_drawable& drawable, numarray<vec3> const& position);
+	void render_clear(mesh_drawable& drawable);
+	void render_clear(curve_drawable& drawable);
+	void render_load(opengl_shader_structure& shader, std::string const& vertex_shader, std::string const& fragment_shader);
+
+	template <typename T> void render_update(opengl_vbo_structure& vbo, numarray<T> const& data);
+	template <typename DRAWABLE, typename ENVIRONMENT> void render_draw(DRAWABLE const& drawable, ENVIRONMENT const& environment);
+	template <typename DRAWABLE, typename ENVIRONMENT> void render_draw_wireframe(DRAWABLE const& drawable, ENVIRONMENT const& environment, vec3 const& color);
+}
+
+
+namespace cgp
+{
+	template <typename T> void render_update(opengl_vbo_structure& vbo, numarray<T> const& data)
+	{
+		render_counter.update_call++;
+		render_counter.update_bytes += data.size() * sizeof(T);
+#ifndef VELOCITY_SKINNING_HEADLESS
+		vbo.update(data);
+#else
+		(void)vbo;
+#endif
+	}
+
+	template <typename DRAWABLE, typename ENVIRONMENT> void render_draw(DRAWABLE const& drawable, ENVIRONMENT const& environment)
+	{
+		render_counter.draw_call++;
+#ifndef VELOCITY_SKINNING_HEADLESS
+		draw(drawable, environment);
+#else
+		(void)drawable; (void)environment;
+#endif
+	}
+
+	template <typename DRAWABLE, typename ENVIRONMENT> void render_draw_wireframe(DRAWABLE const& drawable, ENVIRONMENT const& environment, vec3 const& color)
+	{
+		render_counter.draw_call++;
+#ifndef VELOCITY_SKINNING_HEADLESS
+		draw_wireframe(drawable, environment, color);
+#else
+		(void)drawable; (void)environment; (void)color;
+#endif
+	}
+}
@@ -4,6 +4,7 @@
 
 using namespace cgp;
 
+static void build_content(loaded_content& content, std::string const& name, shape_loader load_shape, animation_loader load_animation, content_settings const& settings);
 
 
 
@@ -12,92 +13,1033 @@ void scene_structure::initialize()
 	camera_control.initialize(inputs, window); // Give access to the inputs and window global state to the camera controler
 	camera_control.set_rotation_axis_y();
 	camera_control.look_at({ 3.0f, 2.0f, 2.0f }, {0,0,0}, {0,0,1});
-	global_frame.initialize_data_on_gpu(mesh_primitive_frame());
+	render_initialize(global_frame, mesh_primitive_frame());
+	render_load(packed_output.shader_octahedral, project::path + "shaders/mesh_octahedral/vert.glsl", project::path + "shaders/mesh/frag.glsl");
+	culling.bounds_drawable.display_type = curve_drawable_display_type::Segments;
+	render_initialize(culling.bounds_drawable, bounding_box_structure().edges());
 
 
-	mesh shape;
-	load_cylinder(skeleton_data, rig, shape);
-	load_animation_bend_zx(skeleton_data.animation_geometry_local,
-		skeleton_data.animation_time,
-		skeleton_data.parent_index);
-	update_new_content(shape, mesh_drawable::default_texture);
+	load_content("Cylinder bend zx", load_cylinder, load_animation_bend_zx);
 }
 
 void scene_structure::compute_deformation(float dt)
 {
+	if (skinning_thread.enabled) {
+		compute_deformation_thread();
+		return;
+	}
+	if (fixed_rate.enabled) {
+		compute_deformation_fixed_rate(dt);
+		return;
+	}
+	if (frame_graph.enabled) {
+		compute_deformation_task_graph(dt);
+		return;
+	}
+
 	float const t = timer.t;
 
-	skinning_data.skeleton_current = skeleton_data.evaluate_global(t);
-	visual_data.skeleton_current.update(skinning_data.skeleton_current, skeleton_data.parent_index);
+	evaluate_skeleton(t, skinning_data.skeleton_current);
+	visual_data.skeleton_current.update(skinning_data.skeleton_current, asset->skeleton.parent_index);
+
+	// Off-screen: only the velocity state is advanced
+	if (!update_culling(dt)) {
+		velocity_skinning_advance_state(skinning_data.skeleton_current, asset->velocity_rig, old_joint_rt, old_velocity, dt,
+			velocity_skinning_params.speed_blending);
+		return;
+	}
 
 	// Compute skinning deformation
-	velocity_skinning_compute(skinning_data.position_skinned, skinning_data.normal_skinned,
-		skinning_data.skeleton_current, skinning_data.skeleton_rest_pose,
-		skinning_data.position_rest_pose, skinning_data.normal_rest_pose,
-		rig, velocity_rig, old_joint_rt, old_velocity, dt,
+	auto const time_start = std::chrono::steady_clock::now();
+	if (skinning_arena.enabled) {
+		skinning_buffers& buffers = skinning_arena.buffers;
+		velocity_skinning_prepare(skinning_arena.frame, skinning_data.skeleton_current, asset->skeleton_rest_pose, asset->velocity_rig,
+			old_joint_rt, old_velocity, dt, velocity_skinning_params.speed_blending, velocity_skinning_params.fast_rotation_angle);
+
+		// The shared output ring replaces the outputs of the arena: the vertices are skinned directly in its slot
+		skinning_vertex_view view = buffers.view();
+		shared_output_frame shared_frame;
+		bool const shared = update_shared_output();
+		if (shared) {
+			shared_frame = shared_output.writer.begin_frame(++shared_output.frame_id);
+			view.position_skinned = shared_frame.position;
+			view.normal_skinned = shared_frame.normal;
+		}
+		// The packed vertices are written by the skinning along with the float ones
+		packed_vertex_buffer* const packed = packed_output.enabled ? &packed_output.buffer : nullptr;
+		if (packed != nullptr)
+			packed->resize(buffers.number_vertex());
+		velocity_skinning_vertices(0, buffers.number_vertex(), view, skinning_data.skeleton_current, skinning_arena.frame,
+			velocity_skinning_params.linear_deformation_intensity, velocity_skinning_params.rotational_deformation_intensity, packed);
+		velocity_skinning_finish(skinning_arena.frame, skinning_data.skeleton_current, old_joint_rt, old_velocity, velocity_skinning_params.speed_blending);
+		if (shared)
+			shared_output.writer.publish(shared_frame);
+
+		std::copy(view.position_skinned.begin(), view.position_skinned.end(), skinning_data.position_skinned.begin());
+		std::copy(view.normal_skinned.begin(), view.normal_skinned.end(), skinning_data.normal_skinned.begin());
+	}
+	else {
+		velocity_skinning_compute(skinning_data.position_skinned, skinning_data.normal_skinned,
+			skinning_data.skeleton_current, asset->skeleton_rest_pose,
+			asset->position_rest_pose, asset->normal_rest_pose,
+			asset->rig, asset->velocity_rig, old_joint_rt, old_velocity, dt,
+			velocity_skinning_params.speed_blending, velocity_skinning_params.linear_deformation_intensity,
+			velocity_skinning_params.rotational_deformation_intensity,
+			packed_output.enabled ? &packed_output.buffer : nullptr, velocity_skinning_params.fast_rotation_angle);
+		publish_shared_output(skinning_data.position_skinned, skinning_data.normal_skinned);
+	}
+	double const time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+	skinning_arena.skinning_ms = 0.95 * skinning_arena.skinning_ms + 0.05 * time_ms;
+	upload_skinned_vertices();
+
+}
+
+void scene_structure::compute_deformation_fixed_rate(float dt)
+{
+	int const N_step = fixed_rate.stepper.advance(dt);
+	float const h = fixed_rate.stepper.step();
+	float const period = timer.t_max - timer.t_min;
+
+	for (int k = 0; k < N_step; ++k)
+	{
+		// The last step of the frame ends at timer.t minus the time remaining in the accumulator
+		float t = timer.t - fixed_rate.stepper.accumulator - (N_step - 1 - k) * h;
+		t = timer.t_min + std::fmod(std::fmod(t - timer.t_min, period) + period, period);
+
+		evaluate_skeleton(t, skinning_data.skeleton_current);
+		std::swap(fixed_rate.skeleton_previous, fixed_rate.skeleton_next);
+		fixed_rate.skeleton_next = skinning_data.skeleton_current;
+
+		// Every step rotates the buffers: a skipped step holds the last skinned state
+		std::swap(fixed_rate.position_previous, fixed_rate.position_next);
+		std::swap(fixed_rate.normal_previous, fixed_rate.normal_next);
+		if (!update_culling(h)) {
+			velocity_skinning_advance_state(skinning_data.skeleton_current, asset->velocity_rig, old_joint_rt, old_velocity, h,
+				velocity_skinning_params.speed_blending);
+			fixed_rate.position_next = fixed_rate.position_previous;
+			fixed_rate.normal_next = fixed_rate.normal_previous;
+			continue;
+		}
+
+		velocity_skinning_compute(fixed_rate.position_next, fixed_rate.normal_next,
+			skinning_data.skeleton_current, asset->skeleton_rest_pose,
+			asset->position_rest_pose, asset->normal_rest_pose,
+			asset->rig, asset->velocity_rig, old_joint_rt, old_velocity, h,
+			velocity_skinning_params.speed_blending, velocity_skinning_params.linear_deformation_intensity,
+			velocity_skinning_params.rotational_deformation_intensity, nullptr, velocity_skinning_params.fast_rotation_angle);
+	}
+
+	// Display frames in between simulated frames are interpolated, the skeleton as the mesh
+	float const alpha = fixed_rate.stepper.alpha();
+	interpolate_skeleton(fixed_rate.skeleton_display, fixed_rate.skeleton_previous, fixed_rate.skeleton_next, alpha);
+	visual_data.skeleton_current.update(fixed_rate.skeleton_display, asset->skeleton.parent_index);
+	interpolate_vertices(skinning_data.position_skinned, fixed_rate.position_previous, fixed_rate.position_next, alpha);
+	interpolate_normals(skinning_data.normal_skinned, fixed_rate.normal_previous, fixed_rate.normal_next, alpha);
+
+	if (packed_output.enabled)
+		pack_vertices(packed_output.buffer, skinning_data.position_skinned, skinning_data.normal_skinned);
+	publish_shared_output(skinning_data.position_skinned, skinning_data.normal_skinned);
+	upload_skinned_vertices();
+}
+
+void scene_structure::compute_deformation_task_graph(float dt)
+{
+	float const t = timer.t;
+	size_t const N_vertex = asset->position_rest_pose.size();
+	size_t const chunk_size = std::max(frame_graph.chunk_size, 64);
+	bool const packed = packed_output.enabled;
+	if (packed)
+		packed_output.buffer.resize(N_vertex);
+
+	task_graph& graph = frame_graph.graph;
+	velocity_skinning_frame& frame = frame_graph.frame;
+	graph.clear();
+
+	int const pose = graph.add("pose", [this, t]() { evaluate_skeleton(t, skinning_data.skeleton_current); });
+	int const bounds = graph.add("bounds", [this, dt]() { compute_culling(dt); });
+	int const palette = graph.add("palette", [this, &frame, dt]() {
+		velocity_skinning_prepare(frame, skinning_data.skeleton_current, asset->skeleton_rest_pose, asset->velocity_rig,
+			old_joint_rt, old_velocity, dt, velocity_skinning_params.speed_blending, velocity_skinning_params.fast_rotation_angle);
+	});
+	// The velocity state is read by bounds and by the skinning of every chunk
+	int const state = graph.add("velocity state", [this, &frame]() {
+		velocity_skinning_finish(frame, skinning_data.skeleton_current, old_joint_rt, old_velocity, velocity_skinning_params.speed_blending);
+	});
+	graph.depend(bounds, pose);
+	graph.depend(palette, pose);
+	graph.depend(state, bounds);
+	graph.depend(state, palette);
+
+	for (size_t begin = 0; begin < N_vertex; begin += chunk_size) {
+		size_t const end = std::min(begin + chunk_size, N_vertex);
+		std::string const range = " [" + str(begin) + "," + str(end) + "[";
+
+		int const skin = graph.add("skin" + range, [this, &frame, begin, end]() {
+			if (culling.culled)
+				return;
+			velocity_skinning_vertices(begin, end, skinning_data.position_skinned, skinning_data.normal_skinned,
+				skinning_data.skeleton_current, asset->position_rest_pose, asset->normal_rest_pose,
+				asset->rig, asset->velocity_rig, frame,
+				velocity_skinning_params.linear_deformation_intensity, velocity_skinning_params.rotational_deformation_intensity);
+		});
+		graph.depend(skin, palette);
+		graph.depend(skin, bounds);
+		graph.depend(state, skin);
+
+		if (packed) {
+			int const pack = graph.add("pack" + range, [this, begin, end]() {
+				if (culling.culled)
+					return;
+				for (size_t k = begin; k < end; ++k)
+					packed_output.buffer.write(k, skinning_data.position_skinned[k], skinning_data.normal_skinned[k]);
+			});
+			graph.depend(pack, skin);
+		}
+	}
+
+	// The instances are independent of the main character and of each other: one task per single instance and per batch.
+	//  Under a time budget, they stay serial after the graph (each item is timed against the deadline).
+	crowd.in_frame_graph = instances.instances.size() > 0 && !skinning_budget.enabled;
+	if (crowd.in_frame_graph) {
+		// The lazy fill of the pose cache would be shared by the tasks
+		if (pose_cache.cache != nullptr)
+			pose_cache.cache->bake(asset->skeleton);
+		schedule_crowd(dt);
+		assign_crowd_updates();
+		for (size_t k : crowd.single) {
+			crowd_update const u = crowd.update[k];
+			graph.add("instance " + str(u.instance), [this, u]() { update_crowd_instance(u); });
+		}
+		size_t const N_batch = batched.engine.number_batch(batched.updates.size());
+		batched.workspaces.resize(N_batch);
+		for (size_t b = 0; b < N_batch; ++b) {
+			graph.add("batch " + str(b), [this, b, t]() {
+				velocity_skinning_parameters const& params = velocity_skinning_params;
+				batched.engine.update_batch(b, batched.updates, t, params.speed_blending, params.linear_deformation_intensity,
+					params.rotational_deformation_intensity, params.fast_rotation_angle, batched.workspaces[b]);
+			});
+		}
+	}
+
+	frame_graph.scheduler.run(graph, &frame_graph.profile);
+	frame_graph.critical_path = frame_graph.profile.critical_path_summary(graph);
+
+	// OpenGL calls stay on the main thread
+	visual_data.skeleton_current.update(skinning_data.skeleton_current, asset->skeleton.parent_index);
+	if (culling.display_bounds)
+		render_update(culling.bounds_drawable.vbo_position, culling.bounds.edges());
+	if (!culling.culled) {
+		publish_shared_output(skinning_data.position_skinned, skinning_data.normal_skinned);
+		upload_skinned_vertices();
+	}
+}
+
+void scene_structure::compute_deformation_thread()
+{
+	skinning_worker_input input;
+	input.t = timer.t;
+	input.speed_blending = velocity_skinning_params.speed_blending;
+	input.linear_deformation_intensity = velocity_skinning_params.linear_deformation_intensity;
+	input.rotational_deformation_intensity = velocity_skinning_params.rotational_deformation_intensity;
+	input.fast_rotation_angle = velocity_skinning_params.fast_rotation_angle;
+	skinning_thread.worker.publish_input(input);
+
+	// Results computed on a content that has been replaced since are dropped
+	skinning_worker_output const* output = skinning_thread.worker.receive();
+	if (output == nullptr || output->content != asset)
+		return;
+	skinning_thread.received_step = output->step;
+	publish_shared_output(output->position, output->normal);
+
+	visual_data.skeleton_current.update(output->skeleton, asset->skeleton.parent_index);
+	if (packed_output.enabled) {
+		pack_vertices(packed_output.buffer, output->position, output->normal);
+		packed_vertex_upload(packed_output.vbo, packed_output.buffer);
+	}
+	else {
+		render_update(visual_data.surface_skinned.vbo_position, output->position);
+		render_update(visual_data.surface_skinned.vbo_normal, output->normal);
+	}
+}
+
+std::shared_ptr<skinning_content> scene_structure::edit_asset() const
+{
+	return std::make_shared<skinning_content>(*asset);
+}
+
+void scene_structure::publish_asset(std::shared_ptr<skinning_content const> content)
+{
+	asset = std::move(content);
+	lod.measure.clear();
+	assets.insert(asset_name, asset);
+	if (skinning_thread.enabled)
+		skinning_thread.worker.publish_content(asset);
+	update_character_instances();
+}
+
+void scene_structure::update_lod()
+{
+	std::shared_ptr<skinning_content> content = edit_asset();
+	content->lod = skinning_lod();
+	if (lod.enabled)
+		build_skinning_lod(content->lod, content->position_rest_pose, lod.parameters);
+	publish_asset(content);
+}
+
+void scene_structure::update_character_instances()
+{
+	update_pose_cache();
+	size_t const N = size_t(std::max(instances.count, 0));
+	if (N == 0) {
+		instances.instances.clear();
+		update_instance_arena();
+		return;
+	}
+
+	if (instances.instances.size() == 0 || instances.instances[0].asset != asset) {
+		bounding_box_structure box;
+		for (vec3 const& p : asset->position_rest_pose)
+			box.add(p);
+		vec3 const center = 0.5f * (box.p_min + box.p_max);
+		crowd.radius = 0.0f;
+		for (vec3 const& p : asset->position_rest_pose)
+			crowd.radius = std::max(crowd.radius, norm(p - center));
+	}
+
+	if (batched.engine.asset != asset)
+		batched.engine.set_asset(asset);
+
+	// Rows of 16 instances
+	instances.instances.resize(N);
+	crowd.scheduler.resize(N);
+	skinning_budget.budget.resize(N);
+	for (size_t k = 0; k < N; ++k) {
+		character_instance& instance = instances.instances[k];
+		instance.time_offset = (k + 1) * instances.time_offset;
+		instance.translation = { (k % 16 + 1) * instances.spacing, (k / 16) * instances.spacing, 0.0f };
+		if (instance.asset != asset)
+			instance.set_asset(asset);
+		instance.poses = pose_cache.cache;
+	}
+	update_instance_arena();
+}
+
+void scene_structure::update_pose_cache()
+{
+	if (!pose_cache.enabled || asset == nullptr) {
+		pose_cache.cache = nullptr;
+		pose_cache.source = nullptr;
+	}
+	else if (pose_cache.cache == nullptr || pose_cache.source != asset || pose_cache.cache->parameters.sample_rate != pose_cache.parameters.sample_rate
+		|| pose_cache.cache->parameters.max_bytes != pose_cache.parameters.max_bytes) {
+		// A new table: the instances still holding the previous one keep it until they are given this one
+		pose_cache.cache = std::make_shared<cgp::pose_cache>();
+		pose_cache.cache->reset(asset->skeleton, pose_cache.parameters);
+		pose_cache.source = asset;
+	}
+	for (character_instance& instance : instances.instances)
+		instance.poses = pose_cache.cache;
+}
+
+void scene_structure::schedule_crowd(float dt)
+{
+	vec3 const camera_position = camera_control.camera_model.position();
+	size_t const N = instances.instances.size();
+
+	numarray<crowd_update>& update = crowd.update;
+	if (crowd.enabled) {
+		for (size_t k = 0; k < N; ++k) {
+			float const distance = norm(instances.instances[k].translation - camera_position);
+			crowd.scheduler.set_screen_size(k, screen_size_of_sphere(crowd.radius, distance, camera_projection.field_of_view));
+		}
+		crowd.scheduler.schedule(dt, update);
+	}
+	else {
+		update.resize(N);
+		for (size_t k = 0; k < N; ++k)
+			update[k] = { k, dt, 1 };
+	}
+}
+
+void scene_structure::assign_crowd_updates()
+{
+	vec3 const camera_position = camera_control.camera_model.position();
+	crowd.vertex_updated = 0;
+	crowd.single.clear();
+	batched.updates.clear();
+	for (size_t k = 0; k < crowd.update.size(); ++k) {
+		crowd_update const& u = crowd.update[k];
+		character_instance& instance = instances.instances[u.instance];
+		instance.lod_level = lod.enabled ? asset->lod.select_level(norm(instance.translation - camera_position)) : 0;
+		if (batched.enabled && instance.lod_level == 0 && instance.asset == batched.engine.asset) {
+			batched_instance_update b;
+			b.instance = &instance;
+			b.dt = u.dt;
+			b.frame_count = u.frame_count;
+			batched.updates.push_back(b);
+		}
+		else
+			crowd.single.push_back(k);
+		crowd.vertex_updated += instance.position_skinned.size();
+	}
+}
+
+void scene_structure::update_crowd_instance(crowd_update const& u)
+{
+	velocity_skinning_parameters const& params = velocity_skinning_params;
+	instances.instances[u.instance].update(timer.t, u.dt, params.speed_blending, params.linear_deformation_intensity, params.rotational_deformation_intensity,
+		params.fast_rotation_angle, u.frame_count);
+}
+
+void scene_structure::update_crowd(float dt)
+{
+	vec3 const camera_position = camera_control.camera_model.position();
+	size_t const N = instances.instances.size();
+	velocity_skinning_parameters const& params = velocity_skinning_params;
+
+	schedule_crowd(dt);
+	numarray<crowd_update>& update = crowd.update;
+	if (!skinning_budget.enabled) {
+		assign_crowd_updates();
+		for (size_t k : crowd.single)
+			update_crowd_instance(update[k]);
+		batched.engine.update(batched.updates, timer.t, params.speed_blending, params.linear_deformation_intensity,
+			params.rotational_deformation_intensity, params.fast_rotation_angle);
+		return;
+	}
+
+	crowd.vertex_updated = 0;
+
+	// The instances due share what remains of the budget after the main character, by size on screen
+	numarray<skinning_work_item>& items = skinning_budget.items;
+	skinning_budget.update_of_instance.resize(N);
+	items.resize(update.size());
+	for (size_t k = 0; k < update.size(); ++k) {
+		character_instance& instance = instances.instances[update[k].instance];
+		float const distance = norm(instance.translation - camera_position);
+		instance.lod_level = lod.enabled ? asset->lod.select_level(distance) : 0;
+		skinning_budget.update_of_instance[update[k].instance] = k;
+		items[k].index = update[k].instance;
+		items[k].vertex_count = instance.position_skinned.size();
+		items[k].priority = screen_size_of_sphere(crowd.radius, distance, camera_projection.field_of_view);
+	}
+	skinning_budget.budget.plan(items, skinning_budget.budget.parameters.budget_ms - skinning_budget.main_ms);
+	skinning_budget.budget.execute(items, [&](skinning_work_item const& item) {
+		crowd_update const& u = update[skinning_budget.update_of_instance[item.index]];
+		character_instance& instance = instances.instances[item.index];
+		instance.update(timer.t, u.dt, params.speed_blending, params.linear_deformation_intensity, params.rotational_deformation_intensity,
+			params.fast_rotation_angle, u.frame_count, item.quality);
+		if (item.quality != skinning_quality::reuse)
+			crowd.vertex_updated += instance.position_skinned.size();
+	});
+}
+
+void scene_structure::prepare_asset_surface(bool rest_pose)
+{
+	asset_surface_data& surface = visual_data.surface_asset;
+	if (!surface.initialized) {
+		render_initialize(surface.drawable, rest_pose_mesh(*asset));
+		surface.drawable.texture = visual_data.surface_skinned.texture;
+		surface.initialized = true;
+		surface.rest_pose = true;
+	}
+	if (rest_pose && !surface.rest_pose) {
+		render_update(surface.drawable.vbo_position, asset->position_rest_pose);
+		render_update(surface.drawable.vbo_normal, asset->normal_rest_pose);
+		surface.rest_pose = true;
+	}
+	surface.drawable.model.translation = { 0.0f, 0.0f, 0.0f };
+}
+
+void scene_structure::draw_character_instances()
+{
+	if (instances.instances.size() == 0)
+		return;
+
+	// The instances are drawn one after the other from the mesh of the asset, with their own vertices
+	prepare_asset_surface(false);
+	mesh_drawable& drawable = visual_data.surface_asset.drawable;
+	for (character_instance const& instance : instances.instances) {
+		render_update(drawable.vbo_position, instance.position_skinned);
+		render_update(drawable.vbo_normal, instance.normal_skinned);
+		drawable.model.translation = instance.translation;
+		render_draw(drawable, environment);
+	}
+	visual_data.surface_asset.rest_pose = false;
+}
+
+void scene_structure::update_skinning_arena()
+{
+	if (!skinning_arena.enabled)
+		skinning_arena.buffers.arena.release();
+	else if (!build_skinning_buffers(skinning_arena.buffers, asset->position_rest_pose, asset->normal_rest_pose, asset->rig, asset->velocity_rig, huge_page_mode(skinning_arena.huge_pages))) {
+		std::cerr << "Could not allocate the skinning arena" << std::endl;
+		skinning_arena.enabled = false;
+	}
+	update_instance_arena();
+}
+
+void scene_structure::update_instance_arena()
+{
+	instance_skinning_arena& arena = skinning_arena.instances;
+	size_t const N = instances.instances.size();
+	huge_page_mode const mode = huge_page_mode(skinning_arena.huge_pages);
+	if (!skinning_arena.enabled || N == 0)
+		arena.release();
+	else if (arena.asset != asset || arena.number_instance() != N || arena.mode != mode) {
+		if (!build_instance_skinning_arena(arena, asset, N, mode))
+			std::cerr << "Could not allocate the instance skinning arena" << std::endl;
+	}
+	// The instances not given a view skin their numarray
+	for (size_t k = 0; k < N; ++k)
+		instances.instances[k].arena = k < arena.number_instance() ? arena.view[k] : skinning_vertex_view();
+}
+
+void scene_structure::stream_current_pose()
+{
+	std::string const mesh_filename = project::path + "mesh.vsmesh";
+	std::string const output_filename = project::path + "skinned.bin";
+	if (!write_skinning_stream(mesh_filename, asset->position_rest_pose, asset->normal_rest_pose, asset->rig, asset->velocity_rig)) {
+		std::cerr << "Could not write " << mesh_filename << std::endl;
+		return;
+	}
+
+	skinning_stream stream;
+	stream.chunk_size = size_t(std::max(streaming.chunk_size, 1));
+	std::ofstream output(output_filename, std::ios::binary);
+	if (!stream.open(mesh_filename) || stream.max_joint() >= int(skinning_data.skeleton_current.size()) || !output.is_open()) {
+		std::cerr << "Could not stream " << mesh_filename << " to " << output_filename << std::endl;
+		return;
+	}
+
+	// The velocity state of the scene is used as is, without being advanced
+	velocity_skinning_frame frame;
+	velocity_skinning_prepare(frame, skinning_data.skeleton_current, asset->skeleton_rest_pose, asset->velocity_rig,
+		old_joint_rt, old_velocity, timer.scale / 60.0f, velocity_skinning_params.speed_blending, velocity_skinning_params.fast_rotation_angle);
+
+	auto const time_start = std::chrono::steady_clock::now();
+	stream.compute(skinning_data.skeleton_current, frame,
+		velocity_skinning_params.linear_deformation_intensity, velocity_skinning_params.rotational_deformation_intensity,
+		skinning_stream_file_output(output));
+	streaming.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+	streaming.chunk_bytes = stream.chunk_memory_size();
+	streaming.vertex_count = stream.number_vertex();
+}
+
+memory_footprint scene_structure::compute_memory_footprint() const
+{
+	memory_footprint report;
+	if (asset == nullptr)
+		return report; // before the first content
+	report.vertex_count = asset->position_rest_pose.size();
+
+	report.add("skinned vertices", memory_usage_of(skinning_data.position_skinned) + memory_usage_of(skinning_data.normal_skinned));
+	report.add("skeleton pose", memory_usage_of(skinning_data.skeleton_current));
+	report.add("velocity state", memory_usage_of(old_joint_rt) + memory_usage_of(old_velocity)
+		+ memory_usage_of(frame_graph.frame) + memory_usage_of(skinning_arena.frame));
+	report.add("fixed rate keyframes", memory_usage_of(fixed_rate.position_previous) + memory_usage_of(fixed_rate.position_next)
+		+ memory_usage_of(fixed_rate.normal_previous) + memory_usage_of(fixed_rate.normal_next));
+	report.add("packed vertices", memory_usage_of(packed_output.buffer.bytes), packed_output.enabled ? packed_output.buffer.bytes.size() : 0);
+	report.add("blend layer", memory_usage_of(blend.layer_animation) + memory_usage_of(blend.skeleton_local));
+
+	memory_usage arena;
+	if (skinning_arena.buffers.arena.capacity() > 0) {
+		arena.bytes = skinning_arena.buffers.arena.capacity();
+		arena.allocation = 1;
+	}
+	report.add("skinning arena", arena);
+	report.add("instance skinning arena", memory_usage_of(skinning_arena.instances));
+
+	report.add("shared asset", memory_usage_of(*asset));
+	if (pose_cache.cache != nullptr)
+		report.add("pose cache", memory_usage_of(*pose_cache.cache));
+	memory_usage instances_usage;
+	for (character_instance const& instance : instances.instances)
+		instances_usage += memory_usage_of(instance);
+	report.add("character instances", instances_usage);
+
+	memory_usage clip_library_usage;
+	clip_library_usage.bytes = clips.library.statistics.resident_bytes;
+	clip_library_usage.allocation = clips.library.statistics.resident_clip;
+	report.add("clip library", clip_library_usage);
+
+	report.add("skinned surface", memory_usage(), footprint.gpu_mesh_bytes);
+	report.add("asset surface (rest pose, instances)", memory_usage(), visual_data.surface_asset.initialized ? footprint.gpu_mesh_bytes : 0);
+
+	return report;
+}
+
+void scene_structure::upload_skinned_vertices()
+{
+	if (packed_output.enabled) {
+		packed_vertex_upload(packed_output.vbo, packed_output.buffer);
+	}
+	else {
+		render_update(visual_data.surface_skinned.vbo_position, skinning_data.position_skinned);
+		render_update(visual_data.surface_skinned.vbo_normal, skinning_data.normal_skinned);
+	}
+}
+
+void scene_structure::update_packed_output_layout()
+{
+	if (!packed_output.enabled) {
+		packed_vertex_detach(visual_data.surface_skinned);
+		visual_data.surface_skinned.shader = mesh_drawable::default_shader;
+		// The float VBOs have not been updated while the packed output was used
+		render_update(visual_data.surface_skinned.vbo_position, skinning_data.position_skinned);
+		render_update(visual_data.surface_skinned.vbo_normal, skinning_data.normal_skinned);
+		return;
+	}
+
+	packed_output.buffer.layout = build_packed_vertex_layout(
+		packed_output.half_position ? packed_position_format::float16 : packed_position_format::float32,
+		packed_output.octahedral_normal ? packed_normal_format::octahedral : packed_normal_format::int_2_10_10_10);
+	pack_vertices(packed_output.buffer, skinning_data.position_skinned, skinning_data.normal_skinned);
+	packed_vertex_upload(packed_output.vbo, packed_output.buffer);
+
+	packed_vertex_attach(visual_data.surface_skinned, packed_output.vbo, packed_output.buffer.layout);
+	visual_data.surface_skinned.shader = packed_output.octahedral_normal ? packed_output.shader_octahedral : mesh_drawable::default_shader;
+}
+
+bool scene_structure::update_culling(float dt)
+{
+	bool const visible = compute_culling(dt);
+	if (culling.display_bounds)
+		render_update(culling.bounds_drawable.vbo_position, culling.bounds.edges());
+	return visible;
+}
+
+bool scene_structure::compute_culling(float dt)
+{
+	culling.bounds = skinned_mesh_bounds(culling.joint_bounds, skinning_data.skeleton_current, old_joint_rt, old_velocity, dt,
 		velocity_skinning_params.speed_blending, velocity_skinning_params.linear_deformation_intensity,
 		velocity_skinning_params.rotational_deformation_intensity);
-	visual_data.surface_skinned.vbo_position.update(skinning_data.position_skinned);
-	visual_data.surface_skinned.vbo_normal.update(skinning_data.normal_skinned);
 
+	culling.culled = culling.enabled && !is_box_in_frustum(culling.bounds, environment.camera_projection * environment.camera_view);
+	return !culling.culled;
+}
+
+void scene_structure::evaluate_skeleton(float t, numarray<affine_rt>& skeleton_global)
+{
+	if (clips.active >= 0) {
+		skeleton_local_to_global(clips.library.sample_local(clips.active, t), asset->skeleton.parent_index, skeleton_global);
+		return;
+	}
+	if (!blend.enabled && pose_cache.cache != nullptr && !pose_cache.cache->empty()) {
+		pose_cache.cache->sample(pose_cache.source->skeleton, t, skeleton_global);
+		return;
+	}
+	if (!blend.enabled) {
+		asset->skeleton.evaluate_local(t, blend.skeleton_local);
+		skeleton_local_to_global(blend.skeleton_local, asset->skeleton.parent_index, skeleton_global);
+		return;
+	}
+
+	// The layer loops over its own duration
+	numarray<float> const& layer_time = blend.layer_animation.animation_time;
+	float const layer_t_min = layer_time[0];
+	float const layer_duration = layer_time[layer_time.size() - 1] - layer_t_min;
+
+	blend.layers[0].animation = &asset->skeleton;
+	blend.layers[0].time = t;
+	blend.layers[1].animation = &blend.layer_animation;
+	blend.layers[1].time = layer_t_min + std::fmod(t - timer.t_min, layer_duration);
+	blend.layers[1].weight = blend.weight;
+	blend.layers[1].mode = blend.additive ? blend_mode::additive : blend_mode::override_pose;
+
+	blend.evaluator.evaluate(blend.layers, 2, blend.skeleton_local);
+	skeleton_local_to_global(blend.skeleton_local, asset->skeleton.parent_index, skeleton_global);
+}
+
+void scene_structure::update_blend_layer()
+{
+	skeleton_animation_structure& layer = blend.layer_animation;
+	layer.parent_index = asset->skeleton.parent_index;
+	layer.rest_pose_local = asset->skeleton.rest_pose_local;
+	layer.compressed_animation.reset();
+
+	void (*load_animation[4])(numarray<numarray<affine_rt>>&, numarray<float>&, numarray<int> const&) = {
+		load_animation_bend_z, load_animation_bend_zx, load_animation_twist_x, load_animation_translation };
+	load_animation[blend.layer_clip](layer.animation_geometry_local, layer.animation_time, layer.parent_index);
+	if (layer.animation_geometry_local[0].size() != asset->skeleton.number_joint()) {
+		blend.enabled = false; // the built-in clips only animate the 3 joints of the cylinder and the rectangle
+		layer.animation_geometry_local.clear();
+		layer.animation_time.clear();
+		return;
+	}
+
+	size_t const N_joint = asset->skeleton.number_joint();
+	numarray<float>& mask = blend.layers[1].joint_mask;
+	mask.resize(N_joint);
+	for (size_t k = 0; k < N_joint; ++k)
+		mask[k] = (!blend.mask_lower || k >= N_joint / 2) ? 1.0f : 0.0f;
+
+	blend.evaluator.initialize(N_joint);
+	blend.evaluator.statistics = animation_blend_statistics();
+	blend.skeleton_local.resize(N_joint);
+}
+
+static animation_clip build_clip(std::string const& name,
+	void (*load_animation)(numarray<numarray<affine_rt>>&, numarray<float>&, numarray<int> const&),
+	numarray<int> const& parent_index)
+{
+	animation_clip clip;
+	clip.name = name;
+	load_animation(clip.animation_geometry_local, clip.animation_time, parent_index);
+	return clip;
+}
+
+void scene_structure::export_clip_archive()
+{
+	numarray<int> const& parent_index = asset->skeleton.parent_index;
+	numarray<animation_clip> built_in_clips;
+	built_in_clips.push_back(build_clip("bend_z", load_animation_bend_z, parent_index));
+	built_in_clips.push_back(build_clip("bend_zx", load_animation_bend_zx, parent_index));
+	built_in_clips.push_back(build_clip("twist_x", load_animation_twist_x, parent_index));
+	built_in_clips.push_back(build_clip("translation", load_animation_translation, parent_index));
+
+	clips.filename = project::path + "clips.vsclip";
+	select_clip(-1);
+	clips.library.close();
+	if (!write_clip_archive(clips.filename, built_in_clips) || !clips.library.open(clips.filename))
+		std::cerr << "Could not create the clip archive " << clips.filename << std::endl;
+}
+
+void scene_structure::select_clip(int index)
+{
+	clips.active = index;
+
+	numarray<float> const* animation_time = &asset->skeleton.animation_time;
+	std::shared_ptr<animation_clip const> clip;
+	if (index >= 0) {
+		clip = clips.library.acquire(index);
+		animation_time = &clip->animation_time;
+	}
+	timer.t_min = (*animation_time)[0];
+	timer.t_max = (*animation_time)[animation_time->size() - 1];
+	timer.t = timer.t_min;
+}
+
+// The clip is always compressed from its original frames, kept aside while the animation is compressed:
+//  changing the settings doesn't accumulate the loss, and disabling the compression restores the original clip
+static void compress_animation(skinning_content& content, animation_compression_data& compression)
+{
+	skeleton_animation_structure& skeleton = content.skeleton;
+	if (!content.animation_source) {
+		assert_cgp(!skeleton.compressed_animation, "Compressed animation without its original frames");
+		if (!compression.enabled)
+			return;
+		content.animation_source = std::make_shared<numarray<numarray<affine_rt> > const>(std::move(skeleton.animation_geometry_local));
+	}
+	numarray<numarray<affine_rt> > const& source = *content.animation_source;
+	skeleton.compressed_animation.reset();
+
+	if (!compression.enabled) {
+		skeleton.animation_geometry_local = source;
+		content.animation_source.reset();
+		return;
+	}
+
+	compression.uncompressed_bytes = source.size() * (sizeof(numarray<affine_rt>) + skeleton.number_joint() * sizeof(affine_rt));
+	skeleton.compressed_animation = std::make_shared<compressed_clip>(compress_clip(skeleton.animation_time, source, compression.parameters));
+	skeleton.animation_geometry_local.clear();
+	compression.compressed_bytes = skeleton.compressed_animation->memory_size();
+	compression.error = compressed_clip_error(*skeleton.compressed_animation, source);
+}
+
+void scene_structure::record_vertex_cache()
+{
+	numarray<float> const& animation_time = asset->skeleton.animation_time;
+	if (animation_time.size() == 0)
+		return;
+	float const t_min = animation_time[0];
+	float const duration = animation_time[animation_time.size() - 1] - t_min;
+	float const dt = 1.0f / 60.0f;
+	size_t const N_vertex = asset->position_rest_pose.size();
+
+	// The velocity state starts over at frame 0: both passes over the frames give the same vertices
+	numarray<affine_rt> skeleton_local, skeleton_current, joint_rt;
+	numarray<vec3> velocity;
+	velocity_skinning_parameters const& params = velocity_skinning_params;
+	vertex_cache_source const source = [&](size_t frame, numarray<vec3>& position, numarray<vec3>& normal) {
+		if (frame == 0) {
+			joint_rt.clear();
+			velocity.clear();
+		}
+		float const t = duration > 0.0f ? t_min + std::fmod(frame * dt, duration) : t_min;
+		asset->skeleton.evaluate_local(t, skeleton_local);
+		skeleton_local_to_global(skeleton_local, asset->skeleton.parent_index, skeleton_current);
+		position.resize(N_vertex);
+		normal.resize(N_vertex);
+		velocity_skinning_compute(position, normal, skeleton_current, asset->skeleton_rest_pose,
+			asset->position_rest_pose, asset->normal_rest_pose, asset->rig, asset->velocity_rig, joint_rt, velocity, dt,
+			params.speed_blending, params.linear_deformation_intensity, params.rotational_deformation_intensity, nullptr, params.fast_rotation_angle);
+	};
+
+	cgp::vertex_cache cache;
+	vertex_cache.measure = measure_vertex_cache(source, size_t(std::max(vertex_cache.number_frame, 1)), N_vertex, vertex_cache.parameters, 0, &cache);
+	vertex_cache.filename = project::path + "skinned.vsc";
+	if (!write_vertex_cache(vertex_cache.filename, cache))
+		std::cerr << "Could not write " << vertex_cache.filename << std::endl;
+}
+
+bool scene_structure::update_shared_output()
+{
+	shared_output_writer& writer = shared_output.writer;
+	if (!shared_output.enabled) {
+		writer.close();
+		return false;
+	}
+	size_t const N_vertex = asset->position_rest_pose.size();
+	if (writer.is_open() && writer.vertex_count() == N_vertex)
+		return true;
+	if (shared_output.failed)
+		return false;
+
+	// New content: readers detect the new ring when they open the name again
+	shared_output.failed = !writer.create(shared_output.name, N_vertex, std::max(shared_output.slot_count, 1));
+	if (shared_output.failed)
+		std::cerr << "Could not create the shared memory output " << shared_output.name << std::endl;
+	return !shared_output.failed;
+}
+
+void scene_structure::publish_shared_output(numarray<vec3> const& position, numarray<vec3> const& normal)
+{
+	if (update_shared_output() && position.size() == shared_output.writer.vertex_count())
+		shared_output.writer.publish(++shared_output.frame_id, position, normal);
+}
+
+void scene_structure::measure_fast_rotation()
+{
+	struct { char const* name; animation_loader load; } const clips[] = {
+		{ "bend z", load_animation_bend_z }, { "bend zx", load_animation_bend_zx },
+		{ "twist x", load_animation_twist_x }, { "translation", load_animation_translation } };
+
+	fast_rotation_parameters parameters;
+	parameters.fast_rotation_angle = velocity_skinning_params.fast_rotation_angle;
+	parameters.speed_blending = velocity_skinning_params.speed_blending;
+	parameters.linear_deformation_intensity = velocity_skinning_params.linear_deformation_intensity;
+	parameters.rotational_deformation_intensity = velocity_skinning_params.rotational_deformation_intensity;
+
+	fast_rotation.clip.clear();
+	fast_rotation.report.clear();
+	for (auto const& clip : clips) {
+		skeleton_animation_structure skeleton;
+		skeleton.parent_index = asset->skeleton.parent_index;
+		skeleton.rest_pose_local = asset->skeleton.rest_pose_local;
+		clip.load(skeleton.animation_geometry_local, skeleton.animation_time, skeleton.parent_index);
+		if (skeleton.animation_geometry_local[0].size() != skeleton.number_joint())
+			continue;
+
+		fast_rotation.clip.push_back(clip.name);
+		fast_rotation.report.push_back(cgp::measure_fast_rotation(skeleton, asset->rig, asset->velocity_rig,
+			asset->position_rest_pose, asset->normal_rest_pose, parameters));
+	}
+}
+
+void scene_structure::update_compression()
+{
+	std::shared_ptr<skinning_content> content = edit_asset();
+	compress_animation(*content, compression);
+	publish_asset(content);
+}
+
+// Run on the background thread of the content loader: only touches content
+static void build_content(loaded_content& content, std::string const& name, shape_loader load_shape, animation_loader load_animation, content_settings const& settings)
+{
+	content.name = name;
+	content.asset = std::make_shared<skinning_content>();
+	skinning_content& asset = *content.asset;
+
+	mesh shape;
+	load_shape(asset.skeleton, asset.rig, shape);
+	load_animation(asset.skeleton.animation_geometry_local, asset.skeleton.animation_time, asset.skeleton.parent_index);
+	init_velocity_skinning_weights(asset.velocity_rig, asset.rig, asset.skeleton.parent_index);
+	asset.skeleton_rest_pose = asset.skeleton.rest_pose_global();
+	asset.position_rest_pose = std::move(shape.position);
+	asset.normal_rest_pose = std::move(shape.normal);
+	asset.connectivity = std::move(shape.connectivity);
+	asset.uv = std::move(shape.uv);
+
+	content.settings = settings;
+	compress_animation(asset, content.settings.compression);
+	build_sparse_weight_matrix(asset.weights, asset.rig, asset.skeleton_rest_pose.size());
+	if (settings.lod)
+		build_skinning_lod(asset.lod, asset.position_rest_pose, settings.lod_parameters);
+
+	content.shape = rest_pose_mesh(asset);
+	if (settings.arena)
+		build_skinning_buffers(content.arena, asset.position_rest_pose, asset.normal_rest_pose, asset.rig, asset.velocity_rig, huge_page_mode(settings.huge_pages));
+	compute_joint_bounds(content.joint_bounds, asset.position_rest_pose, asset.skeleton_rest_pose, asset.rig, asset.velocity_rig);
+}
+
+content_settings scene_structure::current_content_settings() const
+{
+	content_settings settings;
+	settings.compression = compression;
+	settings.lod = lod.enabled;
+	settings.lod_parameters = lod.parameters;
+	settings.arena = skinning_arena.enabled;
+	settings.huge_pages = skinning_arena.huge_pages;
+	return settings;
+}
+
+void scene_structure::request_content(std::string const& name, shape_loader load_shape, animation_loader load_animation)
+{
+	content_settings const settings = current_content_settings();
+	content_loader.request([=](loaded_content& content) {
+		build_content(content, name, load_shape, load_animation, settings);
+	});
+}
+
+void scene_structure::request_procedural_content(procedural_motion motion)
+{
+	procedural_rig_parameters const parameters = procedural_rig;
+	std::string const name = parameters.name() + (motion == procedural_motion::wave ? " wave" : " twist");
+	request_content(name,
+		[parameters](skeleton_animation_structure& skeleton, rig_structure& rig, mesh& shape) { load_procedural_rig(parameters, skeleton, rig, shape); },
+		[parameters, motion](numarray<numarray<affine_rt>>& animation, numarray<float>& time, numarray<int> const& parent_index) {
+			load_procedural_animation(parameters, motion, animation, time, parent_index); });
+}
+
+void scene_structure::load_content(std::string const& name, shape_loader load_shape, animation_loader load_animation)
+{
+	loaded_content content;
+	build_content(content, name, load_shape, load_animation, current_content_settings());
+	apply_content(content);
+}
+
+void scene_structure::apply_content(loaded_content& content)
+{
+	asset_name = content.name;
+	rig_optimization.has_report = false;
+
+	// The settings may have changed while the content was prepared: only what they affect is rebuilt here
+	content_settings const& used = content.settings;
+	compression_parameters const& p = compression.parameters;
+	compression_parameters const& q = used.compression.parameters;
+	bool const same_compression = used.compression.enabled == compression.enabled &&
+		p.rotation_error == q.rotation_error && p.translation_error == q.translation_error && p.max_key_span == q.max_key_span;
+	if (same_compression) {
+		compression.uncompressed_bytes = used.compression.uncompressed_bytes;
+		compression.compressed_bytes = used.compression.compressed_bytes;
+		compression.error = used.compression.error;
+	}
+	else
+		compress_animation(*content.asset, compression);
+
+	skinning_lod_parameters const& a = lod.parameters;
+	skinning_lod_parameters const& b = used.lod_parameters;
+	bool const same_lod = used.lod == lod.enabled && (!lod.enabled || (a.number_level == b.number_level &&
+		a.cell_size_ratio == b.cell_size_ratio && a.neighbor == b.neighbor && a.distance_step == b.distance_step));
+	if (!same_lod) {
+		content.asset->lod = skinning_lod();
+		if (lod.enabled)
+			build_skinning_lod(content.asset->lod, content.asset->position_rest_pose, lod.parameters);
+	}
+
+	culling.joint_bounds = std::move(content.joint_bounds);
+	update_new_content(std::move(content.asset), content.shape, mesh_drawable::default_texture);
+
+	if (skinning_arena.enabled && used.arena && used.huge_pages == skinning_arena.huge_pages && content.arena.number_vertex() == asset->position_rest_pose.size())
+		skinning_arena.buffers.swap(content.arena);
+	else
+		update_skinning_arena();
+}
+
+void scene_structure::reset_fixed_rate()
+{
+	fixed_rate.stepper.reset();
+	fixed_rate.position_previous = skinning_data.position_skinned;
+	fixed_rate.position_next = skinning_data.position_skinned;
+	fixed_rate.normal_previous = skinning_data.normal_skinned;
+	fixed_rate.normal_next = skinning_data.normal_skinned;
+	fixed_rate.skeleton_previous = skinning_data.skeleton_current;
+	fixed_rate.skeleton_next = skinning_data.skeleton_current;
 }
 
 void scene_structure::display_frame()
+{
+	// New content prepared in the background is swapped in between two frames
+	std::shared_ptr<loaded_content> content = content_loader.take();
+	if (content != nullptr)
+		apply_content(*content);
+
+	render_frame(timer.update());
+}
+
+void scene_structure::render_frame(float dt)
 {
 	// Set the light to the current position of the camera
 	environment.light = camera_control.camera_model.position();
 	
 	if (gui.display_frame)
-		draw(global_frame, environment);
-
-	float dt = timer.update();
+		render_draw(global_frame, environment);
 
+	auto const time_start = std::chrono::steady_clock::now();
+	crowd.in_frame_graph = false;
 	compute_deformation(dt);
+	skinning_budget.main_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+	if (!crowd.in_frame_graph)
+		update_crowd(dt);
 
 	if (gui.surface_skinned)
-		draw(visual_data.surface_skinned, environment);
+		render_draw(visual_data.surface_skinned, environment);
 	if (gui.wireframe_skinned)
-		draw_wireframe(visual_data.surface_skinned, environment, { 0.5f, 0.5f, 0.5f });
+		render_draw_wireframe(visual_data.surface_skinned, environment, { 0.5f, 0.5f, 0.5f });
 
 	draw(visual_data.skeleton_current, environment);
 
+	// Drawn before the instances, which replace the vertices of the shared surface
+	if (gui.surface_rest_pose || gui.wireframe_rest_pose)
+		prepare_asset_surface(true);
 	if (gui.surface_rest_pose)
-		draw(visual_data.surface_rest_pose, environment);
+		render_draw(visual_data.surface_asset.drawable, environment);
 	if (gui.wireframe_rest_pose)
-		draw_wireframe(visual_data.surface_rest_pose, environment, { 0.5f, 0.5f, 0.5f });
+		render_draw_wireframe(visual_data.surface_asset.drawable, environment, { 0.5f, 0.5f, 0.5f });
+	draw_character_instances();
 
 	draw(visual_data.skeleton_rest_pose, environment);
 
+	if (culling.display_bounds)
+		render_draw(culling.bounds_drawable, environment);
+
 }
 
 
-void scene_structure::update_new_content(mesh const& shape, opengl_texture_image_structure texture_id)
+void scene_structure::update_new_content(std::shared_ptr<skinning_content const> content, mesh const& shape, opengl_texture_image_structure texture_id)
 {
-	visual_data.surface_skinned.clear();
-	visual_data.surface_skinned.initialize_data_on_gpu(shape);
+	asset = std::move(content);
+	render_clear(visual_data.surface_skinned);
+	render_initialize(visual_data.surface_skinned, shape);
 	visual_data.surface_skinned.texture = texture_id;
+	footprint.gpu_mesh_bytes = gpu_bytes_of_mesh_drawable(shape);
 
-	visual_data.surface_rest_pose.clear();
-	visual_data.surface_rest_pose.initialize_data_on_gpu(shape);
-	visual_data.surface_rest_pose.texture = texture_id;
+	// Uploaded for the new mesh when first drawn
+	render_clear(visual_data.surface_asset.drawable);
+	visual_data.surface_asset.initialized = false;
 
-	skinning_data.position_rest_pose = shape.position;
-	skinning_data.position_skinned = skinning_data.position_rest_pose;
-	skinning_data.normal_rest_pose = shape.normal;
-	skinning_data.normal_skinned = skinning_data.normal_rest_pose;
+	skinning_data.position_skinned = asset->position_rest_pose;
+	skinning_data.normal_skinned = asset->normal_rest_pose;
+	skinning_data.skeleton_current = asset->skeleton_rest_pose;
 
-	skinning_data.skeleton_current = skeleton_data.rest_pose_global();
-	skinning_data.skeleton_rest_pose = skinning_data.skeleton_current;
+	// The velocity of the previous content is meaningless for the new one
+	old_joint_rt.clear();
+	old_velocity.clear();
 
 	visual_data.skeleton_current.clear();
-	visual_data.skeleton_current = skeleton_drawable(skinning_data.skeleton_current, skeleton_data.parent_index);
+	visual_data.skeleton_current = skeleton_drawable(skinning_data.skeleton_current, asset->skeleton.parent_index);
 
 	visual_data.skeleton_rest_pose.clear();
-	visual_data.skeleton_rest_pose = skeleton_drawable(skinning_data.skeleton_rest_pose, skeleton_data.parent_index);
+	visual_data.skeleton_rest_pose = skeleton_drawable(asset->skeleton_rest_pose, asset->skeleton.parent_index);
+
+	select_clip(-1);
+	update_blend_layer();
+	publish_asset(asset);
 
-	timer.t_min = skeleton_data.animation_time[0];
-	timer.t_max = skeleton_data.animation_time[skeleton_data.animation_time.size() - 1];
-	timer.t = skeleton_data.animation_time[0];
+	reset_fixed_rate();
+	if (packed_output.enabled)
+		update_packed_output_layout();
 }
 
 void scene_structure::display_gui()
@@ -142,73 +1084,342 @@ void scene_structure::display_gui()
 	visual_data.skeleton_rest_pose.display_joint_frame = gui.skeleton_rest_pose_frame;
 	visual_data.skeleton_rest_pose.display_joint_sphere = gui.skeleton_rest_pose_sphere;
 
-	mesh new_shape;
-	bool update = false;
 	ImGui::Text("Cylinder"); ImGui::SameLine();
-	bool const cylinder_bend_z = ImGui::Button("Bend z###CylinderBendZ");  ImGui::SameLine();
-	if (cylinder_bend_z) {
-		update = true;
-		load_cylinder(skeleton_data, rig, new_shape);
-		load_animation_bend_z(skeleton_data.animation_geometry_local,
-			skeleton_data.animation_time,
-			skeleton_data.parent_index);
-	}
-	bool const cylinder_bend_zx = ImGui::Button("Bend zx###CylinderBendZX");  ImGui::SameLine();
-	if (cylinder_bend_zx)std::cout << cylinder_bend_zx << std::endl;
-	if (cylinder_bend_zx) {
-		update = true;
-		load_cylinder(skeleton_data, rig, new_shape);
-		load_animation_bend_zx(skeleton_data.animation_geometry_local,
-			skeleton_data.animation_time,
-			skeleton_data.parent_index);
-	}
-	bool const cylinder_move_y = ImGui::Button("Move y###CylinderMoveY");
-	if (cylinder_move_y) {
-		update = true;
-		load_cylinder(skeleton_data, rig, new_shape);
-		load_animation_translation(skeleton_data.animation_geometry_local,
-			skeleton_data.animation_time,
-			skeleton_data.parent_index);
-	}
+	if (ImGui::Button("Bend z###CylinderBendZ"))
+		request_content("Cylinder bend z", load_cylinder, load_animation_bend_z);
+	ImGui::SameLine();
+	if (ImGui::Button("Bend zx###CylinderBendZX"))
+		request_content("Cylinder bend zx", load_cylinder, load_animation_bend_zx);
+	ImGui::SameLine();
+	if (ImGui::Button("Move y###CylinderMoveY"))
+		request_content("Cylinder move y", load_cylinder, load_animation_translation);
 
 	ImGui::Text("Rectangle"); ImGui::SameLine();
-	bool const rectangle_bend_z = ImGui::Button("Bend z###RectangleBendZ");  ImGui::SameLine();
-	if (rectangle_bend_z) {
-		update = true;
-		load_rectangle(skeleton_data, rig, new_shape);
-		load_animation_bend_z(skeleton_data.animation_geometry_local,
-			skeleton_data.animation_time,
-			skeleton_data.parent_index);
-	}
-	bool const rectangle_bend_zx = ImGui::Button("Bend zx###RectangleBendZX");  ImGui::SameLine();
-	if (rectangle_bend_zx) {
-		update = true;
-		load_rectangle(skeleton_data, rig, new_shape);
-		load_animation_bend_zx(skeleton_data.animation_geometry_local,
-			skeleton_data.animation_time,
-			skeleton_data.parent_index);
-	}
-	bool const rectangle_twist_x = ImGui::Button("Twist x###RectangleTwistX");
-	if (rectangle_twist_x) {
-		update = true;
-		load_rectangle(skeleton_data, rig, new_shape);
-		load_animation_twist_x(skeleton_data.animation_geometry_local,
-			skeleton_data.animation_time,
-			skeleton_data.parent_index);
-	}
+	if (ImGui::Button("Bend z###RectangleBendZ"))
+		request_content("Rectangle bend z", load_rectangle, load_animation_bend_z);
+	ImGui::SameLine();
+	if (ImGui::Button("Bend zx###RectangleBendZX"))
+		request_content("Rectangle bend zx", load_rectangle, load_animation_bend_zx);
+	ImGui::SameLine();
+	if (ImGui::Button("Twist x###RectangleTwistX"))
+		request_content("Rectangle twist x", load_rectangle, load_animation_twist_x);
+
+	ImGui::Text("Procedural");
+	int topology = int(procedural_rig.topology);
+	ImGui::RadioButton("Chain", &topology, int(procedural_topology::chain)); ImGui::SameLine();
+	ImGui::RadioButton("Tree", &topology, int(procedural_topology::tree)); ImGui::SameLine();
+	ImGui::RadioButton("Hand", &topology, int(procedural_topology::hand));
+	procedural_rig.topology = procedural_topology(topology);
+	ImGui::SliderInt("Joints", &procedural_rig.number_joint, 2, 256);
+	ImGui::SliderInt("Branching", &procedural_rig.branching, 1, 8);
+	ImGui::SliderInt("Influences", &procedural_rig.influence, 1, 8);
+	ImGui::SliderInt("Rings per bone", &procedural_rig.ring, 2, 1024);
+	ImGui::SliderInt("Vertices per ring", &procedural_rig.radial, 3, 256);
+	int seed = int(procedural_rig.seed);
+	ImGui::SliderInt("Seed", &seed, 1, 1000);
+	procedural_rig.seed = unsigned(seed);
+	ImGui::Text("%s", procedural_rig.name().c_str());
+	if (ImGui::Button("Wave###ProceduralWave"))
+		request_procedural_content(procedural_motion::wave);
+	ImGui::SameLine();
+	if (ImGui::Button("Twist###ProceduralTwist"))
+		request_procedural_content(procedural_motion::twist);
+
+	if (content_loader.is_busy())
+		ImGui::Text("Loading ...");
 
 	ImGui::Spacing(); ImGui::Spacing();
 
 	ImGui::SliderFloat("Velocity blending", &velocity_skinning_params.speed_blending, 0.01, 1, "%.2f s");
 	ImGui::SliderFloat("Linear skinning intensity", &velocity_skinning_params.linear_deformation_intensity, 0.01, 10, "%.2f s");
 	ImGui::SliderFloat("Rotational skinning intensity", &velocity_skinning_params.rotational_deformation_intensity, 0.1, 10, "%.2f s");
-	
-	opengl_texture_image_structure texture_id = mesh_drawable::default_texture;
+	ImGui::SliderFloat("Fast rotation below", &velocity_skinning_params.fast_rotation_angle, 0.0f, 1.5f, "%.2f rad");
+	if (ImGui::Button("Measure fast rotation"))
+		measure_fast_rotation();
+	for (size_t k = 0; k < fast_rotation.report.size(); ++k) {
+		fast_rotation_report const& r = fast_rotation.report[k];
+		ImGui::Text("  %s: deviation %.2e (vertex %d, t=%.2f s), %.1f ms -> %.1f ms", fast_rotation.clip[k].c_str(),
+			r.max_deviation, r.max_deviation_vertex, r.max_deviation_time, r.exact_ms, r.fast_ms);
+	}
+
+	ImGui::Spacing(); ImGui::Spacing();
+
+	if (ImGui::Checkbox("Fixed rate", &fixed_rate.enabled))
+		reset_fixed_rate();
+	if (fixed_rate.enabled) {
+		ImGui::SliderFloat("Rate", &fixed_rate.stepper.rate, 10.0f, 240.0f, "%.0f Hz");
+		ImGui::SliderInt("Max steps per frame", &fixed_rate.stepper.max_steps_per_frame, 1, 32);
+	}
+
+	bool packed_layout = ImGui::Checkbox("Packed output", &packed_output.enabled);
+	if (packed_output.enabled) {
+		packed_layout |= ImGui::Checkbox("Half positions", &packed_output.half_position); ImGui::SameLine();
+		packed_layout |= ImGui::Checkbox("Octahedral normals", &packed_output.octahedral_normal);
+	}
+	// The layout is built and the vertices packed before the error is measured on the buffer
+	if (packed_layout)
+		update_packed_output_layout();
+	if (packed_output.enabled && packed_output.buffer.size() == skinning_data.position_skinned.size()) {
+		packed_output.error = packed_vertex_max_error(packed_output.buffer, skinning_data.position_skinned, skinning_data.normal_skinned);
+		ImGui::Text("Stride %d bytes, error position %.2e, normal %.2e rad", int(packed_output.buffer.layout.stride), packed_output.error.position, packed_output.error.normal);
+	}
+
+	ImGui::Checkbox("Culling", &culling.enabled); ImGui::SameLine();
+	ImGui::Checkbox("Display bounds", &culling.display_bounds);
+	if (culling.culled)
+		ImGui::Text("Mesh culled");
+
+	ImGui::Spacing(); ImGui::Spacing();
+
+	ImGui::Text("Rig optimization");
+	ImGui::SliderInt("Max influence", &rig_optimization.parameters.max_influence, 1, 8);
+	ImGui::SliderFloat("Weight threshold", &rig_optimization.parameters.weight_threshold, 0.0f, 0.2f, "%.3f");
+	if (ImGui::Button("Optimize rig")) {
+		rig_optimization.parameters.speed_blending = velocity_skinning_params.speed_blending;
+		rig_optimization.parameters.linear_deformation_intensity = velocity_skinning_params.linear_deformation_intensity;
+		rig_optimization.parameters.rotational_deformation_intensity = velocity_skinning_params.rotational_deformation_intensity;
+		std::shared_ptr<skinning_content> content = edit_asset();
+		rig_optimization.report = optimize_rig(content->rig, content->velocity_rig, content->skeleton,
+			content->position_rest_pose, content->normal_rest_pose, rig_optimization.parameters);
+		build_sparse_weight_matrix(content->weights, content->rig, content->skeleton_rest_pose.size());
+		rig_optimization.has_report = true;
+		publish_asset(content);
+		update_skinning_arena();
+		compute_joint_bounds(culling.joint_bounds, asset->position_rest_pose, asset->skeleton_rest_pose, asset->rig, asset->velocity_rig);
+	}
+	if (rig_optimization.has_report) {
+		rig_optimization_report const& report = rig_optimization.report;
+		ImGui::Text("Influences %d -> %d (max %d -> %d)", int(report.influence_before), int(report.influence_after), report.max_influence_before, report.max_influence_after);
+		ImGui::Text("Max displacement %.2e (vertex %d, t=%.2f s)", report.max_displacement, report.max_displacement_vertex, report.max_displacement_time);
+	}
+
+	ImGui::Spacing(); ImGui::Spacing();
+
+	ImGui::Text("Clip library");
+	if (ImGui::Button("Export built-in clips"))
+		export_clip_archive();
+	if (clips.library.is_open()) {
+		if (ImGui::RadioButton("Skeleton animation", clips.active == -1))
+			select_clip(-1);
+		for (size_t k = 0; k < clips.library.number_clip(); ++k) {
+			if (clips.library.clip_number_joint(k) != asset->skeleton.number_joint())
+				continue;
+			ImGui::SameLine();
+			if (ImGui::RadioButton(clips.library.clip_name(k).c_str(), clips.active == int(k)))
+				select_clip(int(k));
+		}
+		clip_library_statistics const& stats = clips.library.statistics;
+		ImGui::Text("Resident %d clips (%d bytes), hit %d, miss %d, eviction %d", int(stats.resident_clip), int(stats.resident_bytes), int(stats.hit), int(stats.miss), int(stats.eviction));
+	}
+
+	ImGui::Spacing(); ImGui::Spacing();
+
+	bool arena_update = ImGui::Checkbox("Skinning arena", &skinning_arena.enabled);
+	if (skinning_arena.enabled) {
+		ImGui::SameLine();
+		arena_update |= ImGui::RadioButton("Pages", &skinning_arena.huge_pages, 0); ImGui::SameLine();
+		arena_update |= ImGui::RadioButton("Transparent huge pages", &skinning_arena.huge_pages, 1); ImGui::SameLine();
+		arena_update |= ImGui::RadioButton("Huge pages", &skinning_arena.huge_pages, 2);
+		ImGui::Text("%d bytes%s", int(skinning_arena.buffers.arena.used()), skinning_arena.buffers.arena.huge_page_backed() ? ", huge pages" : "");
+		if (skinning_arena.instances.number_instance() > 0)
+			ImGui::Text("Instances: %d bytes%s", int(memory_usage_of(skinning_arena.instances).bytes), skinning_arena.instances.huge_page_backed() ? ", huge pages" : "");
+	}
+	if (arena_update)
+		update_skinning_arena();
+	ImGui::Text("Skinning %.3f ms", skinning_arena.skinning_ms);
 
-	if (update) {
-		init_velocity_skinning_weights(velocity_rig, rig, skeleton_data.parent_index);
-		update_new_content(new_shape, texture_id);
+	if (ImGui::Button("Memory footprint"))
+		footprint.report = compute_memory_footprint();
+	if (footprint.report.entries.size() > 0) {
+		ImGui::SameLine();
+		if (ImGui::Button("Export footprint")) {
+			std::ofstream out(project::path + "footprint.json");
+			out << footprint.report.json();
+		}
+		memory_usage const total = footprint.report.total_cpu();
+		size_t const N_vertex = std::max(footprint.report.vertex_count, size_t(1));
+		ImGui::Text("CPU %d bytes in %d allocations (%.1f bytes/vertex), GPU %d bytes", int(total.bytes), int(total.allocation), double(total.bytes) / N_vertex, int(footprint.report.total_gpu_bytes()));
+		for (memory_footprint::entry const& e : footprint.report.entries)
+			ImGui::Text("  %s: %d bytes, %d allocations, GPU %d bytes", e.name.c_str(), int(e.cpu.bytes), int(e.cpu.allocation), int(e.gpu_bytes));
 	}
+
+	ImGui::SliderInt("Streaming chunk", &streaming.chunk_size, 1024, 1 << 20);
+	if (ImGui::Button("Stream current pose to file"))
+		stream_current_pose();
+	if (streaming.vertex_count > 0) {
+		ImGui::SameLine();
+		ImGui::Text("%d vertices in %.2f ms, %d bytes per chunk", int(streaming.vertex_count), streaming.time_ms, int(streaming.chunk_bytes));
+	}
+
+	ImGui::SliderInt("Cached frames", &vertex_cache.number_frame, 1, 1200);
+	ImGui::SliderInt("Frames per chunk", &vertex_cache.parameters.frames_per_chunk, 1, 128);
+	ImGui::SliderInt("Position bits", &vertex_cache.parameters.position_bits, 8, 24);
+	ImGui::SliderInt("Normal bits", &vertex_cache.parameters.normal_bits, 6, 16);
+	if (ImGui::Button("Record vertex cache"))
+		record_vertex_cache();
+	if (!vertex_cache.filename.empty()) {
+		vertex_cache_measure const& m = vertex_cache.measure;
+		ImGui::Text("%d -> %d bytes (x%.1f), decode %.2f GB/s, random access %.2f ms", int(m.raw_bytes), int(m.compressed_bytes), m.ratio, m.decode_gb_per_s, m.random_access_ms);
+		ImGui::Text("Max error: position %.2e, normal %.2e rad", m.max_position_error, m.max_normal_error);
+	}
+
+	bool shared_output_update = ImGui::Checkbox("Shared memory output", &shared_output.enabled);
+	shared_output_update |= ImGui::SliderInt("Ring slots", &shared_output.slot_count, 1, 16);
+	if (shared_output_update) {
+		shared_output.writer.close();
+		shared_output.failed = false;
+	}
+	if (shared_output.enabled) {
+		ImGui::SameLine();
+		if (shared_output.writer.is_open())
+			ImGui::Text("%s: %d frames published", shared_output.name.c_str(), int(shared_output.writer.published()));
+		else
+			ImGui::Text("%s unavailable", shared_output.name.c_str());
+	}
+
+	bool instances_update = ImGui::SliderInt("Instances", &instances.count, 0, 256);
+	instances_update |= ImGui::SliderFloat("Instance time offset", &instances.time_offset, 0.0f, 1.0f, "%.2f s");
+	if (instances_update)
+		update_character_instances();
+	if (instances.count > 0) {
+		ImGui::Text("%d assets in the registry, %d bytes per instance", int(assets.number_asset()), int(memory_usage_of(instances.instances[0]).bytes));
+		std::string levels;
+		for (character_instance const& instance : instances.instances)
+			levels += std::to_string(instance.lod_level) + " ";
+		ImGui::Text("Levels of detail: %s", levels.c_str());
+	}
+
+	ImGui::Checkbox("Amortized crowd update", &crowd.enabled);
+	if (crowd.enabled) {
+		if (ImGui::SliderInt("Max update interval", &crowd.scheduler.parameters.max_interval, 1, 16))
+			crowd.scheduler.resize(instances.instances.size());
+		ImGui::SliderFloat("Full rate screen size", &crowd.scheduler.parameters.full_rate_size, 0.01f, 1.0f, "%.2f");
+		crowd_frame_statistics const& stats = crowd.scheduler.statistics;
+		ImGui::Text("Updated %d instances (%d vertices), per frame: min %d, mean %.1f, max %d", int(stats.updated), int(crowd.vertex_updated),
+			int(stats.min_updated), stats.mean_updated(), int(stats.max_updated));
+		if (ImGui::Button("Reset crowd statistics"))
+			crowd.scheduler.reset_statistics();
+	}
+
+	bool pose_cache_update = ImGui::Checkbox("Pose cache", &pose_cache.enabled);
+	if (pose_cache.enabled) {
+		int max_mb = int(pose_cache.parameters.max_bytes >> 20);
+		pose_cache_update |= ImGui::SliderFloat("Baked poses per second", &pose_cache.parameters.sample_rate, 10.0f, 480.0f, "%.0f");
+		if (ImGui::SliderInt("Pose cache limit (MB)", &max_mb, 1, 256)) {
+			pose_cache.parameters.max_bytes = size_t(max_mb) << 20;
+			pose_cache_update = true;
+		}
+		if (pose_cache.cache != nullptr) {
+			cgp::pose_cache const& cache = *pose_cache.cache;
+			ImGui::Text("%d of %d poses baked (%d bytes), %d lookups", int(cache.baked_count), int(cache.number_sample + 1),
+				int(memory_usage_of(cache).bytes), int(cache.lookup_count));
+			if (ImGui::Button("Bake all poses"))
+				pose_cache.cache->bake(pose_cache.source->skeleton);
+			ImGui::SameLine();
+		}
+		if (ImGui::Button("Measure pose cache"))
+			pose_cache.measure = measure_pose_cache(asset->skeleton, pose_cache.parameters, 1000);
+		if (pose_cache.measure.number_sample > 0) {
+			pose_cache_measure const& m = pose_cache.measure;
+			ImGui::Text("Pose %.0f ns -> %.0f ns, max error %.2e (translation) %.2e rad", m.evaluate_ns, m.sample_ns, m.max_translation_error, m.max_rotation_error);
+		}
+	}
+	if (pose_cache_update)
+		update_pose_cache();
+
+	ImGui::Checkbox("Batched instance skinning", &batched.enabled);
+	if (batched.enabled) {
+		ImGui::SliderInt("Instances per product", &batched.engine.parameters.max_batch, 4, 256);
+		ImGui::SliderInt("Vertices per block", &batched.engine.parameters.vertices_per_block, 16, 4096);
+		ImGui::SliderInt("Measured instances", &batched.measure_instance, 1, 256);
+		if (ImGui::Button("Measure batched skinning"))
+			batched.measure = measure_batched_skinning(asset, size_t(batched.measure_instance), 60, batched.engine.parameters,
+				velocity_skinning_params.speed_blending, velocity_skinning_params.linear_deformation_intensity, velocity_skinning_params.rotational_deformation_intensity);
+		batched_skinning_measure const& m = batched.measure;
+		if (m.number_instance > 0) {
+			ImGui::Text("%d x %d vertices: %.1f -> %.1f M instance-vertices/s (LBS %.1f -> %.1f), max difference %.2e", int(m.number_instance), int(m.number_vertex),
+				m.loop_vertices_per_s * 1e-6, m.batched_vertices_per_s * 1e-6, m.loop_lbs_vertices_per_s * 1e-6, m.batched_lbs_vertices_per_s * 1e-6, m.max_difference);
+		}
+	}
+
+	ImGui::Checkbox("Skinning time budget", &skinning_budget.enabled);
+	if (skinning_budget.enabled) {
+		cgp::skinning_budget& budget = skinning_budget.budget;
+		ImGui::SliderFloat("Budget", &budget.parameters.budget_ms, 0.0f, 33.0f, "%.1f ms");
+		skinning_budget_statistics const& stats = budget.statistics;
+		ImGui::Text("Main character %.2f ms, instances %.2f ms (planned %.2f of %.2f)", skinning_budget.main_ms, stats.spent_ms, stats.planned_ms, stats.available_ms);
+		ImGui::Text("%d full, %d no rotation, %d linear, %d reused, %d lowered by the deadline", int(stats.quality_count[0]), int(stats.quality_count[1]),
+			int(stats.quality_count[2]), int(stats.quality_count[3]), int(stats.deadline_degraded));
+		ImGui::Text("%d frames, %d over budget (max %.2f ms), %d of %d items degraded, %d reused", int(stats.frame), int(stats.frame_over_budget),
+			stats.max_spent_ms, int(stats.total_degraded), int(stats.total_item), int(stats.total_reused));
+		if (ImGui::Button("Reset budget statistics"))
+			budget.reset_statistics();
+	}
+
+	bool lod_update = ImGui::Checkbox("Skinning LOD", &lod.enabled);
+	if (lod.enabled) {
+		lod_update |= ImGui::SliderInt("LOD levels", &lod.parameters.number_level, 1, 6);
+		lod_update |= ImGui::SliderInt("LOD neighbors", &lod.parameters.neighbor, 1, 8);
+		lod_update |= ImGui::SliderFloat("LOD distance step", &lod.parameters.distance_step, 0.5f, 20.0f);
+		if (ImGui::Button("Measure levels"))
+			lod.measure = measure_skinning_lod(asset, 60, velocity_skinning_params.speed_blending,
+				velocity_skinning_params.linear_deformation_intensity, velocity_skinning_params.rotational_deformation_intensity);
+		for (size_t k = 0; k < lod.measure.size(); ++k) {
+			skinning_lod_measure const& m = lod.measure[k];
+			ImGui::Text("  level %d: %d samples, %.3f ms, error max %.2e mean %.2e", int(k), int(m.sample), m.ms_per_frame, m.max_error, m.mean_error);
+		}
+	}
+	if (lod_update)
+		update_lod();
+
+	if (ImGui::Checkbox("Skinning thread", &skinning_thread.enabled)) {
+		if (skinning_thread.enabled) {
+			skinning_thread.worker.publish_content(asset);
+			skinning_thread.worker.start();
+		}
+		else
+			skinning_thread.worker.stop();
+	}
+	if (skinning_thread.enabled)
+		ImGui::Text("Skinning step %d (clip library and blend layer are not used by the thread)", int(skinning_thread.received_step));
+
+	ImGui::Checkbox("Task graph", &frame_graph.enabled);
+	if (frame_graph.enabled) {
+		ImGui::SliderInt("Vertices per task", &frame_graph.chunk_size, 256, 65536);
+		task_graph_profile const& profile = frame_graph.profile;
+		ImGui::Text("%d threads, frame %.3f ms, work %.3f ms, critical path %.3f ms", int(frame_graph.scheduler.number_thread()), profile.wall_ms, profile.work_ms, profile.critical_path_ms);
+		ImGui::TextWrapped("Critical path: %s", frame_graph.critical_path.c_str());
+		if (ImGui::Button("Export frame trace"))
+			write_task_trace(project::path + "frame_trace.json", frame_graph.graph, profile);
+	}
+
+	ImGui::Spacing(); ImGui::Spacing();
+
+	bool blend_update = ImGui::Checkbox("Blend layer", &blend.enabled);
+	if (blend.enabled) {
+		blend_update |= ImGui::RadioButton("Bend z###LayerBendZ", &blend.layer_clip, 0); ImGui::SameLine();
+		blend_update |= ImGui::RadioButton("Bend zx###LayerBendZX", &blend.layer_clip, 1); ImGui::SameLine();
+		blend_update |= ImGui::RadioButton("Twist x###LayerTwistX", &blend.layer_clip, 2); ImGui::SameLine();
+		blend_update |= ImGui::RadioButton("Move y###LayerMoveY", &blend.layer_clip, 3);
+		ImGui::SliderFloat("Layer weight", &blend.weight, 0.0f, 1.0f, "%.2f");
+		ImGui::Checkbox("Additive", &blend.additive); ImGui::SameLine();
+		blend_update |= ImGui::Checkbox("Second half of the joints only", &blend.mask_lower);
+		ImGui::Text("%.2f ns per joint per layer", blend.evaluator.statistics.ns_per_joint_layer());
+	}
+	if (blend_update)
+		update_blend_layer();
+
+	ImGui::Spacing(); ImGui::Spacing();
+
+	bool compression_update = ImGui::Checkbox("Compress animation", &compression.enabled);
+	if (compression.enabled) {
+		compression_update |= ImGui::SliderFloat("Rotation error", &compression.parameters.rotation_error, 1e-4f, 1e-1f, "%.4f rad");
+		compression_update |= ImGui::SliderFloat("Translation error", &compression.parameters.translation_error, 1e-5f, 1e-2f, "%.5f");
+		ImGui::Text("%d -> %d bytes, error %.2e rad, %.2e", int(compression.uncompressed_bytes), int(compression.compressed_bytes), compression.error.rotation, compression.error.translation);
+	}
+	if (compression_update)
+		update_compression();
+
 		
 
 }
@@ -7,6 +7,26 @@
 #include "skeleton/skeleton.hpp"
 #include "skeleton/skeleton_drawable.hpp"
 #include "skinning/skinning.hpp"
+#include "skinning/fixed_rate.hpp"
+#include "skinning/skinning_bounds.hpp"
+#include "skinning/rig_optimization.hpp"
+#include "skinning/skinning_thread.hpp"
+#include "skinning/skinning_buffers.hpp"
+#include "skinning/skinning_stream.hpp"
+#include "skinning/skinned_asset.hpp"
+#include "skinning/fast_rotation.hpp"
+#include "skinning/crowd_scheduler.hpp"
+#include "skinning/vertex_cache.hpp"
+#include "skinning/shared_output_ring.hpp"
+#include "skinning/batched_skinning.hpp"
+#include "animation/clip_library.hpp"
+#include "animation/animation_blend.hpp"
+#include "scheduler/task_graph.hpp"
+#include "scheduler/background_job.hpp"
+#include "render/render_backend.hpp"
+#include "loader/procedural_rig.hpp"
+
+#include <functional>
 
 using cgp::mesh_drawable;
 
@@ -29,23 +49,30 @@ struct gui_parameters {
 	bool skeleton_rest_pose_sphere = false;
 };
 
+// GPU mesh of the asset, uploaded when the rest pose or the instances are first drawn.
+//  Its vertex buffers hold the rest pose, or the vertices of the last instance drawn (uploaded just before its draw).
+struct asset_surface_data
+{
+	cgp::mesh_drawable drawable;
+	bool initialized = false; // the mesh of the current asset has been uploaded
+	bool rest_pose = false;   // the vertex buffers hold the rest pose
+};
+
 struct visual_shapes_parameters
 {
 	cgp::mesh_drawable surface_skinned;
-	cgp::mesh_drawable surface_rest_pose;
+	asset_surface_data surface_asset; // rest pose and instances
 	cgp::skeleton_drawable skeleton_current;
 	cgp::skeleton_drawable skeleton_rest_pose;
 };
 
+// Output of the main character. Its rest data is read from the asset.
 struct skinning_current_data
 {
-	cgp::numarray<cgp::vec3> position_rest_pose;
 	cgp::numarray<cgp::vec3> position_skinned;
-	cgp::numarray<cgp::vec3> normal_rest_pose;
 	cgp::numarray<cgp::vec3> normal_skinned;
 
 	cgp::numarray<cgp::affine_rt> skeleton_current;
-	cgp::numarray<cgp::affine_rt> skeleton_rest_pose;
 };
 
 
@@ -54,6 +81,253 @@ struct velocity_skinning_parameters
 	float speed_blending = 0.9;
 	float linear_deformation_intensity = 0.1;
 	float rotational_deformation_intensity = 1.0;
+	float fast_rotation_angle = 0.0f; // rotational deformation approximated below this angle (0: exact)
+};
+
+// Velocity skinning run at a fixed rate: the displayed vertices are interpolated between the two last simulated frames
+struct fixed_rate_data
+{
+	bool enabled = false;
+	cgp::fixed_rate_stepper stepper;
+
+	cgp::numarray<cgp::vec3> position_previous;
+	cgp::numarray<cgp::vec3> position_next;
+	cgp::numarray<cgp::vec3> normal_previous;
+	cgp::numarray<cgp::vec3> normal_next;
+
+	// Poses of the two last steps, the displayed skeleton is interpolated like the mesh
+	cgp::numarray<cgp::affine_rt> skeleton_previous;
+	cgp::numarray<cgp::affine_rt> skeleton_next;
+	cgp::numarray<cgp::affine_rt> skeleton_display;
+};
+
+// Skinned vertices written in a single interleaved buffer (half/float positions, packed normals) instead of two float3 VBOs
+struct packed_output_data
+{
+	bool enabled = false;
+	bool half_position = true;
+	bool octahedral_normal = false;
+
+	cgp::packed_vertex_buffer buffer;
+	GLuint vbo = 0;
+	cgp::opengl_shader_structure shader_octahedral; // mesh shader decoding octahedral normals
+	cgp::packed_vertex_error error;                 // deviation of the packed vertices with respect to the float output
+};
+
+// Conservative bounds of the skinned mesh obtained from per-joint bounds, used to skip the skinning of an off-screen mesh
+struct culling_data
+{
+	bool enabled = true;
+	bool display_bounds = false;
+	bool culled = false; // result for the last skinned frame
+
+	cgp::joint_bounds_structure joint_bounds;
+	cgp::bounding_box_structure bounds;
+	cgp::curve_drawable bounds_drawable;
+};
+
+// Clips sampled from a memory-mapped archive instead of the animation of the asset
+struct clip_library_data
+{
+	cgp::clip_library library;
+	int active = -1; // index of the sampled clip, -1 when the animation of the asset is used
+	std::string filename;
+};
+
+// Animation of the asset stored as compressed keyframe tracks
+struct animation_compression_data
+{
+	bool enabled = false;
+	cgp::compression_parameters parameters;
+
+	size_t uncompressed_bytes = 0;
+	size_t compressed_bytes = 0;
+	cgp::compression_error error;
+};
+
+// Second clip layered over the animation of the asset
+struct animation_blend_data
+{
+	bool enabled = false;
+	int layer_clip = 2;     // 0: bend z, 1: bend zx, 2: twist x, 3: translation
+	float weight = 0.5f;
+	bool additive = false;
+	bool mask_lower = true; // the layer only drives the second half of the joints
+
+	cgp::skeleton_animation_structure layer_animation;
+	cgp::blend_layer layers[2];
+	cgp::animation_blend_evaluator evaluator;
+	cgp::numarray<cgp::affine_rt> skeleton_local;
+};
+
+// Frame computed as a graph of tasks (pose, palette, bounds, skinning chunks, packing, velocity state) run on a thread pool
+struct frame_graph_data
+{
+	bool enabled = false;
+	int chunk_size = 4096; // vertices per skinning task
+
+	cgp::task_scheduler scheduler;
+	cgp::task_graph graph;
+	cgp::task_graph_profile profile;
+	cgp::velocity_skinning_frame frame;
+	std::string critical_path; // summary of the last profiled frame
+};
+
+// Velocity skinning computed by a dedicated thread: the GUI only publishes parameters and content, then uploads the last result
+struct skinning_thread_data
+{
+	bool enabled = false;
+	cgp::skinning_worker worker;
+	size_t received_step = 0;
+};
+
+// Per-vertex skinning data gathered in one arena (optionally on huge pages) instead of separate numarray
+struct skinning_arena_data
+{
+	bool enabled = false;
+	int huge_pages = 0; // 0: none, 1: transparent, 2: explicit
+	cgp::skinning_buffers buffers;
+	cgp::instance_skinning_arena instances; // rig and outputs of the character instances
+	cgp::velocity_skinning_frame frame;
+	double skinning_ms = 0.0; // smoothed duration of the skinning of a frame (both storages, for comparison)
+};
+
+// Offline skinning of the current pose from a memory-mapped copy of the mesh, chunk by chunk, to a file
+struct skinning_stream_data
+{
+	int chunk_size = 65536;
+	double time_ms = 0.0;
+	size_t chunk_bytes = 0;
+	size_t vertex_count = 0;
+};
+
+// Bytes used by each component of the character, refreshed on demand from the GUI
+struct memory_footprint_data
+{
+	size_t gpu_mesh_bytes = 0; // one mesh_drawable (the skinned surface has one, the rest pose and the instances share another)
+	cgp::memory_footprint report;
+};
+
+// Extra characters sharing the asset of the main one, side by side and with a time offset
+struct character_instances_data
+{
+	int count = 0;
+	float spacing = 1.5f;
+	float time_offset = 0.25f;
+	cgp::numarray<cgp::character_instance> instances; // drawn with visual_data.surface_asset
+};
+
+// Instances updated less often as they get smaller on screen, with the updates spread over the frames
+struct crowd_schedule_data
+{
+	bool enabled = false;
+	cgp::crowd_scheduler scheduler;
+	cgp::numarray<cgp::crowd_update> update; // instances due in the last frame
+	float radius = 1.0f;                     // bounding sphere of the rest pose of the asset
+	size_t vertex_updated = 0;               // vertices skinned for the instances in the last frame
+	cgp::numarray<size_t> single;            // entries of update skinned one by one (the others are batched)
+	bool in_frame_graph = false;             // the instances of the frame have been skinned by the tasks of the frame graph
+};
+
+// Skinning of the instances under a CPU time budget per frame: the least visible ones are degraded first
+struct skinning_budget_data
+{
+	bool enabled = false;
+	cgp::skinning_budget budget;
+	cgp::numarray<cgp::skinning_work_item> items;
+	cgp::numarray<size_t> update_of_instance; // entry of crowd.update for each instance due in the frame
+	double main_ms = 0.0;                     // deformation of the main character in the last frame, taken from the budget
+};
+
+// Linear blend skinning of the instances at full resolution as one product of the weights of the asset with their stacked palettes
+//  (not combined with the time budget, which degrades the instances one by one)
+struct batched_skinning_data
+{
+	bool enabled = false;
+	cgp::batched_skinning engine;
+	cgp::numarray<cgp::batched_instance_update> updates;
+	cgp::numarray<cgp::batched_skinning_workspace> workspaces; // one per batch run by the frame graph
+	int measure_instance = 32;
+	cgp::batched_skinning_measure measure;
+};
+
+// Global poses of the clip of the asset baked in a table, sampled by the main character and the instances instead of the clip
+struct pose_cache_data
+{
+	bool enabled = false;
+	cgp::pose_cache_parameters parameters;
+	std::shared_ptr<cgp::pose_cache> cache;
+	std::shared_ptr<cgp::skinning_content const> source; // asset the table has been built from
+	cgp::pose_cache_measure measure;
+};
+
+// Velocity deformation of the instances computed on fewer vertices as they get farther from the camera
+struct skinning_lod_data
+{
+	bool enabled = false;
+	cgp::skinning_lod_parameters parameters;
+	cgp::numarray<cgp::skinning_lod_measure> measure; // last measure of the cost and error of each level
+};
+
+// Deviation of the fast rotational deformation on the current shape, for each built-in animation
+struct fast_rotation_data
+{
+	cgp::numarray<std::string> clip;
+	cgp::numarray<cgp::fast_rotation_report> report;
+};
+
+// Compressed cache of the skinned vertices of the current animation, written to a file and measured on demand
+struct vertex_cache_data
+{
+	int number_frame = 240;
+	cgp::vertex_cache_parameters parameters;
+	cgp::vertex_cache_measure measure;
+	std::string filename; // empty until the first measure
+};
+
+// Skinned vertices of the main character published to other processes in a shared memory ring
+//  With the arena storage, the skinning writes directly in the slot of the ring; otherwise the vertices are copied in it
+struct shared_output_data
+{
+	bool enabled = false;
+	std::string name = "/velocity_skinning";
+	int slot_count = 4;
+	cgp::shared_output_writer writer;
+	uint64_t frame_id = 0;
+	bool failed = false; // the ring could not be created with the current settings
+};
+
+// Settings of the data derived from a content, taken when it is requested
+struct content_settings
+{
+	animation_compression_data compression; // and result if enabled
+	bool lod = false;
+	cgp::skinning_lod_parameters lod_parameters;
+	bool arena = false;
+	int huge_pages = 0;
+};
+
+// Character prepared by the content loader, off the render thread, with everything derived from it
+//  The render thread only uploads the mesh and publishes the rest, unless the settings have changed in the meantime.
+struct loaded_content
+{
+	std::string name;
+	std::shared_ptr<cgp::skinning_content> asset; // with its sparse weights, and its levels of detail if enabled
+	cgp::mesh shape;                              // rest pose, to upload
+	content_settings settings;                    // used, with the result of the compression
+	cgp::skinning_buffers arena;                  // storage of the main character, if enabled (empty if it could not be allocated)
+	cgp::joint_bounds_structure joint_bounds;
+};
+
+// std::function so that the procedural loaders can carry their parameters
+typedef std::function<void(cgp::skeleton_animation_structure&, cgp::rig_structure&, cgp::mesh&)> shape_loader;
+typedef std::function<void(cgp::numarray<cgp::numarray<cgp::affine_rt>>&, cgp::numarray<float>&, cgp::numarray<int> const&)> animation_loader;
+
+struct rig_optimization_data
+{
+	cgp::rig_optimization_parameters parameters;
+	cgp::rig_optimization_report report;
+	bool has_report = false;
 };
 
 
@@ -74,16 +348,42 @@ struct scene_structure : cgp::scene_inputs_generic {
 
 	cgp::timer_interval timer;
 	visual_shapes_parameters visual_data;
-	cgp::skeleton_animation_structure skeleton_data;
-	cgp::rig_structure rig;
 	skinning_current_data skinning_data;
 
 
 	// specific variables for velocity skinning
-	cgp::rig_structure velocity_rig;
 	cgp::numarray<cgp::affine_rt> old_joint_rt;
 	cgp::numarray<cgp::vec3> old_velocity;
 	velocity_skinning_parameters velocity_skinning_params;
+	fixed_rate_data fixed_rate;
+	packed_output_data packed_output;
+	culling_data culling;
+	rig_optimization_data rig_optimization;
+	clip_library_data clips;
+	animation_compression_data compression;
+	animation_blend_data blend;
+	frame_graph_data frame_graph;
+	skinning_thread_data skinning_thread;
+	cgp::background_job<loaded_content> content_loader;
+	skinning_arena_data skinning_arena;
+	skinning_stream_data streaming;
+	memory_footprint_data footprint;
+
+	// Rest data of the main character (animation, rigs, rest pose mesh), shared with the skinning thread and the instances.
+	//  It is never modified once published: an edit publishes a modified copy.
+	cgp::skinned_asset_registry assets;
+	std::string asset_name;
+	std::shared_ptr<cgp::skinning_content const> asset;
+	character_instances_data instances;
+	skinning_lod_data lod;
+	crowd_schedule_data crowd;
+	skinning_budget_data skinning_budget;
+	pose_cache_data pose_cache;
+	batched_skinning_data batched;
+	vertex_cache_data vertex_cache;
+	shared_output_data shared_output;
+	fast_rotation_data fast_rotation;
+	procedural_rig_parameters procedural_rig;
 	
 
 	// ****************************** //
@@ -92,10 +392,48 @@ struct scene_structure : cgp::scene_inputs_generic {
 
 	void initialize();    // Standard initialization to be called before the animation loop
 	void display_frame(); // The frame display to be called within the animation loop
+	void render_frame(float dt); // Deformation and draw calls of a frame of duration dt (called by display_frame, or directly by the headless driver)
 	void display_gui();   // The display of the GUI, also called within the animation loop
 
 	void compute_deformation(float dt);
-	void update_new_content(cgp::mesh const& shape, cgp::opengl_texture_image_structure texture_id);
+	void compute_deformation_fixed_rate(float dt);
+	void compute_deformation_task_graph(float dt);
+	void compute_deformation_thread();
+	std::shared_ptr<cgp::skinning_content> edit_asset() const; // copy of the asset to modify, then to publish
+	void publish_asset(std::shared_ptr<cgp::skinning_content const> content); // new rest data of the main character, given to its users
+	void update_lod(); // levels of the asset for the current settings
+	void update_character_instances();
+	void update_crowd(float dt); // velocity skinning of the instances for a frame
+	void schedule_crowd(float dt); // instances due in the frame
+	void assign_crowd_updates(); // level of detail of the instances due, split between batched and single updates
+	void update_crowd_instance(cgp::crowd_update const& u);
+	void update_pose_cache(); // table of the current asset, given to the instances
+	void draw_character_instances();
+	void prepare_asset_surface(bool rest_pose); // uploads the mesh of the asset if needed, and its rest pose if requested
+	void update_skinning_arena();
+	void update_instance_arena(); // rebuilt if the asset, the number of instances or the huge page mode changed
+	void stream_current_pose();
+	void record_vertex_cache(); // velocity skinning of vertex_cache.number_frame frames at 60 fps, encoded and decoded back
+	bool update_shared_output(); // (re)creates the ring for the current vertex count, return true if it is open
+	void publish_shared_output(cgp::numarray<cgp::vec3> const& position, cgp::numarray<cgp::vec3> const& normal);
+	cgp::memory_footprint compute_memory_footprint() const;
+	void reset_fixed_rate();
+	void upload_skinned_vertices();
+	void update_packed_output_layout();
+	bool update_culling(float dt); // return true if the skinned mesh is visible
+	bool compute_culling(float dt); // same as update_culling, without updating the drawable of the bounds (no OpenGL call)
+	void evaluate_skeleton(float t, cgp::numarray<cgp::affine_rt>& skeleton_global); // global joint transforms of the current animation
+	void export_clip_archive();
+	void select_clip(int index);
+	void update_compression();
+	void measure_fast_rotation();
+	void update_blend_layer();
+	void load_content(std::string const& name, shape_loader load_shape, animation_loader load_animation); // prepared immediately
+	void request_content(std::string const& name, shape_loader load_shape, animation_loader load_animation); // prepared in the background
+	void request_procedural_content(procedural_motion motion); // character of procedural_rig
+	void apply_content(loaded_content& content);
+	content_settings current_content_settings() const;
+	void update_new_content(std::shared_ptr<cgp::skinning_content const> content, cgp::mesh const& shape, cgp::opengl_texture_image_structure texture_id);
 
 	void mouse_move_event();
 	void mouse_click_event();
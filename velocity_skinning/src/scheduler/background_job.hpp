@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+
+
+namespace cgp
+{
+	// Build a value of type T on a background thread, and collect it later without blocking.
+	//  Only one job runs at a time: a request made while a job is running replaces any request still waiting,
+	//  and the result of the running job is dropped once it is superseded.
+	template <typename T>
+	struct background_job
+	{
+		using build_function = std::function<void(T&)>;
+
+		~background_job();
+
+		void request(build_function const& build);
+		// The finished value, or nullptr if no up-to-date value is ready yet (never blocks)
+		std::shared_ptr<T> take();
+		bool is_busy() const;
+
+	private:
+		void launch(build_function const& build);
+
+		std::future<std::shared_ptr<T> > job;
+		build_function queued;
+	};
+
+
+	template <typename T>
+	background_job<T>::~background_job()
+	{
+		if (job.valid())
+			job.wait();
+	}
+
+	template <typename T>
+	void background_job<T>::request(build_function const& build)
+	{
+		if (job.valid())
+			queued = build;
+		else
+			launch(build);
+	}
+
+	template <typename T>
+	std::shared_ptr<T> background_job<T>::take()
+	{
+		if (!job.valid() || job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return nullptr;
+
+		std::shared_ptr<T> value = job.get();
+		if (queued) {
+			launch(queued);
+			queued = nullptr;
+			return nullptr;
+		}
+		return value;
+	}
+
+	template <typename T>
+	bool background_job<T>::is_busy() const
+	{
+		return job.valid();
+	}
+
+	template <typename T>
+	void background_job<T>::launch(build_function const& build)
+	{
+		job = std::async(std::launch::async, [build]() {
+			std::shared_ptr<T> value = std::make_shared<T>();
+			build(*value);
+			return value;
+		});
+	}
+}
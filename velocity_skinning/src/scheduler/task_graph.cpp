@@ -0,0 +1,324 @@
+#include "task_graph.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+namespace cgp
+{
+	int task_graph::add(std::string const& name, std::function<void()> const& work)
+	{
+		task t;
+		t.name = name;
+		t.work = work;
+		tasks.push_back(t);
+		return int(tasks.size()) - 1;
+	}
+
+	void task_graph::depend(int task_index, int dependency)
+	{
+		assert_cgp(task_index>=0 && task_index<int(tasks.size()) && dependency>=0 && dependency<int(tasks.size()) && task_index!=dependency, "Invalid task dependency");
+		tasks[task_index].dependency.push_back(dependency);
+		tasks[dependency].successor.push_back(task_index);
+	}
+
+	void task_graph::clear()
+	{
+		tasks.clear();
+	}
+
+	size_t task_graph::size() const
+	{
+		return tasks.size();
+	}
+
+
+	void compute_critical_path(task_graph const& graph, task_graph_profile& profile)
+	{
+		size_t const N = graph.size();
+		profile.critical_path.clear();
+		profile.critical_path_ms = 0.0;
+		profile.work_ms = 0.0;
+		if (N == 0)
+			return;
+
+		// Topological order (Kahn)
+		numarray<int> in_degree(N);
+		numarray<int> order;
+		for (size_t k = 0; k < N; ++k) {
+			in_degree[k] = int(graph.tasks[k].dependency.size());
+			if (in_degree[k] == 0)
+				order.push_back(int(k));
+		}
+		for (size_t k = 0; k < order.size(); ++k)
+			for (int s : graph.tasks[order[k]].successor)
+				if (--in_degree[s] == 0)
+					order.push_back(s);
+		assert_cgp(order.size()==N, "The task graph has a cycle");
+
+		// Longest path ending at each task
+		numarray<double> longest(N);
+		numarray<int> previous(N);
+		int last = -1;
+		for (int t : order) {
+			double const duration = profile.timing[t].end_ms - profile.timing[t].start_ms;
+			profile.work_ms += duration;
+
+			previous[t] = -1;
+			double before = 0.0;
+			for (int d : graph.tasks[t].dependency) {
+				if (longest[d] > before || previous[t] == -1) {
+					before = longest[d];
+					previous[t] = d;
+				}
+			}
+			longest[t] = before + duration;
+			if (last == -1 || longest[t] > longest[last])
+				last = t;
+		}
+
+		profile.critical_path_ms = longest[last];
+		for (int t = last; t != -1; t = previous[t])
+			profile.critical_path.push_back(t);
+		std::reverse(profile.critical_path.data.begin(), profile.critical_path.data.end());
+	}
+
+	std::string task_graph_profile::critical_path_summary(task_graph const& graph) const
+	{
+		std::ostringstream s;
+		s.precision(3);
+		for (size_t k = 0; k < critical_path.size(); ++k) {
+			int const t = critical_path[k];
+			if (k > 0)
+				s << " > ";
+			s << graph.tasks[t].name << " (" << std::fixed << timing[t].end_ms - timing[t].start_ms << " ms)";
+		}
+		return s.str();
+	}
+
+	bool write_task_trace(std::string const& filename, task_graph const& graph, task_graph_profile const& profile)
+	{
+		std::ofstream stream(filename);
+		if (!stream)
+			return false;
+
+		stream << "[";
+		for (size_t k = 0; k < graph.size(); ++k) {
+			task_graph_profile::task_timing const& t = profile.timing[k];
+			bool const critical = std::find(profile.critical_path.data.begin(), profile.critical_path.data.end(), int(k)) != profile.critical_path.data.end();
+			stream << (k > 0 ? ",\n" : "\n")
+				<< "{\"name\":\"" << graph.tasks[k].name << "\",\"cat\":\"" << (critical ? "critical" : "task") << "\",\"ph\":\"X\""
+				<< ",\"ts\":" << 1000.0 * t.start_ms << ",\"dur\":" << 1000.0 * (t.end_ms - t.start_ms)
+				<< ",\"pid\":0,\"tid\":" << t.worker << "}";
+		}
+		stream << "\n]\n";
+		return bool(stream);
+	}
+
+
+	task_scheduler::~task_scheduler()
+	{
+		shutdown();
+	}
+
+	void task_scheduler::initialize(size_t N_thread)
+	{
+		shutdown();
+		if (N_thread == 0)
+			N_thread = std::max(1u, std::thread::hardware_concurrency());
+
+		N_queue = N_thread;
+		queues.reset(new worker_queue[N_queue]);
+		// The new workers start from generation 0: none of them may take a run of the previous pool for a new one
+		{
+			std::lock_guard<std::mutex> lock(run_mutex);
+			quit = false;
+			generation = 0;
+			active_worker = 0;
+		}
+		for (size_t k = 1; k < N_thread; ++k)
+			threads.push_back(std::thread(&task_scheduler::worker_loop, this, k));
+	}
+
+	void task_scheduler::shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(run_mutex);
+			quit = true;
+		}
+		run_begin.notify_all();
+		for (std::thread& t : threads)
+			t.join();
+		threads.clear();
+	}
+
+	size_t task_scheduler::number_thread() const
+	{
+		return threads.size() + 1;
+	}
+
+	void task_scheduler::run(task_graph const& graph_arg, task_graph_profile* profile_arg)
+	{
+		if (N_queue == 0)
+			initialize();
+
+		size_t const N = graph_arg.size();
+		if (N == 0)
+			return;
+
+		graph = &graph_arg;
+		profile = profile_arg;
+		if (profile != nullptr)
+			profile->timing.resize(N);
+		if (pending_capacity < N) {
+			pending.reset(new std::atomic<int>[N]);
+			pending_capacity = N;
+		}
+
+		// Tasks without dependency are spread over all the workers
+		size_t root = 0;
+		for (size_t k = 0; k < N; ++k) {
+			pending[k].store(int(graph->tasks[k].dependency.size()), std::memory_order_relaxed);
+			if (graph->tasks[k].dependency.size() == 0)
+				push(root++ % N_queue, int(k));
+		}
+		remaining.store(int(N));
+		run_start = std::chrono::steady_clock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(run_mutex);
+			active_worker = threads.size();
+			++generation;
+		}
+		run_begin.notify_all();
+
+		execute(0);
+
+		// The workers must be done with the graph before it is released by the caller
+		{
+			std::unique_lock<std::mutex> lock(run_mutex);
+			run_end.wait(lock, [this]() { return active_worker == 0; });
+		}
+
+		if (profile != nullptr) {
+			profile->wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - run_start).count();
+			compute_critical_path(*graph, *profile);
+		}
+		graph = nullptr;
+		profile = nullptr;
+	}
+
+	void task_scheduler::worker_loop(size_t worker)
+	{
+		size_t seen_generation = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(run_mutex);
+				run_begin.wait(lock, [&]() { return quit || generation != seen_generation; });
+				if (quit)
+					return;
+				seen_generation = generation;
+			}
+
+			execute(worker);
+
+			{
+				std::lock_guard<std::mutex> lock(run_mutex);
+				--active_worker;
+			}
+			run_end.notify_all();
+		}
+	}
+
+	void task_scheduler::execute(size_t worker)
+	{
+		// A few attempts before sleeping: the tasks unlocked by a running task are usually pushed soon after
+		int const attempt_before_sleep = 16;
+		int attempt = 0;
+		while (remaining.load() > 0) {
+			int t;
+			if (!pop(worker, t)) {
+				if (++attempt < attempt_before_sleep)
+					std::this_thread::yield();
+				else {
+					wait_for_task();
+					attempt = 0;
+				}
+				continue;
+			}
+			attempt = 0;
+
+			task_graph::task const& current = graph->tasks[t];
+			auto const start = std::chrono::steady_clock::now();
+			current.work();
+			auto const end = std::chrono::steady_clock::now();
+
+			if (profile != nullptr) {
+				task_graph_profile::task_timing& timing = profile->timing[t];
+				timing.start_ms = std::chrono::duration<double, std::milli>(start - run_start).count();
+				timing.end_ms = std::chrono::duration<double, std::milli>(end - run_start).count();
+				timing.worker = int(worker);
+			}
+
+			for (int s : current.successor)
+				if (pending[s].fetch_sub(1) == 1)
+					push(worker, s);
+			if (remaining.fetch_sub(1) == 1)
+				wake_all();
+		}
+	}
+
+	void task_scheduler::push(size_t worker, int task_index)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queues[worker].mutex);
+			queues[worker].tasks.push_back(task_index);
+		}
+		// queued is written before sleeping is read, and the reverse in wait_for_task (both sequentially consistent):
+		//  either the pusher sees the sleeper, or the sleeper sees the task
+		queued.fetch_add(1);
+		if (sleeping.load() > 0) {
+			std::lock_guard<std::mutex> lock(idle_mutex);
+			idle.notify_one();
+		}
+	}
+
+	void task_scheduler::wait_for_task()
+	{
+		std::unique_lock<std::mutex> lock(idle_mutex);
+		sleeping.fetch_add(1);
+		idle.wait(lock, [this]() { return queued.load() > 0 || remaining.load() == 0; });
+		sleeping.fetch_sub(1);
+	}
+
+	void task_scheduler::wake_all()
+	{
+		std::lock_guard<std::mutex> lock(idle_mutex);
+		idle.notify_all();
+	}
+
+	bool task_scheduler::pop(size_t worker, int& task_index)
+	{
+		{
+			worker_queue& own = queues[worker];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.tasks.empty()) {
+				task_index = own.tasks.back();
+				own.tasks.pop_back();
+				queued.fetch_sub(1);
+				return true;
+			}
+		}
+		for (size_t k = 1; k < N_queue; ++k) {
+			worker_queue& victim = queues[(worker + k) % N_queue];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				task_index = victim.tasks.front();
+				victim.tasks.pop_front();
+				queued.fetch_sub(1);
+				return true;
+			}
+		}
+		return false;
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace cgp
+{
+	// Directed acyclic graph of tasks: a task starts once all its dependencies are done
+	struct task_graph
+	{
+		struct task
+		{
+			std::string name;
+			std::function<void()> work;
+			numarray<int> dependency; // tasks that must be done before this one
+			numarray<int> successor;  // tasks waiting for this one
+		};
+		numarray<task> tasks;
+
+		// Return the index of the new task
+		int add(std::string const& name, std::function<void()> const& work);
+		// The task runs after the task dependency
+		void depend(int task_index, int dependency);
+		void clear();
+		size_t size() const;
+	};
+
+	// Measured execution of a graph
+	struct task_graph_profile
+	{
+		struct task_timing
+		{
+			double start_ms = 0.0; // relative to the beginning of the run
+			double end_ms = 0.0;
+			int worker = -1;
+		};
+		numarray<task_timing> timing;
+
+		double wall_ms = 0.0;          // duration of the run
+		double work_ms = 0.0;          // sum of the durations of all tasks
+		double critical_path_ms = 0.0; // longest chain of dependent tasks (sum of their durations)
+		numarray<int> critical_path;   // tasks of this chain, in execution order
+
+		// Human readable critical path: "name (duration) > name (duration) > ..."
+		std::string critical_path_summary(task_graph const& graph) const;
+	};
+
+	// Longest chain of dependent tasks, weighted by the measured durations
+	void compute_critical_path(task_graph const& graph, task_graph_profile& profile);
+
+	// Trace of the run in the Chrome tracing format (chrome://tracing, Perfetto)
+	bool write_task_trace(std::string const& filename, task_graph const& graph, task_graph_profile const& profile);
+
+
+	// Pool of threads running task graphs with work stealing:
+	//  each worker pushes the tasks it unlocks on its own deque and pops them back (LIFO),
+	//  an idle worker steals the oldest task of another worker, and sleeps once all the queues are empty.
+	//  The calling thread takes part in the run as worker 0.
+	struct task_scheduler
+	{
+		task_scheduler() = default;
+		task_scheduler(task_scheduler const&) = delete;
+		task_scheduler& operator=(task_scheduler const&) = delete;
+		~task_scheduler();
+
+		// N_thread includes the calling thread, 0 uses the number of hardware threads
+		void initialize(size_t N_thread = 0);
+		void shutdown();
+		size_t number_thread() const;
+
+		// Run all the tasks of the graph and return once they are all done
+		void run(task_graph const& graph, task_graph_profile* profile = nullptr);
+
+	private:
+		struct worker_queue
+		{
+			std::mutex mutex;
+			std::deque<int> tasks;
+		};
+
+		void worker_loop(size_t worker);
+		void execute(size_t worker);
+		void push(size_t worker, int task_index);
+		bool pop(size_t worker, int& task_index);
+		void wait_for_task(); // until a task is queued or the run is over
+		void wake_all();
+
+		std::vector<std::thread> threads;
+		std::unique_ptr<worker_queue[]> queues;
+		size_t N_queue = 0;
+
+		// State of the current run
+		task_graph const* graph = nullptr;
+		task_graph_profile* profile = nullptr;
+		std::unique_ptr<std::atomic<int>[]> pending; // remaining dependencies of each task
+		size_t pending_capacity = 0;
+		std::atomic<int> remaining{ 0 };
+		std::atomic<int> queued{ 0 };   // tasks in all the queues
+		std::atomic<int> sleeping{ 0 }; // workers waiting in wait_for_task
+		std::mutex idle_mutex;
+		std::condition_variable idle;
+		std::chrono::steady_clock::time_point run_start;
+
+		std::mutex run_mutex;
+		std::condition_variable run_begin;
+		std::condition_variable run_end;
+		size_t generation = 0;
+		size_t active_worker = 0;
+		bool quit = false;
+	};
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+
+
+namespace cgp
+{
+	// Lock-free channel between one writer thread and one reader thread.
+	//  The writer fills write_buffer() then publish(), the reader calls update() then read_buffer().
+	//  Neither side ever waits for the other: the reader sees the last published value, intermediate ones may be skipped.
+	//  The three buffers are exchanged instead of copied, so a value holding memory (numarray) keeps its capacity.
+	template <typename T>
+	struct triple_buffer
+	{
+		// Set all three buffers (not thread safe: call before the threads start)
+		void reset(T const& value);
+
+		// Writer side
+		T& write_buffer();
+		void publish();
+
+		// Reader side: return true if a new value has been published since the last update
+		bool update();
+		T const& read_buffer() const;
+
+	private:
+		static unsigned char const index_mask = 3;
+		static unsigned char const fresh_bit = 4;
+
+		T buffer[3];
+		std::atomic<unsigned char> middle{ 1 }; // index of the buffer exchanged between the two sides (+ fresh_bit)
+		unsigned char back = 0;                 // owned by the writer
+		unsigned char front = 2;                // owned by the reader
+	};
+
+
+	template <typename T>
+	void triple_buffer<T>::reset(T const& value)
+	{
+		for (T& b : buffer)
+			b = value;
+		middle.store(1);
+		back = 0;
+		front = 2;
+	}
+
+	template <typename T>
+	T& triple_buffer<T>::write_buffer()
+	{
+		return buffer[back];
+	}
+
+	template <typename T>
+	void triple_buffer<T>::publish()
+	{
+		unsigned char const previous = middle.exchange(static_cast<unsigned char>(back | fresh_bit), std::memory_order_acq_rel);
+		back = previous & index_mask;
+	}
+
+	template <typename T>
+	bool triple_buffer<T>::update()
+	{
+		if ((middle.load(std::memory_order_relaxed) & fresh_bit) == 0)
+			return false;
+		unsigned char const previous = middle.exchange(front, std::memory_order_acq_rel);
+		front = previous & index_mask;
+		return true;
+	}
+
+	template <typename T>
+	T const& triple_buffer<T>::read_buffer() const
+	{
+		return buffer[front];
+	}
+}
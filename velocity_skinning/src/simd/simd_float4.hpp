@@ -0,0 +1,74 @@
+#pragma once
+
+// Four packed floats, mapped to SSE when available and to plain scalar code otherwise (e.g. emscripten)
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CGP_SIMD_SSE
+#include <xmmintrin.h>
+#else
+#include <cmath>
+#endif
+
+namespace cgp
+{
+#ifdef CGP_SIMD_SSE
+	struct float4
+	{
+		__m128 v;
+
+		float4() : v(_mm_setzero_ps()) {}
+		float4(__m128 value) : v(value) {}
+		explicit float4(float s) : v(_mm_set1_ps(s)) {}
+
+		static float4 load(float const* p) { return float4(_mm_loadu_ps(p)); }
+		void store(float* p) const { _mm_storeu_ps(p, v); }
+	};
+
+	inline float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+	inline float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+	inline float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+	inline float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+	inline float4 sqrt(float4 a) { return _mm_sqrt_ps(a.v); }
+	inline float4 min(float4 a, float4 b) { return _mm_min_ps(a.v, b.v); }
+	inline float4 max(float4 a, float4 b) { return _mm_max_ps(a.v, b.v); }
+	inline float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+	// Sign of a (+1 or -1, +1 for 0)
+	inline float4 sign(float4 a) { return _mm_or_ps(_mm_set1_ps(1.0f), _mm_and_ps(_mm_set1_ps(-0.0f), a.v)); }
+	// Per lane: mask ? a : b, with mask = (x < y)
+	inline float4 select_less(float4 x, float4 y, float4 a, float4 b)
+	{
+		__m128 const mask = _mm_cmplt_ps(x.v, y.v);
+		return _mm_or_ps(_mm_and_ps(mask, a.v), _mm_andnot_ps(mask, b.v));
+	}
+#else
+	struct float4
+	{
+		float v[4];
+
+		float4() : v{ 0, 0, 0, 0 } {}
+		explicit float4(float s) : v{ s, s, s, s } {}
+
+		static float4 load(float const* p) { float4 r; for (int k = 0; k < 4; ++k) r.v[k] = p[k]; return r; }
+		void store(float* p) const { for (int k = 0; k < 4; ++k) p[k] = v[k]; }
+	};
+
+	template <typename F>
+	inline float4 float4_apply(float4 a, float4 b, F f) { float4 r; for (int k = 0; k < 4; ++k) r.v[k] = f(a.v[k], b.v[k]); return r; }
+
+	inline float4 operator+(float4 a, float4 b) { return float4_apply(a, b, [](float x, float y) { return x + y; }); }
+	inline float4 operator-(float4 a, float4 b) { return float4_apply(a, b, [](float x, float y) { return x - y; }); }
+	inline float4 operator*(float4 a, float4 b) { return float4_apply(a, b, [](float x, float y) { return x * y; }); }
+	inline float4 operator/(float4 a, float4 b) { return float4_apply(a, b, [](float x, float y) { return x / y; }); }
+	inline float4 sqrt(float4 a) { return float4_apply(a, a, [](float x, float) { return std::sqrt(x); }); }
+	inline float4 min(float4 a, float4 b) { return float4_apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+	inline float4 max(float4 a, float4 b) { return float4_apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+	inline float4 abs(float4 a) { return float4_apply(a, a, [](float x, float) { return std::abs(x); }); }
+	inline float4 sign(float4 a) { return float4_apply(a, a, [](float x, float) { return std::signbit(x) ? -1.0f : 1.0f; }); }
+	inline float4 select_less(float4 x, float4 y, float4 a, float4 b)
+	{
+		float4 r;
+		for (int k = 0; k < 4; ++k) r.v[k] = x.v[k] < y.v[k] ? a.v[k] : b.v[k];
+		return r;
+	}
+#endif
+}
@@ -2,7 +2,7 @@
 
 namespace cgp
 {
-	static bool find_interval(int& index_0, float& alpha, numarray<float> times, float t)
+	static bool find_interval(int& index_0, float& alpha, numarray<float> const& times, float t)
 	{
 		assert_cgp(times.size()>=2, "time intervals should have more than 2 values");
 
@@ -31,6 +31,28 @@ namespace cgp
 	}
 
 	numarray<affine_rt> skeleton_animation_structure::evaluate_local(float t) const
+	{
+		numarray<affine_rt> skeleton_local;
+		evaluate_local(t, skeleton_local);
+		return skeleton_local;
+	}
+
+	void skeleton_animation_structure::evaluate_local(float t, numarray<affine_rt>& skeleton_local) const
+	{
+		if (compressed_animation)
+			compressed_animation->evaluate_local(t, skeleton_local);
+		else
+			evaluate_animation_local(animation_time, animation_geometry_local, t, skeleton_local);
+	}
+
+	numarray<affine_rt> evaluate_animation_local(numarray<float> const& animation_time, numarray<numarray<affine_rt> > const& animation_geometry_local, float t)
+	{
+		numarray<affine_rt> skeleton_local;
+		evaluate_animation_local(animation_time, animation_geometry_local, t, skeleton_local);
+		return skeleton_local;
+	}
+
+	void evaluate_animation_local(numarray<float> const& animation_time, numarray<numarray<affine_rt> > const& animation_geometry_local, float t, numarray<affine_rt>& skeleton_current)
 	{
 		int kt=0;
 		float alpha;
@@ -38,7 +60,6 @@ namespace cgp
 		assert_cgp(find_time, "Could not find correct time interval for time t="+str(t)+", while allowed time interval is ["+str(animation_time[0])+","+str(animation_time[animation_time.size()-1])+"]");
 
 		size_t const N_joint = animation_geometry_local[0].size();
-		numarray<affine_rt> skeleton_current;
 		skeleton_current.resize(N_joint);
 
 		for(size_t kj=0; kj<N_joint; ++kj)
@@ -81,8 +102,6 @@ namespace cgp
 
 			skeleton_current[kj] = T;
 		}
-
-		return skeleton_current;
 	}
 	size_t skeleton_animation_structure::number_joint() const
 	{
@@ -96,13 +115,34 @@ namespace cgp
 	void skeleton_animation_structure::scale(float s)
 	{
 		size_t const N_joint = number_joint();
-		size_t const N_time = number_animation_frame();
 		for(size_t k=0; k<N_joint; ++k)
 			rest_pose_local[k].translation *= s;
 
-		for(size_t kt=0; kt<N_time; ++kt)
+		for(size_t kt=0; kt<animation_geometry_local.size(); ++kt)
 			for(size_t k=0; k<N_joint; ++k)
 				animation_geometry_local[kt][k].translation *= s;
+
+		if (compressed_animation) {
+			std::shared_ptr<compressed_clip> scaled = std::make_shared<compressed_clip>(*compressed_animation);
+			scaled->scale(s);
+			compressed_animation = scaled;
+		}
+	}
+
+	void skeleton_animation_structure::compress(compression_parameters const& parameters)
+	{
+		if (compressed_animation)
+			decompress();
+		compressed_animation = std::make_shared<compressed_clip>(compress_clip(animation_time, animation_geometry_local, parameters));
+		animation_geometry_local.clear();
+	}
+
+	void skeleton_animation_structure::decompress()
+	{
+		if (!compressed_animation)
+			return;
+		animation_geometry_local = compressed_animation->decompress();
+		compressed_animation.reset();
 	}
 	
 
@@ -116,18 +156,33 @@ namespace cgp
 		return skeleton_local_to_global(rest_pose_local, parent_index);
 	}
 
+	memory_usage memory_usage_of(skeleton_animation_structure const& skeleton)
+	{
+		memory_usage usage = memory_usage_of(skeleton.parent_index) + memory_usage_of(skeleton.rest_pose_local)
+			+ memory_usage_of(skeleton.animation_time) + memory_usage_of(skeleton.animation_geometry_local);
+		if (skeleton.compressed_animation) {
+			usage.bytes += skeleton.compressed_animation->memory_size() + heap_allocation_overhead;
+			usage.allocation += 1;
+		}
+		return usage;
+	}
+
 	numarray<affine_rt> skeleton_local_to_global(numarray<affine_rt> const& local, numarray<int> const& parent_index)
+	{
+		numarray<affine_rt> global;
+		skeleton_local_to_global(local, parent_index, global);
+		return global;
+	}
+
+	void skeleton_local_to_global(numarray<affine_rt> const& local, numarray<int> const& parent_index, numarray<affine_rt>& global)
 	{
 		assert_cgp(parent_index.size()==local.size(), "Incoherent size of skeleton data");
 		size_t const N = parent_index.size();
-		numarray<affine_rt> global;
 		global.resize(N);
 		global[0] = local[0];
 
 		for (size_t k = 1; k < N; ++k)
 			global[k] = global[parent_index[k]] * local[k];
-	
-		return global;
 	}
 
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "cgp/cgp.hpp"
+#include "../animation/compressed_clip.hpp"
+#include "../memory/memory_footprint.hpp"
+
+#include <memory>
 
 
 namespace cgp
@@ -13,6 +17,7 @@ namespace cgp
 
 		numarray<float> animation_time;      // Sequence of time corresponding to the animation
 		numarray<numarray<affine_rt> > animation_geometry_local; // Storage of all rigid transforms of the joints for every frame in local coordinates (for all time, for all joints)
+		std::shared_ptr<compressed_clip const> compressed_animation; // When set, replaces animation_geometry_local (which is then empty)
 
 		// Number of joints in the skeleton
 		size_t number_joint() const;
@@ -21,6 +26,7 @@ namespace cgp
 
 		// Evaluate the interpolated joint rigid transforms in local coordinates at the time t
 		numarray<affine_rt> evaluate_local(float t) const;
+		void evaluate_local(float t, numarray<affine_rt>& skeleton_local) const; // no allocation if skeleton_local has the right size
 		// Evaluate the interpolated joint rigid transforms in global coordinates at the time t
 		numarray<affine_rt> evaluate_global(float t) const;
 
@@ -30,8 +36,20 @@ namespace cgp
 		// Apply scaling to the entire skeleton (scale the translation part of the rigid transforms)
 		void scale(float s);
 
+		// Replace animation_geometry_local by its compressed version / expand it back
+		void compress(compression_parameters const& parameters);
+		void decompress();
+
 	};
 
+	// The compressed animation is counted by its memory_size, as a single block
+	memory_usage memory_usage_of(skeleton_animation_structure const& skeleton);
+
 	// Convert a skeleton defined in local coordinates to global coordinates
 	numarray<affine_rt> skeleton_local_to_global(numarray<affine_rt> const& local, numarray<int> const& parent_index);
+	void skeleton_local_to_global(numarray<affine_rt> const& local, numarray<int> const& parent_index, numarray<affine_rt>& global);
+
+	// Interpolated joint rigid transforms in local coordinates at time t, for an animation given as a sequence of frames
+	numarray<affine_rt> evaluate_animation_local(numarray<float> const& animation_time, numarray<numarray<affine_rt> > const& animation_geometry_local, float t);
+	void evaluate_animation_local(numarray<float> const& animation_time, numarray<numarray<affine_rt> > const& animation_geometry_local, float t, numarray<affine_rt>& skeleton_local);
 }
\ No newline at end of file
@@ -19,16 +19,16 @@ namespace cgp
 		}
 		
 		segments.display_type = curve_drawable_display_type::Segments;
-		segments.initialize_data_on_gpu(edges);
-		joint_frame.initialize_data_on_gpu(mesh_primitive_frame());
-		joint_sphere.initialize_data_on_gpu(mesh_primitive_sphere());
+		render_initialize(segments, edges);
+		render_initialize(joint_frame, mesh_primitive_frame());
+		render_initialize(joint_sphere, mesh_primitive_sphere());
 	}
 
 	void skeleton_drawable::clear()
 	{
-		segments.clear();
-		joint_frame.clear();
-		joint_sphere.clear();
+		render_clear(segments);
+		render_clear(joint_frame);
+		render_clear(joint_sphere);
 		data.clear();
 	}
 
@@ -45,6 +45,6 @@ namespace cgp
 			edges.push_back(skeleton[parent].translation);
 		}
 
-		segments.vbo_position.update(edges);
+		render_update(segments.vbo_position, edges);
 	}
 } 
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cgp/cgp.hpp"
+#include "../render/render_backend.hpp"
 
 namespace cgp
 {
@@ -34,7 +35,7 @@ namespace cgp
 	void draw(skeleton_drawable const& skeleton, SCENE const& scene)
 	{
 		if(skeleton.display_segments)
-			draw(skeleton.segments, scene);
+			render_draw(skeleton.segments, scene);
 		
 		size_t const N = skeleton.data.size();
 
@@ -46,7 +47,7 @@ namespace cgp
 			{
 				joint_frame_temp.model.translation = skeleton.data[k].translation;
 				joint_frame_temp.model.rotation = skeleton.data[k].rotation;
-				draw(joint_frame_temp, scene);
+				render_draw(joint_frame_temp, scene);
 			}
 		}
 		
@@ -57,7 +58,7 @@ namespace cgp
 			for (size_t k = 0; k < N; ++k)
 			{
 				joint_sphere_temp.model.translation = skeleton.data[k].translation;
-				draw(joint_sphere_temp, scene);
+				render_draw(joint_sphere_temp, scene);
 			}
 		}
 
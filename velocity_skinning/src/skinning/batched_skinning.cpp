@@ -0,0 +1,234 @@
+#include "batched_skinning.hpp"
+#include "../simd/simd_float4.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace cgp
+{
+	size_t stacked_palette::number_group() const
+	{
+		return (number_instance + 3) / 4;
+	}
+
+	void stacked_palette::resize(size_t N_instance, size_t N_joint)
+	{
+		number_instance = N_instance;
+		number_joint = N_joint;
+		data.resize(number_group() * N_joint * 48);
+		data.fill(0.0f);
+	}
+
+	void stacked_palette::set(size_t instance, numarray<mat4> const& palette)
+	{
+		assert_cgp(instance < number_instance && palette.size() == number_joint, "Incoherent size of the stacked palettes");
+		size_t const lane = instance % 4;
+		float* group = &data[(instance / 4) * number_joint * 48];
+		for (size_t j = 0; j < number_joint; ++j) {
+			mat4 const& M = palette[j];
+			float* coefficient = group + j * 48;
+			for (int r = 0; r < 3; ++r)
+				for (int c = 0; c < 4; ++c)
+					coefficient[(4 * r + c) * 4 + lane] = M(r, c);
+		}
+	}
+
+	void batched_linear_blend_skinning(
+		size_t begin,
+		size_t end,
+		sparse_weight_matrix const& W,
+		stacked_palette const& P,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		numarray<vec3>* const* position_skinned,
+		numarray<vec3>* const* normal_skinned,
+		size_t vertices_per_block)
+	{
+		size_t const N_group = P.number_group();
+		size_t const N_joint = P.number_joint;
+		vertices_per_block = std::max(vertices_per_block, size_t(1));
+
+		for (size_t block = begin; block < end; block += vertices_per_block) {
+			size_t const block_end = std::min(block + vertices_per_block, end);
+			for (size_t g = 0; g < N_group; ++g) {
+				float const* palette = &P.data[g * N_joint * 48];
+				size_t const first = 4 * g;
+				size_t const N_lane = std::min(size_t(4), P.number_instance - first);
+
+				for (size_t i = block; i < block_end; ++i) {
+					// Row i of W times the palettes: one weighted 3x4 matrix per lane
+					float4 m[12];
+					for (unsigned int k = W.row_offset[i]; k < W.row_offset[i + 1]; ++k) {
+						float4 const w(W.value[k]);
+						float const* Pj = palette + size_t(W.column[k]) * 48;
+						for (int c = 0; c < 12; ++c)
+							m[c] = m[c] + w * float4::load(Pj + 4 * c);
+					}
+
+					// Same as mat4 * vec3 in linear_blend_skinning_vertices (both as points)
+					float result[6][4];
+					vec3 const& p = position_rest_pose[i];
+					vec3 const& n = normal_rest_pose[i];
+					float4 const px(p.x), py(p.y), pz(p.z);
+					float4 const nx(n.x), ny(n.y), nz(n.z);
+					for (int r = 0; r < 3; ++r) {
+						float4 const* row = m + 4 * r;
+						(row[0] * px + row[1] * py + row[2] * pz + row[3]).store(result[r]);
+						(row[0] * nx + row[1] * ny + row[2] * nz + row[3]).store(result[3 + r]);
+					}
+					for (size_t l = 0; l < N_lane; ++l) {
+						(*position_skinned[first + l])[i] = vec3(result[0][l], result[1][l], result[2][l]);
+						(*normal_skinned[first + l])[i] = vec3(result[3][l], result[4][l], result[5][l]);
+					}
+				}
+			}
+		}
+	}
+
+	void batched_skinning::set_asset(std::shared_ptr<skinning_content const> const& value)
+	{
+		assert_cgp(value == nullptr || value->weights.number_row == value->position_rest_pose.size(), "The sparse weights of the asset have not been built");
+		asset = value;
+	}
+
+	void batched_skinning::update(numarray<batched_instance_update> const& updates, float t, float speed_blending,
+		float linear_deformation_intensity, float rotational_deformation_intensity, float fast_rotation_angle)
+	{
+		size_t const N_batch = number_batch(updates.size());
+		for (size_t batch = 0; batch < N_batch; ++batch)
+			update_batch(batch, updates, t, speed_blending, linear_deformation_intensity, rotational_deformation_intensity, fast_rotation_angle, workspace);
+	}
+
+	size_t batched_skinning::number_batch(size_t N_update) const
+	{
+		if (asset == nullptr)
+			return 0;
+		size_t const max_batch = size_t(std::max(parameters.max_batch, 1));
+		return (N_update + max_batch - 1) / max_batch;
+	}
+
+	void batched_skinning::update_batch(size_t batch, numarray<batched_instance_update> const& updates, float t, float speed_blending,
+		float linear_deformation_intensity, float rotational_deformation_intensity, float fast_rotation_angle,
+		batched_skinning_workspace& scratch) const
+	{
+		skinning_content const& content = *asset;
+		size_t const N_vertex = content.position_rest_pose.size();
+		size_t const max_batch = size_t(std::max(parameters.max_batch, 1));
+		size_t const first = batch * max_batch;
+		assert_cgp(first < updates.size(), "Batch out of the updates");
+		size_t const B = std::min(max_batch, updates.size() - first);
+
+		scratch.palette.resize(B, content.weights.number_column);
+		scratch.position_output.resize(B);
+		scratch.normal_output.resize(B);
+		scratch.finish_speed_blending.resize(B);
+		for (size_t b = 0; b < B; ++b) {
+			batched_instance_update const& u = updates[first + b];
+			character_instance& instance = *u.instance;
+			assert_cgp(instance.asset == asset && instance.position_skinned.size() == N_vertex, "The instance doesn't use the asset of the batch");
+			instance.evaluate_pose(t);
+			scratch.finish_speed_blending[b] = instance.prepare_frame(u.dt, speed_blending, fast_rotation_angle, u.frame_count, skinning_quality::full);
+			scratch.palette.set(b, instance.frame.palette);
+			scratch.position_output[b] = &instance.position_skinned;
+			scratch.normal_output[b] = &instance.normal_skinned;
+		}
+
+		batched_linear_blend_skinning(0, N_vertex, content.weights, scratch.palette, content.position_rest_pose, content.normal_rest_pose,
+			&scratch.position_output[0], &scratch.normal_output[0], size_t(std::max(parameters.vertices_per_block, 1)));
+
+		for (size_t b = 0; b < B; ++b) {
+			character_instance& instance = *updates[first + b].instance;
+			if (instance.frame.velocity_enabled) {
+				for (size_t i = 0; i < N_vertex; ++i)
+					velocity_skinning_deform_vertex(i, instance.position_skinned[i], instance.skeleton_current, content.velocity_rig, instance.frame,
+						linear_deformation_intensity, rotational_deformation_intensity);
+			}
+			velocity_skinning_finish(instance.frame, instance.skeleton_current, instance.old_joint_rt, instance.old_velocity, scratch.finish_speed_blending[b]);
+		}
+	}
+
+	batched_skinning_measure measure_batched_skinning(std::shared_ptr<skinning_content const> const& asset, size_t N_instance, int N_frame,
+		batched_skinning_parameters const& parameters, float speed_blending, float linear_deformation_intensity, float rotational_deformation_intensity)
+	{
+		batched_skinning_measure measure;
+		if (asset == nullptr || N_instance == 0 || N_frame <= 0 || asset->skeleton.number_animation_frame() < 2)
+			return measure;
+		size_t const N_vertex = asset->position_rest_pose.size();
+		measure.number_instance = N_instance;
+		measure.number_vertex = N_vertex;
+
+		// Two identical crowds, one per method
+		numarray<character_instance> loop_instance(N_instance);
+		numarray<character_instance> batched_instance(N_instance);
+		numarray<batched_instance_update> updates(N_instance);
+		float const dt = 1.0f / 60.0f;
+		for (size_t k = 0; k < N_instance; ++k) {
+			loop_instance[k].set_asset(asset);
+			loop_instance[k].time_offset = 0.25f * k;
+			batched_instance[k].set_asset(asset);
+			batched_instance[k].time_offset = 0.25f * k;
+			updates[k].instance = &batched_instance[k];
+			updates[k].dt = dt;
+		}
+		batched_skinning engine;
+		engine.parameters = parameters;
+		engine.set_asset(asset);
+
+		// Linear blend skinning only, on the palettes of the last frame of the batched crowd
+		stacked_palette lbs_palette;
+		numarray<numarray<vec3>> lbs_position(N_instance);
+		numarray<numarray<vec3>> lbs_normal(N_instance);
+		numarray<numarray<vec3>*> lbs_position_output(N_instance);
+		numarray<numarray<vec3>*> lbs_normal_output(N_instance);
+		for (size_t k = 0; k < N_instance; ++k) {
+			lbs_position[k].resize(N_vertex);
+			lbs_normal[k].resize(N_vertex);
+			lbs_position_output[k] = &lbs_position[k];
+			lbs_normal_output[k] = &lbs_normal[k];
+		}
+
+		double loop_s = 0.0, batched_s = 0.0, loop_lbs_s = 0.0, batched_lbs_s = 0.0;
+		float const t_min = asset->skeleton.animation_time[0];
+		for (int frame = 0; frame < N_frame; ++frame) {
+			float const t = t_min + frame * dt;
+
+			auto time_start = std::chrono::steady_clock::now();
+			for (character_instance& instance : loop_instance) {
+				instance.evaluate_pose(t);
+				velocity_skinning_compute(instance.position_skinned, instance.normal_skinned, instance.skeleton_current, asset->skeleton_rest_pose,
+					asset->position_rest_pose, asset->normal_rest_pose, asset->rig, asset->velocity_rig, instance.old_joint_rt, instance.old_velocity,
+					dt, speed_blending, linear_deformation_intensity, rotational_deformation_intensity);
+			}
+			loop_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+
+			time_start = std::chrono::steady_clock::now();
+			engine.update(updates, t, speed_blending, linear_deformation_intensity, rotational_deformation_intensity);
+			batched_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+
+			for (size_t k = 0; k < N_instance; ++k)
+				for (size_t i = 0; i < N_vertex; ++i)
+					measure.max_difference = std::max(measure.max_difference, norm(loop_instance[k].position_skinned[i] - batched_instance[k].position_skinned[i]));
+
+			time_start = std::chrono::steady_clock::now();
+			for (size_t k = 0; k < N_instance; ++k)
+				linear_blend_skinning_vertices(0, N_vertex, lbs_position[k], lbs_normal[k], asset->position_rest_pose, asset->normal_rest_pose,
+					asset->rig, batched_instance[k].frame);
+			loop_lbs_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+
+			lbs_palette.resize(N_instance, asset->weights.number_column);
+			for (size_t k = 0; k < N_instance; ++k)
+				lbs_palette.set(k, batched_instance[k].frame.palette);
+			time_start = std::chrono::steady_clock::now();
+			batched_linear_blend_skinning(0, N_vertex, asset->weights, lbs_palette, asset->position_rest_pose, asset->normal_rest_pose,
+				&lbs_position_output[0], &lbs_normal_output[0], size_t(std::max(parameters.vertices_per_block, 1)));
+			batched_lbs_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+		}
+
+		double const instance_vertex = double(N_instance) * N_vertex * N_frame;
+		measure.loop_vertices_per_s = loop_s > 0.0 ? instance_vertex / loop_s : 0.0;
+		measure.batched_vertices_per_s = batched_s > 0.0 ? instance_vertex / batched_s : 0.0;
+		measure.loop_lbs_vertices_per_s = loop_lbs_s > 0.0 ? instance_vertex / loop_lbs_s : 0.0;
+		measure.batched_lbs_vertices_per_s = batched_lbs_s > 0.0 ? instance_vertex / batched_lbs_s : 0.0;
+		return measure;
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+#include "skinned_asset.hpp"
+#include "sparse_weight_matrix.hpp"
+
+#include <memory>
+
+
+namespace cgp
+{
+	// Palettes of B instances stacked by groups of 4, one float4 lane per instance: P is a dense matrix of N_joint rows,
+	//  each holding the 12 coefficients of the 3x4 upper part of the palette matrix (row major) of every instance.
+	//  Group g, joint j, coefficient c, lane l: data[((g*N_joint + j)*12 + c)*4 + l]. The lanes past the last instance are zero.
+	struct stacked_palette
+	{
+		size_t number_instance = 0;
+		size_t number_joint = 0;
+		numarray<float> data;
+
+		void resize(size_t N_instance, size_t N_joint);
+		void set(size_t instance, numarray<mat4> const& palette);
+		size_t number_group() const;
+	};
+
+	// Linear blend skinning of the B instances of P as the product W * P on the vertices [begin,end[:
+	//  for each vertex, the weighted palettes of 4 instances are accumulated in float4, then applied to the rest position and normal.
+	//  The vertices are processed by blocks, and each block by all the groups of instances, so that the rows of W and the rest
+	//  vertices of a block are read from the cache by every group. Same result as linear_blend_skinning_vertices for each instance.
+	void batched_linear_blend_skinning(
+		size_t begin,
+		size_t end,
+		sparse_weight_matrix const& W,
+		stacked_palette const& P,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		numarray<vec3>* const* position_skinned, // B outputs, with the size of the mesh
+		numarray<vec3>* const* normal_skinned,
+		size_t vertices_per_block = 256
+	);
+
+	struct batched_skinning_parameters
+	{
+		int vertices_per_block = 256;
+		int max_batch = 64; // instances per product, bounds the size of the stacked palettes
+	};
+
+	// Instance due in the frame, with the time elapsed since its last update
+	struct batched_instance_update
+	{
+		character_instance* instance = nullptr;
+		float dt = 0.0f;
+		int frame_count = 1;
+	};
+
+	// Scratch of the product of one batch
+	struct batched_skinning_workspace
+	{
+		stacked_palette palette;
+		numarray<numarray<vec3>*> position_output;
+		numarray<numarray<vec3>*> normal_output;
+		numarray<float> finish_speed_blending;
+	};
+
+	// Velocity skinning of the instances of one asset: W is the sparse weights of the asset (built with it),
+	//  the linear blend skinning of up to max_batch instances is one product with their stacked palettes,
+	//  and the velocity deformation is applied per instance afterwards. The instances must use the asset at full resolution.
+	struct batched_skinning
+	{
+		batched_skinning_parameters parameters;
+		std::shared_ptr<skinning_content const> asset;
+		batched_skinning_workspace workspace;
+
+		void set_asset(std::shared_ptr<skinning_content const> const& value);
+		// Same result as character_instance::update at full quality for each instance
+		void update(numarray<batched_instance_update> const& updates, float t, float speed_blending,
+			float linear_deformation_intensity, float rotational_deformation_intensity, float fast_rotation_angle = 0.0f);
+
+		// The updates are split in batches of max_batch instances.
+		//  Batches given distinct workspaces can be skinned concurrently (the engine is only read).
+		size_t number_batch(size_t N_update) const;
+		void update_batch(size_t batch, numarray<batched_instance_update> const& updates, float t, float speed_blending,
+			float linear_deformation_intensity, float rotational_deformation_intensity, float fast_rotation_angle,
+			batched_skinning_workspace& scratch) const;
+	};
+
+	// Throughput of the per-instance loop of velocity_skinning_compute and of batched_skinning on N_instance instances of an asset
+	struct batched_skinning_measure
+	{
+		size_t number_instance = 0;
+		size_t number_vertex = 0;
+		double loop_vertices_per_s = 0.0;    // instance-vertices per second
+		double batched_vertices_per_s = 0.0;
+		double loop_lbs_vertices_per_s = 0.0; // linear blend skinning only
+		double batched_lbs_vertices_per_s = 0.0;
+		float max_difference = 0.0f;          // between the positions of the two, over the frames
+	};
+	batched_skinning_measure measure_batched_skinning(std::shared_ptr<skinning_content const> const& asset, size_t N_instance, int N_frame,
+		batched_skinning_parameters const& parameters, float speed_blending, float linear_deformation_intensity, float rotational_deformation_intensity);
+}
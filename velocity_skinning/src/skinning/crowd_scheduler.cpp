@@ -0,0 +1,136 @@
+#include "crowd_scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cgp
+{
+	double crowd_frame_statistics::mean_updated() const
+	{
+		return frame > 0 ? double(total_updated) / frame : 0.0;
+	}
+
+	int crowd_scheduler::cycle() const
+	{
+		int value = 1;
+		while (2 * value <= parameters.max_interval)
+			value *= 2;
+		return value;
+	}
+
+	void crowd_scheduler::resize(size_t N_instance)
+	{
+		size_t const N_previous = interval.size();
+		int const P = cycle();
+
+		// The cycle may have changed with the parameters: the loads are rebuilt from the kept instances
+		slot_load.resize(P);
+		slot_load.fill(0);
+		for (size_t k = 0; k < std::min(N_previous, N_instance); ++k) {
+			interval[k] = std::min(interval[k], P);
+			phase[k] = phase[k] % interval[k];
+			for (int s = phase[k]; s < P; s += interval[k])
+				slot_load[s]++;
+		}
+
+		interval.resize(N_instance);
+		phase.resize(N_instance);
+		accumulated_dt.resize(N_instance);
+		frame_count.resize(N_instance);
+		for (size_t k = N_previous; k < N_instance; ++k) {
+			interval[k] = 1;
+			phase[k] = 0;
+			accumulated_dt[k] = 0.0f;
+			frame_count[k] = 0;
+			for (int s = 0; s < P; ++s)
+				slot_load[s]++;
+		}
+	}
+
+	int crowd_scheduler::interval_from_screen_size(float screen_size) const
+	{
+		float const ratio = parameters.full_rate_size / std::max(screen_size, 1e-6f);
+		int const P = cycle();
+		int value = 1;
+		while (2 * value <= P && 2 * value <= ratio)
+			value *= 2;
+		return value;
+	}
+
+	void crowd_scheduler::set_interval(size_t instance, int value)
+	{
+		int const P = cycle();
+		value = std::max(1, std::min(value, P));
+		if (value == interval[instance])
+			return;
+
+		for (int s = phase[instance]; s < P; s += interval[instance])
+			slot_load[s]--;
+
+		// Phase whose frames have the lowest maximal load (then the lowest total load)
+		int best_phase = 0;
+		int best_max = 0, best_sum = 0;
+		for (int p = 0; p < value; ++p) {
+			int max_load = 0, sum_load = 0;
+			for (int s = p; s < P; s += value) {
+				max_load = std::max(max_load, slot_load[s]);
+				sum_load += slot_load[s];
+			}
+			if (p == 0 || max_load < best_max || (max_load == best_max && sum_load < best_sum)) {
+				best_phase = p;
+				best_max = max_load;
+				best_sum = sum_load;
+			}
+		}
+
+		interval[instance] = value;
+		phase[instance] = best_phase;
+		for (int s = best_phase; s < P; s += value)
+			slot_load[s]++;
+	}
+
+	void crowd_scheduler::set_screen_size(size_t instance, float screen_size)
+	{
+		set_interval(instance, interval_from_screen_size(screen_size));
+	}
+
+	void crowd_scheduler::schedule(float dt, numarray<crowd_update>& update)
+	{
+		update.clear();
+		for (size_t k = 0; k < interval.size(); ++k) {
+			accumulated_dt[k] += dt;
+			frame_count[k]++;
+
+			if (int(frame % size_t(interval[k])) != phase[k])
+				continue;
+
+			crowd_update u;
+			u.instance = k;
+			u.dt = accumulated_dt[k];
+			u.frame_count = frame_count[k];
+			update.push_back(u);
+			accumulated_dt[k] = 0.0f;
+			frame_count[k] = 0;
+		}
+		frame++;
+
+		size_t const N = update.size();
+		statistics.updated = N;
+		statistics.min_updated = statistics.frame == 0 ? N : std::min(statistics.min_updated, N);
+		statistics.max_updated = statistics.frame == 0 ? N : std::max(statistics.max_updated, N);
+		statistics.total_updated += N;
+		statistics.frame++;
+	}
+
+	void crowd_scheduler::reset_statistics()
+	{
+		statistics = crowd_frame_statistics();
+	}
+
+	float screen_size_of_sphere(float radius, float distance, float field_of_view)
+	{
+		if (distance <= radius)
+			return 1.0f;
+		return radius / (distance * std::tan(0.5f * field_of_view));
+	}
+}
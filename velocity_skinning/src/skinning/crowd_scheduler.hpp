@@ -0,0 +1,66 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+
+
+namespace cgp
+{
+	struct crowd_schedule_parameters
+	{
+		int max_interval = 8;         // frames between two updates of the least important instances (rounded down to a power of two)
+		float full_rate_size = 0.25f; // screen size (fraction of the screen height) from which an instance is updated every frame
+	};
+
+	// Instance due this frame, with the time elapsed since its last update
+	struct crowd_update
+	{
+		size_t instance = 0;
+		float dt = 0.0f;
+		int frame_count = 1; // frames covered by dt
+	};
+
+	struct crowd_frame_statistics
+	{
+		size_t frame = 0;
+		size_t updated = 0;     // instances updated by the last frame
+		size_t min_updated = 0; // over the frames since the last reset
+		size_t max_updated = 0;
+		size_t total_updated = 0;
+
+		double mean_updated() const;
+	};
+
+	// Amortized update of a crowd: instance i is updated every interval[i] frames (a power of two, smaller for larger instances on screen).
+	//  Its phase is chosen so that the frames of the cycle get the same number of updates: the cost per frame stays flat
+	//  instead of peaking when the instances with the same interval would all be due together.
+	struct crowd_scheduler
+	{
+		crowd_schedule_parameters parameters;
+		crowd_frame_statistics statistics;
+
+		numarray<int> interval;
+		numarray<int> phase;           // the instance is due when frame % interval == phase
+		numarray<float> accumulated_dt;
+		numarray<int> frame_count;     // frames since the last update
+		numarray<int> slot_load;       // updates planned on each frame of the cycle of max_interval frames
+		size_t frame = 0;
+
+		// New instances are due on the next frame, to get their first pose. Removed instances are the last ones.
+		void resize(size_t N_instance);
+		int cycle() const; // max_interval, as a power of two
+
+		// Interval of an instance from its size on screen
+		int interval_from_screen_size(float screen_size) const;
+		// Change the interval of an instance: it gets the least loaded phase of the new interval
+		void set_interval(size_t instance, int value);
+		void set_screen_size(size_t instance, float screen_size);
+
+		// Advance by one frame of duration dt, and return the instances due with their accumulated dt
+		void schedule(float dt, numarray<crowd_update>& update);
+
+		void reset_statistics();
+	};
+
+	// Fraction of the screen height covered by a sphere
+	float screen_size_of_sphere(float radius, float distance, float field_of_view);
+}
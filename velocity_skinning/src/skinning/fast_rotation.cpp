@@ -0,0 +1,58 @@
+#include "fast_rotation.hpp"
+
+#include <chrono>
+
+namespace cgp
+{
+	fast_rotation_report measure_fast_rotation(
+		skeleton_animation_structure const& skeleton,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		fast_rotation_parameters const& parameters)
+	{
+		fast_rotation_report report;
+		if (skeleton.number_animation_frame() == 0)
+			return report;
+
+		// Each kernel has its own velocity state
+		numarray<affine_rt> const skeleton_rest_pose = skeleton.rest_pose_global();
+		numarray<vec3> position_exact = position_rest_pose, normal_exact = normal_rest_pose;
+		numarray<vec3> position_fast = position_rest_pose, normal_fast = normal_rest_pose;
+		numarray<affine_rt> old_joint_rt_exact, old_joint_rt_fast;
+		numarray<vec3> old_velocity_exact, old_velocity_fast;
+
+		float const t_min = skeleton.animation_time[0];
+		float const t_max = skeleton.animation_time[skeleton.animation_time.size() - 1];
+		for (float t = t_min; t < t_max; t += parameters.dt) {
+			numarray<affine_rt> const skeleton_current = skeleton.evaluate_global(t);
+
+			auto const time_exact = std::chrono::steady_clock::now();
+			velocity_skinning_compute(position_exact, normal_exact, skeleton_current, skeleton_rest_pose,
+				position_rest_pose, normal_rest_pose, rig, velocity_rig,
+				old_joint_rt_exact, old_velocity_exact, parameters.dt,
+				parameters.speed_blending, parameters.linear_deformation_intensity, parameters.rotational_deformation_intensity);
+			auto const time_fast = std::chrono::steady_clock::now();
+			velocity_skinning_compute(position_fast, normal_fast, skeleton_current, skeleton_rest_pose,
+				position_rest_pose, normal_rest_pose, rig, velocity_rig,
+				old_joint_rt_fast, old_velocity_fast, parameters.dt,
+				parameters.speed_blending, parameters.linear_deformation_intensity, parameters.rotational_deformation_intensity,
+				nullptr, parameters.fast_rotation_angle);
+			auto const time_end = std::chrono::steady_clock::now();
+			report.exact_ms += std::chrono::duration<double, std::milli>(time_fast - time_exact).count();
+			report.fast_ms += std::chrono::duration<double, std::milli>(time_end - time_fast).count();
+
+			for (size_t i = 0; i < position_exact.size(); ++i) {
+				float const d = norm(position_fast[i] - position_exact[i]);
+				if (d > report.max_deviation) {
+					report.max_deviation = d;
+					report.max_deviation_vertex = int(i);
+					report.max_deviation_time = t;
+				}
+			}
+		}
+
+		return report;
+	}
+}
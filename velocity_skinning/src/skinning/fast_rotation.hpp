@@ -0,0 +1,39 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+#include "../skeleton/skeleton.hpp"
+
+
+namespace cgp
+{
+	struct fast_rotation_parameters
+	{
+		float fast_rotation_angle = 0.5f; // rotations below this angle use rotation_offset_fast
+
+		// Sampling of the animation used to measure the deviation
+		float dt = 1.0f / 30.0f;
+		float speed_blending = 0.9f;
+		float linear_deformation_intensity = 0.1f;
+		float rotational_deformation_intensity = 1.0f;
+	};
+
+	struct fast_rotation_report
+	{
+		float max_deviation = 0.0f; // Worst distance between the vertices skinned with the exact and the fast rotational deformation
+		int max_deviation_vertex = -1;
+		float max_deviation_time = 0.0f;
+
+		double exact_ms = 0.0; // skinning time over the whole animation
+		double fast_ms = 0.0;
+	};
+
+	// Run velocity skinning over the animation of the skeleton with the exact and the fast rotational deformation
+	fast_rotation_report measure_fast_rotation(
+		skeleton_animation_structure const& skeleton,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		fast_rotation_parameters const& parameters);
+}
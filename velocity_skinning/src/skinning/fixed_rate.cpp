@@ -0,0 +1,68 @@
+#include "fixed_rate.hpp"
+
+namespace cgp
+{
+	float fixed_rate_stepper::step() const
+	{
+		assert_cgp(rate>0, "Simulation rate should be > 0");
+		return 1.0f / rate;
+	}
+
+	int fixed_rate_stepper::advance(float dt)
+	{
+		float const h = step();
+		accumulator += dt;
+
+		int N_step = 0;
+		while (accumulator >= h && N_step < max_steps_per_frame) {
+			accumulator -= h;
+			++N_step;
+		}
+
+		// Too much time elapsed since the last frame: drop it instead of accumulating a delay
+		if (accumulator >= h)
+			accumulator = 0.0f;
+
+		return N_step;
+	}
+
+	float fixed_rate_stepper::alpha() const
+	{
+		return std::min(std::max(accumulator / step(), 0.0f), 1.0f);
+	}
+
+	void fixed_rate_stepper::reset()
+	{
+		accumulator = 0.0f;
+	}
+
+	void interpolate_vertices(numarray<vec3>& result, numarray<vec3> const& previous, numarray<vec3> const& next, float alpha)
+	{
+		assert_cgp(previous.size()==next.size(), "Incoherent size of interpolated data");
+		size_t const N = next.size();
+		result.resize(N);
+		for (size_t k = 0; k < N; ++k)
+			result[k] = (1 - alpha) * previous[k] + alpha * next[k];
+	}
+
+	void interpolate_normals(numarray<vec3>& result, numarray<vec3> const& previous, numarray<vec3> const& next, float alpha)
+	{
+		interpolate_vertices(result, previous, next, alpha);
+		size_t const N = result.size();
+		for (size_t k = 0; k < N; ++k) {
+			float const n = norm(result[k]);
+			if (n > 1e-8f)
+				result[k] = result[k] / n;
+		}
+	}
+
+	void interpolate_skeleton(numarray<affine_rt>& result, numarray<affine_rt> const& previous, numarray<affine_rt> const& next, float alpha)
+	{
+		assert_cgp(previous.size()==next.size(), "Incoherent size of interpolated skeletons");
+		size_t const N = next.size();
+		result.resize(N);
+		for (size_t k = 0; k < N; ++k)
+			result[k] = affine_rt(rotation_transform::lerp(previous[k].rotation, next[k].rotation, alpha),
+				(1 - alpha) * previous[k].translation + alpha * next[k].translation);
+	}
+}
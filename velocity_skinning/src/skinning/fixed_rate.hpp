@@ -0,0 +1,30 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+
+
+namespace cgp
+{
+	// Accumulator running a simulation at a fixed rate, independently of the display frame rate
+	struct fixed_rate_stepper
+	{
+		float rate = 60.0f;          // Number of simulation steps per second
+		int max_steps_per_frame = 8; // Maximal number of steps taken in one frame (the remaining time is dropped)
+		float accumulator = 0.0f;    // Time not yet simulated, always in [0, step()[ after advance
+
+		// Duration of one simulation step
+		float step() const;
+		// Add the frame duration dt and return the number of simulation steps to run for this frame
+		int advance(float dt);
+		// Interpolation factor in [0,1] between the two last simulated states
+		float alpha() const;
+		void reset();
+	};
+
+	// Linear interpolation (1-alpha)*previous + alpha*next of per-vertex data
+	void interpolate_vertices(numarray<vec3>& result, numarray<vec3> const& previous, numarray<vec3> const& next, float alpha);
+	// Same interpolation, renormalized (zero normals are kept)
+	void interpolate_normals(numarray<vec3>& result, numarray<vec3> const& previous, numarray<vec3> const& next, float alpha);
+	// Lerp of the rotations and of the translations of the joints
+	void interpolate_skeleton(numarray<affine_rt>& result, numarray<affine_rt> const& previous, numarray<affine_rt> const& next, float alpha);
+}
@@ -0,0 +1,298 @@
+#include "packed_vertex.hpp"
+#include "../render/render_backend.hpp"
+
+#include <cstring>
+
+namespace cgp
+{
+	static packed_vertex_attribute make_attribute(GLuint location, GLint components, GLenum type, GLboolean normalized, size_t offset)
+	{
+		packed_vertex_attribute attribute;
+		attribute.location = location;
+		attribute.components = components;
+		attribute.type = type;
+		attribute.normalized = normalized;
+		attribute.offset = offset;
+		return attribute;
+	}
+
+	packed_vertex_layout build_packed_vertex_layout(packed_position_format position_format, packed_normal_format normal_format)
+	{
+		packed_vertex_layout layout;
+		layout.position_format = position_format;
+		layout.normal_format = normal_format;
+
+		// The normal is always 4 bytes, aligned on 4 bytes after the position
+		size_t normal_offset = 0;
+		if (position_format == packed_position_format::float32) {
+			layout.position = make_attribute(0, 3, GL_FLOAT, GL_FALSE, 0);
+			normal_offset = 12;
+		}
+		else {
+			layout.position = make_attribute(0, 3, GL_HALF_FLOAT, GL_FALSE, 0);
+			normal_offset = 8; // 6 bytes of position + 2 bytes of padding
+		}
+
+		if (normal_format == packed_normal_format::octahedral)
+			layout.normal = make_attribute(1, 2, GL_SHORT, GL_TRUE, normal_offset);
+		else
+			layout.normal = make_attribute(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, normal_offset);
+
+		layout.stride = normal_offset + 4;
+		return layout;
+	}
+
+
+	void packed_vertex_buffer::resize(size_t N_vertex)
+	{
+		bytes.resize(N_vertex * layout.stride);
+	}
+
+	size_t packed_vertex_buffer::size() const
+	{
+		return layout.stride == 0 ? 0 : bytes.size() / layout.stride;
+	}
+
+	void packed_vertex_buffer::write(size_t k, vec3 const& position, vec3 const& normal)
+	{
+		unsigned char* vertex = &bytes[k * layout.stride];
+
+		if (layout.position_format == packed_position_format::float32) {
+			float const p[3] = { position.x, position.y, position.z };
+			std::memcpy(vertex, p, sizeof(p));
+		}
+		else {
+			uint16_t const p[4] = { float_to_half(position.x), float_to_half(position.y), float_to_half(position.z), 0 };
+			std::memcpy(vertex, p, sizeof(p));
+		}
+
+		uint32_t const n = layout.normal_format == packed_normal_format::octahedral ?
+			pack_normal_octahedral(normal) : pack_normal_2_10_10_10(normal);
+		std::memcpy(vertex + layout.normal.offset, &n, sizeof(n));
+	}
+
+	vec3 packed_vertex_buffer::read_position(size_t k) const
+	{
+		unsigned char const* vertex = &bytes[k * layout.stride];
+		if (layout.position_format == packed_position_format::float32) {
+			float p[3];
+			std::memcpy(p, vertex, sizeof(p));
+			return { p[0], p[1], p[2] };
+		}
+		uint16_t p[3];
+		std::memcpy(p, vertex, sizeof(p));
+		return { half_to_float(p[0]), half_to_float(p[1]), half_to_float(p[2]) };
+	}
+
+	vec3 packed_vertex_buffer::read_normal(size_t k) const
+	{
+		uint32_t n;
+		std::memcpy(&n, &bytes[k * layout.stride + layout.normal.offset], sizeof(n));
+		return layout.normal_format == packed_normal_format::octahedral ?
+			unpack_normal_octahedral(n) : unpack_normal_2_10_10_10(n);
+	}
+
+	void pack_vertices(packed_vertex_buffer& buffer, numarray<vec3> const& position, numarray<vec3> const& normal)
+	{
+		size_t const N = position.size();
+		buffer.resize(N);
+		for (size_t k = 0; k < N; ++k)
+			buffer.write(k, position[k], normal[k]);
+	}
+
+	packed_vertex_error packed_vertex_max_error(packed_vertex_buffer const& buffer, numarray<vec3> const& position, numarray<vec3> const& normal)
+	{
+		assert_cgp(buffer.size()==position.size(), "Incoherent size between packed buffer and reference");
+		packed_vertex_error error;
+		size_t const N = position.size();
+		for (size_t k = 0; k < N; ++k) {
+			error.position = std::max(error.position, norm(buffer.read_position(k) - position[k]));
+
+			float const n_ref = norm(normal[k]);
+			if (n_ref < 1e-8f)
+				continue;
+			// atan2 rather than acos of the dot product, which cannot resolve angles below ~3e-4 rad in float
+			vec3 const n = buffer.read_normal(k);
+			vec3 const u = normal[k] / n_ref;
+			error.normal = std::max(error.normal, std::atan2(norm(cross(n, u)), dot(n, u)));
+		}
+		return error;
+	}
+
+
+	uint16_t float_to_half(float value)
+	{
+		uint32_t x;
+		std::memcpy(&x, &value, sizeof(x));
+
+		uint32_t const sign = (x >> 16) & 0x8000u;
+		uint32_t const exponent = (x >> 23) & 0xffu;
+		uint32_t mantissa = x & 0x7fffffu;
+
+		if (exponent == 0xffu) // inf or nan
+			return uint16_t(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+
+		int const e = int(exponent) - 127 + 15;
+		if (e >= 0x1f) // overflow
+			return uint16_t(sign | 0x7c00u);
+
+		if (e <= 0) { // subnormal half
+			if (e < -10)
+				return uint16_t(sign);
+			mantissa |= 0x800000u;
+			int const shift = 14 - e;
+			uint32_t h = mantissa >> shift;
+			uint32_t const remainder = mantissa & ((1u << shift) - 1);
+			uint32_t const halfway = 1u << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (h & 1u)))
+				++h;
+			return uint16_t(sign | h);
+		}
+
+		// Round to nearest even, a carry in the mantissa correctly propagates to the exponent
+		uint32_t h = sign | (uint32_t(e) << 10) | (mantissa >> 13);
+		uint32_t const remainder = mantissa & 0x1fffu;
+		if (remainder > 0x1000u || (remainder == 0x1000u && (h & 1u)))
+			++h;
+		return uint16_t(h);
+	}
+
+	float half_to_float(uint16_t value)
+	{
+		uint32_t const sign = uint32_t(value & 0x8000u) << 16;
+		uint32_t const exponent = (value >> 10) & 0x1fu;
+		uint32_t const mantissa = value & 0x3ffu;
+
+		if (exponent == 0) {
+			float const f = std::ldexp(float(mantissa), -24);
+			return sign ? -f : f;
+		}
+
+		uint32_t x;
+		if (exponent == 0x1f)
+			x = sign | 0x7f800000u | (mantissa << 13);
+		else
+			x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+		float f;
+		std::memcpy(&f, &x, sizeof(f));
+		return f;
+	}
+
+	static float sign_not_zero(float x)
+	{
+		return x >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	static int16_t to_snorm16(float x)
+	{
+		return int16_t(std::round(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f));
+	}
+
+	uint32_t pack_normal_octahedral(vec3 const& n)
+	{
+		float const s = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		if (s < 1e-20f)
+			return pack_normal_octahedral({ 0, 0, 1 });
+
+		float x = n.x / s;
+		float y = n.y / s;
+		if (n.z < 0) {
+			float const fold_x = (1.0f - std::abs(y)) * sign_not_zero(x);
+			float const fold_y = (1.0f - std::abs(x)) * sign_not_zero(y);
+			x = fold_x;
+			y = fold_y;
+		}
+
+		uint16_t const ex = uint16_t(to_snorm16(x));
+		uint16_t const ey = uint16_t(to_snorm16(y));
+		return uint32_t(ex) | (uint32_t(ey) << 16);
+	}
+
+	vec3 unpack_normal_octahedral(uint32_t packed)
+	{
+		// Same decoding as in shaders/mesh_octahedral/vert.glsl
+		float const x = std::max(int16_t(packed & 0xffffu) / 32767.0f, -1.0f);
+		float const y = std::max(int16_t(packed >> 16) / 32767.0f, -1.0f);
+
+		vec3 n = { x, y, 1.0f - std::abs(x) - std::abs(y) };
+		if (n.z < 0) {
+			n.x = (1.0f - std::abs(y)) * sign_not_zero(x);
+			n.y = (1.0f - std::abs(x)) * sign_not_zero(y);
+		}
+		return normalize(n);
+	}
+
+	uint32_t pack_normal_2_10_10_10(vec3 const& n)
+	{
+		float const L = norm(n);
+		vec3 const u = L > 1e-20f ? n / L : vec3(0, 0, 1);
+
+		uint32_t packed = 0;
+		for (int k = 0; k < 3; ++k) {
+			int const v = int(std::round(std::min(std::max(u[k], -1.0f), 1.0f) * 511.0f));
+			packed |= (uint32_t(v) & 0x3ffu) << (10 * k);
+		}
+		return packed; // w = 0
+	}
+
+	vec3 unpack_normal_2_10_10_10(uint32_t packed)
+	{
+		vec3 n;
+		for (int k = 0; k < 3; ++k) {
+			int v = int((packed >> (10 * k)) & 0x3ffu);
+			if (v & 0x200)
+				v -= 0x400; // sign extension
+			n[k] = std::max(v / 511.0f, -1.0f);
+		}
+		return normalize(n);
+	}
+
+
+	void packed_vertex_attach(mesh_drawable& drawable, GLuint vbo, packed_vertex_layout const& layout)
+	{
+#ifndef VELOCITY_SKINNING_HEADLESS
+		glBindVertexArray(drawable.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		packed_vertex_attribute const attributes[2] = { layout.position, layout.normal };
+		for (packed_vertex_attribute const& a : attributes) {
+			glEnableVertexAttribArray(a.location);
+			glVertexAttribPointer(a.location, a.components, a.type, a.normalized, GLsizei(layout.stride), reinterpret_cast<void const*>(a.offset));
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+#else
+		(void)drawable; (void)vbo; (void)layout;
+#endif
+	}
+
+	void packed_vertex_detach(mesh_drawable& drawable)
+	{
+#ifndef VELOCITY_SKINNING_HEADLESS
+		glBindVertexArray(drawable.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, drawable.vbo_position.id);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+		glBindBuffer(GL_ARRAY_BUFFER, drawable.vbo_normal.id);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+#else
+		(void)drawable;
+#endif
+	}
+
+	void packed_vertex_upload(GLuint& vbo, packed_vertex_buffer const& buffer)
+	{
+		render_counter.update_call++;
+		render_counter.update_bytes += buffer.bytes.size();
+#ifndef VELOCITY_SKINNING_HEADLESS
+		if (vbo == 0)
+			glGenBuffers(1, &vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, buffer.bytes.size(), buffer.bytes.size() > 0 ? &buffer.bytes[0] : nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+#else
+		(void)vbo;
+#endif
+	}
+}
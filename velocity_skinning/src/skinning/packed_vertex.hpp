@@ -0,0 +1,73 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include <cstdint>
+
+
+namespace cgp
+{
+	enum class packed_position_format { float32, float16 };
+	enum class packed_normal_format { octahedral, int_2_10_10_10 };
+
+	// One attribute of the interleaved buffer, with the parameters expected by glVertexAttribPointer
+	struct packed_vertex_attribute
+	{
+		GLuint location;
+		GLint components;
+		GLenum type;
+		GLboolean normalized;
+		size_t offset;
+	};
+
+	// Interleaved layout storing the position and the normal of a vertex
+	//  float32 + normal: 16 bytes per vertex, float16 + normal: 12 bytes per vertex (instead of 24 for two float3 buffers)
+	struct packed_vertex_layout
+	{
+		packed_position_format position_format = packed_position_format::float16;
+		packed_normal_format normal_format = packed_normal_format::int_2_10_10_10;
+		size_t stride = 0;
+		packed_vertex_attribute position;
+		packed_vertex_attribute normal;
+	};
+	packed_vertex_layout build_packed_vertex_layout(packed_position_format position_format, packed_normal_format normal_format);
+
+	// CPU staging buffer filled by the skinning, ready to be uploaded in a single VBO
+	struct packed_vertex_buffer
+	{
+		packed_vertex_layout layout;
+		numarray<unsigned char> bytes;
+
+		void resize(size_t N_vertex);
+		size_t size() const; // Number of vertices
+
+		void write(size_t k, vec3 const& position, vec3 const& normal);
+		vec3 read_position(size_t k) const;
+		vec3 read_normal(size_t k) const;
+	};
+
+	// Maximal deviation of a packed buffer with respect to its float reference
+	struct packed_vertex_error
+	{
+		float position = 0.0f; // Maximal distance between packed and reference position
+		float normal = 0.0f;   // Maximal angle (radians) between packed and reference normal
+	};
+	packed_vertex_error packed_vertex_max_error(packed_vertex_buffer const& buffer, numarray<vec3> const& position, numarray<vec3> const& normal);
+
+	void pack_vertices(packed_vertex_buffer& buffer, numarray<vec3> const& position, numarray<vec3> const& normal);
+
+	// Scalar encoding functions
+	uint16_t float_to_half(float value);
+	float half_to_float(uint16_t value);
+	uint32_t pack_normal_octahedral(vec3 const& n);
+	vec3 unpack_normal_octahedral(uint32_t packed);
+	uint32_t pack_normal_2_10_10_10(vec3 const& n);
+	vec3 unpack_normal_2_10_10_10(uint32_t packed);
+
+
+	// OpenGL side: make a mesh_drawable read its position (location 0) and normal (location 1) from the packed VBO
+	void packed_vertex_attach(mesh_drawable& drawable, GLuint vbo, packed_vertex_layout const& layout);
+	// Restore the original float3 VBOs of the mesh_drawable
+	void packed_vertex_detach(mesh_drawable& drawable);
+	// Upload the buffer in the VBO (created if vbo is 0)
+	void packed_vertex_upload(GLuint& vbo, packed_vertex_buffer const& buffer);
+}
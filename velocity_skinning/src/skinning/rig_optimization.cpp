@@ -0,0 +1,108 @@
+#include "rig_optimization.hpp"
+
+#include <algorithm>
+
+namespace cgp
+{
+	size_t rig_optimization_report::influence_removed() const
+	{
+		return influence_before - influence_after;
+	}
+
+	static void count_influences(rig_structure const& rig, size_t& total, int& max_count)
+	{
+		total = 0;
+		max_count = 0;
+		for (size_t i = 0; i < rig.joint.size(); ++i) {
+			total += rig.joint[i].size();
+			max_count = std::max(max_count, int(rig.joint[i].size()));
+		}
+	}
+
+	void prune_rig_influences(rig_structure& rig, int max_influence, float weight_threshold)
+	{
+		assert_cgp(max_influence>=1, "At least one influence per vertex should be kept");
+		size_t const N_vertex = rig.joint.size();
+
+		numarray<int> order;
+		for (size_t i = 0; i < N_vertex; ++i) {
+			numarray<int>& joint = rig.joint[i];
+			numarray<float>& weight = rig.weight[i];
+			size_t const N_influence = joint.size();
+
+			order.resize(N_influence);
+			for (size_t k = 0; k < N_influence; ++k)
+				order[k] = int(k);
+			std::stable_sort(order.begin(), order.end(), [&weight](int a, int b) { return weight[a] > weight[b]; });
+
+			numarray<int> new_joint;
+			numarray<float> new_weight;
+			for (size_t k = 0; k < N_influence && new_joint.size() < size_t(max_influence); ++k) {
+				float const w = weight[order[k]];
+				if (k > 0 && w < weight_threshold)
+					break;
+				new_joint.push_back(joint[order[k]]);
+				new_weight.push_back(w);
+			}
+
+			joint = new_joint;
+			weight = new_weight;
+		}
+
+		normalize_weights(rig.weight);
+	}
+
+	rig_optimization_report optimize_rig(
+		rig_structure& rig,
+		rig_structure& velocity_rig,
+		skeleton_animation_structure const& skeleton,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_optimization_parameters const& parameters)
+	{
+		rig_optimization_report report;
+		count_influences(rig, report.influence_before, report.max_influence_before);
+
+		// Keep a copy of the original rig to measure the error
+		rig_structure const rig_reference = rig;
+		rig_structure velocity_rig_reference;
+		init_velocity_skinning_weights(velocity_rig_reference, rig_reference, skeleton.parent_index);
+
+		prune_rig_influences(rig, parameters.max_influence, parameters.weight_threshold);
+		init_velocity_skinning_weights(velocity_rig, rig, skeleton.parent_index);
+		count_influences(rig, report.influence_after, report.max_influence_after);
+
+		// Run both rigs over the animation, each with its own velocity state
+		numarray<affine_rt> const skeleton_rest_pose = skeleton.rest_pose_global();
+		numarray<vec3> position_reference = position_rest_pose, normal_reference = normal_rest_pose;
+		numarray<vec3> position_optimized = position_rest_pose, normal_optimized = normal_rest_pose;
+		numarray<affine_rt> old_joint_rt_reference, old_joint_rt_optimized;
+		numarray<vec3> old_velocity_reference, old_velocity_optimized;
+
+		float const t_min = skeleton.animation_time[0];
+		float const t_max = skeleton.animation_time[skeleton.animation_time.size() - 1];
+		for (float t = t_min; t < t_max; t += parameters.dt) {
+			numarray<affine_rt> const skeleton_current = skeleton.evaluate_global(t);
+
+			velocity_skinning_compute(position_reference, normal_reference, skeleton_current, skeleton_rest_pose,
+				position_rest_pose, normal_rest_pose, rig_reference, velocity_rig_reference,
+				old_joint_rt_reference, old_velocity_reference, parameters.dt,
+				parameters.speed_blending, parameters.linear_deformation_intensity, parameters.rotational_deformation_intensity);
+			velocity_skinning_compute(position_optimized, normal_optimized, skeleton_current, skeleton_rest_pose,
+				position_rest_pose, normal_rest_pose, rig, velocity_rig,
+				old_joint_rt_optimized, old_velocity_optimized, parameters.dt,
+				parameters.speed_blending, parameters.linear_deformation_intensity, parameters.rotational_deformation_intensity);
+
+			for (size_t i = 0; i < position_reference.size(); ++i) {
+				float const d = norm(position_optimized[i] - position_reference[i]);
+				if (d > report.max_displacement) {
+					report.max_displacement = d;
+					report.max_displacement_vertex = int(i);
+					report.max_displacement_time = t;
+				}
+			}
+		}
+
+		return report;
+	}
+}
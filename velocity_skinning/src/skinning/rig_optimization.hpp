@@ -0,0 +1,48 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+#include "../skeleton/skeleton.hpp"
+
+
+namespace cgp
+{
+	struct rig_optimization_parameters
+	{
+		int max_influence = 4;          // Maximal number of joints influencing a vertex
+		float weight_threshold = 0.01f; // Weights below this value are removed (the largest weight of a vertex is always kept)
+
+		// Sampling of the animation used to measure the error
+		float dt = 1.0f / 30.0f;
+		float speed_blending = 0.9f;
+		float linear_deformation_intensity = 0.1f;
+		float rotational_deformation_intensity = 1.0f;
+	};
+
+	struct rig_optimization_report
+	{
+		size_t influence_before = 0;
+		size_t influence_after = 0;
+		int max_influence_before = 0;
+		int max_influence_after = 0;
+
+		float max_displacement = 0.0f;     // Worst distance between the vertices skinned with the original and the optimized rig
+		int max_displacement_vertex = -1;
+		float max_displacement_time = 0.0f;
+
+		size_t influence_removed() const;
+	};
+
+	// Cap the number of influences, drop small weights and renormalize. velocity_rig is rebuilt to match the new rig.
+	//  The error is measured by running velocity skinning with both rigs over the animation of the skeleton.
+	rig_optimization_report optimize_rig(
+		rig_structure& rig,
+		rig_structure& velocity_rig,
+		skeleton_animation_structure const& skeleton,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_optimization_parameters const& parameters);
+
+	// Pruning of the weights only (no velocity weights, no error measure)
+	void prune_rig_influences(rig_structure& rig, int max_influence, float weight_threshold);
+}
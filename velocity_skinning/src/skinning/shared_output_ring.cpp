@@ -0,0 +1,337 @@
+#include "shared_output_ring.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CGP_SHARED_OUTPUT_POSIX
+#endif
+
+namespace cgp
+{
+	static char const shared_output_magic[8] = { 'V','S','R','I','N','G','0','1' };
+	static uint32_t const shared_output_version = 1;
+
+	static size_t align_64(size_t n)
+	{
+		return (n + 63) / 64 * 64;
+	}
+
+	static int64_t steady_clock_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static size_t vertex_section_bytes(size_t vertex_count)
+	{
+		return align_64(vertex_count * sizeof(vec3));
+	}
+
+	static_assert(sizeof(vec3) == 3 * sizeof(float), "The shared layout stores vec3 as 3 consecutive floats");
+
+
+	shared_output_writer::shared_output_writer()
+		: mapped_data(nullptr), mapped_size(0), object_name()
+	{}
+
+	shared_output_writer::~shared_output_writer()
+	{
+		close();
+	}
+
+	bool shared_output_writer::create(std::string const& name, size_t vertex_count, int slot_count)
+	{
+		close();
+		assert_cgp(slot_count > 0, "The shared output needs at least one slot");
+
+#ifdef CGP_SHARED_OUTPUT_POSIX
+		size_t const header_bytes = align_64(sizeof(shared_output_header));
+		size_t const slot_header_bytes = align_64(sizeof(shared_output_slot));
+		size_t const data_offset = header_bytes + size_t(slot_count) * slot_header_bytes;
+		size_t const slot_bytes = 2 * vertex_section_bytes(vertex_count);
+		size_t const size = data_offset + size_t(slot_count) * slot_bytes;
+
+		// A previous ring with the same name may have another size: readers mapping it keep it until they close
+		shm_unlink(name.c_str());
+		int const fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		if (fd < 0)
+			return false;
+		if (ftruncate(fd, off_t(size)) != 0) {
+			::close(fd);
+			shm_unlink(name.c_str());
+			return false;
+		}
+		void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED) {
+			shm_unlink(name.c_str());
+			return false;
+		}
+		mapped_data = static_cast<unsigned char*>(view);
+		mapped_size = size;
+		object_name = name;
+
+		// The object is zero-filled by ftruncate: the atomics start at 0 (nothing published)
+		shared_output_header* header = new (mapped_data) shared_output_header;
+		std::memcpy(header->magic, shared_output_magic, sizeof(header->magic));
+		header->version = shared_output_version;
+		header->layout = uint32_t(shared_output_layout::position_normal_float3);
+		header->vertex_count = vertex_count;
+		header->slot_count = uint32_t(slot_count);
+		header->slot_header_bytes = uint32_t(slot_header_bytes);
+		header->slot_bytes = slot_bytes;
+		header->data_offset = data_offset;
+		header->published.store(0, std::memory_order_relaxed);
+		for (int k = 0; k < slot_count; ++k) {
+			shared_output_slot* slot = new (mapped_data + header_bytes + size_t(k) * slot_header_bytes) shared_output_slot;
+			slot->sequence.store(0, std::memory_order_relaxed);
+			slot->frame_id.store(0, std::memory_order_relaxed);
+			slot->vertex_count.store(vertex_count, std::memory_order_relaxed);
+			slot->publish_ns.store(0, std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		return true;
+#else
+		(void)name;
+		(void)vertex_count;
+		return false;
+#endif
+	}
+
+	void shared_output_writer::close()
+	{
+#ifdef CGP_SHARED_OUTPUT_POSIX
+		if (mapped_data != nullptr) {
+			munmap(mapped_data, mapped_size);
+			shm_unlink(object_name.c_str());
+		}
+#endif
+		mapped_data = nullptr;
+		mapped_size = 0;
+		object_name.clear();
+	}
+
+	bool shared_output_writer::is_open() const
+	{
+		return mapped_data != nullptr;
+	}
+
+	std::string const& shared_output_writer::name() const
+	{
+		return object_name;
+	}
+
+	size_t shared_output_writer::vertex_count() const
+	{
+		return is_open() ? size_t(reinterpret_cast<shared_output_header const*>(mapped_data)->vertex_count) : 0;
+	}
+
+	uint64_t shared_output_writer::published() const
+	{
+		return is_open() ? reinterpret_cast<shared_output_header const*>(mapped_data)->published.load(std::memory_order_relaxed) : 0;
+	}
+
+	static size_t slot_header_offset(unsigned char const* data, int slot)
+	{
+		shared_output_header const* header = reinterpret_cast<shared_output_header const*>(data);
+		return align_64(sizeof(shared_output_header)) + size_t(slot) * header->slot_header_bytes;
+	}
+
+	shared_output_frame shared_output_writer::begin_frame(uint64_t frame_id)
+	{
+		assert_cgp(is_open(), "The shared output is not open");
+		shared_output_header* header = reinterpret_cast<shared_output_header*>(mapped_data);
+
+		shared_output_frame frame;
+		frame.index = header->published.load(std::memory_order_relaxed) + 1;
+		frame.frame_id = frame_id;
+		frame.slot = int((frame.index - 1) % header->slot_count);
+
+		// Odd sequence: readers still holding the previous frame of this slot see it torn on release
+		shared_output_slot* slot = reinterpret_cast<shared_output_slot*>(mapped_data + slot_header_offset(mapped_data, frame.slot));
+		slot->sequence.store(2 * frame.index - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		size_t const N = size_t(header->vertex_count);
+		unsigned char* data = mapped_data + header->data_offset + size_t(frame.slot) * header->slot_bytes;
+		frame.position = array_view<vec3>(reinterpret_cast<vec3*>(data), N);
+		frame.normal = array_view<vec3>(reinterpret_cast<vec3*>(data + vertex_section_bytes(N)), N);
+		return frame;
+	}
+
+	void shared_output_writer::publish(shared_output_frame const& frame)
+	{
+		shared_output_header* header = reinterpret_cast<shared_output_header*>(mapped_data);
+		shared_output_slot* slot = reinterpret_cast<shared_output_slot*>(mapped_data + slot_header_offset(mapped_data, frame.slot));
+		slot->frame_id.store(frame.frame_id, std::memory_order_relaxed);
+		slot->publish_ns.store(steady_clock_ns(), std::memory_order_relaxed);
+		slot->sequence.store(2 * frame.index, std::memory_order_release);
+		header->published.store(frame.index, std::memory_order_release);
+	}
+
+	void shared_output_writer::publish(uint64_t frame_id, numarray<vec3> const& position, numarray<vec3> const& normal)
+	{
+		assert_cgp(position.size() == vertex_count() && normal.size() == vertex_count(), "Vertex count differs from the shared output");
+		shared_output_frame const frame = begin_frame(frame_id);
+		std::copy(position.begin(), position.end(), frame.position.begin());
+		std::copy(normal.begin(), normal.end(), frame.normal.begin());
+		publish(frame);
+	}
+
+
+	double shared_output_statistics::mean_latency_ms() const
+	{
+		return received > 0 ? latency_total_ms / received : 0.0;
+	}
+
+
+	// The fields must describe the layout of create within size bytes: the views are built from them without further check.
+	//  They come from another process, so that the products are compared by division.
+	static bool valid_header(shared_output_header const& header, size_t size)
+	{
+		if (std::memcmp(header.magic, shared_output_magic, sizeof(header.magic)) != 0 || header.version != shared_output_version
+			|| header.layout != uint32_t(shared_output_layout::position_normal_float3))
+			return false;
+
+		size_t const header_bytes = align_64(sizeof(shared_output_header));
+		size_t const slot_header_bytes = align_64(sizeof(shared_output_slot));
+		if (size < header_bytes || header.slot_header_bytes != slot_header_bytes || header.slot_count == 0
+			|| header.slot_count > (size - header_bytes) / slot_header_bytes
+			|| header.data_offset != header_bytes + size_t(header.slot_count) * slot_header_bytes)
+			return false;
+
+		// Position then normal sections of every slot, after the slot headers
+		size_t const data_bytes = size - size_t(header.data_offset);
+		if (header.slot_bytes > data_bytes / header.slot_count || header.vertex_count > data_bytes / (2 * sizeof(vec3)))
+			return false;
+		return 2 * vertex_section_bytes(size_t(header.vertex_count)) <= header.slot_bytes;
+	}
+
+	shared_output_reader::shared_output_reader()
+		: statistics(), mapped_data(nullptr), mapped_size(0), last_index(0)
+	{}
+
+	shared_output_reader::~shared_output_reader()
+	{
+		close();
+	}
+
+	bool shared_output_reader::open(std::string const& name)
+	{
+		close();
+
+#ifdef CGP_SHARED_OUTPUT_POSIX
+		int const fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			return false;
+		struct stat object_stat;
+		if (fstat(fd, &object_stat) != 0 || size_t(object_stat.st_size) < sizeof(shared_output_header)) {
+			::close(fd);
+			return false;
+		}
+		size_t const size = size_t(object_stat.st_size);
+		void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED)
+			return false;
+
+		shared_output_header const* header = static_cast<shared_output_header const*>(view);
+		if (!valid_header(*header, size)) {
+			munmap(view, size);
+			return false;
+		}
+		mapped_data = static_cast<unsigned char const*>(view);
+		mapped_size = size;
+		statistics = shared_output_statistics();
+		last_index = header->published.load(std::memory_order_acquire); // frames published before opening are not counted as dropped
+		return true;
+#else
+		(void)name;
+		return false;
+#endif
+	}
+
+	void shared_output_reader::close()
+	{
+#ifdef CGP_SHARED_OUTPUT_POSIX
+		if (mapped_data != nullptr)
+			munmap(const_cast<unsigned char*>(mapped_data), mapped_size);
+#endif
+		mapped_data = nullptr;
+		mapped_size = 0;
+		last_index = 0;
+	}
+
+	bool shared_output_reader::is_open() const
+	{
+		return mapped_data != nullptr;
+	}
+
+	size_t shared_output_reader::vertex_count() const
+	{
+		return is_open() ? size_t(reinterpret_cast<shared_output_header const*>(mapped_data)->vertex_count) : 0;
+	}
+
+	size_t shared_output_reader::slot_count() const
+	{
+		return is_open() ? size_t(reinterpret_cast<shared_output_header const*>(mapped_data)->slot_count) : 0;
+	}
+
+	bool shared_output_reader::acquire(shared_output_received& frame)
+	{
+		if (!is_open())
+			return false;
+		shared_output_header const* header = reinterpret_cast<shared_output_header const*>(mapped_data);
+
+		// The writer may already be filling the slot of the latest frame again: retry on the newer frame
+		for (int attempt = 0; attempt < 4; ++attempt) {
+			uint64_t const index = header->published.load(std::memory_order_acquire);
+			if (index <= last_index)
+				return false;
+			int const slot_index = int((index - 1) % header->slot_count);
+			shared_output_slot const* slot = reinterpret_cast<shared_output_slot const*>(mapped_data + slot_header_offset(mapped_data, slot_index));
+			uint64_t const sequence = slot->sequence.load(std::memory_order_acquire);
+			if (sequence != 2 * index)
+				continue;
+
+			size_t const N = size_t(header->vertex_count);
+			unsigned char const* vertices = mapped_data + header->data_offset + size_t(slot_index) * header->slot_bytes;
+			frame.index = index;
+			frame.frame_id = slot->frame_id.load(std::memory_order_relaxed);
+			frame.sequence = sequence;
+			frame.slot = slot_index;
+			frame.latency_ms = double(steady_clock_ns() - slot->publish_ns.load(std::memory_order_relaxed)) * 1e-6;
+			frame.position = array_view<vec3 const>(reinterpret_cast<vec3 const*>(vertices), N);
+			frame.normal = array_view<vec3 const>(reinterpret_cast<vec3 const*>(vertices + vertex_section_bytes(N)), N);
+
+			statistics.dropped += index - last_index - 1;
+			last_index = index;
+			return true;
+		}
+		return false;
+	}
+
+	bool shared_output_reader::release(shared_output_received const& frame)
+	{
+		// Seqlock read side: the reads of the vertices happen before the second load of the sequence
+		std::atomic_thread_fence(std::memory_order_acquire);
+		shared_output_slot const* slot = reinterpret_cast<shared_output_slot const*>(mapped_data + slot_header_offset(mapped_data, frame.slot));
+		if (slot->sequence.load(std::memory_order_relaxed) != frame.sequence) {
+			statistics.torn++;
+			return false;
+		}
+
+		if (statistics.received == 0 || frame.latency_ms < statistics.latency_min_ms)
+			statistics.latency_min_ms = frame.latency_ms;
+		statistics.latency_max_ms = std::max(statistics.latency_max_ms, frame.latency_ms);
+		statistics.latency_total_ms += frame.latency_ms;
+		statistics.received++;
+		return true;
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "../memory/array_view.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+namespace cgp
+{
+	// Skinned vertices published to other processes through a ring of frames in POSIX shared memory (shm_open).
+	//  Shared object: shared_output_header, slot_count shared_output_slot, then the data of each slot:
+	//  vertex_count positions followed by vertex_count normals (3 floats each, sections aligned on 64 bytes).
+	//  One writer, any number of readers mapping the object read-only. The writer never waits: a reader detects the frames
+	//  it missed (dropped) and the frames overwritten while it was reading them (torn) with the sequence number of the slots.
+	//  Not available on Windows and Emscripten: create and open return false.
+
+	enum class shared_output_layout : uint32_t { position_normal_float3 = 1 };
+
+	struct shared_output_header
+	{
+		char magic[8];           // "VSRING01"
+		uint32_t version;
+		uint32_t layout;         // shared_output_layout
+		uint64_t vertex_count;
+		uint32_t slot_count;
+		uint32_t slot_header_bytes;
+		uint64_t slot_bytes;     // stride between the data of two slots
+		uint64_t data_offset;    // offset of the data of the first slot in the object
+		alignas(64) std::atomic<uint64_t> published; // number of frames published, frame n (from 1) is in slot (n-1) % slot_count
+	};
+
+	struct alignas(64) shared_output_slot
+	{
+		std::atomic<uint64_t> sequence;     // 2n-1 while frame n is written in the slot, 2n once it is published
+		std::atomic<uint64_t> frame_id;     // given by the writer (e.g. frame counter of the scene)
+		std::atomic<uint64_t> vertex_count;
+		std::atomic<int64_t> publish_ns;    // steady clock (CLOCK_MONOTONIC on Linux, shared by the processes)
+	};
+
+	// Frame being written in a slot of the ring
+	struct shared_output_frame
+	{
+		uint64_t index = 0; // n, from 1
+		uint64_t frame_id = 0;
+		int slot = -1;
+		array_view<vec3> position;
+		array_view<vec3> normal;
+	};
+
+	// Frame acquired by a reader
+	struct shared_output_received
+	{
+		uint64_t index = 0;
+		uint64_t frame_id = 0;
+		uint64_t sequence = 0; // of the slot when acquired
+		int slot = -1;
+		double latency_ms = 0.0;
+		array_view<vec3 const> position;
+		array_view<vec3 const> normal;
+	};
+
+	struct shared_output_writer
+	{
+		shared_output_writer();
+		~shared_output_writer();
+		shared_output_writer(shared_output_writer const&) = delete;
+		shared_output_writer& operator=(shared_output_writer const&) = delete;
+
+		// Replace the shared object name (e.g. "/velocity_skinning") by a new ring; readers still mapping the previous one keep it
+		bool create(std::string const& name, size_t vertex_count, int slot_count);
+		void close(); // also removes the name
+
+		bool is_open() const;
+		std::string const& name() const;
+		size_t vertex_count() const;
+		uint64_t published() const;
+
+		// Slot of the next frame: the skinning writes directly in frame.position and frame.normal, then publish(frame)
+		shared_output_frame begin_frame(uint64_t frame_id);
+		void publish(shared_output_frame const& frame);
+		// Copy of vertices computed elsewhere
+		void publish(uint64_t frame_id, numarray<vec3> const& position, numarray<vec3> const& normal);
+
+	private:
+		unsigned char* mapped_data;
+		size_t mapped_size;
+		std::string object_name;
+	};
+
+	struct shared_output_statistics
+	{
+		uint64_t received = 0; // frames acquired and still valid on release
+		uint64_t dropped = 0;  // frames published between two acquired frames, never seen by the reader
+		uint64_t torn = 0;     // frames overwritten by the writer before their release
+		double latency_min_ms = 0.0; // from the publication of a frame to its acquisition
+		double latency_max_ms = 0.0;
+		double latency_total_ms = 0.0;
+
+		double mean_latency_ms() const;
+	};
+
+	struct shared_output_reader
+	{
+		shared_output_reader();
+		~shared_output_reader();
+		shared_output_reader(shared_output_reader const&) = delete;
+		shared_output_reader& operator=(shared_output_reader const&) = delete;
+
+		bool open(std::string const& name); // read-only mapping of a ring created by a writer
+		void close();
+
+		bool is_open() const;
+		size_t vertex_count() const;
+		size_t slot_count() const;
+
+		// Latest published frame if it is newer than the last acquired one. The views point into the read-only mapping:
+		//  their content is only valid if release(frame) returns true, i.e. the writer didn't reuse the slot meanwhile.
+		bool acquire(shared_output_received& frame);
+		bool release(shared_output_received const& frame);
+
+		shared_output_statistics statistics;
+
+	private:
+		unsigned char const* mapped_data;
+		size_t mapped_size;
+		uint64_t last_index;
+	};
+}
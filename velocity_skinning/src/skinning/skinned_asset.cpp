@@ -0,0 +1,271 @@
+#include "skinned_asset.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace cgp
+{
+	memory_usage memory_usage_of(skinning_content const& content)
+	{
+		memory_usage const source = content.animation_source ? memory_usage_of(*content.animation_source) : memory_usage();
+		return source + memory_usage_of(content.skeleton) + memory_usage_of(content.skeleton_rest_pose)
+			+ memory_usage_of(content.rig) + memory_usage_of(content.velocity_rig)
+			+ memory_usage_of(content.position_rest_pose) + memory_usage_of(content.normal_rest_pose)
+			+ memory_usage_of(content.connectivity) + memory_usage_of(content.uv) + memory_usage_of(content.lod)
+			+ memory_usage_of(content.weights);
+	}
+
+	mesh rest_pose_mesh(skinning_content const& content)
+	{
+		mesh shape;
+		shape.position = content.position_rest_pose;
+		shape.normal = content.normal_rest_pose;
+		shape.connectivity = content.connectivity;
+		shape.uv = content.uv;
+		shape.fill_empty_field();
+		return shape;
+	}
+
+	std::shared_ptr<skinning_content const> skinned_asset_registry::find(std::string const& name) const
+	{
+		auto const it = asset.find(name);
+		if (it == asset.end())
+			return nullptr;
+		return it->second.lock();
+	}
+
+	void skinned_asset_registry::insert(std::string const& name, std::shared_ptr<skinning_content const> const& value)
+	{
+		// Forget the released assets at the same time
+		for (auto it = asset.begin(); it != asset.end();) {
+			if (it->second.expired())
+				it = asset.erase(it);
+			else
+				++it;
+		}
+		asset[name] = value;
+	}
+
+	size_t skinned_asset_registry::number_asset() const
+	{
+		size_t N = 0;
+		for (auto const& entry : asset)
+			if (!entry.second.expired())
+				++N;
+		return N;
+	}
+
+	void character_instance::set_asset(std::shared_ptr<skinning_content const> const& value)
+	{
+		asset = value;
+		arena = skinning_vertex_view();
+		old_joint_rt.clear();
+		old_velocity.clear();
+
+		if (asset) {
+			position_skinned = asset->position_rest_pose;
+			normal_skinned = asset->normal_rest_pose;
+		}
+		else {
+			position_skinned.clear();
+			normal_skinned.clear();
+		}
+	}
+
+	void character_instance::evaluate_pose(float t)
+	{
+		skinning_content const& content = *asset;
+
+		// The clip loops, so that any time offset stays in the range of the keyframes
+		float t_instance = t + time_offset;
+		numarray<float> const& animation_time = content.skeleton.animation_time;
+		if (animation_time.size() > 1) {
+			float const t_min = animation_time[0];
+			float const duration = animation_time[animation_time.size() - 1] - t_min;
+			if (duration > 0.0f) {
+				t_instance = std::fmod(t_instance - t_min, duration);
+				t_instance = t_min + (t_instance < 0.0f ? t_instance + duration : t_instance);
+			}
+		}
+		if (poses != nullptr && !poses->empty())
+			poses->sample(content.skeleton, t_instance, skeleton_current);
+		else {
+			content.skeleton.evaluate_local(t_instance, skeleton_local);
+			skeleton_local_to_global(skeleton_local, content.skeleton.parent_index, skeleton_current);
+		}
+	}
+
+	float character_instance::prepare_frame(float dt, float speed_blending, float fast_rotation_angle, int frame_count, skinning_quality quality)
+	{
+		skinning_content const& content = *asset;
+		if (frame_count > 1)
+			speed_blending = std::pow(speed_blending, float(frame_count));
+
+		velocity_skinning_prepare(frame, skeleton_current, content.skeleton_rest_pose, content.velocity_rig,
+			old_joint_rt, old_velocity, dt, speed_blending, fast_rotation_angle);
+		if (quality == skinning_quality::no_rotation && frame.velocity_enabled)
+			frame.rotation_angle.fill(0.0f); // the joints without rotation are skipped by the rotational deformation
+		else if (frame_count > 1 && frame.velocity_enabled) {
+			for (float& angle : frame.rotation_angle)
+				angle /= float(frame_count);
+		}
+		return speed_blending;
+	}
+
+	void character_instance::update(float t, float dt, float speed_blending, float linear_deformation_intensity, float rotational_deformation_intensity,
+		float fast_rotation_angle, int frame_count, skinning_quality quality)
+	{
+		if (asset == nullptr)
+			return;
+		skinning_content const& content = *asset;
+		evaluate_pose(t);
+
+		if (quality == skinning_quality::reuse) {
+			if (frame_count > 1)
+				speed_blending = std::pow(speed_blending, float(frame_count));
+			velocity_skinning_advance_state(skeleton_current, content.velocity_rig, old_joint_rt, old_velocity, dt, speed_blending);
+			return;
+		}
+		speed_blending = prepare_frame(dt, speed_blending, fast_rotation_angle, frame_count, quality);
+
+		int const level = std::min(lod_level, int(content.lod.level.size()));
+		if (quality == skinning_quality::linear)
+			linear_blend_skinning_vertices(0, position_skinned.size(), position_skinned, normal_skinned,
+				content.position_rest_pose, content.normal_rest_pose, content.rig, frame);
+		else if (level > 0)
+			velocity_skinning_vertices_lod(content.lod, level, position_skinned, normal_skinned, skeleton_current,
+				content.position_rest_pose, content.normal_rest_pose, content.rig, content.velocity_rig, frame,
+				linear_deformation_intensity, rotational_deformation_intensity, sample_deformation);
+		else if (arena.position_skinned.size() > 0 && arena.position_skinned.size() == position_skinned.size()) {
+			velocity_skinning_vertices(0, arena.position_skinned.size(), arena, skeleton_current, frame,
+				linear_deformation_intensity, rotational_deformation_intensity);
+			std::copy(arena.position_skinned.begin(), arena.position_skinned.end(), position_skinned.begin());
+			std::copy(arena.normal_skinned.begin(), arena.normal_skinned.end(), normal_skinned.begin());
+		}
+		else
+			velocity_skinning_vertices(0, position_skinned.size(), position_skinned, normal_skinned, skeleton_current,
+				content.position_rest_pose, content.normal_rest_pose, content.rig, content.velocity_rig, frame,
+				linear_deformation_intensity, rotational_deformation_intensity);
+		velocity_skinning_finish(frame, skeleton_current, old_joint_rt, old_velocity, speed_blending);
+	}
+
+	memory_usage memory_usage_of(character_instance const& instance)
+	{
+		return memory_usage_of(instance.skeleton_local) + memory_usage_of(instance.skeleton_current)
+			+ memory_usage_of(instance.old_joint_rt) + memory_usage_of(instance.old_velocity)
+			+ memory_usage_of(instance.position_skinned) + memory_usage_of(instance.normal_skinned)
+			+ memory_usage_of(instance.frame) + memory_usage_of(instance.sample_deformation);
+	}
+
+	size_t instance_skinning_arena::number_instance() const
+	{
+		return view.size();
+	}
+
+	bool instance_skinning_arena::huge_page_backed() const
+	{
+		return shared.arena.huge_page_backed() && output.huge_page_backed();
+	}
+
+	void instance_skinning_arena::release()
+	{
+		asset = nullptr;
+		shared.arena.release();
+		output.release();
+		view.clear();
+	}
+
+	bool build_instance_skinning_arena(instance_skinning_arena& arena, std::shared_ptr<skinning_content const> const& asset, size_t N_instance,
+		huge_page_mode mode)
+	{
+		arena.release();
+		if (asset == nullptr || N_instance == 0)
+			return true;
+		if (!build_skinning_buffers(arena.shared, asset->position_rest_pose, asset->normal_rest_pose, asset->rig, asset->velocity_rig, mode))
+			return false;
+
+		// The outputs of an instance are next to each other, each section 64-byte aligned
+		size_t const N_vertex = asset->position_rest_pose.size();
+		size_t const alignment = 64;
+		size_t size = 0;
+		for (size_t k = 0; k < 2 * N_instance; ++k)
+			size = memory_arena::aligned_offset(size, alignment) + N_vertex * sizeof(vec3);
+		if (!arena.output.reserve(size, mode)) {
+			arena.release();
+			return false;
+		}
+
+		skinning_vertex_view const shared = arena.shared.view();
+		arena.view.resize(N_instance);
+		for (size_t k = 0; k < N_instance; ++k) {
+			skinning_vertex_view& v = arena.view[k];
+			v = shared;
+			v.position_skinned = arena.output.allocate<vec3>(N_vertex, alignment);
+			v.normal_skinned = arena.output.allocate<vec3>(N_vertex, alignment);
+			std::copy(asset->position_rest_pose.begin(), asset->position_rest_pose.end(), v.position_skinned.begin());
+			std::copy(asset->normal_rest_pose.begin(), asset->normal_rest_pose.end(), v.normal_skinned.begin());
+		}
+		arena.asset = asset;
+		arena.mode = mode;
+		return true;
+	}
+
+	static memory_usage memory_usage_of_arena(memory_arena const& arena)
+	{
+		memory_usage usage;
+		if (arena.capacity() > 0) {
+			usage.bytes = arena.capacity();
+			usage.allocation = 1;
+		}
+		return usage;
+	}
+
+	memory_usage memory_usage_of(instance_skinning_arena const& arena)
+	{
+		return memory_usage_of(arena.view) + memory_usage_of_arena(arena.shared.arena) + memory_usage_of_arena(arena.output);
+	}
+
+	numarray<skinning_lod_measure> measure_skinning_lod(std::shared_ptr<skinning_content const> const& asset, int N_frame,
+		float speed_blending, float linear_deformation_intensity, float rotational_deformation_intensity)
+	{
+		size_t const N_level = asset->lod.number_level();
+		numarray<skinning_lod_measure> measure(N_level);
+		if (asset->skeleton.number_animation_frame() == 0 || N_frame <= 0)
+			return measure;
+
+		float const t_min = asset->skeleton.animation_time[0];
+		float const duration = asset->skeleton.animation_time[asset->skeleton.number_animation_frame() - 1] - t_min;
+		float const dt = duration / N_frame;
+		size_t const N_vertex = asset->position_rest_pose.size();
+
+		// All the levels are run side by side so that they see the same velocity history
+		numarray<character_instance> instance(N_level);
+		for (size_t l = 0; l < N_level; ++l) {
+			instance[l].lod_level = int(l);
+			instance[l].set_asset(asset);
+			measure[l].sample = l == 0 ? N_vertex : asset->lod.level[l - 1].sample.size();
+		}
+
+		numarray<double> error_sum(N_level);
+		for (int kt = 0; kt < N_frame; ++kt) {
+			float const t = t_min + kt * dt;
+			for (size_t l = 0; l < N_level; ++l) {
+				auto const time_start = std::chrono::steady_clock::now();
+				instance[l].update(t, dt, speed_blending, linear_deformation_intensity, rotational_deformation_intensity);
+				measure[l].ms_per_frame += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+
+				for (size_t i = 0; i < N_vertex; ++i) {
+					float const error = norm(instance[l].position_skinned[i] - instance[0].position_skinned[i]);
+					measure[l].max_error = std::max(measure[l].max_error, error);
+					error_sum[l] += error;
+				}
+			}
+		}
+		for (size_t l = 0; l < N_level; ++l) {
+			measure[l].ms_per_frame /= N_frame;
+			measure[l].mean_error = N_vertex > 0 ? float(error_sum[l] / (double(N_vertex) * N_frame)) : 0.0f;
+		}
+		return measure;
+	}
+}
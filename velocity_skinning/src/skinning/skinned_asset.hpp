@@ -0,0 +1,114 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+#include "skinning_lod.hpp"
+#include "sparse_weight_matrix.hpp"
+#include "skinning_buffers.hpp"
+#include "skinning_budget.hpp"
+#include "../skeleton/skeleton.hpp"
+#include "../animation/pose_cache.hpp"
+#include "../memory/memory_footprint.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+
+
+namespace cgp
+{
+	// Rest data of a character, shared by all its instances. Published as an immutable block: it is replaced, never modified.
+	struct skinning_content
+	{
+		skeleton_animation_structure skeleton;
+		numarray<affine_rt> skeleton_rest_pose;
+		rig_structure rig;
+		rig_structure velocity_rig;
+		numarray<vec3> position_rest_pose;
+		numarray<vec3> normal_rest_pose;
+		numarray<uint3> connectivity;
+		numarray<vec2> uv;
+		skinning_lod lod;
+		sparse_weight_matrix weights; // rig as a sparse matrix, for batched_skinning
+		// Original frames of the clip while skeleton holds its compressed version (nullptr otherwise): the compression is always redone from them
+		std::shared_ptr<numarray<numarray<affine_rt> > const> animation_source;
+	};
+
+	memory_usage memory_usage_of(skinning_content const& content);
+	// Mesh of the rest pose, to create the drawable of the instances
+	mesh rest_pose_mesh(skinning_content const& content);
+
+	// Assets by name. Only weak references are kept: an asset is released with its last user.
+	struct skinned_asset_registry
+	{
+		std::shared_ptr<skinning_content const> find(std::string const& name) const; // nullptr if unknown or released
+		// Replace the asset registered under this name. The users of the previous one keep it until they switch.
+		void insert(std::string const& name, std::shared_ptr<skinning_content const> const& asset);
+		size_t number_asset() const; // assets still alive
+
+	private:
+		std::map<std::string, std::weak_ptr<skinning_content const> > asset;
+	};
+
+	// Character using a shared asset: only its pose, velocity history and skinned output belong to the instance
+	struct character_instance
+	{
+		std::shared_ptr<skinning_content const> asset;
+		float time_offset = 0.0f;
+		vec3 translation;
+		int lod_level = 0; // 0: full resolution
+		std::shared_ptr<pose_cache> poses; // baked poses of the clip of the asset, shared by its instances (nullptr: clip evaluated)
+
+		numarray<affine_rt> skeleton_local;
+		numarray<affine_rt> skeleton_current;
+		numarray<affine_rt> old_joint_rt;
+		numarray<vec3> old_velocity;
+		numarray<vec3> position_skinned;
+		numarray<vec3> normal_skinned;
+		velocity_skinning_frame frame;
+		numarray<vec3> sample_deformation; // velocity deformation of the samples of the level of detail
+		// Inputs and outputs of the instance in an instance_skinning_arena (empty: numarray only). The full velocity skinning
+		//  reads and writes them, and copies its output to position_skinned and normal_skinned for the drawing and the other paths.
+		skinning_vertex_view arena;
+
+		// Reset the velocity history (and forget the arena views, built for the previous asset)
+		void set_asset(std::shared_ptr<skinning_content const> const& value);
+		// Pose of the animation at t + time_offset, and velocity skinning of the vertices
+		//  frame_count: display frames covered by dt when the instance skips frames (crowd_scheduler). The velocity blending is
+		//  applied once per frame, and the rotation angle brought back to one frame, so that the deformation doesn't depend on the rate.
+		//  quality: degraded skinning under a time budget (skinning_budget), the velocity state is advanced the same way
+		void update(float t, float dt, float speed_blending, float linear_deformation_intensity, float rotational_deformation_intensity,
+			float fast_rotation_angle = 0.0f, int frame_count = 1, skinning_quality quality = skinning_quality::full);
+
+		// Steps of update, for the callers skinning the vertices of several instances at once (batched_skinning)
+		void evaluate_pose(float t); // skeleton_current at t + time_offset
+		// velocity_skinning_prepare of frame (quality above reuse), return the speed blending to give to velocity_skinning_finish
+		float prepare_frame(float dt, float speed_blending, float fast_rotation_angle, int frame_count, skinning_quality quality);
+	};
+
+	// Data owned by the instance only, the shared asset is not counted
+	memory_usage memory_usage_of(character_instance const& instance);
+
+	// Skinning data of the instances of an asset in arenas (optionally on huge pages) instead of separate numarray:
+	//  the rest pose and the rig in CSR once for all the instances, then the skinned vertices of each instance one after the other
+	struct instance_skinning_arena
+	{
+		std::shared_ptr<skinning_content const> asset; // asset the arena was built from (nullptr: empty)
+		huge_page_mode mode = huge_page_mode::none; // requested when it was built
+		skinning_buffers shared; // its own outputs are not used
+		memory_arena output;
+		numarray<skinning_vertex_view> view; // per instance: the shared inputs with its outputs in output
+
+		size_t number_instance() const;
+		bool huge_page_backed() const;
+		void release();
+	};
+
+	bool build_instance_skinning_arena(instance_skinning_arena& arena, std::shared_ptr<skinning_content const> const& asset, size_t N_instance,
+		huge_page_mode mode = huge_page_mode::none);
+	memory_usage memory_usage_of(instance_skinning_arena const& arena);
+
+	// Each level of detail of the asset (level 0 included) run over N_frame frames of its animation, and compared to the full resolution
+	numarray<skinning_lod_measure> measure_skinning_lod(std::shared_ptr<skinning_content const> const& asset, int N_frame,
+		float speed_blending, float linear_deformation_intensity, float rotational_deformation_intensity);
+}
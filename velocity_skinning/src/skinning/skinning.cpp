@@ -2,6 +2,17 @@
 
 namespace cgp
 {
+	memory_usage memory_usage_of(rig_structure const& rig)
+	{
+		return memory_usage_of(rig.joint) + memory_usage_of(rig.weight);
+	}
+
+	memory_usage memory_usage_of(velocity_skinning_frame const& frame)
+	{
+		return memory_usage_of(frame.palette) + memory_usage_of(frame.translation_velocity) + memory_usage_of(frame.blended_velocity)
+			+ memory_usage_of(frame.rotation_axis) + memory_usage_of(frame.rotation_angle);
+	}
+
 	void normalize_weights(numarray<numarray<float>>& weights)
 	{
 		size_t const N = weights.size();
@@ -99,139 +110,263 @@ namespace cgp
 	}
 	
 	
-	void velocity_skinning_compute(
-		numarray<vec3>& position_skinned,
-		numarray<vec3>& normal_skinned,
+	static void initialize_velocity_state(
 		numarray<affine_rt> const& skeleton_current,
-		numarray<affine_rt> const& skeleton_rest_pose,
-		numarray<vec3> const& position_rest_pose,
-		numarray<vec3> const& normal_rest_pose,
-		rig_structure const& rig,
-		rig_structure const& velocity_rig,
+		numarray<affine_rt>& old_joint_rt,
+		numarray<vec3>& old_velocity)
+	{
+		std::cout << "initialising old_joint_position" << std::endl;
+		size_t const N_joint = skeleton_current.size();
+		old_joint_rt.resize(N_joint);
+		for (int i = 0; i < N_joint; i++) {
+			old_joint_rt[i] = skeleton_current[i];
+		}
+
+		// also initialise old_velocity
+		old_velocity.resize(N_joint);
+		for (int i = 0; i < N_joint; i++) {
+			old_velocity[i] = vec3(0, 0, 0);
+		}
+	}
+
+	static void compute_translation_velocity(
+		numarray<vec3>& translation_velocity,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<affine_rt> const& old_joint_rt,
+		float dt)
+	{
+		size_t const N_joint = skeleton_current.size();
+		translation_velocity.resize(N_joint);
+		for (int i = 0; i < N_joint; i++) {
+			translation_velocity[i] = (skeleton_current[i].translation - old_joint_rt[i].translation) / dt;
+		}
+	}
+
+	static void update_velocity_state(
+		numarray<affine_rt> const& skeleton_current,
+		numarray<vec3> const& translation_velocity,
 		numarray<affine_rt>& old_joint_rt,
 		numarray<vec3>& old_velocity,
+		float const speed_blending)
+	{
+		// update old position & velocity
+		size_t const N_joint = skeleton_current.size();
+		for (int i = 0; i < N_joint; i++) {
+			old_joint_rt[i] = skeleton_current[i];
+			old_velocity[i] = (1 - speed_blending) * translation_velocity[i] + speed_blending * old_velocity[i];
+		}
+	}
+
+	void velocity_skinning_prepare(
+		velocity_skinning_frame& frame,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<affine_rt> const& skeleton_rest_pose,
+		rig_structure const& velocity_rig,
+		numarray<affine_rt> const& old_joint_rt,
+		numarray<vec3> const& old_velocity,
 		float dt,
 		float const speed_blending,
-		float const linear_deformation_intensity,
-		float const rotational_deformation_intensity
+		float const fast_rotation_angle
 	)
 	{
-		size_t const N_vertex = position_rest_pose.size();
 		size_t const N_joint = skeleton_current.size();
 
-		#pragma region LBS
+		frame.palette.resize(N_joint);
+		for (size_t k = 0; k < N_joint; ++k)
+			frame.palette[k] = skeleton_current[k].matrix() * inverse(skeleton_rest_pose[k]).matrix();
 
-		for (int i = 0; i < N_vertex; i++) {
-			vec3 new_pos = vec3(0, 0, 0);
-			vec3 new_normal = vec3(0, 0, 0);
+		// if old_joint_rt is empty, the state is initialized at the end of the frame
+		frame.fast_rotation_angle = fast_rotation_angle;
+		frame.initialize_state = old_joint_rt.size() == 0;
+		// if weights arent initialised yet, skip velocity skinning
+		frame.velocity_enabled = !frame.initialize_state && velocity_rig.joint.size() != 0;
+		if (!frame.velocity_enabled)
+			return;
 
-			mat4 M = mat4::build_zero();
+		compute_translation_velocity(frame.translation_velocity, skeleton_current, old_joint_rt, dt);
 
-			for (int j = 0; j < rig.joint[i].size(); j++) {
-				// compute the transformation matrix corresponding to the new position of that vertex
-				int joint_nb = rig.joint[i][j];
-				float weight = rig.weight[i][j];
+		frame.blended_velocity.resize(N_joint);
+		frame.rotation_axis.resize(N_joint);
+		frame.rotation_angle.resize(N_joint);
+		for (size_t k = 0; k < N_joint; ++k) {
+			frame.blended_velocity[k] = (1 - speed_blending) * frame.translation_velocity[k] + speed_blending * old_velocity[k];
 
-				mat4 T = skeleton_current[joint_nb].matrix();
-				mat4 T0inv = inverse(skeleton_rest_pose[joint_nb]).matrix();
-				M += weight * T * T0inv;
+			affine_rt diff = skeleton_current[k] * inverse(old_joint_rt[k]);
+			quaternion diff_q = diff.rotation.quat();
+			if (norm(diff_q.xyz()) < 0.001) {
+				frame.rotation_angle[k] = 0.0f;
+				continue;
 			}
+			frame.rotation_angle[k] = 2 * std::atan2(norm(diff_q.xyz()), diff_q.w);
+			frame.rotation_axis[k] = normalize(diff_q.xyz());
+		}
+	}
+
+	void linear_blend_skinning_vertices(
+		size_t begin,
+		size_t end,
+		numarray<vec3>& position_skinned,
+		numarray<vec3>& normal_skinned,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		velocity_skinning_frame const& frame
+	)
+	{
+		for (size_t i = begin; i < end; i++) {
+			mat4 M = mat4::build_zero();
+			for (int j = 0; j < rig.joint[i].size(); j++)
+				M += rig.weight[i][j] * frame.palette[rig.joint[i][j]];
 
 			position_skinned[i] = M * position_rest_pose[i];
 			normal_skinned[i] = M * normal_rest_pose[i];
 		}
-		
+	}
+
+	void velocity_skinning_deform_vertex(
+		size_t i,
+		vec3& position,
+		numarray<affine_rt> const& skeleton_current,
+		rig_structure const& velocity_rig,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity
+	)
+	{
+		#pragma region linear velocity skinning
+
+		vec3 deformation = vec3(0, 0, 0);
+		for (int j = 0; j < velocity_rig.joint[i].size(); j++)
+			deformation += velocity_rig.weight[i][j] * frame.blended_velocity[velocity_rig.joint[i][j]];
+		position -= deformation * linear_deformation_intensity;
+
 		#pragma endregion
 
-		#pragma region initialise velocity skinning variables
+		#pragma region rotational velocity skinning
 
-		// if old_joint_rt is empty, wait for next iteration
-		if (old_joint_rt.size() == 0) {
-			std::cout << "initialising old_joint_position" << std::endl;
-			old_joint_rt.resize(N_joint);
-			for (int i = 0; i < N_joint; i++) {
-				old_joint_rt[i] = skeleton_current[i];
-			}
+		deformation = vec3(0, 0, 0);
+		for (int j = 0; j < velocity_rig.joint[i].size(); j++) {
+			int joint = velocity_rig.joint[i][j];
+			float const theta = frame.rotation_angle[joint];
+			if (theta == 0.0f) continue;
+			vec3 const& angular_velocity_direction = frame.rotation_axis[joint];
 
-			// also initialise old_velocity
-			old_velocity.resize(N_joint);
-			for (int i = 0; i < N_joint; i++) {
-				old_velocity[i] = vec3(0, 0, 0);
-			}
-			return;
-		}
+			vec3 p_proj = skeleton_current[joint].translation + dot(position - skeleton_current[joint].translation, angular_velocity_direction) * angular_velocity_direction;
+			vec3 p_pi = position - p_proj;
+			float angle = norm(cross(angular_velocity_direction, p_pi) * theta) * 5;
 
-		// if weights arent initialised yet, skip velocity skinning on first iteration
-		if (velocity_rig.joint.size() == 0) {
-			// std::cout << "velocity weights not initialised yet" << std::endl;
-			return;
+			vec3 joint_j_deformation = rotation_offset(angular_velocity_direction, angle, position - skeleton_current[joint].translation, frame.fast_rotation_angle);
+			deformation += joint_j_deformation * velocity_rig.weight[i][j];
 		}
+		position -= deformation * rotational_deformation_intensity;
 
 		#pragma endregion
-		
-		#pragma region linear velocity skinning
+	}
 
-		numarray<vec3> translation_velocity = numarray<vec3>(N_joint);
-		for (int i = 0; i < N_joint; i++) {
-			translation_velocity[i] = (skeleton_current[i].translation - old_joint_rt[i].translation) / dt;
-		}
+	void velocity_skinning_vertices(
+		size_t begin,
+		size_t end,
+		numarray<vec3>& position_skinned,
+		numarray<vec3>& normal_skinned,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		packed_vertex_buffer* packed_output
+	)
+	{
+		for (size_t i = begin; i < end; i++) {
+			linear_blend_skinning_vertices(i, i + 1, position_skinned, normal_skinned, position_rest_pose, normal_rest_pose, rig, frame);
 
-		// then, apply the deformation to all vertices
-		for (int i = 0; i < N_vertex; i++) {
-			compute_linear_velocity_deformation(
-				i,
-				position_skinned,
-				translation_velocity,
-				velocity_rig,
-				old_velocity,
-				speed_blending,
-				linear_deformation_intensity
-			);
+			if (frame.velocity_enabled)
+				velocity_skinning_deform_vertex(i, position_skinned[i], skeleton_current, velocity_rig, frame,
+					linear_deformation_intensity, rotational_deformation_intensity);
+
+			// the vertex is final and can be written directly in the staging buffer
+			if (packed_output != nullptr)
+				packed_output->write(i, position_skinned[i], normal_skinned[i]);
 		}
+	}
 
-		#pragma endregion
+	void velocity_skinning_finish(
+		velocity_skinning_frame const& frame,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<affine_rt>& old_joint_rt,
+		numarray<vec3>& old_velocity,
+		float const speed_blending
+	)
+	{
+		if (frame.initialize_state)
+			initialize_velocity_state(skeleton_current, old_joint_rt, old_velocity);
+		else if (frame.velocity_enabled)
+			update_velocity_state(skeleton_current, frame.translation_velocity, old_joint_rt, old_velocity, speed_blending);
+	}
 
-		#pragma region rotational velocity skinning
+	void velocity_skinning_compute(
+		numarray<vec3>& position_skinned,
+		numarray<vec3>& normal_skinned,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<affine_rt> const& skeleton_rest_pose,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		numarray<affine_rt>& old_joint_rt,
+		numarray<vec3>& old_velocity,
+		float dt,
+		float const speed_blending,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		packed_vertex_buffer* packed_output,
+		float const fast_rotation_angle
+	)
+	{
+		size_t const N_vertex = position_rest_pose.size();
 
-		for (int i = 0; i < N_vertex; i++) {
-			vec3 deformation = vec3(0, 0, 0);
-			for (int j = 0; j < velocity_rig.joint[i].size(); j++) {
-				int joint = velocity_rig.joint[i][j];
-				affine_rt diff = skeleton_current[joint] * inverse(old_joint_rt[joint]);
-				quaternion diff_q = diff.rotation.quat();
-
-				float theta = 2 * std::atan2(norm(diff_q.xyz()), diff_q.w);
-				if (norm(diff_q.xyz()) < 0.001) continue;
-				vec3 angular_velocity_direction = normalize(diff_q.xyz());
-				
-				vec3 p_proj = skeleton_current[joint].translation + dot(position_skinned[i] - skeleton_current[joint].translation, angular_velocity_direction) * angular_velocity_direction;
-				vec3 p_pi = position_skinned[i] - p_proj;
-				// vec3 p_pi = position_skinned[i] - skeleton_current[joint].translation;
-				float angle = norm(cross(angular_velocity_direction, p_pi) * theta) * 5;
-				
-				rotation_transform rotation = rotation_transform::from_axis_angle(angular_velocity_direction, angle);
-				vec3 joint_j_deformation = rotation * (position_skinned[i] - skeleton_current[joint].translation) - 
-					(position_skinned[i] - skeleton_current[joint].translation);
-				deformation += joint_j_deformation * velocity_rig.weight[i][j];
-			}
-			position_skinned[i] -= deformation * rotational_deformation_intensity;
-		}
+		if (packed_output != nullptr)
+			packed_output->resize(N_vertex);
 
-		#pragma endregion
-		
-		#pragma region update velocity skinning variables
+		velocity_skinning_frame frame;
+		velocity_skinning_prepare(frame, skeleton_current, skeleton_rest_pose, velocity_rig, old_joint_rt, old_velocity, dt, speed_blending, fast_rotation_angle);
+		velocity_skinning_vertices(0, N_vertex, position_skinned, normal_skinned, skeleton_current,
+			position_rest_pose, normal_rest_pose, rig, velocity_rig, frame,
+			linear_deformation_intensity, rotational_deformation_intensity, packed_output);
+		velocity_skinning_finish(frame, skeleton_current, old_joint_rt, old_velocity, speed_blending);
+	}
 
-		// update old position & velocity
-		for (int i = 0; i < N_joint; i++) {
-			old_joint_rt[i] = skeleton_current[i];
-			old_velocity[i] = (1 - speed_blending) * translation_velocity[i] + speed_blending * old_velocity[i];
+
+	void velocity_skinning_advance_state(
+		numarray<affine_rt> const& skeleton_current,
+		rig_structure const& velocity_rig,
+		numarray<affine_rt>& old_joint_rt,
+		numarray<vec3>& old_velocity,
+		float dt,
+		float const speed_blending
+	)
+	{
+		// same early exits as velocity_skinning_compute
+		if (old_joint_rt.size() == 0) {
+			initialize_velocity_state(skeleton_current, old_joint_rt, old_velocity);
+			return;
 		}
+		if (velocity_rig.joint.size() == 0)
+			return;
 
-		#pragma endregion
+		numarray<vec3> translation_velocity;
+		compute_translation_velocity(translation_velocity, skeleton_current, old_joint_rt, dt);
+		update_velocity_state(skeleton_current, translation_velocity, old_joint_rt, old_velocity, speed_blending);
+	}
 
+	vec3 rotation_offset_exact(vec3 const& axis, float angle, vec3 const& v)
+	{
+		rotation_transform rotation = rotation_transform::from_axis_angle(axis, angle);
+		return rotation * v - v;
 	}
 
-	
 	void compute_linear_velocity_deformation(
 		int idx,
 		numarray<vec3>& position_skinned,
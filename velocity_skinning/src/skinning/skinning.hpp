@@ -1,6 +1,8 @@
 #pragma once
 
 #include "cgp/cgp.hpp"
+#include "packed_vertex.hpp"
+#include "../memory/memory_footprint.hpp"
 
 
 namespace cgp
@@ -11,6 +13,8 @@ namespace cgp
 		numarray<numarray<float>> weight;
 	};
 
+	memory_usage memory_usage_of(rig_structure const& rig);
+
 	void normalize_weights(numarray<numarray<float>>& weights);
 
 	void init_velocity_skinning_weights(
@@ -32,9 +36,98 @@ namespace cgp
 		float dt,
 		float const speed_blending,
 		float const linear_deformation_intensity,
-		float const rotational_deformation_intensity
+		float const rotational_deformation_intensity,
+		packed_vertex_buffer* packed_output = nullptr, // if set, the final vertices are also written in this interleaved buffer
+		float const fast_rotation_angle = 0.0f         // see velocity_skinning_frame::fast_rotation_angle
 	);
 	
+	// velocity_skinning_compute split in three stages, so that the vertices can be processed by independent chunks:
+	//  prepare (per-joint quantities) -> vertices on [begin,end[ -> finish (update of the velocity state)
+	struct velocity_skinning_frame
+	{
+		numarray<mat4> palette;               // T_current * inverse(T_rest_pose) for each joint
+		numarray<vec3> translation_velocity;
+		numarray<vec3> blended_velocity;      // translation velocity blended with the previous one
+		numarray<vec3> rotation_axis;
+		numarray<float> rotation_angle;       // 0 if the joint doesn't rotate
+		bool initialize_state = false;        // first frame: old_joint_rt is initialized by finish
+		bool velocity_enabled = false;
+		float fast_rotation_angle = 0.0f;     // below this angle, the rotational deformation uses rotation_offset_fast (0: always exact)
+	};
+
+	memory_usage memory_usage_of(velocity_skinning_frame const& frame);
+
+	void velocity_skinning_prepare(
+		velocity_skinning_frame& frame,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<affine_rt> const& skeleton_rest_pose,
+		rig_structure const& velocity_rig,
+		numarray<affine_rt> const& old_joint_rt,
+		numarray<vec3> const& old_velocity,
+		float dt,
+		float const speed_blending,
+		float const fast_rotation_angle = 0.0f
+	);
+
+	// position_skinned, normal_skinned (and packed_output) must already have the size of the mesh
+	void velocity_skinning_vertices(
+		size_t begin,
+		size_t end,
+		numarray<vec3>& position_skinned,
+		numarray<vec3>& normal_skinned,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		packed_vertex_buffer* packed_output = nullptr
+	);
+
+	// The two parts of velocity_skinning_vertices: linear blend skinning of [begin,end[ ...
+	void linear_blend_skinning_vertices(
+		size_t begin,
+		size_t end,
+		numarray<vec3>& position_skinned,
+		numarray<vec3>& normal_skinned,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		velocity_skinning_frame const& frame
+	);
+
+	// ... and velocity deformation of the vertex i, applied to its LBS position (only if frame.velocity_enabled)
+	void velocity_skinning_deform_vertex(
+		size_t i,
+		vec3& position,
+		numarray<affine_rt> const& skeleton_current,
+		rig_structure const& velocity_rig,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity
+	);
+
+	void velocity_skinning_finish(
+		velocity_skinning_frame const& frame,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<affine_rt>& old_joint_rt,
+		numarray<vec3>& old_velocity,
+		float const speed_blending
+	);
+
+	// Advance old_joint_rt and old_velocity exactly as velocity_skinning_compute does, without deforming the vertices
+	//  Used when the deformed mesh is not needed (e.g. culled), so that the velocity stays coherent once it is visible again
+	void velocity_skinning_advance_state(
+		numarray<affine_rt> const& skeleton_current,
+		rig_structure const& velocity_rig,
+		numarray<affine_rt>& old_joint_rt,
+		numarray<vec3>& old_velocity,
+		float dt,
+		float const speed_blending
+	);
+
 	void compute_linear_velocity_deformation(
 		int idx,
 		numarray<vec3>& position_skinned,
@@ -45,4 +138,20 @@ namespace cgp
 		float const deformation_intensity
 	);
 
+	// Offset R(axis,angle)*v - v of the rotational velocity deformation, with a rotation_transform
+	vec3 rotation_offset_exact(vec3 const& axis, float angle, vec3 const& v);
+	// Same offset with Rodrigues' formula and the polynomial expansions of sin and 1-cos (deviation ~angle^7/5040)
+	inline vec3 rotation_offset_fast(vec3 const& axis, float angle, vec3 const& v)
+	{
+		float const a2 = angle * angle;
+		float const s = angle * (1.0f - a2 / 6.0f * (1.0f - a2 / 20.0f));      // angle - angle^3/6 + angle^5/120
+		float const c = a2 / 2.0f * (1.0f - a2 / 12.0f * (1.0f - a2 / 30.0f)); // angle^2/2 - angle^4/24 + angle^6/720
+		vec3 const kv = cross(axis, v);
+		return s * kv + c * cross(axis, kv);
+	}
+	inline vec3 rotation_offset(vec3 const& axis, float angle, vec3 const& v, float fast_rotation_angle)
+	{
+		return angle < fast_rotation_angle ? rotation_offset_fast(axis, angle, v) : rotation_offset_exact(axis, angle, v);
+	}
+
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "skinning_bounds.hpp"
+
+namespace cgp
+{
+	void bounding_box_structure::add(vec3 const& p)
+	{
+		if (empty) {
+			p_min = p;
+			p_max = p;
+			empty = false;
+			return;
+		}
+		for (int k = 0; k < 3; ++k) {
+			p_min[k] = std::min(p_min[k], p[k]);
+			p_max[k] = std::max(p_max[k], p[k]);
+		}
+	}
+
+	void bounding_box_structure::add_sphere(vec3 const& center, float radius)
+	{
+		add(center - vec3(radius, radius, radius));
+		add(center + vec3(radius, radius, radius));
+	}
+
+	void bounding_box_structure::enlarge(float margin)
+	{
+		if (empty)
+			return;
+		p_min -= vec3(margin, margin, margin);
+		p_max += vec3(margin, margin, margin);
+	}
+
+	numarray<vec3> bounding_box_structure::edges() const
+	{
+		numarray<vec3> corners;
+		for (int k = 0; k < 8; ++k)
+			corners.push_back({ (k & 1) ? p_max.x : p_min.x, (k & 2) ? p_max.y : p_min.y, (k & 4) ? p_max.z : p_min.z });
+
+		numarray<vec3> segments;
+		for (int a = 0; a < 8; ++a) {
+			for (int bit = 1; bit < 8; bit <<= 1) {
+				int const b = a | bit;
+				if (b != a) {
+					segments.push_back(corners[a]);
+					segments.push_back(corners[b]);
+				}
+			}
+		}
+		return segments;
+	}
+
+
+	void compute_joint_bounds(
+		joint_bounds_structure& bounds,
+		numarray<vec3> const& position_rest_pose,
+		numarray<affine_rt> const& skeleton_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig)
+	{
+		size_t const N_vertex = position_rest_pose.size();
+		size_t const N_joint = skeleton_rest_pose.size();
+
+		numarray<affine_rt> rest_pose_inverse;
+		rest_pose_inverse.resize(N_joint);
+		for (size_t j = 0; j < N_joint; ++j)
+			rest_pose_inverse[j] = inverse(skeleton_rest_pose[j]);
+
+		// First pass: box of the influenced vertices of each joint, in the joint frame
+		numarray<bounding_box_structure> box;
+		box.resize(N_joint);
+		for (size_t i = 0; i < N_vertex; ++i) {
+			for (size_t k = 0; k < rig.joint[i].size(); ++k) {
+				if (rig.weight[i][k] <= 0.0f)
+					continue;
+				int const j = rig.joint[i][k];
+				box[j].add(rest_pose_inverse[j] * position_rest_pose[i]);
+			}
+		}
+
+		bounds.center_local.resize(N_joint);
+		bounds.radius.resize(N_joint);
+		for (size_t j = 0; j < N_joint; ++j) {
+			bounds.center_local[j] = box[j].empty ? vec3(0, 0, 0) : (box[j].p_min + box[j].p_max) / 2.0f;
+			bounds.radius[j] = -1.0f;
+		}
+
+		// Second pass: radius of the sphere around the center of the box
+		for (size_t i = 0; i < N_vertex; ++i) {
+			for (size_t k = 0; k < rig.joint[i].size(); ++k) {
+				if (rig.weight[i][k] <= 0.0f)
+					continue;
+				int const j = rig.joint[i][k];
+				float const d = norm(rest_pose_inverse[j] * position_rest_pose[i] - bounds.center_local[j]);
+				bounds.radius[j] = std::max(bounds.radius[j], d);
+			}
+		}
+
+		bounds.max_velocity_weight_sum = 0.0f;
+		for (size_t i = 0; i < velocity_rig.weight.size(); ++i) {
+			float s = 0.0f;
+			for (float w : velocity_rig.weight[i])
+				s += std::abs(w);
+			bounds.max_velocity_weight_sum = std::max(bounds.max_velocity_weight_sum, s);
+		}
+	}
+
+
+	bounding_box_structure skinned_mesh_bounds(
+		joint_bounds_structure const& bounds,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<affine_rt> const& old_joint_rt,
+		numarray<vec3> const& old_velocity,
+		float dt,
+		float const speed_blending,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity)
+	{
+		size_t const N_joint = skeleton_current.size();
+
+		bounding_box_structure box;
+		for (size_t j = 0; j < N_joint; ++j) {
+			if (bounds.radius[j] < 0)
+				continue;
+			box.add_sphere(skeleton_current[j] * bounds.center_local[j], bounds.radius[j]);
+		}
+
+		// No velocity deformation before the velocity state is initialized (see velocity_skinning_compute)
+		if (old_joint_rt.size() != N_joint || bounds.max_velocity_weight_sum <= 0 || dt <= 0)
+			return box;
+
+		// Linear term: |sum_j w_j v_j| <= (sum_j w_j) max_j |v_j|
+		float max_speed = 0.0f;
+		for (size_t j = 0; j < N_joint; ++j) {
+			vec3 const translation_velocity = (skeleton_current[j].translation - old_joint_rt[j].translation) / dt;
+			vec3 const v = (1 - speed_blending) * translation_velocity + speed_blending * old_velocity[j];
+			max_speed = std::max(max_speed, norm(v));
+		}
+		box.enlarge(linear_deformation_intensity * bounds.max_velocity_weight_sum * max_speed);
+
+		// Rotational term: a rotation of angle a moves p around the joint by at most min(2, a)|p-c|
+		//  with a = 5 theta |p-c| at most, and |p-c| bounded by the distance of the joint to the farthest corner of the box
+		float max_rotational_displacement = 0.0f;
+		for (size_t j = 0; j < N_joint; ++j) {
+			quaternion const diff_q = (skeleton_current[j] * inverse(old_joint_rt[j])).rotation.quat();
+			float const s = norm(diff_q.xyz());
+			if (s < 0.001f)
+				continue;
+			float const theta = std::abs(2 * std::atan2(s, diff_q.w));
+
+			vec3 const c = skeleton_current[j].translation;
+			vec3 d;
+			for (int k = 0; k < 3; ++k)
+				d[k] = std::max(std::abs(box.p_min[k] - c[k]), std::abs(box.p_max[k] - c[k]));
+			float const distance = norm(d);
+			float const angle = 5 * theta * distance;
+			max_rotational_displacement = std::max(max_rotational_displacement, std::min(2.0f, angle) * distance);
+		}
+		box.enlarge(std::abs(rotational_deformation_intensity) * bounds.max_velocity_weight_sum * max_rotational_displacement);
+
+		return box;
+	}
+
+
+	bool is_box_in_frustum(bounding_box_structure const& box, mat4 const& projection_view)
+	{
+		if (box.empty)
+			return false;
+
+		// Planes of the frustum extracted from the rows of the matrix: row_3 +/- row_k
+		mat4 const& M = projection_view;
+		for (int k = 0; k < 3; ++k) {
+			for (int side = -1; side <= 1; side += 2) {
+				vec4 const plane = { M(3,0) + side * M(k,0), M(3,1) + side * M(k,1), M(3,2) + side * M(k,2), M(3,3) + side * M(k,3) };
+
+				// Corner of the box the farthest along the plane normal
+				vec3 const p = { plane.x >= 0 ? box.p_max.x : box.p_min.x, plane.y >= 0 ? box.p_max.y : box.p_min.y, plane.z >= 0 ? box.p_max.z : box.p_min.z };
+				if (plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < 0)
+					return false;
+			}
+		}
+		return true;
+	}
+}
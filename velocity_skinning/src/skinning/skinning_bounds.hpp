@@ -0,0 +1,54 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+
+
+namespace cgp
+{
+	// Axis aligned bounding box
+	struct bounding_box_structure
+	{
+		vec3 p_min = { 0, 0, 0 };
+		vec3 p_max = { 0, 0, 0 };
+		bool empty = true;
+
+		void add(vec3 const& p);
+		void add_sphere(vec3 const& center, float radius);
+		void enlarge(float margin);
+		numarray<vec3> edges() const; // 12 segments, as expected by a curve_drawable in Segments mode
+	};
+
+	// Bounding spheres of the vertices influenced by each joint, computed once in rest pose.
+	//  The sphere is expressed in the rest-pose frame of the joint, so that it follows the joint rigidly.
+	struct joint_bounds_structure
+	{
+		numarray<vec3> center_local; // center of the sphere in the rest-pose frame of the joint
+		numarray<float> radius;      // negative if the joint doesn't influence any vertex
+
+		float max_velocity_weight_sum = 0.0f; // maximal sum of the velocity weights of a vertex
+	};
+
+	void compute_joint_bounds(
+		joint_bounds_structure& bounds,
+		numarray<vec3> const& position_rest_pose,
+		numarray<affine_rt> const& skeleton_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig);
+
+	// Conservative bounds of the mesh that velocity_skinning_compute would produce for the current skeleton, in O(N_joint)
+	//  - LBS: each skinned vertex is a convex combination of its rigidly moved position for each of its joints (weights summing to 1)
+	//  - Velocity terms: margin bounding the linear and rotational displacements given the deformation intensities
+	bounding_box_structure skinned_mesh_bounds(
+		joint_bounds_structure const& bounds,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<affine_rt> const& old_joint_rt,
+		numarray<vec3> const& old_velocity,
+		float dt,
+		float const speed_blending,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity);
+
+	// Return false if the box is fully outside the view frustum given by the matrix projection*view
+	bool is_box_in_frustum(bounding_box_structure const& box, mat4 const& projection_view);
+}
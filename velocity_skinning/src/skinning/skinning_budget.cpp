@@ -0,0 +1,121 @@
+#include "skinning_budget.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace cgp
+{
+	char const* skinning_quality_name(skinning_quality quality)
+	{
+		switch (quality) {
+		case skinning_quality::full: return "full";
+		case skinning_quality::no_rotation: return "no rotation";
+		case skinning_quality::linear: return "linear";
+		case skinning_quality::reuse: return "reuse";
+		}
+		return "";
+	}
+
+	void skinning_budget::resize(size_t N_index)
+	{
+		size_t const N_previous = reused.size();
+		reused.resize(N_index);
+		for (size_t k = N_previous; k < N_index; ++k)
+			reused[k] = 1 << 16;
+	}
+
+	double skinning_budget::predicted_ns(size_t vertex_count, skinning_quality quality) const
+	{
+		if (quality == skinning_quality::reuse)
+			return ns_reuse;
+		return ns_per_vertex[int(quality)] * double(vertex_count);
+	}
+
+	float skinning_budget::effective_priority(skinning_work_item const& item) const
+	{
+		int const age = item.index < reused.size() ? reused[item.index] : 0;
+		return item.priority * (1.0f + parameters.reuse_age_weight * float(age));
+	}
+
+	void skinning_budget::plan(numarray<skinning_work_item>& items, double available_ms)
+	{
+		std::stable_sort(items.begin(), items.end(), [this](skinning_work_item const& a, skinning_work_item const& b) {
+			return effective_priority(a) > effective_priority(b);
+		});
+
+		// Everything reused first, then each pass raises the items by priority while the prediction fits
+		double const available_ns = std::max(available_ms, 0.0) * 1e6;
+		double planned_ns = 0.0;
+		for (skinning_work_item& item : items) {
+			item.quality = skinning_quality::reuse;
+			planned_ns += predicted_ns(item.vertex_count, item.quality);
+		}
+		skinning_quality const pass[] = { skinning_quality::linear, skinning_quality::no_rotation, skinning_quality::full };
+		for (skinning_quality const quality : pass) {
+			for (skinning_work_item& item : items) {
+				double const extra = predicted_ns(item.vertex_count, quality) - predicted_ns(item.vertex_count, item.quality);
+				if (planned_ns + extra <= available_ns) {
+					item.quality = quality;
+					planned_ns += extra;
+				}
+			}
+		}
+
+		statistics.available_ms = std::max(available_ms, 0.0);
+		statistics.planned_ms = planned_ns * 1e-6;
+	}
+
+	void skinning_budget::execute(numarray<skinning_work_item>& items, std::function<void(skinning_work_item const&)> const& run)
+	{
+		skinning_budget_statistics& s = statistics;
+		s.item = items.size();
+		std::fill(std::begin(s.quality_count), std::end(s.quality_count), size_t(0));
+		s.deadline_degraded = 0;
+		s.vertex_full = 0;
+		s.vertex_degraded = 0;
+
+		double const available_ns = s.available_ms * 1e6;
+		auto const time_start = std::chrono::steady_clock::now();
+		for (skinning_work_item& item : items) {
+			// Running late: the item gets the best quality that still ends before the deadline
+			double const elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - time_start).count();
+			skinning_quality const planned = item.quality;
+			while (item.quality != skinning_quality::reuse && elapsed_ns + predicted_ns(item.vertex_count, item.quality) > available_ns)
+				item.quality = skinning_quality(int(item.quality) + 1);
+			if (item.quality != planned)
+				s.deadline_degraded++;
+
+			auto const item_start = std::chrono::steady_clock::now();
+			run(item);
+			double const item_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - item_start).count();
+
+			float const a = parameters.cost_smoothing;
+			if (item.quality == skinning_quality::reuse)
+				ns_reuse = (1.0f - a) * ns_reuse + a * item_ns;
+			else if (item.vertex_count > 0)
+				ns_per_vertex[int(item.quality)] = (1.0f - a) * ns_per_vertex[int(item.quality)] + a * item_ns / double(item.vertex_count);
+
+			if (item.index < reused.size())
+				reused[item.index] = item.quality == skinning_quality::reuse ? reused[item.index] + 1 : 0;
+			s.quality_count[int(item.quality)]++;
+			if (item.quality == skinning_quality::full)
+				s.vertex_full += item.vertex_count;
+			else
+				s.vertex_degraded += item.vertex_count;
+		}
+		s.spent_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+
+		s.frame++;
+		if (s.spent_ms > s.available_ms)
+			s.frame_over_budget++;
+		s.total_item += s.item;
+		s.total_degraded += s.item - s.quality_count[int(skinning_quality::full)];
+		s.total_reused += s.quality_count[int(skinning_quality::reuse)];
+		s.max_spent_ms = std::max(s.max_spent_ms, s.spent_ms);
+	}
+
+	void skinning_budget::reset_statistics()
+	{
+		statistics = skinning_budget_statistics();
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+
+#include <functional>
+
+
+namespace cgp
+{
+	// Work done for a character in a frame, from the most to the least expensive.
+	//  Whatever the quality, the velocity state (old_joint_rt, old_velocity) advances as with the full skinning.
+	enum class skinning_quality
+	{
+		full,        // velocity skinning
+		no_rotation, // linear blend skinning and linear velocity deformation only
+		linear,      // linear blend skinning only
+		reuse        // the last output is kept, only the velocity state is advanced
+	};
+	static int const number_skinning_quality = 4;
+	char const* skinning_quality_name(skinning_quality quality);
+
+	struct skinning_budget_parameters
+	{
+		float budget_ms = 4.0f;        // CPU time given to the items of a frame
+		float cost_smoothing = 0.1f;   // weight of the last measure in the cost model
+		float reuse_age_weight = 1.0f; // priority grows with the frames an item has been reused, so that none is starved
+	};
+
+	// Character to skin in the frame, index is given by the caller (e.g. the instance)
+	struct skinning_work_item
+	{
+		size_t index = 0;
+		size_t vertex_count = 0;
+		float priority = 0.0f;   // e.g. size on screen, higher first
+		skinning_quality quality = skinning_quality::full; // set by plan, may be lowered by execute
+	};
+
+	struct skinning_budget_statistics
+	{
+		// Last frame
+		size_t item = 0;
+		size_t quality_count[number_skinning_quality] = {};
+		size_t deadline_degraded = 0; // items lowered by execute because the frame was running late
+		size_t vertex_full = 0;       // vertices skinned at full quality
+		size_t vertex_degraded = 0;   // vertices of the items below full quality
+		double available_ms = 0.0;
+		double planned_ms = 0.0;
+		double spent_ms = 0.0;
+
+		// Since the last reset
+		size_t frame = 0;
+		size_t frame_over_budget = 0;
+		size_t total_item = 0;
+		size_t total_degraded = 0;
+		size_t total_reused = 0;
+		double max_spent_ms = 0.0;
+	};
+
+	// Per-frame time budget for the skinning of many characters.
+	//  plan orders the items by priority and raises their quality in passes (all to linear, then no_rotation, then full),
+	//  as long as the predicted cost fits the available time. The cost per vertex of each quality is measured by execute.
+	//  execute runs the items and lowers the quality of the remaining ones if the measured time gets ahead of the plan.
+	struct skinning_budget
+	{
+		skinning_budget_parameters parameters;
+		skinning_budget_statistics statistics;
+
+		double ns_per_vertex[number_skinning_quality] = { 60.0, 30.0, 12.0, 0.0 }; // initial guesses, refined by the measures
+		double ns_reuse = 2000.0;                                                 // pose evaluation and velocity state of a reused item
+		numarray<int> reused;                                                     // consecutive frames reused, by index
+
+		void resize(size_t N_index); // new indices have not been skinned yet: they come first
+
+		double predicted_ns(size_t vertex_count, skinning_quality quality) const;
+		float effective_priority(skinning_work_item const& item) const;
+
+		// Sort items by decreasing effective priority and set their quality
+		void plan(numarray<skinning_work_item>& items, double available_ms);
+		// Run the items in order. The quality passed to run may be lower than the planned one.
+		void execute(numarray<skinning_work_item>& items, std::function<void(skinning_work_item const&)> const& run);
+
+		void reset_statistics();
+	};
+}
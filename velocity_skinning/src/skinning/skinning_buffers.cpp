@@ -0,0 +1,172 @@
+#include "skinning_buffers.hpp"
+
+#include <utility>
+
+namespace cgp
+{
+	size_t skinning_buffers::number_vertex() const
+	{
+		return position_rest_pose.size();
+	}
+
+	template <typename T>
+	static array_view<T const> const_view(array_view<T> const& a)
+	{
+		return array_view<T const>(a.data, a.count);
+	}
+
+	skinning_vertex_view skinning_buffers::view()
+	{
+		skinning_vertex_view v;
+		v.position_rest_pose = const_view(position_rest_pose);
+		v.normal_rest_pose = const_view(normal_rest_pose);
+		v.position_skinned = position_skinned;
+		v.normal_skinned = normal_skinned;
+		v.influence_offset = const_view(influence_offset);
+		v.influence_joint = const_view(influence_joint);
+		v.influence_weight = const_view(influence_weight);
+		v.influence_velocity_weight = const_view(influence_velocity_weight);
+		return v;
+	}
+
+	void skinning_buffers::swap(skinning_buffers& other)
+	{
+		arena.swap(other.arena);
+		std::swap(position_rest_pose, other.position_rest_pose);
+		std::swap(normal_rest_pose, other.normal_rest_pose);
+		std::swap(position_skinned, other.position_skinned);
+		std::swap(normal_skinned, other.normal_skinned);
+		std::swap(influence_offset, other.influence_offset);
+		std::swap(influence_joint, other.influence_joint);
+		std::swap(influence_weight, other.influence_weight);
+		std::swap(influence_velocity_weight, other.influence_velocity_weight);
+	}
+
+	bool build_skinning_buffers(skinning_buffers& buffers,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		huge_page_mode mode)
+	{
+		size_t const N_vertex = position_rest_pose.size();
+		assert_cgp(normal_rest_pose.size()==N_vertex && rig.joint.size()==N_vertex, "Incoherent size of skinning data");
+		bool const has_velocity = velocity_rig.joint.size() > 0;
+
+		size_t N_influence = 0;
+		for (size_t i = 0; i < N_vertex; ++i) {
+			N_influence += rig.joint[i].size();
+			assert_cgp(!has_velocity || velocity_rig.joint[i].size()==rig.joint[i].size(), "The velocity rig must have the same joints as the rig");
+		}
+
+		// Size of the block, with the padding of each section
+		size_t const alignment = 64;
+		size_t const sections[8][2] = {
+			{ N_vertex, sizeof(vec3) }, { N_vertex, sizeof(vec3) }, { N_vertex, sizeof(vec3) }, { N_vertex, sizeof(vec3) },
+			{ N_vertex + 1, sizeof(unsigned int) }, { N_influence, sizeof(int) }, { N_influence, sizeof(float) }, { N_influence, sizeof(float) } };
+		size_t size = 0;
+		for (auto const& section : sections)
+			size = memory_arena::aligned_offset(size, alignment) + section[0] * section[1];
+
+		if (!buffers.arena.reserve(size, mode))
+			return false;
+
+		buffers.position_rest_pose = buffers.arena.allocate<vec3>(N_vertex, alignment);
+		buffers.normal_rest_pose = buffers.arena.allocate<vec3>(N_vertex, alignment);
+		buffers.position_skinned = buffers.arena.allocate<vec3>(N_vertex, alignment);
+		buffers.normal_skinned = buffers.arena.allocate<vec3>(N_vertex, alignment);
+		buffers.influence_offset = buffers.arena.allocate<unsigned int>(N_vertex + 1, alignment);
+		buffers.influence_joint = buffers.arena.allocate<int>(N_influence, alignment);
+		buffers.influence_weight = buffers.arena.allocate<float>(N_influence, alignment);
+		buffers.influence_velocity_weight = buffers.arena.allocate<float>(N_influence, alignment);
+
+		size_t k = 0;
+		for (size_t i = 0; i < N_vertex; ++i) {
+			buffers.position_rest_pose[i] = position_rest_pose[i];
+			buffers.normal_rest_pose[i] = normal_rest_pose[i];
+			buffers.position_skinned[i] = position_rest_pose[i];
+			buffers.normal_skinned[i] = normal_rest_pose[i];
+
+			buffers.influence_offset[i] = (unsigned int)k;
+			for (size_t j = 0; j < rig.joint[i].size(); ++j, ++k) {
+				buffers.influence_joint[k] = rig.joint[i][j];
+				buffers.influence_weight[k] = rig.weight[i][j];
+				buffers.influence_velocity_weight[k] = has_velocity ? velocity_rig.weight[i][j] : 0.0f;
+			}
+		}
+		buffers.influence_offset[N_vertex] = (unsigned int)k;
+
+		return true;
+	}
+
+	void velocity_skinning_vertices(
+		size_t begin,
+		size_t end,
+		skinning_buffers& buffers,
+		numarray<affine_rt> const& skeleton_current,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		packed_vertex_buffer* packed_output
+	)
+	{
+		velocity_skinning_vertices(begin, end, buffers.view(), skeleton_current, frame, linear_deformation_intensity, rotational_deformation_intensity, packed_output);
+	}
+
+	void velocity_skinning_vertices(
+		size_t begin,
+		size_t end,
+		skinning_vertex_view const& buffers,
+		numarray<affine_rt> const& skeleton_current,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		packed_vertex_buffer* packed_output
+	)
+	{
+		array_view<unsigned int const> const offset = buffers.influence_offset;
+		array_view<int const> const joint = buffers.influence_joint;
+		array_view<float const> const weight = buffers.influence_weight;
+		array_view<float const> const velocity_weight = buffers.influence_velocity_weight;
+
+		for (size_t i = begin; i < end; i++) {
+			unsigned int const k_begin = offset[i];
+			unsigned int const k_end = offset[i + 1];
+
+			// LBS
+			mat4 M = mat4::build_zero();
+			for (unsigned int k = k_begin; k < k_end; ++k)
+				M += weight[k] * frame.palette[joint[k]];
+
+			vec3 position = M * buffers.position_rest_pose[i];
+			vec3 const normal = M * buffers.normal_rest_pose[i];
+			buffers.normal_skinned[i] = normal;
+
+			if (frame.velocity_enabled) {
+				// linear velocity skinning
+				vec3 deformation = vec3(0, 0, 0);
+				for (unsigned int k = k_begin; k < k_end; ++k)
+					deformation += velocity_weight[k] * frame.blended_velocity[joint[k]];
+				position -= deformation * linear_deformation_intensity;
+
+				// rotational velocity skinning
+				deformation = vec3(0, 0, 0);
+				for (unsigned int k = k_begin; k < k_end; ++k) {
+					float const theta = frame.rotation_angle[joint[k]];
+					if (theta == 0.0f) continue;
+					vec3 const& axis = frame.rotation_axis[joint[k]];
+					vec3 const& center = skeleton_current[joint[k]].translation;
+
+					vec3 const p_proj = center + dot(position - center, axis) * axis;
+					float const angle = norm(cross(axis, position - p_proj) * theta) * 5;
+					deformation += rotation_offset(axis, angle, position - center, frame.fast_rotation_angle) * velocity_weight[k];
+				}
+				position -= deformation * rotational_deformation_intensity;
+			}
+
+			buffers.position_skinned[i] = position;
+			if (packed_output != nullptr)
+				packed_output->write(i, position, normal);
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+#include "../memory/memory_arena.hpp"
+
+
+namespace cgp
+{
+	// Per-vertex inputs and outputs of the skinning seen through views.
+	//  influence_offset holds indices into the influence arrays: a view starting at a given vertex still points to the full influence arrays.
+	struct skinning_vertex_view
+	{
+		array_view<vec3 const> position_rest_pose;
+		array_view<vec3 const> normal_rest_pose;
+		array_view<vec3> position_skinned;
+		array_view<vec3> normal_skinned;
+
+		array_view<unsigned int const> influence_offset; // influences of vertex i are in [influence_offset[i], influence_offset[i+1][
+		array_view<int const> influence_joint;
+		array_view<float const> influence_weight;
+		array_view<float const> influence_velocity_weight;
+	};
+
+	// Per-vertex skinning data of one character placed contiguously in a single arena (64-byte aligned sections).
+	//  Both rigs are stored in compressed sparse rows (CSR) sharing the same joint indices.
+	struct skinning_buffers
+	{
+		memory_arena arena;
+
+		array_view<vec3> position_rest_pose;
+		array_view<vec3> normal_rest_pose;
+		array_view<vec3> position_skinned;
+		array_view<vec3> normal_skinned;
+
+		array_view<unsigned int> influence_offset; // influences of vertex i are in [influence_offset[i], influence_offset[i+1][
+		array_view<int> influence_joint;
+		array_view<float> influence_weight;
+		array_view<float> influence_velocity_weight;
+
+		size_t number_vertex() const;
+		skinning_vertex_view view();
+		void swap(skinning_buffers& other); // exchange the arenas with their views (buffers built on another thread are taken without copy)
+	};
+
+	// velocity_rig must have the same joints as rig (as built by init_velocity_skinning_weights), or be empty
+	bool build_skinning_buffers(skinning_buffers& buffers,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		huge_page_mode mode = huge_page_mode::none);
+
+	// Same as velocity_skinning_vertices, reading and writing views instead of numarray (packed_output must already have the size of the mesh)
+	void velocity_skinning_vertices(
+		size_t begin,
+		size_t end,
+		skinning_vertex_view const& view,
+		numarray<affine_rt> const& skeleton_current,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		packed_vertex_buffer* packed_output = nullptr
+	);
+	void velocity_skinning_vertices(
+		size_t begin,
+		size_t end,
+		skinning_buffers& buffers,
+		numarray<affine_rt> const& skeleton_current,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		packed_vertex_buffer* packed_output = nullptr
+	);
+}
@@ -0,0 +1,376 @@
+#include "skinning_fuzz.hpp"
+
+#include "skinning_buffers.hpp"
+#include "batched_skinning.hpp"
+#include "rig_optimization.hpp"
+#include "../scheduler/task_graph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+namespace cgp
+{
+	static float random_uniform(std::mt19937& generator, float a, float b)
+	{
+		return std::uniform_real_distribution<float>(a, b)(generator);
+	}
+
+	static int random_int(std::mt19937& generator, int a, int b)
+	{
+		return std::uniform_int_distribution<int>(a, b)(generator);
+	}
+
+	static vec3 random_direction(std::mt19937& generator)
+	{
+		vec3 d;
+		do {
+			d = { random_uniform(generator, -1, 1), random_uniform(generator, -1, 1), random_uniform(generator, -1, 1) };
+		} while (norm(d) < 0.1f || norm(d) > 1.0f);
+		return normalize(d);
+	}
+
+	static rotation_transform random_rotation(std::mt19937& generator, float max_angle)
+	{
+		return rotation_transform::from_axis_angle(random_direction(generator), random_uniform(generator, -max_angle, max_angle));
+	}
+
+	void generate_skinning_fuzz_case(skinning_fuzz_case& fuzz_case, unsigned int seed, skinning_fuzz_parameters const& parameters)
+	{
+		std::mt19937 generator(seed);
+		fuzz_case.seed = seed;
+		skeleton_animation_structure& skeleton = fuzz_case.skeleton;
+		skeleton = skeleton_animation_structure();
+
+		// Random tree: the parent is the previous joint (long chains) with a probability drawn per case, any previous joint otherwise (branching)
+		int const N_joint = random_int(generator, 2, std::max(parameters.max_joint, 2));
+		float const chain_probability = random_uniform(generator, 0.0f, 1.0f);
+		skeleton.parent_index.resize(N_joint);
+		skeleton.rest_pose_local.resize(N_joint);
+		skeleton.parent_index[0] = -1;
+		skeleton.rest_pose_local[0] = affine_rt(random_rotation(generator, 3.14f), { 0,0,0 });
+		for (int k = 1; k < N_joint; ++k) {
+			skeleton.parent_index[k] = random_uniform(generator, 0, 1) < chain_probability ? k - 1 : random_int(generator, 0, k - 1);
+			skeleton.rest_pose_local[k] = affine_rt(random_rotation(generator, 0.5f), random_uniform(generator, 0.2f, 0.4f) * random_direction(generator));
+		}
+
+		// Keyframes: rotation of every joint around its rest pose, and translation of the root
+		int const N_key = std::max(parameters.number_keyframe, 2);
+		float const duration = 0.5f * parameters.number_frame * parameters.dt;
+		skeleton.animation_time.resize(N_key);
+		skeleton.animation_geometry_local.resize(N_key);
+		for (int kt = 0; kt < N_key; ++kt) {
+			skeleton.animation_time[kt] = duration * kt / (N_key - 1);
+			numarray<affine_rt>& pose = skeleton.animation_geometry_local[kt];
+			pose.resize(N_joint);
+			for (int k = 0; k < N_joint; ++k) {
+				pose[k] = skeleton.rest_pose_local[k];
+				pose[k].rotation = skeleton.rest_pose_local[k].rotation * random_rotation(generator, 1.2f);
+			}
+			pose[0].translation += random_uniform(generator, 0.0f, 0.5f) * random_direction(generator);
+		}
+		fuzz_case.skeleton_rest_pose = skeleton.rest_pose_global();
+
+		// Vertices around a joint, influenced by this joint, its parent and random other joints
+		int const N_vertex = std::max(parameters.number_vertex, 1);
+		fuzz_case.position_rest_pose.resize(N_vertex);
+		fuzz_case.normal_rest_pose.resize(N_vertex);
+		fuzz_case.rig.joint.resize(N_vertex);
+		fuzz_case.rig.weight.resize(N_vertex);
+		for (int i = 0; i < N_vertex; ++i) {
+			int const joint = random_int(generator, 0, N_joint - 1);
+			fuzz_case.position_rest_pose[i] = fuzz_case.skeleton_rest_pose[joint].translation + random_uniform(generator, 0.0f, 0.3f) * random_direction(generator);
+			fuzz_case.normal_rest_pose[i] = random_direction(generator);
+
+			int const N_influence = std::min(random_int(generator, 1, std::max(parameters.max_influence, 1)), N_joint);
+			numarray<int>& influence = fuzz_case.rig.joint[i];
+			influence.clear();
+			influence.push_back(joint);
+			if (N_influence > 1 && skeleton.parent_index[joint] != -1)
+				influence.push_back(skeleton.parent_index[joint]);
+			while (int(influence.size()) < N_influence) {
+				int const other = random_int(generator, 0, N_joint - 1);
+				if (std::find(influence.begin(), influence.end(), other) == influence.end())
+					influence.push_back(other);
+			}
+
+			fuzz_case.rig.weight[i].resize(influence.size());
+			for (float& w : fuzz_case.rig.weight[i])
+				w = random_uniform(generator, 0.05f, 1.0f);
+		}
+		normalize_weights(fuzz_case.rig.weight);
+		init_velocity_skinning_weights(fuzz_case.velocity_rig, fuzz_case.rig, skeleton.parent_index);
+
+		// Rig reduced as by the rig optimizer of the scene (the candidates build their data, e.g. the sparse weights, from the reduced rig)
+		if (parameters.optimized_max_influence > 0) {
+			rig_optimization_parameters optimization;
+			optimization.max_influence = parameters.optimized_max_influence;
+			optimization.speed_blending = parameters.speed_blending;
+			optimization.linear_deformation_intensity = parameters.linear_deformation_intensity;
+			optimization.rotational_deformation_intensity = parameters.rotational_deformation_intensity;
+			optimize_rig(fuzz_case.rig, fuzz_case.velocity_rig, skeleton, fuzz_case.position_rest_pose, fuzz_case.normal_rest_pose, optimization);
+		}
+	}
+
+	float check_velocity_skinning_weights(skinning_fuzz_case const& fuzz_case)
+	{
+		numarray<int> const& parent_index = fuzz_case.skeleton.parent_index;
+		rig_structure const& rig = fuzz_case.rig;
+		float max_difference = 0.0f;
+
+		numarray<float> weight;
+		for (size_t i = 0; i < rig.joint.size(); ++i) {
+			// The weight of an influence is added to all its ancestors influencing the vertex (itself included)
+			weight.resize(rig.joint[i].size());
+			weight.fill(0.0f);
+			for (size_t k = 0; k < rig.joint[i].size(); ++k) {
+				for (int joint = rig.joint[i][k]; joint != -1; joint = parent_index[joint]) {
+					for (size_t m = 0; m < rig.joint[i].size(); ++m)
+						if (rig.joint[i][m] == joint)
+							weight[m] += rig.weight[i][k];
+				}
+			}
+
+			if (fuzz_case.velocity_rig.weight[i].size() != weight.size())
+				return 1e30f;
+			for (size_t m = 0; m < weight.size(); ++m)
+				max_difference = std::max(max_difference, std::abs(weight[m] - fuzz_case.velocity_rig.weight[i][m]));
+		}
+		return max_difference;
+	}
+
+
+	struct velocity_state
+	{
+		numarray<affine_rt> old_joint_rt;
+		numarray<vec3> old_velocity;
+		velocity_skinning_frame frame;
+	};
+
+	static skinning_frame_function create_reference(skinning_fuzz_case const& fuzz_case, skinning_fuzz_parameters const& parameters, float fast_rotation_angle)
+	{
+		std::shared_ptr<velocity_state> state = std::make_shared<velocity_state>();
+		return [&fuzz_case, parameters, fast_rotation_angle, state](numarray<affine_rt> const& skeleton_current, numarray<vec3>& position, numarray<vec3>& normal) {
+			velocity_skinning_compute(position, normal, skeleton_current, fuzz_case.skeleton_rest_pose,
+				fuzz_case.position_rest_pose, fuzz_case.normal_rest_pose, fuzz_case.rig, fuzz_case.velocity_rig,
+				state->old_joint_rt, state->old_velocity, parameters.dt,
+				parameters.speed_blending, parameters.linear_deformation_intensity, parameters.rotational_deformation_intensity,
+				nullptr, fast_rotation_angle);
+		};
+	}
+
+	static skinning_frame_function create_arena(skinning_fuzz_case const& fuzz_case, skinning_fuzz_parameters const& parameters)
+	{
+		struct arena_state : velocity_state
+		{
+			skinning_buffers buffers;
+		};
+		std::shared_ptr<arena_state> state = std::make_shared<arena_state>();
+		build_skinning_buffers(state->buffers, fuzz_case.position_rest_pose, fuzz_case.normal_rest_pose, fuzz_case.rig, fuzz_case.velocity_rig);
+
+		return [&fuzz_case, parameters, state](numarray<affine_rt> const& skeleton_current, numarray<vec3>& position, numarray<vec3>& normal) {
+			skinning_buffers& buffers = state->buffers;
+			velocity_skinning_prepare(state->frame, skeleton_current, fuzz_case.skeleton_rest_pose, fuzz_case.velocity_rig,
+				state->old_joint_rt, state->old_velocity, parameters.dt, parameters.speed_blending);
+			velocity_skinning_vertices(0, buffers.number_vertex(), buffers, skeleton_current, state->frame,
+				parameters.linear_deformation_intensity, parameters.rotational_deformation_intensity);
+			velocity_skinning_finish(state->frame, skeleton_current, state->old_joint_rt, state->old_velocity, parameters.speed_blending);
+
+			position.resize(buffers.number_vertex());
+			normal.resize(buffers.number_vertex());
+			std::copy(buffers.position_skinned.begin(), buffers.position_skinned.end(), position.begin());
+			std::copy(buffers.normal_skinned.begin(), buffers.normal_skinned.end(), normal.begin());
+		};
+	}
+
+	static skinning_frame_function create_task_chunks(skinning_fuzz_case const& fuzz_case, skinning_fuzz_parameters const& parameters)
+	{
+		struct chunk_state : velocity_state
+		{
+			task_scheduler scheduler;
+			task_graph graph;
+		};
+		std::shared_ptr<chunk_state> state = std::make_shared<chunk_state>();
+		state->scheduler.initialize(4);
+
+		return [&fuzz_case, parameters, state](numarray<affine_rt> const& skeleton_current, numarray<vec3>& position, numarray<vec3>& normal) {
+			size_t const N_vertex = fuzz_case.position_rest_pose.size();
+			size_t const chunk_size = 37; // not a multiple of anything, so that the last chunk is partial
+			position.resize(N_vertex);
+			normal.resize(N_vertex);
+
+			velocity_skinning_prepare(state->frame, skeleton_current, fuzz_case.skeleton_rest_pose, fuzz_case.velocity_rig,
+				state->old_joint_rt, state->old_velocity, parameters.dt, parameters.speed_blending);
+			state->graph.clear();
+			for (size_t begin = 0; begin < N_vertex; begin += chunk_size) {
+				size_t const end = std::min(begin + chunk_size, N_vertex);
+				state->graph.add("vertices", [&fuzz_case, &parameters, &state, &skeleton_current, &position, &normal, begin, end]() {
+					velocity_skinning_vertices(begin, end, position, normal, skeleton_current,
+						fuzz_case.position_rest_pose, fuzz_case.normal_rest_pose, fuzz_case.rig, fuzz_case.velocity_rig, state->frame,
+						parameters.linear_deformation_intensity, parameters.rotational_deformation_intensity);
+				});
+			}
+			state->scheduler.run(state->graph);
+			velocity_skinning_finish(state->frame, skeleton_current, state->old_joint_rt, state->old_velocity, parameters.speed_blending);
+		};
+	}
+
+	// Instances of an asset made of the case, skinned together by batched_skinning: more instances than a group of SIMD lanes, so that the last group
+	//  is partial. The instances evaluate their pose at the time of the frame, as the harness does, and each frame returns the output of the next instance.
+	static skinning_frame_function create_batched(skinning_fuzz_case const& fuzz_case, skinning_fuzz_parameters const& parameters)
+	{
+		struct batched_state
+		{
+			batched_skinning engine;
+			numarray<character_instance> instance;
+			numarray<batched_instance_update> updates;
+			int frame = 0;
+		};
+		std::shared_ptr<skinning_content> content = std::make_shared<skinning_content>();
+		content->skeleton = fuzz_case.skeleton;
+		content->skeleton_rest_pose = fuzz_case.skeleton_rest_pose;
+		content->rig = fuzz_case.rig;
+		content->velocity_rig = fuzz_case.velocity_rig;
+		content->position_rest_pose = fuzz_case.position_rest_pose;
+		content->normal_rest_pose = fuzz_case.normal_rest_pose;
+		build_sparse_weight_matrix(content->weights, content->rig, content->skeleton_rest_pose.size());
+
+		std::shared_ptr<batched_state> state = std::make_shared<batched_state>();
+		size_t const N_instance = 6;
+		state->engine.set_asset(content);
+		state->instance.resize(N_instance);
+		state->updates.resize(N_instance);
+		for (size_t k = 0; k < N_instance; ++k) {
+			state->instance[k].set_asset(content);
+			state->updates[k].instance = &state->instance[k];
+			state->updates[k].dt = parameters.dt;
+		}
+
+		return [parameters, state](numarray<affine_rt> const&, numarray<vec3>& position, numarray<vec3>& normal) {
+			numarray<float> const& animation_time = state->engine.asset->skeleton.animation_time;
+			float const t = std::fmod(state->frame * parameters.dt, animation_time[animation_time.size() - 1]);
+			state->engine.update(state->updates, t, parameters.speed_blending, parameters.linear_deformation_intensity, parameters.rotational_deformation_intensity);
+
+			character_instance const& instance = state->instance[size_t(state->frame) % state->instance.size()];
+			position = instance.position_skinned;
+			normal = instance.normal_skinned;
+			state->frame++;
+		};
+	}
+
+	skinning_candidate default_skinning_reference()
+	{
+		skinning_candidate reference;
+		reference.name = "velocity_skinning_compute";
+		reference.create = [](skinning_fuzz_case const& fuzz_case, skinning_fuzz_parameters const& parameters) {
+			return create_reference(fuzz_case, parameters, 0.0f);
+		};
+		return reference;
+	}
+
+	numarray<skinning_candidate> default_skinning_candidates()
+	{
+		numarray<skinning_candidate> candidates;
+
+		skinning_candidate fast_rotation;
+		fast_rotation.name = "fast rotation (0.5 rad)";
+		fast_rotation.create = [](skinning_fuzz_case const& fuzz_case, skinning_fuzz_parameters const& parameters) {
+			return create_reference(fuzz_case, parameters, 0.5f);
+		};
+		candidates.push_back(fast_rotation);
+
+		skinning_candidate arena;
+		arena.name = "arena CSR buffers";
+		arena.create = create_arena;
+		candidates.push_back(arena);
+
+		skinning_candidate chunks;
+		chunks.name = "task scheduler chunks";
+		chunks.create = create_task_chunks;
+		candidates.push_back(chunks);
+
+		skinning_candidate batched;
+		batched.name = "batched instances";
+		batched.create = create_batched;
+		candidates.push_back(batched);
+
+		return candidates;
+	}
+
+	numarray<skinning_fuzz_report> run_skinning_fuzz(skinning_candidate const& reference, numarray<skinning_candidate> const& candidates,
+		unsigned int first_seed, int number_case, skinning_fuzz_parameters const& parameters)
+	{
+		size_t const N_candidate = candidates.size();
+		numarray<skinning_fuzz_report> report(N_candidate + 1);
+		for (size_t c = 0; c < N_candidate; ++c)
+			report[c].candidate = candidates[c].name;
+		skinning_fuzz_report& weights_report = report[N_candidate];
+		weights_report.candidate = "velocity weights (ancestors)";
+
+		skinning_fuzz_case fuzz_case;
+		numarray<affine_rt> skeleton_local, skeleton_current;
+		numarray<vec3> position_reference, normal_reference;
+		numarray<numarray<vec3> > position(N_candidate), normal(N_candidate);
+		numarray<skinning_frame_function> candidate_frame(N_candidate);
+
+		for (int k_case = 0; k_case < number_case; ++k_case) {
+			unsigned int const seed = first_seed + unsigned(k_case);
+			generate_skinning_fuzz_case(fuzz_case, seed, parameters);
+
+			if (!weights_report.diverged) {
+				float const difference = check_velocity_skinning_weights(fuzz_case);
+				weights_report.case_run++;
+				weights_report.max_error = std::max(weights_report.max_error, difference);
+				if (difference > parameters.tolerance) {
+					weights_report.diverged = true;
+					weights_report.seed = seed;
+					weights_report.error = difference;
+				}
+			}
+
+			skinning_frame_function reference_frame = reference.create(fuzz_case, parameters);
+			for (size_t c = 0; c < N_candidate; ++c) {
+				candidate_frame[c] = report[c].diverged ? skinning_frame_function() : candidates[c].create(fuzz_case, parameters);
+				if (!report[c].diverged)
+					report[c].case_run++;
+				position[c] = fuzz_case.position_rest_pose;
+				normal[c] = fuzz_case.normal_rest_pose;
+			}
+			position_reference = fuzz_case.position_rest_pose;
+			normal_reference = fuzz_case.normal_rest_pose;
+
+			float const duration = fuzz_case.skeleton.animation_time[fuzz_case.skeleton.animation_time.size() - 1];
+			for (int frame = 0; frame < parameters.number_frame; ++frame) {
+				// The animation loops: the jump back to the first keyframe is part of the test
+				float const t = std::fmod(frame * parameters.dt, duration);
+				fuzz_case.skeleton.evaluate_local(t, skeleton_local);
+				skeleton_local_to_global(skeleton_local, fuzz_case.skeleton.parent_index, skeleton_current);
+
+				reference_frame(skeleton_current, position_reference, normal_reference);
+				for (size_t c = 0; c < N_candidate; ++c) {
+					skinning_fuzz_report& r = report[c];
+					if (r.diverged)
+						continue;
+					candidate_frame[c](skeleton_current, position[c], normal[c]);
+
+					for (size_t i = 0; i < position_reference.size() && !r.diverged; ++i) {
+						float const error_position = norm(position[c][i] - position_reference[i]);
+						float const error_normal = norm(normal[c][i] - normal_reference[i]);
+						float const error = std::max(error_position, error_normal);
+						r.max_error = std::max(r.max_error, error);
+						if (error > parameters.tolerance) {
+							r.diverged = true;
+							r.seed = seed;
+							r.frame = frame;
+							r.vertex = int(i);
+							r.normal = error_normal > error_position;
+							r.error = error;
+						}
+					}
+				}
+			}
+		}
+		return report;
+	}
+}
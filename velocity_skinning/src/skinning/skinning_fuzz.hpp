@@ -0,0 +1,78 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+#include "../skeleton/skeleton.hpp"
+
+#include <functional>
+#include <string>
+
+
+namespace cgp
+{
+	struct skinning_fuzz_parameters
+	{
+		int max_joint = 32;           // joints of a skeleton in [2, max_joint]
+		int max_influence = 4;        // joints influencing a vertex in [1, max_influence]
+		int number_vertex = 400;
+		int number_frame = 300;       // frames run for each case
+		int number_keyframe = 6;      // keyframes of the random animation
+		float dt = 1.0f / 60.0f;
+		float speed_blending = 0.9f;
+		float linear_deformation_intensity = 0.1f;
+		float rotational_deformation_intensity = 1.0f;
+		float tolerance = 1e-4f;      // distance between positions (or normals) above which a candidate diverges
+		int optimized_max_influence = 0; // > 0: the rig of each case is reduced by optimize_rig to this number of influences
+	};
+
+	// Random character: skeleton (random tree, random depth and branching), animation, rig and rest pose
+	struct skinning_fuzz_case
+	{
+		unsigned int seed = 0;
+		skeleton_animation_structure skeleton;
+		numarray<affine_rt> skeleton_rest_pose;
+		rig_structure rig;
+		rig_structure velocity_rig;
+		numarray<vec3> position_rest_pose;
+		numarray<vec3> normal_rest_pose;
+	};
+	void generate_skinning_fuzz_case(skinning_fuzz_case& fuzz_case, unsigned int seed, skinning_fuzz_parameters const& parameters);
+
+	// One frame of a skinning implementation. It keeps its own velocity state from one call to the next.
+	typedef std::function<void(numarray<affine_rt> const& skeleton_current, numarray<vec3>& position, numarray<vec3>& normal)> skinning_frame_function;
+
+	// Implementation compared to the reference: create() returns the frame function of a case
+	struct skinning_candidate
+	{
+		std::string name;
+		std::function<skinning_frame_function(skinning_fuzz_case const&, skinning_fuzz_parameters const&)> create;
+	};
+	// velocity_skinning_compute
+	skinning_candidate default_skinning_reference();
+	// Fast rotation, CSR arena, chunks run on a task scheduler, batched instances
+	numarray<skinning_candidate> default_skinning_candidates();
+
+	struct skinning_fuzz_report
+	{
+		std::string candidate;
+		size_t case_run = 0;
+		float max_error = 0.0f;       // over all the cases, until the first divergence
+
+		// First divergence, if any
+		bool diverged = false;
+		unsigned int seed = 0;
+		int frame = -1;
+		int vertex = -1;
+		bool normal = false;          // the divergence is on the normal (otherwise on the position)
+		float error = 0.0f;
+	};
+
+	// velocity weights rebuilt from the ancestors of each influence, compared to init_velocity_skinning_weights.
+	//  Returns the largest difference of weight.
+	float check_velocity_skinning_weights(skinning_fuzz_case const& fuzz_case);
+
+	// Run the reference and every candidate side by side on the cases [first_seed, first_seed + number_case[
+	//  The run of a candidate stops at its first divergence.
+	numarray<skinning_fuzz_report> run_skinning_fuzz(skinning_candidate const& reference, numarray<skinning_candidate> const& candidates,
+		unsigned int first_seed, int number_case, skinning_fuzz_parameters const& parameters);
+}
@@ -0,0 +1,159 @@
+#include "skinning_lod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace cgp
+{
+	size_t skinning_lod::number_level() const
+	{
+		return level.size() + 1;
+	}
+
+	int skinning_lod::select_level(float distance) const
+	{
+		if (distance_step <= 0.0f)
+			return 0;
+		int const k = int(distance / distance_step);
+		return std::min(std::max(k, 0), int(level.size()));
+	}
+
+	memory_usage memory_usage_of(skinning_lod const& lod)
+	{
+		memory_usage usage = memory_usage_of(lod.level);
+		for (skinning_lod_level const& level : lod.level)
+			usage += memory_usage_of(level.sample) + memory_usage_of(level.source_offset) + memory_usage_of(level.source) + memory_usage_of(level.source_weight);
+		return usage;
+	}
+
+	static int64_t cell_key(int x, int y, int z)
+	{
+		// 21 bits per coordinate
+		return (int64_t(x & 0x1fffff) << 42) | (int64_t(y & 0x1fffff) << 21) | int64_t(z & 0x1fffff);
+	}
+
+	static void build_level(skinning_lod_level& level, numarray<vec3> const& position, vec3 const& p_min, float cell, int neighbor)
+	{
+		size_t const N_vertex = position.size();
+		numarray<int> cx(N_vertex), cy(N_vertex), cz(N_vertex);
+		for (size_t i = 0; i < N_vertex; ++i) {
+			vec3 const c = (position[i] - p_min) / cell;
+			cx[i] = int(std::floor(c.x)); cy[i] = int(std::floor(c.y)); cz[i] = int(std::floor(c.z));
+		}
+
+		// One sample per cell: the first vertex found in it
+		std::unordered_map<int64_t, int> cell_sample; // index in level.sample
+		level.sample.clear();
+		for (size_t i = 0; i < N_vertex; ++i) {
+			if (cell_sample.insert({ cell_key(cx[i], cy[i], cz[i]), int(level.sample.size()) }).second)
+				level.sample.push_back(int(i));
+		}
+
+		// Inverse distance weights of the nearest samples in the neighboring cells. Each vertex has at least the sample of its own cell.
+		numarray<int> sample_index(N_vertex);
+		sample_index.fill(-1);
+		for (size_t k = 0; k < level.sample.size(); ++k)
+			sample_index[level.sample[k]] = int(k);
+
+		level.source_offset.resize(N_vertex + 1);
+		level.source.clear();
+		level.source_weight.clear();
+		std::vector<std::pair<float, int> > candidate;
+		for (size_t i = 0; i < N_vertex; ++i) {
+			level.source_offset[i] = (unsigned int)level.source.size();
+			if (sample_index[i] != -1) {
+				level.source.push_back(sample_index[i]);
+				level.source_weight.push_back(1.0f);
+				continue;
+			}
+
+			candidate.clear();
+			for (int dx = -1; dx <= 1; ++dx) {
+				for (int dy = -1; dy <= 1; ++dy) {
+					for (int dz = -1; dz <= 1; ++dz) {
+						auto const it = cell_sample.find(cell_key(cx[i] + dx, cy[i] + dy, cz[i] + dz));
+						if (it == cell_sample.end())
+							continue;
+						int const k = it->second;
+						candidate.push_back({ norm(position[level.sample[k]] - position[i]), k });
+					}
+				}
+			}
+			size_t const N_source = std::min(candidate.size(), size_t(std::max(neighbor, 1)));
+			std::partial_sort(candidate.begin(), candidate.begin() + N_source, candidate.end());
+
+			float weight_sum = 0.0f;
+			for (size_t k = 0; k < N_source; ++k)
+				weight_sum += 1.0f / (candidate[k].first + 1e-6f);
+			for (size_t k = 0; k < N_source; ++k) {
+				level.source.push_back(candidate[k].second);
+				level.source_weight.push_back(1.0f / (candidate[k].first + 1e-6f) / weight_sum);
+			}
+		}
+		level.source_offset[N_vertex] = (unsigned int)level.source.size();
+	}
+
+	void build_skinning_lod(skinning_lod& lod, numarray<vec3> const& position_rest_pose, skinning_lod_parameters const& parameters)
+	{
+		lod.level.clear();
+		lod.distance_step = parameters.distance_step;
+		size_t const N_vertex = position_rest_pose.size();
+		if (N_vertex == 0)
+			return;
+
+		vec3 p_min = position_rest_pose[0], p_max = position_rest_pose[0];
+		for (vec3 const& p : position_rest_pose) {
+			p_min = { std::min(p_min.x, p.x), std::min(p_min.y, p.y), std::min(p_min.z, p.z) };
+			p_max = { std::max(p_max.x, p.x), std::max(p_max.y, p.y), std::max(p_max.z, p.z) };
+		}
+		float cell = std::max(norm(p_max - p_min), 1e-6f) * parameters.cell_size_ratio;
+
+		lod.level.resize(size_t(std::max(parameters.number_level, 0)));
+		for (skinning_lod_level& level : lod.level) {
+			build_level(level, position_rest_pose, p_min, cell, parameters.neighbor);
+			cell *= 2.0f;
+		}
+	}
+
+	void velocity_skinning_vertices_lod(
+		skinning_lod const& lod,
+		int level_index,
+		numarray<vec3>& position_skinned,
+		numarray<vec3>& normal_skinned,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		numarray<vec3>& sample_deformation
+	)
+	{
+		assert_cgp(level_index >= 1 && level_index <= int(lod.level.size()), "Incorrect level of detail");
+		skinning_lod_level const& level = lod.level[level_index - 1];
+		size_t const N_vertex = position_rest_pose.size();
+
+		linear_blend_skinning_vertices(0, N_vertex, position_skinned, normal_skinned, position_rest_pose, normal_rest_pose, rig, frame);
+		if (!frame.velocity_enabled)
+			return;
+
+		size_t const N_sample = level.sample.size();
+		sample_deformation.resize(N_sample);
+		for (size_t k = 0; k < N_sample; ++k) {
+			int const i = level.sample[k];
+			vec3 p = position_skinned[i];
+			velocity_skinning_deform_vertex(i, p, skeleton_current, velocity_rig, frame, linear_deformation_intensity, rotational_deformation_intensity);
+			sample_deformation[k] = p - position_skinned[i];
+		}
+
+		for (size_t i = 0; i < N_vertex; ++i) {
+			vec3 deformation = { 0,0,0 };
+			for (unsigned int k = level.source_offset[i]; k < level.source_offset[i + 1]; ++k)
+				deformation += level.source_weight[k] * sample_deformation[level.source[k]];
+			position_skinned[i] += deformation;
+		}
+	}
+}
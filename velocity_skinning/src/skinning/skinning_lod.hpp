@@ -0,0 +1,66 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+
+
+namespace cgp
+{
+	struct skinning_lod_parameters
+	{
+		int number_level = 3;            // levels in addition to the full resolution one
+		float cell_size_ratio = 1/64.0f; // sampling cell of the first level, relative to the diagonal of the mesh. Doubled at each level
+		int neighbor = 4;                // samples used to interpolate the deformation of a vertex
+		float distance_step = 4.0f;      // camera distance covered by each level
+	};
+
+	// Level of detail of the velocity deformation: it is only computed on a sparse subset of the vertices (one per cell of a grid),
+	//  and spread to every vertex with precomputed interpolation weights. The LBS part stays at full resolution.
+	struct skinning_lod_level
+	{
+		numarray<int> sample;                  // vertices where the velocity deformation is computed
+		numarray<unsigned int> source_offset;  // samples of vertex i are in [source_offset[i], source_offset[i+1][
+		numarray<int> source;                  // index in sample
+		numarray<float> source_weight;
+	};
+
+	struct skinning_lod
+	{
+		numarray<skinning_lod_level> level; // level[0] is the first reduced level (the full resolution has no data)
+		float distance_step = 4.0f;
+
+		size_t number_level() const; // including the full resolution
+		int select_level(float distance) const;
+	};
+
+	memory_usage memory_usage_of(skinning_lod const& lod);
+
+	void build_skinning_lod(skinning_lod& lod, numarray<vec3> const& position_rest_pose, skinning_lod_parameters const& parameters);
+
+	// velocity_skinning_vertices on all the vertices, for a reduced level (level_index >= 1)
+	//  sample_deformation is a buffer reused from one call to the next
+	void velocity_skinning_vertices_lod(
+		skinning_lod const& lod,
+		int level_index,
+		numarray<vec3>& position_skinned,
+		numarray<vec3>& normal_skinned,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		numarray<vec3>& sample_deformation
+	);
+
+	// Cost and deviation of a level with respect to the full resolution, over an animation
+	struct skinning_lod_measure
+	{
+		size_t sample = 0;
+		double ms_per_frame = 0.0;
+		float max_error = 0.0f;
+		float mean_error = 0.0f;
+	};
+}
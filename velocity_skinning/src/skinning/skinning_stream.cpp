@@ -0,0 +1,267 @@
+#include "skinning_stream.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace cgp
+{
+	static char const skinning_stream_magic[8] = { 'V','S','M','E','S','H','0','1' };
+	static size_t const skinning_stream_alignment = 64;
+
+	// Header of the file, followed by the sections (each aligned on 64 bytes):
+	//  position, normal (vec3) | influence offset (uint32, N_vertex+1) | joint (int32) | weight, velocity weight (float)
+	struct skinning_stream_header
+	{
+		char magic[8];
+		uint64_t vertex_count;
+		uint64_t influence_count;
+		uint64_t section_offset[6];
+	};
+
+	static void write_padding(std::ofstream& stream)
+	{
+		static char const zeros[skinning_stream_alignment] = {};
+		size_t const position = size_t(stream.tellp());
+		size_t const padding = memory_arena::aligned_offset(position, skinning_stream_alignment) - position;
+		stream.write(zeros, padding);
+	}
+
+	bool write_skinning_stream(std::string const& filename,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig)
+	{
+		size_t const N_vertex = position_rest_pose.size();
+		assert_cgp(normal_rest_pose.size()==N_vertex && rig.joint.size()==N_vertex, "Incoherent size of skinning data");
+		bool const has_velocity = velocity_rig.joint.size() > 0;
+
+		std::ofstream stream(filename, std::ios::binary);
+		if (!stream.is_open())
+			return false;
+
+		skinning_stream_header header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, skinning_stream_magic, sizeof(header.magic));
+		header.vertex_count = N_vertex;
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+		write_padding(stream);
+		header.section_offset[0] = uint64_t(stream.tellp());
+		stream.write(reinterpret_cast<char const*>(position_rest_pose.data.data()), N_vertex * sizeof(vec3));
+
+		write_padding(stream);
+		header.section_offset[1] = uint64_t(stream.tellp());
+		stream.write(reinterpret_cast<char const*>(normal_rest_pose.data.data()), N_vertex * sizeof(vec3));
+
+		write_padding(stream);
+		header.section_offset[2] = uint64_t(stream.tellp());
+		uint32_t offset = 0;
+		for (size_t i = 0; i < N_vertex; ++i) {
+			assert_cgp(!has_velocity || velocity_rig.joint[i].size()==rig.joint[i].size(), "The velocity rig must have the same joints as the rig");
+			stream.write(reinterpret_cast<char const*>(&offset), sizeof(offset));
+			offset += uint32_t(rig.joint[i].size());
+		}
+		stream.write(reinterpret_cast<char const*>(&offset), sizeof(offset));
+		header.influence_count = offset;
+
+		write_padding(stream);
+		header.section_offset[3] = uint64_t(stream.tellp());
+		for (size_t i = 0; i < N_vertex; ++i)
+			stream.write(reinterpret_cast<char const*>(rig.joint[i].data.data()), rig.joint[i].size() * sizeof(int));
+
+		write_padding(stream);
+		header.section_offset[4] = uint64_t(stream.tellp());
+		for (size_t i = 0; i < N_vertex; ++i)
+			stream.write(reinterpret_cast<char const*>(rig.weight[i].data.data()), rig.weight[i].size() * sizeof(float));
+
+		write_padding(stream);
+		header.section_offset[5] = uint64_t(stream.tellp());
+		for (size_t i = 0; i < N_vertex; ++i) {
+			if (has_velocity)
+				stream.write(reinterpret_cast<char const*>(velocity_rig.weight[i].data.data()), velocity_rig.weight[i].size() * sizeof(float));
+			else
+				for (size_t j = 0; j < rig.joint[i].size(); ++j) {
+					float const zero = 0.0f;
+					stream.write(reinterpret_cast<char const*>(&zero), sizeof(zero));
+				}
+		}
+
+		stream.seekp(0);
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		return bool(stream);
+	}
+
+
+	bool skinning_stream::open(std::string const& filename)
+	{
+		close();
+		if (!file.open(filename))
+			return false;
+
+		skinning_stream_header header;
+		if (file.size() < sizeof(header)) {
+			close();
+			return false;
+		}
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, skinning_stream_magic, sizeof(header.magic)) != 0) {
+			close();
+			return false;
+		}
+
+		// Every section must be aligned and inside the file (the counts are bounded first, so that N_vertex+1 can't wrap around)
+		uint64_t const V = header.vertex_count;
+		uint64_t const I = header.influence_count;
+		if (V > file.size() || I > file.size()) {
+			close();
+			return false;
+		}
+		section* sections[6] = { &position, &normal, &influence_offset, &influence_joint, &influence_weight, &influence_velocity_weight };
+		size_t const element_size[6] = { sizeof(vec3), sizeof(vec3), sizeof(uint32_t), sizeof(int32_t), sizeof(float), sizeof(float) };
+		uint64_t const element_count[6] = { V, V, V + 1, I, I, I };
+		for (int k = 0; k < 6; ++k) {
+			if (header.section_offset[k] % skinning_stream_alignment != 0 || !file.contains(header.section_offset[k], element_count[k], element_size[k])) {
+				close();
+				return false;
+			}
+			sections[k]->offset = size_t(header.section_offset[k]);
+			sections[k]->element_size = element_size[k];
+		}
+		N_vertex = size_t(header.vertex_count);
+		N_influence = size_t(header.influence_count);
+
+		// compute reads the influences of vertex i in [offset[i], offset[i+1][
+		uint32_t const* offset = section_data<uint32_t>(influence_offset);
+		bool valid = offset[0] == 0 && offset[N_vertex] == N_influence;
+		for (size_t i = 0; i < N_vertex && valid; ++i)
+			valid = offset[i] <= offset[i + 1];
+		int32_t const* joint = section_data<int32_t>(influence_joint);
+		for (size_t k = 0; k < N_influence && valid; ++k) {
+			valid = joint[k] >= 0;
+			joint_max = std::max(joint_max, int(joint[k]));
+		}
+		if (!valid) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void skinning_stream::close()
+	{
+		file.close();
+		N_vertex = 0;
+		N_influence = 0;
+		joint_max = -1;
+		chunk_position.clear();
+		chunk_normal.clear();
+	}
+
+	bool skinning_stream::is_open() const
+	{
+		return file.is_open();
+	}
+
+	size_t skinning_stream::number_vertex() const
+	{
+		return N_vertex;
+	}
+
+	size_t skinning_stream::number_influence() const
+	{
+		return N_influence;
+	}
+
+	int skinning_stream::max_joint() const
+	{
+		return joint_max;
+	}
+
+	template <typename T> T const* skinning_stream::section_data(section const& s) const
+	{
+		return reinterpret_cast<T const*>(file.data() + s.offset);
+	}
+
+	void skinning_stream::advise_chunk(size_t begin, size_t end, bool will_need) const
+	{
+		uint32_t const* offset = section_data<uint32_t>(influence_offset);
+		size_t const influence_begin = offset[begin];
+		size_t const influence_end = offset[end];
+
+		struct range { section const* s; size_t begin, end; };
+		range const ranges[6] = {
+			{ &position, begin, end }, { &normal, begin, end }, { &influence_offset, begin, end + 1 },
+			{ &influence_joint, influence_begin, influence_end }, { &influence_weight, influence_begin, influence_end },
+			{ &influence_velocity_weight, influence_begin, influence_end } };
+		for (range const& r : ranges) {
+			size_t const offset_bytes = r.s->offset + r.begin * r.s->element_size;
+			size_t const length = (r.end - r.begin) * r.s->element_size;
+			if (will_need)
+				file.advise_will_need(offset_bytes, length);
+			else
+				file.advise_dont_need(offset_bytes, length);
+		}
+	}
+
+	void skinning_stream::compute(numarray<affine_rt> const& skeleton_current,
+		velocity_skinning_frame const& frame,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity,
+		skinning_stream_output const& output)
+	{
+		assert_cgp(is_open(), "Skinning stream not opened");
+		assert_cgp(joint_max < int(skeleton_current.size()), "The skinning stream has joints out of the skeleton");
+		size_t const chunk = std::max(chunk_size, size_t(1));
+		chunk_position.resize(chunk);
+		chunk_normal.resize(chunk);
+
+		vec3 const* position_rest_pose = section_data<vec3>(position);
+		vec3 const* normal_rest_pose = section_data<vec3>(normal);
+		unsigned int const* offset = section_data<unsigned int>(influence_offset);
+
+		skinning_vertex_view view;
+		view.influence_joint = array_view<int const>(section_data<int>(influence_joint), N_influence);
+		view.influence_weight = array_view<float const>(section_data<float>(influence_weight), N_influence);
+		view.influence_velocity_weight = array_view<float const>(section_data<float>(influence_velocity_weight), N_influence);
+		view.position_skinned = array_view<vec3>(chunk_position.data.data(), chunk);
+		view.normal_skinned = array_view<vec3>(chunk_normal.data.data(), chunk);
+
+		if (read_ahead && N_vertex > 0)
+			advise_chunk(0, std::min(chunk, N_vertex), true);
+
+		for (size_t begin = 0; begin < N_vertex; begin += chunk) {
+			size_t const end = std::min(begin + chunk, N_vertex);
+			if (read_ahead && end < N_vertex)
+				advise_chunk(end, std::min(end + chunk, N_vertex), true);
+
+			// Views starting at the chunk, the influence arrays are indexed by the absolute offsets
+			view.position_rest_pose = array_view<vec3 const>(position_rest_pose + begin, end - begin);
+			view.normal_rest_pose = array_view<vec3 const>(normal_rest_pose + begin, end - begin);
+			view.influence_offset = array_view<unsigned int const>(offset + begin, end - begin + 1);
+			velocity_skinning_vertices(0, end - begin, view, skeleton_current, frame, linear_deformation_intensity, rotational_deformation_intensity);
+
+			output(begin, end, chunk_position.data.data(), chunk_normal.data.data());
+			advise_chunk(begin, end, false);
+		}
+	}
+
+	size_t skinning_stream::chunk_memory_size() const
+	{
+		size_t const influence_per_vertex = N_vertex > 0 ? (N_influence + N_vertex - 1) / N_vertex : 0;
+		size_t const per_vertex = 4 * sizeof(vec3) + sizeof(uint32_t) + influence_per_vertex * (sizeof(int32_t) + 2 * sizeof(float));
+		return chunk_size * per_vertex;
+	}
+
+	skinning_stream_output skinning_stream_file_output(std::ofstream& stream)
+	{
+		return [&stream](size_t begin, size_t end, vec3 const* position, vec3 const* normal) {
+			for (size_t k = 0; k < end - begin; ++k) {
+				stream.write(reinterpret_cast<char const*>(&position[k]), sizeof(vec3));
+				stream.write(reinterpret_cast<char const*>(&normal[k]), sizeof(vec3));
+			}
+		};
+	}
+}
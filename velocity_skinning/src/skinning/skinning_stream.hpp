@@ -0,0 +1,78 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+#include "skinning_buffers.hpp"
+#include "../memory/mapped_file.hpp"
+
+#include <fstream>
+#include <functional>
+#include <string>
+
+
+namespace cgp
+{
+	// Write the rest pose and both rigs (CSR, same layout as skinning_buffers) in a file that can be skinned without loading it
+	//  velocity_rig must have the same joints as rig, or be empty
+	bool write_skinning_stream(std::string const& filename,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig);
+
+	// Receives the skinned vertices [begin,end[ of a chunk. The arrays are only valid during the call.
+	using skinning_stream_output = std::function<void(size_t begin, size_t end, vec3 const* position, vec3 const* normal)>;
+
+	// Memory-mapped mesh written by write_skinning_stream
+	struct skinning_stream
+	{
+		size_t chunk_size = 65536; // vertices skinned per chunk
+		bool read_ahead = true;    // ask the system to load the next chunk while the current one is skinned
+
+		// Return false if the file is truncated or its sections are inconsistent (bounds, alignment, influence offsets, joints)
+		bool open(std::string const& filename);
+		void close();
+		bool is_open() const;
+
+		size_t number_vertex() const;
+		size_t number_influence() const;
+		int max_joint() const; // largest joint index of the influences, -1 without influence
+
+		// Skin all the vertices chunk by chunk with the per-joint quantities of frame (see velocity_skinning_prepare).
+		//  The pages of the chunks already skinned are released: the resident memory is bounded by a few chunks.
+		void compute(numarray<affine_rt> const& skeleton_current,
+			velocity_skinning_frame const& frame,
+			float const linear_deformation_intensity,
+			float const rotational_deformation_intensity,
+			skinning_stream_output const& output);
+
+		// Bytes of the chunk buffers (outputs) and of the mapped data touched by one chunk
+		size_t chunk_memory_size() const;
+
+	private:
+		struct section
+		{
+			size_t offset = 0;
+			size_t element_size = 0;
+		};
+		void advise_chunk(size_t begin, size_t end, bool will_need) const;
+		template <typename T> T const* section_data(section const& s) const;
+
+		mapped_file file;
+		size_t N_vertex = 0;
+		size_t N_influence = 0;
+		int joint_max = -1;
+		section position;
+		section normal;
+		section influence_offset;
+		section influence_joint;
+		section influence_weight;
+		section influence_velocity_weight;
+
+		numarray<vec3> chunk_position;
+		numarray<vec3> chunk_normal;
+	};
+
+	// Output appending the skinned positions and normals (interleaved, float) to a binary file
+	skinning_stream_output skinning_stream_file_output(std::ofstream& stream);
+}
@@ -0,0 +1,108 @@
+#include "skinning_thread.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace cgp
+{
+	skinning_worker::~skinning_worker()
+	{
+		stop();
+	}
+
+	void skinning_worker::start()
+	{
+		if (is_running())
+			return;
+		running.store(true);
+		thread = std::thread(&skinning_worker::loop, this);
+	}
+
+	void skinning_worker::stop()
+	{
+		running.store(false);
+		if (thread.joinable())
+			thread.join();
+	}
+
+	bool skinning_worker::is_running() const
+	{
+		return thread.joinable();
+	}
+
+	void skinning_worker::publish_input(skinning_worker_input const& value)
+	{
+		input.write_buffer() = value;
+		input.publish();
+	}
+
+	void skinning_worker::publish_content(std::shared_ptr<skinning_content const> const& value)
+	{
+		content.write_buffer() = value;
+		content.publish();
+	}
+
+	skinning_worker_output const* skinning_worker::receive()
+	{
+		if (!output.update())
+			return nullptr;
+		return &output.read_buffer();
+	}
+
+	void skinning_worker::loop()
+	{
+		std::shared_ptr<skinning_content const> current;
+		numarray<affine_rt> skeleton_local;
+		numarray<affine_rt> old_joint_rt;
+		numarray<vec3> old_velocity;
+		velocity_skinning_frame frame;
+		float previous_t = 0.0f;
+		size_t step = 0;
+
+		std::chrono::duration<double> const period(1.0 / double(rate));
+		auto next_step = std::chrono::steady_clock::now();
+
+		while (running.load()) {
+			// Steps that could not be run in time are dropped
+			next_step = std::max(next_step + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period), std::chrono::steady_clock::now());
+			std::this_thread::sleep_until(next_step);
+
+			if (content.update()) {
+				current = content.read_buffer();
+				old_joint_rt.clear();
+				old_velocity.clear();
+			}
+			input.update();
+			skinning_worker_input const& in = input.read_buffer();
+			if (current == nullptr)
+				continue;
+
+			// The time comes from the GUI timeline: paused -> no step, looped back -> one regular step
+			float dt = in.t - previous_t;
+			if (dt == 0.0f && old_joint_rt.size() > 0)
+				continue;
+			if (dt <= 0.0f)
+				dt = 1.0f / rate;
+			previous_t = in.t;
+
+			skinning_worker_output& out = output.write_buffer();
+			size_t const N_vertex = current->position_rest_pose.size();
+			out.content = current;
+			out.position.resize(N_vertex);
+			out.normal.resize(N_vertex);
+
+			current->skeleton.evaluate_local(in.t, skeleton_local);
+			skeleton_local_to_global(skeleton_local, current->skeleton.parent_index, out.skeleton);
+
+			velocity_skinning_prepare(frame, out.skeleton, current->skeleton_rest_pose, current->velocity_rig,
+				old_joint_rt, old_velocity, dt, in.speed_blending, in.fast_rotation_angle);
+			velocity_skinning_vertices(0, N_vertex, out.position, out.normal, out.skeleton,
+				current->position_rest_pose, current->normal_rest_pose, current->rig, current->velocity_rig, frame,
+				in.linear_deformation_intensity, in.rotational_deformation_intensity);
+			velocity_skinning_finish(frame, out.skeleton, old_joint_rt, old_velocity, in.speed_blending);
+
+			out.step = ++step;
+			output.publish();
+		}
+	}
+}
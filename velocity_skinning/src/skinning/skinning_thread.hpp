@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+#include "skinned_asset.hpp"
+#include "../skeleton/skeleton.hpp"
+#include "../scheduler/triple_buffer.hpp"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+
+namespace cgp
+{
+	// Parameters and timeline sent by the GUI every frame
+	struct skinning_worker_input
+	{
+		float t = 0.0f;
+		float speed_blending = 0.9f;
+		float linear_deformation_intensity = 0.1f;
+		float rotational_deformation_intensity = 1.0f;
+		float fast_rotation_angle = 0.0f;
+	};
+
+	struct skinning_worker_output
+	{
+		std::shared_ptr<skinning_content const> content; // content used for this result
+		numarray<affine_rt> skeleton;
+		numarray<vec3> position;
+		numarray<vec3> normal;
+		size_t step = 0;
+	};
+
+	// Velocity skinning run on its own thread at a fixed rate.
+	//  Inputs, content and results go through triple buffers: the skinning thread never waits for the GUI and conversely.
+	struct skinning_worker
+	{
+		float rate = 120.0f; // skinning steps per second (set before start)
+
+		skinning_worker() = default;
+		skinning_worker(skinning_worker const&) = delete;
+		skinning_worker& operator=(skinning_worker const&) = delete;
+		~skinning_worker();
+
+		void start();
+		void stop();
+		bool is_running() const;
+
+		// Called by the GUI/render thread
+		void publish_input(skinning_worker_input const& value);
+		void publish_content(std::shared_ptr<skinning_content const> const& value); // the velocity state is reset
+		skinning_worker_output const* receive(); // last result if a new one is available, nullptr otherwise
+
+	private:
+		void loop();
+
+		triple_buffer<skinning_worker_input> input;
+		triple_buffer<std::shared_ptr<skinning_content const> > content;
+		triple_buffer<skinning_worker_output> output;
+
+		std::thread thread;
+		std::atomic<bool> running{ false };
+	};
+}
@@ -0,0 +1,33 @@
+#include "sparse_weight_matrix.hpp"
+
+namespace cgp
+{
+	void build_sparse_weight_matrix(sparse_weight_matrix& W, rig_structure const& rig, size_t N_joint)
+	{
+		size_t const N_vertex = rig.joint.size();
+		size_t N_influence = 0;
+		for (size_t i = 0; i < N_vertex; ++i)
+			N_influence += rig.joint[i].size();
+
+		W.number_row = N_vertex;
+		W.number_column = N_joint;
+		W.row_offset.resize(N_vertex + 1);
+		W.column.resize(N_influence);
+		W.value.resize(N_influence);
+		size_t k = 0;
+		for (size_t i = 0; i < N_vertex; ++i) {
+			W.row_offset[i] = static_cast<unsigned int>(k);
+			for (size_t j = 0; j < rig.joint[i].size(); ++j, ++k) {
+				assert_cgp(rig.joint[i][j] >= 0 && size_t(rig.joint[i][j]) < N_joint, "Joint index out of the skeleton");
+				W.column[k] = rig.joint[i][j];
+				W.value[k] = rig.weight[i][j];
+			}
+		}
+		W.row_offset[N_vertex] = static_cast<unsigned int>(k);
+	}
+
+	memory_usage memory_usage_of(sparse_weight_matrix const& W)
+	{
+		return memory_usage_of(W.row_offset) + memory_usage_of(W.column) + memory_usage_of(W.value);
+	}
+}
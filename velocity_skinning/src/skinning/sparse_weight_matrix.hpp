@@ -0,0 +1,20 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "skinning.hpp"
+
+
+namespace cgp
+{
+	// Skinning weights of a rig as a sparse matrix W of N_vertex rows and N_joint columns, in compressed sparse rows
+	struct sparse_weight_matrix
+	{
+		size_t number_row = 0;
+		size_t number_column = 0;
+		numarray<unsigned int> row_offset; // non-zeros of row i are in [row_offset[i], row_offset[i+1][
+		numarray<int> column;
+		numarray<float> value;
+	};
+	void build_sparse_weight_matrix(sparse_weight_matrix& W, rig_structure const& rig, size_t N_joint);
+	memory_usage memory_usage_of(sparse_weight_matrix const& W);
+}
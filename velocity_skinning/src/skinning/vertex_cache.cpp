@@ -0,0 +1,554 @@
+#include "vertex_cache.hpp"
+#include "../simd/simd_float4.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace cgp
+{
+	static char const vertex_cache_magic[8] = { 'V','S','C','A','C','H','E','1' };
+
+	struct vertex_cache_header
+	{
+		char magic[8];
+		uint64_t vertex_count;
+		uint64_t frame_count;
+		uint64_t block_count;
+		uint64_t byte_count;
+		int32_t frames_per_chunk;
+		int32_t vertices_per_block;
+		int32_t position_bits;
+		int32_t normal_bits;
+	};
+
+	static uint32_t zigzag(int32_t value)
+	{
+		return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+	}
+
+	static int32_t unzigzag(uint32_t value)
+	{
+		return int32_t(value >> 1) ^ -int32_t(value & 1);
+	}
+
+	static int bit_width(uint32_t value)
+	{
+		int width = 0;
+		for (; value != 0; value >>= 1)
+			++width;
+		return width;
+	}
+
+	// Values by groups of 32: the width in bits of the largest zigzag value, then the values packed on this width
+	//  (residuals of a smooth motion are mostly 0 and +-1: 2 bits instead of a byte)
+	static void write_packed(std::vector<unsigned char>& out, int32_t const* value, size_t count)
+	{
+		uint32_t group[32];
+		for (size_t g = 0; g < count; g += 32) {
+			size_t const n = std::min(size_t(32), count - g);
+			uint32_t all = 0;
+			for (size_t j = 0; j < n; ++j) {
+				group[j] = zigzag(value[g + j]);
+				all |= group[j];
+			}
+			int const width = bit_width(all);
+			out.push_back((unsigned char)width);
+
+			uint64_t bits = 0;
+			int N_bits = 0;
+			for (size_t j = 0; j < n; ++j) {
+				bits |= uint64_t(group[j]) << N_bits;
+				N_bits += width;
+				for (; N_bits >= 8; N_bits -= 8, bits >>= 8)
+					out.push_back((unsigned char)(bits & 0xff));
+			}
+			if (N_bits > 0)
+				out.push_back((unsigned char)(bits & 0xff));
+		}
+	}
+
+	// Reads 0 past the end of the block (corrupted data)
+	static void read_packed(unsigned char const*& p, unsigned char const* end, int32_t* value, size_t count)
+	{
+		for (size_t g = 0; g < count; g += 32) {
+			size_t const n = std::min(size_t(32), count - g);
+			int const width = p < end ? std::min(int(*p++), 32) : 0;
+			if (width == 0) {
+				std::fill(value + g, value + g + n, 0);
+				continue;
+			}
+			uint64_t const mask = (uint64_t(1) << width) - 1;
+
+			uint64_t bits = 0;
+			int N_bits = 0;
+			for (size_t j = 0; j < n; ++j) {
+				for (; N_bits < width; N_bits += 8)
+					bits |= uint64_t(p < end ? *p++ : 0) << N_bits;
+				value[g + j] = unzigzag(uint32_t(bits & mask));
+				bits >>= width;
+				N_bits -= width;
+			}
+		}
+	}
+
+	static float sign_not_zero(float x)
+	{
+		return x >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// Octahedral coordinates in [-M,M] (same mapping as pack_normal_octahedral, with a configurable precision)
+	static void encode_octahedral(vec3 const& n, int32_t M, int32_t& qx, int32_t& qy)
+	{
+		float const s = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		float x = s > 1e-20f ? n.x / s : 0.0f;
+		float y = s > 1e-20f ? n.y / s : 0.0f;
+		if (s > 1e-20f && n.z < 0) {
+			float const fold_x = (1.0f - std::abs(y)) * sign_not_zero(x);
+			float const fold_y = (1.0f - std::abs(x)) * sign_not_zero(y);
+			x = fold_x;
+			y = fold_y;
+		}
+		qx = int32_t(std::lround(x * M));
+		qy = int32_t(std::lround(y * M));
+	}
+
+	static vec3 decode_octahedral(int32_t qx, int32_t qy, float inverse_M)
+	{
+		float const x = qx * inverse_M;
+		float const y = qy * inverse_M;
+		vec3 n = { x, y, 1.0f - std::abs(x) - std::abs(y) };
+		if (n.z < 0) {
+			n.x = (1.0f - std::abs(y)) * sign_not_zero(x);
+			n.y = (1.0f - std::abs(x)) * sign_not_zero(y);
+		}
+		return normalize(n);
+	}
+
+	static int32_t normal_range(vertex_cache_parameters const& parameters)
+	{
+		int const bits = std::min(std::max(parameters.normal_bits, 4), 16);
+		return (int32_t(1) << (bits - 1)) - 1;
+	}
+
+	size_t vertex_cache::number_block_per_chunk() const
+	{
+		size_t const B = size_t(std::max(parameters.vertices_per_block, 1));
+		return (number_vertex + B - 1) / B;
+	}
+
+	size_t vertex_cache::raw_bytes() const
+	{
+		return number_frame * number_vertex * 2 * sizeof(vec3);
+	}
+
+	size_t vertex_cache::compressed_bytes() const
+	{
+		return bytes.size() + block.size() * sizeof(vertex_cache_block);
+	}
+
+
+	void vertex_cache_encoder::begin(vertex_cache& cache_arg, size_t N_vertex, vertex_cache_parameters const& parameters)
+	{
+		cache = &cache_arg;
+		cache->parameters = parameters;
+		cache->parameters.frames_per_chunk = std::max(parameters.frames_per_chunk, 1);
+		cache->parameters.vertices_per_block = std::max(parameters.vertices_per_block, 1);
+		cache->parameters.position_bits = std::min(std::max(parameters.position_bits, 4), 24);
+		cache->parameters.normal_bits = std::min(std::max(parameters.normal_bits, 4), 16);
+		cache->number_vertex = N_vertex;
+		cache->number_frame = 0;
+		cache->block.clear();
+		cache->bytes.clear();
+
+		chunk_position.resize(N_vertex * cache->parameters.frames_per_chunk);
+		chunk_normal.resize(N_vertex * cache->parameters.frames_per_chunk);
+		chunk_frame = 0;
+	}
+
+	void vertex_cache_encoder::add_frame(numarray<vec3> const& position, numarray<vec3> const& normal)
+	{
+		assert_cgp(cache != nullptr, "vertex_cache_encoder::begin must be called first");
+		size_t const N = cache->number_vertex;
+		assert_cgp(position.size() == N && normal.size() == N, "Incoherent size of the frame added to the vertex cache");
+
+		std::copy(position.begin(), position.end(), chunk_position.begin() + chunk_frame * N);
+		std::copy(normal.begin(), normal.end(), chunk_normal.begin() + chunk_frame * N);
+		chunk_frame++;
+		cache->number_frame++;
+		if (chunk_frame == size_t(cache->parameters.frames_per_chunk))
+			encode_chunk();
+	}
+
+	void vertex_cache_encoder::finish()
+	{
+		if (cache != nullptr && chunk_frame > 0)
+			encode_chunk();
+		chunk_position.clear();
+		chunk_normal.clear();
+		cache = nullptr;
+	}
+
+	void vertex_cache_encoder::encode_chunk()
+	{
+		vertex_cache_parameters const& parameters = cache->parameters;
+		size_t const N = cache->number_vertex;
+		size_t const F = chunk_frame;
+		size_t const B = size_t(parameters.vertices_per_block);
+		int32_t const Q = (int32_t(1) << parameters.position_bits) - 1;
+		int32_t const M = normal_range(parameters);
+
+		std::vector<unsigned char> out;
+		std::vector<int32_t> qp, qpp, qn, residual;
+		for (size_t first = 0; first < N; first += B) {
+			size_t const count = std::min(B, N - first);
+
+			vertex_cache_block block;
+			block.first_frame = uint32_t(cache->number_frame - F);
+			block.frame_count = uint32_t(F);
+			block.first_vertex = uint32_t(first);
+			block.vertex_count = uint32_t(count);
+
+			vec3 p_min = chunk_position[first];
+			vec3 p_max = p_min;
+			for (size_t f = 0; f < F; ++f) {
+				for (size_t i = first; i < first + count; ++i) {
+					vec3 const& p = chunk_position[f * N + i];
+					for (int c = 0; c < 3; ++c) {
+						p_min[c] = std::min(p_min[c], p[c]);
+						p_max[c] = std::max(p_max[c], p[c]);
+					}
+				}
+			}
+			block.position_min = p_min;
+			for (int c = 0; c < 3; ++c)
+				block.position_step[c] = p_max[c] > p_min[c] ? (p_max[c] - p_min[c]) / Q : 1.0f;
+
+			out.clear();
+			qp.assign(3 * count, 0);
+			qpp.assign(3 * count, 0);
+			qn.assign(2 * count, 0);
+			residual.resize(5 * count);
+			for (size_t f = 0; f < F; ++f) {
+				// One stream of residuals per coordinate: x, y, z, then the two octahedral coordinates
+				for (size_t i = 0; i < count; ++i) {
+					vec3 const& p = chunk_position[f * N + first + i];
+					for (int c = 0; c < 3; ++c) {
+						size_t const k = 3 * i + c;
+						int32_t const q = std::min(std::max(int32_t(std::lround((p[c] - p_min[c]) / block.position_step[c])), 0), Q);
+						int32_t prediction;
+						if (f == 0) prediction = i == 0 ? 0 : qp[k - 3];
+						else if (f == 1) prediction = qp[k];
+						else prediction = 2 * qp[k] - qpp[k];
+						residual[c * count + i] = q - prediction;
+						qpp[k] = f == 0 ? q : qp[k];
+						qp[k] = q;
+					}
+
+					int32_t o[2];
+					encode_octahedral(chunk_normal[f * N + first + i], M, o[0], o[1]);
+					for (int c = 0; c < 2; ++c) {
+						size_t const k = 2 * i + c;
+						int32_t const prediction = f == 0 ? (i == 0 ? 0 : qn[k - 2]) : qn[k];
+						residual[(3 + c) * count + i] = o[c] - prediction;
+						qn[k] = o[c];
+					}
+				}
+				write_packed(out, residual.data(), residual.size());
+			}
+
+			block.offset = cache->bytes.size();
+			block.size = out.size();
+			cache->bytes.data.insert(cache->bytes.data.end(), out.begin(), out.end());
+			cache->block.push_back(block);
+		}
+		chunk_frame = 0;
+	}
+
+
+	bool write_vertex_cache(std::string const& filename, vertex_cache const& cache)
+	{
+		std::ofstream stream(filename, std::ios::binary);
+		if (!stream.is_open())
+			return false;
+
+		vertex_cache_header header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, vertex_cache_magic, sizeof(header.magic));
+		header.vertex_count = cache.number_vertex;
+		header.frame_count = cache.number_frame;
+		header.block_count = cache.block.size();
+		header.byte_count = cache.bytes.size();
+		header.frames_per_chunk = cache.parameters.frames_per_chunk;
+		header.vertices_per_block = cache.parameters.vertices_per_block;
+		header.position_bits = cache.parameters.position_bits;
+		header.normal_bits = cache.parameters.normal_bits;
+
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<char const*>(cache.block.data.data()), cache.block.size() * sizeof(vertex_cache_block));
+		stream.write(reinterpret_cast<char const*>(cache.bytes.data.data()), cache.bytes.size());
+		return bool(stream);
+	}
+
+	// Bytes written by write_packed for one frame of the blocks of a chunk: at least the width of each group,
+	//  at most 32 bits per value on top of it
+	static void packed_frame_bytes(size_t N_vertex, size_t vertices_per_block, size_t& min_bytes, size_t& max_bytes)
+	{
+		size_t const N_full = N_vertex / vertices_per_block;
+		size_t const last = N_vertex % vertices_per_block;
+		min_bytes = N_full * ((5 * vertices_per_block + 31) / 32) + (5 * last + 31) / 32;
+		max_bytes = min_bytes + 20 * N_vertex;
+	}
+
+	bool read_vertex_cache(std::string const& filename, vertex_cache& cache)
+	{
+		std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+		if (!stream.is_open())
+			return false;
+		std::streamoff const file_size = stream.tellg();
+		if (file_size < std::streamoff(sizeof(vertex_cache_header)))
+			return false;
+		stream.seekg(0);
+
+		vertex_cache_header header;
+		stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!stream || std::memcmp(header.magic, vertex_cache_magic, sizeof(header.magic)) != 0)
+			return false;
+		if (header.frames_per_chunk < 1 || header.vertices_per_block < 1 || header.position_bits < 4 || header.position_bits > 24
+			|| header.normal_bits < 4 || header.normal_bits > 16)
+			return false;
+
+		// The block table and the bytes are the rest of the file, checked before anything is allocated
+		uint64_t const remaining = uint64_t(file_size) - sizeof(header);
+		if (header.block_count > remaining / sizeof(vertex_cache_block) || header.byte_count != remaining - header.block_count * sizeof(vertex_cache_block))
+			return false;
+
+		// Each frame of each block takes from one byte per group of 32 values to 33 bits per value: the counts must fit the bytes
+		uint64_t const N_vertex = header.vertex_count;
+		uint64_t const N_frame = header.frame_count;
+		if (N_frame > 0) {
+			if (N_vertex == 0 || N_vertex > header.byte_count * 32 / 5)
+				return false;
+			size_t min_bytes, max_bytes;
+			packed_frame_bytes(size_t(N_vertex), size_t(header.vertices_per_block), min_bytes, max_bytes);
+			if (N_frame > header.byte_count / min_bytes || (header.byte_count + max_bytes - 1) / max_bytes > N_frame)
+				return false;
+		}
+		else if (header.byte_count != 0)
+			return false;
+
+		cache.number_vertex = size_t(N_vertex);
+		cache.number_frame = size_t(N_frame);
+		cache.parameters.frames_per_chunk = header.frames_per_chunk;
+		cache.parameters.vertices_per_block = header.vertices_per_block;
+		cache.parameters.position_bits = header.position_bits;
+		cache.parameters.normal_bits = header.normal_bits;
+
+		size_t const N_chunk = (cache.number_frame + header.frames_per_chunk - 1) / header.frames_per_chunk;
+		if (header.block_count != N_chunk * cache.number_block_per_chunk())
+			return false;
+
+		cache.block.resize(size_t(header.block_count));
+		cache.bytes.resize(size_t(header.byte_count));
+		stream.read(reinterpret_cast<char*>(cache.block.data.data()), cache.block.size() * sizeof(vertex_cache_block));
+		stream.read(reinterpret_cast<char*>(cache.bytes.data.data()), cache.bytes.size());
+		if (!stream)
+			return false;
+
+		for (vertex_cache_block const& block : cache.block)
+			if (block.offset > cache.bytes.size() || block.size > cache.bytes.size() - block.offset || size_t(block.first_vertex) + block.vertex_count > cache.number_vertex)
+				return false;
+		return true;
+	}
+
+
+	void vertex_cache_decoder::open(vertex_cache const& cache_arg)
+	{
+		cache = &cache_arg;
+		size_t const N = cache->number_vertex;
+		q_position.resize(3 * N);
+		q_position_previous.resize(3 * N);
+		q_normal.resize(2 * N);
+		residual.resize(5 * N);
+		cursor.resize(cache->number_block_per_chunk());
+		chunk = size_t(-1);
+		decoded_frame = -1;
+
+		graph.clear();
+		for (size_t b = 0; b < cursor.size(); ++b)
+			graph.add("vertex cache block", [this, b]() { decode_block(b); });
+		scheduler.initialize(size_t(std::max(number_thread, 0)));
+	}
+
+	void vertex_cache_decoder::decode_frame(size_t frame, numarray<vec3>& position, numarray<vec3>& normal)
+	{
+		assert_cgp(cache != nullptr && frame < cache->number_frame, "Frame out of the vertex cache");
+		size_t const F = size_t(cache->parameters.frames_per_chunk);
+		size_t const frame_chunk = frame / F;
+		int const local = int(frame - frame_chunk * F);
+
+		// Restart from the key frame of the chunk
+		if (frame_chunk != chunk || local < decoded_frame) {
+			chunk = frame_chunk;
+			decoded_frame = -1;
+			for (size_t b = 0; b < cursor.size(); ++b)
+				cursor[b] = size_t(cache->block[chunk * cursor.size() + b].offset);
+		}
+
+		position.resize(cache->number_vertex);
+		normal.resize(cache->number_vertex);
+		target_frame = size_t(local);
+		target_position = &position;
+		target_normal = &normal;
+		scheduler.run(graph);
+		decoded_frame = local;
+	}
+
+	void vertex_cache_decoder::decode_block(size_t block_in_chunk)
+	{
+		vertex_cache_block const& block = cache->block[chunk * cursor.size() + block_in_chunk];
+		size_t const first = block.first_vertex;
+		size_t const count = block.vertex_count;
+		unsigned char const* p = cache->bytes.data.data() + cursor[block_in_chunk];
+		unsigned char const* const end = cache->bytes.data.data() + block.offset + block.size;
+
+		int32_t* const qp = q_position.data.data() + 3 * first;
+		int32_t* const qpp = q_position_previous.data.data() + 3 * first;
+		int32_t* const qn = q_normal.data.data() + 2 * first;
+		int32_t* const r = residual.data.data() + 5 * first;
+		for (int f = decoded_frame + 1; f <= int(target_frame); ++f) {
+			read_packed(p, end, r, 5 * count);
+			for (int c = 0; c < 3; ++c) {
+				int32_t const* rc = r + c * count;
+				if (f == 0) {
+					int32_t q = 0;
+					for (size_t i = 0; i < count; ++i) {
+						q += rc[i];
+						qp[3 * i + c] = q;
+						qpp[3 * i + c] = q;
+					}
+				}
+				else {
+					for (size_t i = 0; i < count; ++i) {
+						size_t const k = 3 * i + c;
+						int32_t const q = (f == 1 ? qp[k] : 2 * qp[k] - qpp[k]) + rc[i];
+						qpp[k] = qp[k];
+						qp[k] = q;
+					}
+				}
+			}
+			for (int c = 0; c < 2; ++c) {
+				int32_t const* rc = r + (3 + c) * count;
+				if (f == 0) {
+					int32_t q = 0;
+					for (size_t i = 0; i < count; ++i) {
+						q += rc[i];
+						qn[2 * i + c] = q;
+					}
+				}
+				else {
+					for (size_t i = 0; i < count; ++i)
+						qn[2 * i + c] += rc[i];
+				}
+			}
+		}
+		cursor[block_in_chunk] = size_t(p - cache->bytes.data.data());
+
+		// Dequantization, 4 vertices (12 floats) at a time: the offsets and steps repeat every 3 floats
+		float offset[12], step[12];
+		for (int k = 0; k < 12; ++k) {
+			offset[k] = block.position_min[k % 3];
+			step[k] = block.position_step[k % 3];
+		}
+		float4 const offset4[3] = { float4::load(offset), float4::load(offset + 4), float4::load(offset + 8) };
+		float4 const step4[3] = { float4::load(step), float4::load(step + 4), float4::load(step + 8) };
+
+		float* const out = &(*target_position)[first].x;
+		size_t const N_float = 3 * count;
+		size_t k = 0;
+		float q[12];
+		for (; k + 12 <= N_float; k += 12) {
+			for (int j = 0; j < 12; ++j)
+				q[j] = float(qp[k + j]);
+			for (int j = 0; j < 3; ++j)
+				(offset4[j] + float4::load(q + 4 * j) * step4[j]).store(out + k + 4 * j);
+		}
+		for (; k < N_float; ++k)
+			out[k] = offset[k % 3] + float(qp[k]) * step[k % 3];
+
+		float const inverse_M = 1.0f / normal_range(cache->parameters);
+		numarray<vec3>& normal = *target_normal;
+		for (size_t i = 0; i < count; ++i)
+			normal[first + i] = decode_octahedral(qn[2 * i], qn[2 * i + 1], inverse_M);
+	}
+
+
+	vertex_cache_measure measure_vertex_cache(vertex_cache_source const& source, size_t N_frame, size_t N_vertex,
+		vertex_cache_parameters const& parameters, int number_thread, vertex_cache* result)
+	{
+		vertex_cache_measure measure;
+		vertex_cache local_cache;
+		vertex_cache& cache = result != nullptr ? *result : local_cache;
+		if (N_frame == 0 || N_vertex == 0)
+			return measure;
+
+		numarray<vec3> position, normal;
+		vertex_cache_encoder encoder;
+		encoder.begin(cache, N_vertex, parameters);
+		double encode_ms = 0.0;
+		for (size_t f = 0; f < N_frame; ++f) {
+			source(f, position, normal);
+			auto const time_start = std::chrono::steady_clock::now();
+			encoder.add_frame(position, normal);
+			encode_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+		}
+		auto const time_finish = std::chrono::steady_clock::now();
+		encoder.finish();
+		encode_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_finish).count();
+
+		measure.number_frame = N_frame;
+		measure.raw_bytes = cache.raw_bytes();
+		measure.compressed_bytes = cache.compressed_bytes();
+		measure.ratio = double(measure.raw_bytes) / double(std::max(measure.compressed_bytes, size_t(1)));
+		measure.encode_ms = encode_ms;
+
+		// Sequential playback, compared to the source
+		vertex_cache_decoder decoder;
+		decoder.number_thread = number_thread;
+		decoder.open(cache);
+		numarray<vec3> decoded_position, decoded_normal;
+		for (size_t f = 0; f < N_frame; ++f) {
+			auto const time_start = std::chrono::steady_clock::now();
+			decoder.decode_frame(f, decoded_position, decoded_normal);
+			measure.decode_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+
+			source(f, position, normal);
+			for (size_t i = 0; i < N_vertex; ++i) {
+				measure.max_position_error = std::max(measure.max_position_error, norm(decoded_position[i] - position[i]));
+				float const n_ref = norm(normal[i]);
+				if (n_ref > 1e-8f) {
+					float const c = std::min(std::max(dot(decoded_normal[i], normal[i] / n_ref), -1.0f), 1.0f);
+					measure.max_normal_error = std::max(measure.max_normal_error, std::acos(c));
+				}
+			}
+		}
+		measure.decode_gb_per_s = measure.decode_ms > 0.0 ? measure.raw_bytes / (measure.decode_ms * 1e6) : 0.0;
+
+		// Random access: middle of each chunk, visited from the last chunk to the first so that every access restarts
+		size_t const F = size_t(cache.parameters.frames_per_chunk);
+		size_t const N_chunk = (N_frame + F - 1) / F;
+		size_t N_access = 0;
+		for (size_t c = N_chunk; c-- > 0;) {
+			size_t const frame = std::min(c * F + F / 2, N_frame - 1);
+			auto const time_start = std::chrono::steady_clock::now();
+			decoder.decode_frame(frame, decoded_position, decoded_normal);
+			measure.random_access_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+			N_access++;
+		}
+		measure.random_access_ms /= double(N_access);
+		return measure;
+	}
+}
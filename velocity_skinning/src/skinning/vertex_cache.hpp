@@ -0,0 +1,117 @@
+#pragma once
+
+#include "cgp/cgp.hpp"
+#include "../scheduler/task_graph.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+
+namespace cgp
+{
+	struct vertex_cache_parameters
+	{
+		int frames_per_chunk = 32;      // random access to a frame decodes at most this number of frames
+		int vertices_per_block = 16384; // the blocks of a frame are decoded in parallel
+		int position_bits = 16;         // positions quantized against the bounds of their block over the chunk
+		int normal_bits = 12;           // per octahedral coordinate
+	};
+
+	// Vertices [first_vertex, first_vertex+vertex_count[ over the frames of a chunk, decodable on their own.
+	//  Bytes, for each frame: the residuals of the x, y, z and octahedral normal coordinates, bit-packed by groups of 32.
+	//  The key frame predicts each vertex from the previous one, the other frames from the two previous frames (constant velocity).
+	struct vertex_cache_block
+	{
+		uint32_t first_frame = 0;
+		uint32_t frame_count = 0;
+		uint32_t first_vertex = 0;
+		uint32_t vertex_count = 0;
+		vec3 position_min;
+		vec3 position_step;  // position = position_min + q * position_step
+		uint64_t offset = 0; // in vertex_cache::bytes
+		uint64_t size = 0;
+	};
+
+	// Positions and normals of a sequence of frames (e.g. the output of velocity_skinning_compute).
+	//  The decoded normals are unit vectors: only the direction of the skinned normals is kept.
+	struct vertex_cache
+	{
+		vertex_cache_parameters parameters;
+		size_t number_vertex = 0;
+		size_t number_frame = 0;
+		numarray<vertex_cache_block> block; // by chunk, then by vertex
+		numarray<unsigned char> bytes;
+
+		size_t number_block_per_chunk() const;
+		size_t raw_bytes() const;        // float3 position and normal of every frame
+		size_t compressed_bytes() const; // bytes and block table
+	};
+
+	// Frames are added in order. A chunk is encoded once its last frame is added, or by finish.
+	struct vertex_cache_encoder
+	{
+		void begin(vertex_cache& cache, size_t N_vertex, vertex_cache_parameters const& parameters);
+		void add_frame(numarray<vec3> const& position, numarray<vec3> const& normal);
+		void finish();
+
+	private:
+		void encode_chunk();
+
+		vertex_cache* cache = nullptr;
+		numarray<vec3> chunk_position; // frames of the current chunk, one after the other
+		numarray<vec3> chunk_normal;
+		size_t chunk_frame = 0;
+	};
+
+	bool write_vertex_cache(std::string const& filename, vertex_cache const& cache);
+	bool read_vertex_cache(std::string const& filename, vertex_cache& cache);
+
+	// Playback of a cache. Decoding the next frame of the same chunk only reads its residuals,
+	//  any other frame restarts from the key frame of its chunk.
+	struct vertex_cache_decoder
+	{
+		int number_thread = 0; // 0: hardware concurrency
+
+		void open(vertex_cache const& cache);
+		// position and normal are resized to the number of vertices
+		void decode_frame(size_t frame, numarray<vec3>& position, numarray<vec3>& normal);
+
+	private:
+		void decode_block(size_t block_in_chunk);
+
+		vertex_cache const* cache = nullptr;
+		numarray<int32_t> q_position;          // last decoded frame, 3 per vertex
+		numarray<int32_t> q_position_previous; // the frame before
+		numarray<int32_t> q_normal;            // 2 per vertex
+		numarray<int32_t> residual;            // residuals of the frame being decoded, 5 per vertex (by block, then by coordinate)
+		numarray<size_t> cursor;               // next byte to read in each block of the chunk
+		size_t chunk = size_t(-1);
+		int decoded_frame = -1;                // last frame decoded in the chunk, relative to its first frame
+
+		size_t target_frame = 0;
+		numarray<vec3>* target_position = nullptr;
+		numarray<vec3>* target_normal = nullptr;
+		task_scheduler scheduler;
+		task_graph graph; // one task per block of a chunk
+	};
+
+	struct vertex_cache_measure
+	{
+		size_t number_frame = 0;
+		size_t raw_bytes = 0;
+		size_t compressed_bytes = 0;
+		double ratio = 0.0;
+		double encode_ms = 0.0;
+		double decode_ms = 0.0;            // sequential playback of all the frames
+		double decode_gb_per_s = 0.0;      // decoded float3 position and normal per second
+		double random_access_ms = 0.0;     // mean decoding time of a frame in the middle of a chunk, from a different chunk
+		float max_position_error = 0.0f;
+		float max_normal_error = 0.0f;     // radians
+	};
+
+	// Frame k of the sequence. Called twice for each frame (encoding, then check of the decoded frames), in order from 0.
+	using vertex_cache_source = std::function<void(size_t frame, numarray<vec3>& position, numarray<vec3>& normal)>;
+	vertex_cache_measure measure_vertex_cache(vertex_cache_source const& source, size_t N_frame, size_t N_vertex,
+		vertex_cache_parameters const& parameters, int number_thread = 0, vertex_cache* result = nullptr);
+}
@@ -0,0 +1,154 @@
+// Round trip of the packed vertex formats against the float reference:
+//  every position and normal format on random vertices, with its error bound,
+//  then the packed output written by the skinning kernels compared to packing their float output afterwards.
+
+#include "cgp/cgp.hpp"
+#include "../src/skinning/packed_vertex.hpp"
+#include "../src/skinning/skinning_buffers.hpp"
+#include "../src/loader/skinning_loader.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+using namespace cgp;
+
+static void random_vertices(numarray<vec3>& position, numarray<vec3>& normal, size_t N, unsigned int seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+	std::uniform_int_distribution<int> exponent(-12, 8);
+	position.resize(N);
+	normal.resize(N);
+	for (size_t k = 0; k < N; ++k) {
+		// Positions over several orders of magnitude, normals of any length (the formats store a direction)
+		float const scale = std::ldexp(1.0f, exponent(generator));
+		position[k] = scale * vec3(coordinate(generator), coordinate(generator), coordinate(generator));
+		normal[k] = vec3(coordinate(generator), coordinate(generator), coordinate(generator));
+	}
+	// Axes and diagonals, where the octahedral fold and the 10-bit clamp are at their limits
+	vec3 const special[] = { {1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}, {1,1,1}, {-1,-1,-1}, {1,-1,-0.5f}, {-1,1,-1e-3f} };
+	for (size_t k = 0; k < sizeof(special) / sizeof(special[0]) && k < N; ++k)
+		normal[k] = special[k];
+}
+
+// Largest deviation of each position component, relative to the half precision of that component (2^-11 of its magnitude, 2^-25 below the normal range)
+static float half_position_error(packed_vertex_buffer const& buffer, numarray<vec3> const& position)
+{
+	float error = 0.0f;
+	for (size_t k = 0; k < position.size(); ++k) {
+		vec3 const p = buffer.read_position(k);
+		for (int c = 0; c < 3; ++c) {
+			float const bound = std::max(std::abs(position[k][c]) * std::ldexp(1.0f, -11), std::ldexp(1.0f, -25));
+			error = std::max(error, std::abs(p[c] - position[k][c]) / bound);
+		}
+	}
+	return error;
+}
+
+static bool check_round_trip(size_t N, unsigned int seed)
+{
+	numarray<vec3> position, normal;
+	random_vertices(position, normal, N, seed);
+
+	// Maximal angle of each normal format: half the quantization step, amplified by the projection
+	struct normal_case { packed_normal_format format; char const* name; float max_angle; };
+	normal_case const normal_cases[2] = {
+		{ packed_normal_format::octahedral, "octahedral", 1e-4f },
+		{ packed_normal_format::int_2_10_10_10, "10-10-10-2", 2e-3f } };
+	packed_position_format const position_formats[2] = { packed_position_format::float32, packed_position_format::float16 };
+
+	bool success = true;
+	for (packed_position_format const position_format : position_formats) {
+		for (normal_case const& c : normal_cases) {
+			packed_vertex_buffer buffer;
+			buffer.layout = build_packed_vertex_layout(position_format, c.format);
+			pack_vertices(buffer, position, normal);
+			packed_vertex_error const error = packed_vertex_max_error(buffer, position, normal);
+
+			bool const half = position_format == packed_position_format::float16;
+			size_t const stride = half ? 12 : 16;
+			float const position_error = half ? half_position_error(buffer, position) : error.position;
+			bool const valid = buffer.layout.stride == stride && buffer.size() == N
+				&& (half ? position_error <= 1.0f : position_error == 0.0f) && error.normal <= c.max_angle;
+			std::cout << (half ? "half" : "float") << " + " << c.name << ": stride " << buffer.layout.stride
+				<< ", position error " << position_error << (half ? " of the rounding bound" : "") << ", normal error " << error.normal
+				<< " rad (bound " << c.max_angle << ")" << (valid ? "" : " - FAILED") << std::endl;
+			success = success && valid;
+		}
+	}
+
+	// Values out of the half range saturate to infinity with their sign, instead of wrapping
+	bool const saturate = std::isinf(half_to_float(float_to_half(1e6f))) && half_to_float(float_to_half(-1e6f)) < 0.0f
+		&& half_to_float(float_to_half(65504.0f)) == 65504.0f;
+	std::cout << "half saturation: " << (saturate ? "ok" : "FAILED") << std::endl;
+	return success && saturate;
+}
+
+// The kernels write the packed output along with the float one: the bytes must be those of pack_vertices on their float output
+static bool check_kernel_output(int N_frame)
+{
+	skeleton_animation_structure skeleton;
+	rig_structure rig, velocity_rig;
+	mesh shape;
+	load_cylinder(skeleton, rig, shape);
+	load_animation_bend_zx(skeleton.animation_geometry_local, skeleton.animation_time, skeleton.parent_index);
+	init_velocity_skinning_weights(velocity_rig, rig, skeleton.parent_index);
+	numarray<affine_rt> const skeleton_rest_pose = skeleton.rest_pose_global();
+	size_t const N_vertex = shape.position.size();
+
+	skinning_buffers buffers;
+	if (!build_skinning_buffers(buffers, shape.position, shape.normal, rig, velocity_rig)) {
+		std::cout << "kernel output: could not allocate the arena - FAILED" << std::endl;
+		return false;
+	}
+
+	packed_vertex_buffer packed_compute, packed_arena, reference;
+	packed_compute.layout = build_packed_vertex_layout(packed_position_format::float16, packed_normal_format::octahedral);
+	packed_arena.layout = build_packed_vertex_layout(packed_position_format::float16, packed_normal_format::int_2_10_10_10);
+	reference.layout = packed_arena.layout;
+	packed_arena.resize(N_vertex);
+
+	numarray<vec3> position = shape.position, normal = shape.normal, position_arena(N_vertex), normal_arena(N_vertex);
+	numarray<affine_rt> old_joint_rt, old_joint_rt_arena, skeleton_local, skeleton_current;
+	numarray<vec3> old_velocity, old_velocity_arena;
+	velocity_skinning_frame frame;
+	float const dt = 1.0f / 60.0f;
+	float const duration = skeleton.animation_time[skeleton.animation_time.size() - 1] - skeleton.animation_time[0];
+
+	size_t mismatch = 0;
+	for (int k = 0; k < N_frame; ++k) {
+		float const t = skeleton.animation_time[0] + std::fmod(k * dt, duration);
+		skeleton.evaluate_local(t, skeleton_local);
+		skeleton_local_to_global(skeleton_local, skeleton.parent_index, skeleton_current);
+
+		velocity_skinning_compute(position, normal, skeleton_current, skeleton_rest_pose, shape.position, shape.normal,
+			rig, velocity_rig, old_joint_rt, old_velocity, dt, 0.9f, 0.1f, 1.0f, &packed_compute);
+		reference.layout = packed_compute.layout;
+		pack_vertices(reference, position, normal);
+		if (reference.bytes.size() != packed_compute.bytes.size() || std::memcmp(&reference.bytes[0], &packed_compute.bytes[0], reference.bytes.size()) != 0)
+			mismatch++;
+
+		velocity_skinning_prepare(frame, skeleton_current, skeleton_rest_pose, velocity_rig, old_joint_rt_arena, old_velocity_arena, dt, 0.9f);
+		velocity_skinning_vertices(0, N_vertex, buffers, skeleton_current, frame, 0.1f, 1.0f, &packed_arena);
+		velocity_skinning_finish(frame, skeleton_current, old_joint_rt_arena, old_velocity_arena, 0.9f);
+		for (size_t i = 0; i < N_vertex; ++i) {
+			position_arena[i] = buffers.position_skinned[i];
+			normal_arena[i] = buffers.normal_skinned[i];
+		}
+		reference.layout = packed_arena.layout;
+		pack_vertices(reference, position_arena, normal_arena);
+		if (std::memcmp(&reference.bytes[0], &packed_arena.bytes[0], reference.bytes.size()) != 0)
+			mismatch++;
+	}
+	std::cout << "kernel output: " << N_frame << " frames, " << mismatch << " packed buffers differing from their float output" << std::endl;
+	return mismatch == 0;
+}
+
+int main()
+{
+	bool success = check_round_trip(100000, 1);
+	success = check_kernel_output(120) && success;
+	return success ? 0 : 1;
+}
@@ -0,0 +1,353 @@
+// Differential test of the skinning implementations against the per-vertex kernel of the original code, frozen below:
+//  the velocity weights, velocity_skinning_compute on the built-in meshes and animations, and every candidate of the fuzz harness
+//  on random characters (fixed seed), over hundreds of frames of velocity state, then on the same characters after the rig optimizer.
+
+#include "cgp/cgp.hpp"
+#include "../src/skinning/skinning_fuzz.hpp"
+#include "../src/loader/skinning_loader.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+using namespace cgp;
+
+// Copy of init_velocity_skinning_weights and velocity_skinning_compute as they were before the optimized paths, logging removed.
+//  Not to be modified: it is the reference the current code is measured against.
+namespace baseline
+{
+	static void init_velocity_skinning_weights(
+		rig_structure& velocity_rig,
+		rig_structure const& rig,
+		numarray<int> const& parent_index)
+	{
+		int N_vertex = rig.joint.size();
+
+		// convert the parent_index array into a descendence array
+		// Note: the root is the only node with a parent_index of -1
+		numarray<numarray<int>> descendents_index;
+		descendents_index.resize(parent_index.size());
+		for (int child = 0; child < parent_index.size(); child++) {
+			int parent = child;
+			while (parent != -1) {
+				descendents_index[parent].push_back(child);
+				parent = parent_index[parent];
+			}
+		}
+
+		// compute the velocity weights
+		velocity_rig.joint.resize(N_vertex);
+		for (int i = 0; i < N_vertex; i++) {
+			velocity_rig.joint[i].resize(rig.joint[i].size());
+			for (int j = 0; j < rig.joint[i].size(); j++) {
+				velocity_rig.joint[i][j] = rig.joint[i][j];
+			}
+		}
+
+		velocity_rig.weight.resize(N_vertex);
+		for (int i = 0; i < N_vertex; i++) {
+
+			// calculate the weights associated to vertex i
+			velocity_rig.weight[i].resize(rig.joint[i].size());
+
+			for (int j = 0; j < rig.joint[i].size(); j++) {
+
+				// for every joint to which vertex i is attached
+				int joint = rig.joint[i][j];
+				float velocity_weight = 0.0f;
+				for (int k = 0; k < descendents_index[joint].size(); k++) {
+					int child = descendents_index[joint][k];
+					int weight_index = 0;
+					while (weight_index < rig.joint[i].size() && rig.joint[i][weight_index] != child) {
+						weight_index++;
+					}
+					if (weight_index < rig.joint[i].size())
+						velocity_weight += rig.weight[i][weight_index];
+				}
+				velocity_rig.weight[i][j] = velocity_weight;
+			}
+		}
+	}
+
+	static void compute_linear_velocity_deformation(
+		int idx,
+		numarray<vec3>& position_skinned,
+		numarray<vec3> const& translation_velocity,
+		rig_structure const& velocity_rig,
+		numarray<vec3> const& old_velocity,
+		float const speed_blending,
+		float const deformation_intensity
+	)
+	{
+		vec3 deformation = vec3(0, 0, 0);
+		for (int j = 0; j < velocity_rig.joint[idx].size(); j++) {
+			int joint_nb = velocity_rig.joint[idx][j];
+			float weight = velocity_rig.weight[idx][j];
+			deformation += weight * ((1 - speed_blending) * translation_velocity[joint_nb] + speed_blending * old_velocity[joint_nb]);
+		}
+
+		position_skinned[idx] -= deformation * deformation_intensity;
+	}
+
+	static void velocity_skinning_compute(
+		numarray<vec3>& position_skinned,
+		numarray<vec3>& normal_skinned,
+		numarray<affine_rt> const& skeleton_current,
+		numarray<affine_rt> const& skeleton_rest_pose,
+		numarray<vec3> const& position_rest_pose,
+		numarray<vec3> const& normal_rest_pose,
+		rig_structure const& rig,
+		rig_structure const& velocity_rig,
+		numarray<affine_rt>& old_joint_rt,
+		numarray<vec3>& old_velocity,
+		float dt,
+		float const speed_blending,
+		float const linear_deformation_intensity,
+		float const rotational_deformation_intensity
+	)
+	{
+		size_t const N_vertex = position_rest_pose.size();
+		size_t const N_joint = skeleton_current.size();
+
+		// LBS
+		for (int i = 0; i < N_vertex; i++) {
+			mat4 M = mat4::build_zero();
+
+			for (int j = 0; j < rig.joint[i].size(); j++) {
+				// compute the transformation matrix corresponding to the new position of that vertex
+				int joint_nb = rig.joint[i][j];
+				float weight = rig.weight[i][j];
+
+				mat4 T = skeleton_current[joint_nb].matrix();
+				mat4 T0inv = inverse(skeleton_rest_pose[joint_nb]).matrix();
+				M += weight * T * T0inv;
+			}
+
+			position_skinned[i] = M * position_rest_pose[i];
+			normal_skinned[i] = M * normal_rest_pose[i];
+		}
+
+		// if old_joint_rt is empty, wait for next iteration
+		if (old_joint_rt.size() == 0) {
+			old_joint_rt.resize(N_joint);
+			for (int i = 0; i < N_joint; i++) {
+				old_joint_rt[i] = skeleton_current[i];
+			}
+
+			// also initialise old_velocity
+			old_velocity.resize(N_joint);
+			for (int i = 0; i < N_joint; i++) {
+				old_velocity[i] = vec3(0, 0, 0);
+			}
+			return;
+		}
+
+		// if weights arent initialised yet, skip velocity skinning on first iteration
+		if (velocity_rig.joint.size() == 0) {
+			return;
+		}
+
+		// linear velocity skinning
+		numarray<vec3> translation_velocity = numarray<vec3>(N_joint);
+		for (int i = 0; i < N_joint; i++) {
+			translation_velocity[i] = (skeleton_current[i].translation - old_joint_rt[i].translation) / dt;
+		}
+
+		for (int i = 0; i < N_vertex; i++) {
+			baseline::compute_linear_velocity_deformation(
+				i,
+				position_skinned,
+				translation_velocity,
+				velocity_rig,
+				old_velocity,
+				speed_blending,
+				linear_deformation_intensity
+			);
+		}
+
+		// rotational velocity skinning
+		for (int i = 0; i < N_vertex; i++) {
+			vec3 deformation = vec3(0, 0, 0);
+			for (int j = 0; j < velocity_rig.joint[i].size(); j++) {
+				int joint = velocity_rig.joint[i][j];
+				affine_rt diff = skeleton_current[joint] * inverse(old_joint_rt[joint]);
+				quaternion diff_q = diff.rotation.quat();
+
+				float theta = 2 * std::atan2(norm(diff_q.xyz()), diff_q.w);
+				if (norm(diff_q.xyz()) < 0.001) continue;
+				vec3 angular_velocity_direction = normalize(diff_q.xyz());
+
+				vec3 p_proj = skeleton_current[joint].translation + dot(position_skinned[i] - skeleton_current[joint].translation, angular_velocity_direction) * angular_velocity_direction;
+				vec3 p_pi = position_skinned[i] - p_proj;
+				float angle = norm(cross(angular_velocity_direction, p_pi) * theta) * 5;
+
+				rotation_transform rotation = rotation_transform::from_axis_angle(angular_velocity_direction, angle);
+				vec3 joint_j_deformation = rotation * (position_skinned[i] - skeleton_current[joint].translation) -
+					(position_skinned[i] - skeleton_current[joint].translation);
+				deformation += joint_j_deformation * velocity_rig.weight[i][j];
+			}
+			position_skinned[i] -= deformation * rotational_deformation_intensity;
+		}
+
+		// update old position & velocity
+		for (int i = 0; i < N_joint; i++) {
+			old_joint_rt[i] = skeleton_current[i];
+			old_velocity[i] = (1 - speed_blending) * translation_velocity[i] + speed_blending * old_velocity[i];
+		}
+	}
+}
+
+static skinning_candidate baseline_reference()
+{
+	struct state
+	{
+		numarray<affine_rt> old_joint_rt;
+		numarray<vec3> old_velocity;
+	};
+
+	skinning_candidate reference;
+	reference.name = "baseline kernel";
+	reference.create = [](skinning_fuzz_case const& fuzz_case, skinning_fuzz_parameters const& parameters) -> skinning_frame_function {
+		std::shared_ptr<state> s = std::make_shared<state>();
+		return [&fuzz_case, parameters, s](numarray<affine_rt> const& skeleton_current, numarray<vec3>& position, numarray<vec3>& normal) {
+			position.resize(fuzz_case.position_rest_pose.size());
+			normal.resize(fuzz_case.position_rest_pose.size());
+			baseline::velocity_skinning_compute(position, normal, skeleton_current, fuzz_case.skeleton_rest_pose,
+				fuzz_case.position_rest_pose, fuzz_case.normal_rest_pose, fuzz_case.rig, fuzz_case.velocity_rig,
+				s->old_joint_rt, s->old_velocity, parameters.dt,
+				parameters.speed_blending, parameters.linear_deformation_intensity, parameters.rotational_deformation_intensity);
+		};
+	};
+	return reference;
+}
+
+static float max_weight_difference(rig_structure const& a, rig_structure const& b)
+{
+	if (a.joint.size() != b.joint.size())
+		return 1e30f;
+	float difference = 0.0f;
+	for (size_t i = 0; i < a.joint.size(); ++i) {
+		if (a.joint[i].size() != b.joint[i].size() || a.weight[i].size() != b.weight[i].size())
+			return 1e30f;
+		for (size_t j = 0; j < a.joint[i].size(); ++j) {
+			if (a.joint[i][j] != b.joint[i][j])
+				return 1e30f;
+			difference = std::max(difference, std::abs(a.weight[i][j] - b.weight[i][j]));
+		}
+	}
+	return difference;
+}
+
+// init_velocity_skinning_weights of the random characters, compared to the baseline
+static bool check_weights(unsigned int first_seed, int number_case, skinning_fuzz_parameters const& parameters)
+{
+	skinning_fuzz_case fuzz_case;
+	rig_structure velocity_rig;
+	float max_difference = 0.0f;
+	for (int k = 0; k < number_case; ++k) {
+		generate_skinning_fuzz_case(fuzz_case, first_seed + unsigned(k), parameters);
+		baseline::init_velocity_skinning_weights(velocity_rig, fuzz_case.rig, fuzz_case.skeleton.parent_index);
+		max_difference = std::max(max_difference, max_weight_difference(fuzz_case.velocity_rig, velocity_rig));
+	}
+	std::cout << "velocity weights: " << number_case << " cases, max difference " << max_difference << std::endl;
+	return max_difference == 0.0f;
+}
+
+// velocity_skinning_compute on the meshes and clips of the application, compared to the baseline kernel.
+//  Only the order of the float operations differs: the deviation must stay below tolerance.
+static bool check_built_in_characters(int N_frame, float tolerance)
+{
+	void (*const load_shape[2])(skeleton_animation_structure&, rig_structure&, mesh&) = { load_cylinder, load_rectangle };
+	void (*const load_animation[4])(numarray<numarray<affine_rt>>&, numarray<float>&, numarray<int> const&) = {
+		load_animation_bend_z, load_animation_bend_zx, load_animation_twist_x, load_animation_translation };
+	float const dt = 1.0f / 60.0f;
+
+	float max_error = 0.0f;
+	for (int s = 0; s < 2; ++s) {
+		for (int a = 0; a < 4; ++a) {
+			skeleton_animation_structure skeleton;
+			rig_structure rig, velocity_rig;
+			mesh shape;
+			load_shape[s](skeleton, rig, shape);
+			load_animation[a](skeleton.animation_geometry_local, skeleton.animation_time, skeleton.parent_index);
+			init_velocity_skinning_weights(velocity_rig, rig, skeleton.parent_index);
+			numarray<affine_rt> const skeleton_rest_pose = skeleton.rest_pose_global();
+
+			numarray<vec3> position = shape.position, normal = shape.normal;
+			numarray<vec3> position_baseline = shape.position, normal_baseline = shape.normal;
+			numarray<affine_rt> old_joint_rt, old_joint_rt_baseline, skeleton_local, skeleton_current;
+			numarray<vec3> old_velocity, old_velocity_baseline;
+			float const duration = skeleton.animation_time[skeleton.animation_time.size() - 1] - skeleton.animation_time[0];
+			for (int frame = 0; frame < N_frame; ++frame) {
+				float const t = skeleton.animation_time[0] + std::fmod(frame * dt, duration);
+				skeleton.evaluate_local(t, skeleton_local);
+				skeleton_local_to_global(skeleton_local, skeleton.parent_index, skeleton_current);
+
+				velocity_skinning_compute(position, normal, skeleton_current, skeleton_rest_pose, shape.position, shape.normal,
+					rig, velocity_rig, old_joint_rt, old_velocity, dt, 0.9f, 0.1f, 1.0f);
+				baseline::velocity_skinning_compute(position_baseline, normal_baseline, skeleton_current, skeleton_rest_pose, shape.position, shape.normal,
+					rig, velocity_rig, old_joint_rt_baseline, old_velocity_baseline, dt, 0.9f, 0.1f, 1.0f);
+				for (size_t i = 0; i < position.size(); ++i)
+					max_error = std::max(max_error, std::max(norm(position[i] - position_baseline[i]), norm(normal[i] - normal_baseline[i])));
+			}
+		}
+	}
+	std::cout << "built-in characters: 8 shape/clip pairs, " << N_frame << " frames, max error " << max_error << " (tolerance " << tolerance << ")" << std::endl;
+	return max_error < tolerance;
+}
+
+// velocity_skinning_compute and the candidates of the harness on random characters, with the baseline kernel as reference
+static bool check_fuzz(unsigned int first_seed, int number_case, skinning_fuzz_parameters const& parameters, float compute_tolerance)
+{
+	numarray<skinning_candidate> candidates;
+	candidates.push_back(default_skinning_reference());
+	for (skinning_candidate const& candidate : default_skinning_candidates())
+		candidates.push_back(candidate);
+
+	numarray<skinning_fuzz_report> const report = run_skinning_fuzz(baseline_reference(), candidates, first_seed, number_case, parameters);
+
+	bool success = true;
+	std::cout << "fuzz: " << number_case << " cases from seed " << first_seed << ", " << parameters.number_frame << " frames each";
+	if (parameters.optimized_max_influence > 0)
+		std::cout << ", rigs optimized to " << parameters.optimized_max_influence << " influences";
+	std::cout << std::endl;
+	for (size_t k = 0; k < report.size(); ++k) {
+		skinning_fuzz_report const& r = report[k];
+		std::cout << "  " << r.candidate << ": " << r.case_run << " cases, max error " << r.max_error;
+		if (r.diverged) {
+			success = false;
+			std::cout << " - DIVERGED, seed " << r.seed;
+			if (r.frame != -1)
+				std::cout << " frame " << r.frame << " vertex " << r.vertex << (r.normal ? " (normal)" : " (position)");
+			std::cout << " error " << r.error;
+		}
+		std::cout << std::endl;
+	}
+
+	// The exact path only associates the palette product differently (weight * (T * T0inv) instead of (weight * T) * T0inv),
+	//  amplified by the rotational deformation on long chains: about 2e-5 on these characters, 0 with the same association
+	if (report[0].max_error >= compute_tolerance) {
+		std::cout << "velocity_skinning_compute deviates from the baseline by " << report[0].max_error << " (tolerance " << compute_tolerance << ")" << std::endl;
+		success = false;
+	}
+	return success;
+}
+
+int main()
+{
+	skinning_fuzz_parameters parameters;
+	parameters.number_frame = 300;
+	unsigned int const seed = 1;
+	int const number_case = 40;
+
+	bool success = check_weights(seed, number_case, parameters);
+	success = check_built_in_characters(300, 3e-7f) && success;
+	success = check_fuzz(seed, number_case, parameters, 5e-5f) && success;
+
+	// Again on rigs reduced by the rig optimizer: the candidates rebuild their data (CSR arena, sparse weights of the batches) from the reduced rig
+	skinning_fuzz_parameters optimized = parameters;
+	optimized.optimized_max_influence = 2;
+	success = check_fuzz(seed, 10, optimized, 5e-5f) && success;
+	return success ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+// Stress of the hand-offs between threads, meant to be run under ThreadSanitizer (cmake -DSANITIZE_THREAD=ON, or make SANITIZE_THREAD=1 test):
+//  a producer and a consumer exchanging blocks through a triple_buffer,
+//  then a skinning_worker started, fed with inputs, reloaded with other contents and stopped, several times,
+//  then a task_scheduler rebuilt with different numbers of threads, each pool running a series of graphs.
+
+#include "cgp/cgp.hpp"
+#include "../src/scheduler/triple_buffer.hpp"
+#include "../src/scheduler/task_graph.hpp"
+#include "../src/skinning/skinning_thread.hpp"
+#include "../src/loader/procedural_rig.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace cgp;
+
+// Every block published holds its sequence number in all its entries: a torn read mixes two numbers
+static bool stress_triple_buffer(int N_value, size_t block_size)
+{
+	numarray<int> initial;
+	initial.resize(block_size);
+	initial.fill(0);
+	triple_buffer<numarray<int> > channel;
+	channel.reset(initial);
+
+	std::thread producer([&]() {
+		for (int s = 1; s <= N_value; ++s) {
+			numarray<int>& block = channel.write_buffer();
+			block.resize(block_size);
+			block.fill(s);
+			channel.publish();
+			if (s % 64 == 0)
+				std::this_thread::yield(); // lets the consumer interleave on few cores
+		}
+	});
+
+	int last = 0;
+	size_t received = 0, torn = 0, backward = 0;
+	while (last < N_value) {
+		if (!channel.update()) {
+			std::this_thread::yield();
+			continue;
+		}
+		numarray<int> const& block = channel.read_buffer();
+		for (size_t k = 0; k < block.size(); ++k)
+			if (block[k] != block[0]) {
+				torn++;
+				break;
+			}
+		if (block[0] <= last)
+			backward++;
+		last = block[0];
+		received++;
+	}
+	producer.join();
+
+	std::cout << "triple_buffer: " << N_value << " published, " << received << " received, " << torn << " torn, " << backward << " out of order" << std::endl;
+	return torn == 0 && backward == 0;
+}
+
+static std::shared_ptr<skinning_content const> procedural_content(int number_joint)
+{
+	procedural_rig_parameters parameters;
+	parameters.number_joint = number_joint;
+	parameters.ring = 4;
+	parameters.radial = 8;
+	parameters.number_thread = 1;
+
+	std::shared_ptr<skinning_content> content = std::make_shared<skinning_content>();
+	mesh shape;
+	load_procedural_rig(parameters, content->skeleton, content->rig, shape);
+	load_procedural_animation(parameters, procedural_motion::wave, content->skeleton.animation_geometry_local, content->skeleton.animation_time,
+		content->skeleton.parent_index);
+	init_velocity_skinning_weights(content->velocity_rig, content->rig, content->skeleton.parent_index);
+	content->skeleton_rest_pose = content->skeleton.rest_pose_global();
+	content->position_rest_pose = shape.position;
+	content->normal_rest_pose = shape.normal;
+	return content;
+}
+
+// The results must always come from one of the published contents, with its sizes
+static bool stress_skinning_worker(int N_cycle, int N_frame)
+{
+	std::shared_ptr<skinning_content const> const content[2] = { procedural_content(4), procedural_content(9) };
+
+	skinning_worker worker;
+	worker.rate = 1000.0f;
+	size_t received = 0, incoherent = 0;
+	for (int cycle = 0; cycle < N_cycle; ++cycle) {
+		worker.start();
+		for (int frame = 0; frame < N_frame; ++frame) {
+			if (frame % 25 == 0)
+				worker.publish_content(content[(cycle + frame / 25) % 2]);
+
+			skinning_worker_input input;
+			input.t = 0.01f * frame;
+			worker.publish_input(input);
+
+			skinning_worker_output const* output = worker.receive();
+			if (output != nullptr) {
+				received++;
+				bool const known = output->content == content[0] || output->content == content[1];
+				if (!known || output->position.size() != output->content->position_rest_pose.size()
+					|| output->normal.size() != output->content->position_rest_pose.size()
+					|| output->skeleton.size() != output->content->skeleton.number_joint())
+					incoherent++;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+		worker.stop();
+	}
+
+	std::cout << "skinning_worker: " << N_cycle << " start/stop, " << received << " results received, " << incoherent << " incoherent" << std::endl;
+	return received > 0 && incoherent == 0;
+}
+
+// Every task of every run must be executed exactly once, including the first runs after a change of the number of threads
+static bool stress_task_scheduler(int N_run, int N_task)
+{
+	size_t const thread_count[] = { 4, 2, 3, 1, 4, 2 };
+	std::unique_ptr<std::atomic<int>[]> counter(new std::atomic<int>[N_task]);
+	task_scheduler scheduler;
+	task_graph graph;
+	size_t run = 0, wrong = 0;
+	for (size_t const N_thread : thread_count) {
+		scheduler.initialize(N_thread);
+		for (int k = 0; k < N_run; ++k) {
+			graph.clear();
+			for (int t = 0; t < N_task; ++t) {
+				counter[t].store(0);
+				int const task = graph.add("task", [&counter, t]() { counter[t].fetch_add(1); });
+				if (t > 0 && t % 4 != 0)
+					graph.depend(task, t - 1); // chains of 4 tasks, the chains are independent
+			}
+			scheduler.run(graph);
+			run++;
+			for (int t = 0; t < N_task; ++t)
+				if (counter[t].load() != 1)
+					wrong++;
+		}
+	}
+	scheduler.shutdown();
+
+	std::cout << "task_scheduler: " << run << " runs on pools of 4, 2, 3, 1, 4, 2 threads, " << wrong << " tasks not executed exactly once" << std::endl;
+	return wrong == 0;
+}
+
+int main()
+{
+	bool success = stress_triple_buffer(200000, 64);
+	success = stress_skinning_worker(4, 200) && success;
+	success = stress_task_scheduler(200, 32) && success;
+	return success ? 0 : 1;
+}
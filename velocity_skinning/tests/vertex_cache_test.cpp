@@ -0,0 +1,166 @@
+// Round trip of the vertex cache: random moving vertices encoded, written, read back and decoded, against their quantization bound.
+//  Then the reader must reject the files whose header does not match their content, before allocating anything.
+
+#include "cgp/cgp.hpp"
+#include "../src/skinning/vertex_cache.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cgp;
+
+// Smooth motion of random points (what the cache predicts well), with a few jumps (what it does not)
+static void random_frame(size_t frame, numarray<vec3> const& origin, numarray<vec3>& position, numarray<vec3>& normal)
+{
+	size_t const N = origin.size();
+	position.resize(N);
+	normal.resize(N);
+	float const t = 0.05f * frame;
+	for (size_t i = 0; i < N; ++i) {
+		vec3 const& p = origin[i];
+		position[i] = p + vec3(0.3f * std::sin(t + p.x), 0.2f * std::cos(2 * t + p.y), (i % 97 == 0 && frame % 7 == 0) ? 1.0f : 0.0f);
+		normal[i] = vec3(std::cos(t + p.z), std::sin(t + p.z), p.x - p.y);
+	}
+}
+
+static std::vector<char> read_file(std::string const& filename)
+{
+	std::ifstream stream(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+static void write_file(std::string const& filename, std::vector<char> const& bytes)
+{
+	std::ofstream stream(filename, std::ios::binary);
+	stream.write(bytes.data(), bytes.size());
+}
+
+static bool same_cache(vertex_cache const& a, vertex_cache const& b)
+{
+	return a.number_vertex == b.number_vertex && a.number_frame == b.number_frame && a.block.size() == b.block.size()
+		&& a.bytes.size() == b.bytes.size() && std::memcmp(a.block.data.data(), b.block.data.data(), a.block.size() * sizeof(vertex_cache_block)) == 0
+		&& std::memcmp(a.bytes.data.data(), b.bytes.data.data(), a.bytes.size()) == 0;
+}
+
+static bool check_round_trip(std::string const& filename, size_t N_vertex, size_t N_frame)
+{
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> coordinate(-2.0f, 2.0f);
+	numarray<vec3> origin(N_vertex);
+	for (vec3& p : origin)
+		p = vec3(coordinate(generator), coordinate(generator), coordinate(generator));
+
+	vertex_cache_parameters parameters;
+	parameters.frames_per_chunk = 16;
+	parameters.vertices_per_block = 1000; // a partial last block
+	vertex_cache cache;
+	vertex_cache_encoder encoder;
+	encoder.begin(cache, N_vertex, parameters);
+	numarray<vec3> position, normal;
+	for (size_t f = 0; f < N_frame; ++f) {
+		random_frame(f, origin, position, normal);
+		encoder.add_frame(position, normal);
+	}
+	encoder.finish(); // a partial last chunk
+
+	vertex_cache read;
+	bool const io = write_vertex_cache(filename, cache) && read_vertex_cache(filename, read) && same_cache(cache, read);
+
+	// Positions within half a quantization step of their block (relative error below 1), normals within the octahedral precision of the bits
+	vertex_cache_decoder decoder;
+	decoder.number_thread = 2;
+	decoder.open(read);
+	float position_error = 0.0f, normal_error = 0.0f;
+	numarray<vec3> decoded_position, decoded_normal;
+	for (size_t f = 0; f < N_frame; ++f) {
+		random_frame(f, origin, position, normal);
+		decoder.decode_frame(f, decoded_position, decoded_normal);
+		size_t const chunk = f / parameters.frames_per_chunk;
+		for (size_t b = 0; b < read.number_block_per_chunk(); ++b) {
+			vertex_cache_block const& block = read.block[chunk * read.number_block_per_chunk() + b];
+			for (size_t i = block.first_vertex; i < block.first_vertex + block.vertex_count; ++i) {
+				for (int c = 0; c < 3; ++c) {
+					// Half a step, plus the float rounding of the decoded position_min + q * position_step
+					float const bound = 0.5f * block.position_step[c] + 4 * FLT_EPSILON * std::max(std::abs(position[i][c]), std::abs(block.position_min[c]));
+					position_error = std::max(position_error, std::abs(decoded_position[i][c] - position[i][c]) / bound);
+				}
+				vec3 const n = normalize(normal[i]);
+				normal_error = std::max(normal_error, std::atan2(norm(cross(n, decoded_normal[i])), dot(n, decoded_normal[i])));
+			}
+		}
+	}
+	// Octahedral coordinates on 12 bits: about 2/2047 per coordinate, at most ~1.5 times that as an angle
+	float const normal_bound = 2e-3f;
+	bool const valid = io && position_error <= 1.0f && normal_error <= normal_bound;
+	std::cout << "round trip of " << N_vertex << " vertices x " << N_frame << " frames: " << cache.bytes.size() << " bytes, file "
+		<< (io ? "identical" : "DIFFERENT") << ", position error " << position_error << " of the bound, normal error " << normal_error
+		<< " rad (bound " << normal_bound << ")" << (valid ? "" : " - FAILED") << std::endl;
+	return valid;
+}
+
+// Offsets of the header fields (magic, then the 64-bit counts)
+static size_t const vertex_count_offset = 8;
+static size_t const frame_count_offset = 16;
+static size_t const byte_count_offset = 32;
+
+static std::vector<char> with_field(std::vector<char> bytes, size_t offset, uint64_t value)
+{
+	std::memcpy(&bytes[offset], &value, sizeof(value));
+	return bytes;
+}
+
+static uint64_t field(std::vector<char> const& bytes, size_t offset)
+{
+	uint64_t value;
+	std::memcpy(&value, &bytes[offset], sizeof(value));
+	return value;
+}
+
+static bool check_rejected(std::string const& filename)
+{
+	std::vector<char> const valid = read_file(filename);
+	std::vector<char> const truncated(valid.begin(), valid.end() - 1);
+	std::vector<char> extended = valid;
+	extended.push_back(0);
+
+	struct corrupted_case { char const* name; std::vector<char> bytes; };
+	corrupted_case const cases[] = {
+		{ "truncated", truncated },
+		{ "extended", extended },
+		{ "header only", std::vector<char>(valid.begin(), valid.begin() + 64) },
+		{ "byte count past the end", with_field(valid, byte_count_offset, field(valid, byte_count_offset) + 1) },
+		{ "huge byte count", with_field(valid, byte_count_offset, uint64_t(1) << 62) },
+		{ "huge vertex count", with_field(valid, vertex_count_offset, uint64_t(1) << 40) },
+		{ "vertex count of more blocks", with_field(valid, vertex_count_offset, field(valid, vertex_count_offset) + 1000) },
+		{ "huge frame count", with_field(valid, frame_count_offset, uint64_t(1) << 62) },
+		{ "frame count of more chunks", with_field(valid, frame_count_offset, field(valid, frame_count_offset) + 16) } };
+
+	bool success = true;
+	std::string const corrupted_filename = filename + ".corrupted";
+	for (corrupted_case const& c : cases) {
+		write_file(corrupted_filename, c.bytes);
+		vertex_cache cache;
+		bool const rejected = !read_vertex_cache(corrupted_filename, cache);
+		std::cout << c.name << ": " << (rejected ? "rejected" : "ACCEPTED") << std::endl;
+		success = success && rejected;
+	}
+	std::remove(corrupted_filename.c_str());
+	return success;
+}
+
+int main()
+{
+	std::string const filename = "vertex_cache_test.vscache";
+	bool success = check_round_trip(filename, 2500, 70);
+	success = check_rejected(filename) && success;
+	std::remove(filename.c_str());
+	return success ? 0 : 1;
+}